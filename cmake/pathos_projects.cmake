@@ -22,4 +22,23 @@ macro(add_pathos_app name sources)
                 $<TARGET_FILE_DIR:${name}>)
     endif()
 
+endmacro()
+
+macro(add_pathos_test name sources)
+    message("Adding pathos test: ${name}")
+    add_executable(${name} ${sources})
+    set_target_properties(${name} PROPERTIES FOLDER pathos_tests)
+    source_group(TREE ${CMAKE_CURRENT_SOURCE_DIR} PREFIX "src" FILES ${sources})
+    target_include_directories(${name} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR})
+    add_test(NAME ${name} COMMAND ${name} WORKING_DIRECTORY ${PATHOS_ASSSET_DIR})
+endmacro()
+
+# Benchmarks also get a ctest entry running with --quick, as a fast regression check of the benchmarked code.
+macro(add_pathos_bench name sources)
+    message("Adding pathos benchmark: ${name}")
+    add_executable(${name} ${sources})
+    set_target_properties(${name} PROPERTIES FOLDER pathos_bench)
+    source_group(TREE ${CMAKE_CURRENT_SOURCE_DIR} PREFIX "src" FILES ${sources})
+    target_include_directories(${name} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR})
+    add_test(NAME ${name}_quick COMMAND ${name} --quick WORKING_DIRECTORY ${PATHOS_ASSSET_DIR})
 endmacro()
\ No newline at end of file
@@ -29,6 +29,11 @@ static core::CVar<float> s_camFarPlane("cam.far_plane", "Camera far plane", 5000
 
 static core::CVar<bool> s_vsync("app.vsync", "Vsync enabled", true);
 
+static core::CVar<uint32_t> s_worldTestGrid("world.test_grid", "Streams an N by N grid of test models (0 for none)", 0, 0, 1024);
+static core::CVar<float> s_worldTestGridSpacing("world.test_grid_spacing", "Distance between test grid models", 16.0f, 1.0f, 256.0f);
+static core::CVar<bool> s_worldFlyThrough("world.fly_through", "Flies the camera diagonally across the streamed world then logs a hitch report", false);
+static core::CVar<float> s_worldFlyThroughSpeed("world.fly_through_speed", "Fly through camera speed", 50.0f, 1.0f, 1000.0f);
+
 static const float c_shadowMapRes = 2048.0f;
 
 void TestbedApp::Setup()
@@ -37,6 +42,8 @@ void TestbedApp::Setup()
 
 	m_scene.Init(uint32_t(c_shadowMapRes));
 
+	m_world.Init(&m_scene);
+
 	m_sceneWindow.SetScene(&m_scene);
 	m_sceneWindow.SetMainViewCamera(&m_cam);
 
@@ -124,6 +131,80 @@ void ShadowTest(gpu::cmd::Context* _ctx, TestbedApp& _app)
 	_app.m_scene.RenderCascadeViews(_ctx);
 }
 
+void TestbedApp::UpdateStreamedWorld(float _dt)
+{
+	if (m_worldTestGridSize != s_worldTestGrid)
+	{
+		m_worldTestGridSize = s_worldTestGrid;
+
+		float const cellSize = m_world.CellSize();
+		m_world.Shutdown();
+		m_world.Init(&m_scene, cellSize);
+
+		float const spacing = s_worldTestGridSpacing;
+		for (uint32_t z = 0; z < m_worldTestGridSize; ++z)
+		{
+			for (uint32_t x = 0; x < m_worldTestGridSize; ++x)
+			{
+				// Mostly small models with the odd large one, so cells have uneven costs.
+				char const* path = (x + z) % 8 == 0 ? "models/rainier_ak/Scene.gltf" : "models/DamagedHelmet/DamagedHelmet.gltf";
+				m_world.AddInstance(path, kt::Mat4::Translation(kt::Vec3(float(x) * spacing, 0.0f, float(z) * spacing)));
+			}
+		}
+	}
+
+	if (s_worldFlyThrough && !m_flyThrough.m_active)
+	{
+		if (m_world.Cells().Size() == 0)
+		{
+			KT_LOG_INFO("Fly through: the streamed world is empty, set world.test_grid first.");
+			s_worldFlyThrough.Set(false);
+		}
+		else
+		{
+			m_flyThrough = FlyThrough{};
+			m_flyThrough.m_active = true;
+			m_world.ResetHitchStats();
+		}
+	}
+
+	bool flyThroughDone = m_flyThrough.m_active && !s_worldFlyThrough;
+
+	if (m_flyThrough.m_active)
+	{
+		kt::AABB const& bounds = m_world.InstanceBounds();
+		kt::Vec3 const start = kt::Vec3(bounds.m_min.x, m_cam.GetPos().y, bounds.m_min.z);
+		kt::Vec3 const end = kt::Vec3(bounds.m_max.x, m_cam.GetPos().y, bounds.m_max.z);
+		float const length = kt::Length(end - start);
+
+		m_flyThrough.m_distance = kt::Min(m_flyThrough.m_distance + _dt * s_worldFlyThroughSpeed, length);
+		m_cam.SetCameraPos(length > 0.0f ? start + (end - start) * (m_flyThrough.m_distance / length) : start);
+
+		// The first frame's dt is from before the run started.
+		if (m_flyThrough.m_numFrames++ != 0)
+		{
+			m_flyThrough.m_totalFrameMs += _dt * 1000.0f;
+			m_flyThrough.m_maxFrameMs = kt::Max(m_flyThrough.m_maxFrameMs, _dt * 1000.0f);
+		}
+
+		flyThroughDone |= m_flyThrough.m_distance >= length;
+	}
+
+	m_world.Update(m_cam.GetPos());
+
+	if (flyThroughDone)
+	{
+		gfx::StreamedWorld::Stats const& stats = m_world.GetStats();
+		uint32_t const numFrames = kt::Max(m_flyThrough.m_numFrames, 2u) - 1;
+
+		KT_LOG_INFO("Fly through: %u frames, %.2fms average frame, %.2fms worst frame.", numFrames, m_flyThrough.m_totalFrameMs / float(numFrames), m_flyThrough.m_maxFrameMs);
+		KT_LOG_INFO("Fly through: %u of %u stream updates were hitches, %.2fms worst update, %u cell loads, %u cell unloads.", stats.m_numHitches, stats.m_numUpdates, stats.m_maxUpdateMs, stats.m_numCellLoads, stats.m_numCellUnloads);
+
+		m_flyThrough.m_active = false;
+		s_worldFlyThrough.Set(false);
+	}
+}
+
 void TestbedApp::Tick(float _dt)
 {
 	gpu::SetVsyncEnabled(s_vsync);
@@ -136,6 +217,8 @@ void TestbedApp::Tick(float _dt)
 	m_cam.SetProjection(params);
 
 	m_camController.UpdateCamera(_dt, m_cam);
+	UpdateStreamedWorld(_dt);
+
 	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
 
 	m_scene.BeginFrameAndUpdateBuffers(ctx, m_cam, _dt);
@@ -168,6 +251,14 @@ void TestbedApp::Tick(float _dt)
 
 	m_scene.RenderInstances(ctx);
 
+	if (m_scene.BuildDepthPyramidAndCullLate(ctx, depth))
+	{
+		gpu::cmd::SetPSO(ctx, m_pso);
+		gpu::cmd::SetRenderTarget(ctx, 0, backbuffer);
+		gpu::cmd::SetDepthBuffer(ctx, depth);
+		m_scene.RenderLateInstances(ctx);
+	}
+
 	m_skyboxRenderer.Render(ctx, m_cam);
 	
 
@@ -176,6 +267,7 @@ void TestbedApp::Tick(float _dt)
 
 void TestbedApp::Shutdown()
 {
+	m_world.Shutdown();
 }
 
 void TestbedApp::HandleInputEvent(input::Event const& _ev)
@@ -10,6 +10,7 @@
 #include <gfx/Model.h>
 #include <gfx/Scene.h>
 #include <gfx/Primitive.h>
+#include <gfx/StreamedWorld.h>
 
 #include <editor/Windows/GFXSceneWindow.h>
 
@@ -21,6 +22,8 @@ struct TestbedApp : app::GraphicsApp
 
 	void HandleInputEvent(input::Event const& _ev) override;
 
+	void UpdateStreamedWorld(float _dt);
+
 	editor::GFXSceneWindow m_sceneWindow;
 	gfx::Scene m_scene;
 
@@ -37,5 +40,21 @@ struct TestbedApp : app::GraphicsApp
 	gfx::SkyBoxRenderer m_skyboxRenderer;
 
 	gfx::ResourceManager::ModelIdx m_modelIdx;
+
+	gfx::StreamedWorld m_world;
+	uint32_t m_worldTestGridSize = 0;
+
+	// world.fly_through run in progress.
+	struct FlyThrough
+	{
+		bool m_active = false;
+		float m_distance = 0.0f;
+
+		uint32_t m_numFrames = 0;
+		float m_totalFrameMs = 0.0f;
+		float m_maxFrameMs = 0.0f;
+	};
+
+	FlyThrough m_flyThrough;
 };
 
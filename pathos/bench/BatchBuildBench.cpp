@@ -0,0 +1,192 @@
+#include "Bench.h"
+#include "HeadlessGfx.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+#include <kt/Vec4.h>
+
+#include <core/Memory.h>
+#include <core/Jobs.h>
+
+#include <gpu/GPUDevice.h>
+#include <gpu/null/GPUDevice_Null.h>
+
+#include <gfx/InstanceTable.h>
+#include <gfx/MeshRenderer.h>
+#include <gfx/Material.h>
+
+static uint32_t const c_numMeshes = 16;
+
+// Meshes of one to six submeshes and one to four lods, with every alpha mode, so instances spread over many draws and all buckets.
+static void CreateBenchMeshes(gfx::ResourceManager::MeshIdx* o_meshes)
+{
+	gfx::Material::AlphaMode const modes[] = { gfx::Material::AlphaMode::Opaque, gfx::Material::AlphaMode::Mask, gfx::Material::AlphaMode::Transparent };
+	gfx::ResourceManager::MaterialIdx materials[6];
+
+	for (uint32_t i = 0; i < KT_ARRAY_COUNT(materials); ++i)
+	{
+		materials[i] = gfx::ResourceManager::CreateMaterial();
+		gfx::ResourceManager::GetMaterial(materials[i])->m_params.m_alphaMode = modes[i % KT_ARRAY_COUNT(modes)];
+	}
+
+	for (uint32_t meshIdx = 0; meshIdx < c_numMeshes; ++meshIdx)
+	{
+		gfx::ResourceManager::MaterialIdx meshMaterials[6];
+
+		for (uint32_t i = 0; i < KT_ARRAY_COUNT(meshMaterials); ++i)
+		{
+			meshMaterials[i] = materials[(meshIdx + i) % KT_ARRAY_COUNT(materials)];
+		}
+
+		o_meshes[meshIdx] = headless::CreateBoxMesh(meshIdx % 6 + 1, meshIdx % gfx::c_maxMeshLods + 1, meshMaterials);
+	}
+
+	for (gfx::ResourceManager::MaterialIdx material : materials)
+	{
+		gfx::ResourceManager::Release(material);
+	}
+}
+
+// Submits every slot and builds, timing only the build. The frame allocators are reset first, nothing from a previous build is kept.
+static double TimedBuild(gfx::MeshRenderer& _renderer, gfx::DrawSortView const& _sortView, uint32_t _firstSlot, uint32_t _numInstances)
+{
+	core::ResetThreadFrameAllocator();
+	core::jobs::ResetWorkerFrameAllocators();
+
+	_renderer.Clear();
+
+	for (uint32_t i = 0; i < _numInstances; ++i)
+	{
+		_renderer.Submit(_firstSlot + i);
+	}
+
+	kt::TimePoint const start = kt::TimePoint::Now();
+	_renderer.BuildMultiDrawBuffersCPU(gpu::GetMainThreadCommandCtx(), _sortView);
+	return (kt::TimePoint::Now() - start).Seconds() * 1000.0;
+}
+
+// The sorted draws and the instance entries they cover, as uploaded.
+static void CopyBuiltBuffers(gfx::MeshRenderer const& _renderer, kt::Array<uint8_t>& o_args, kt::Array<uint8_t>& o_instances)
+{
+	uint32_t const numDraws = _renderer.NumSortedDraws();
+	kt::Slice<uint8_t const> const args = gpu::BufferContents_Null(_renderer.SortedIndirectArgsBuffer());
+	kt::Slice<uint8_t const> const instances = gpu::BufferContents_Null(_renderer.SortedInstanceIdx_MeshIdxBuffer());
+
+	uint32_t numInstanceEntries = 0;
+
+	for (uint32_t drawIdx = 0; drawIdx < numDraws; ++drawIdx)
+	{
+		gpu::IndexedDrawArguments const* drawArgs = (gpu::IndexedDrawArguments const*)args.Data() + drawIdx;
+		numInstanceEntries = kt::Max(numInstanceEntries, drawArgs->m_startInstance + drawArgs->m_instanceCount);
+	}
+
+	o_args.Resize(numDraws * sizeof(gpu::IndexedDrawArguments));
+	o_instances.Resize(numInstanceEntries * sizeof(uint32_t));
+	memcpy(o_args.Data(), args.Data(), o_args.Size());
+	memcpy(o_instances.Data(), instances.Data(), o_instances.Size());
+}
+
+// MeshRenderer::BuildMultiDrawBuffersCPU over 100k+ submitted instances (several submesh instances each): keying, radix sort and batching.
+// Builds with gfx.parallel_batch_build on must match the serial build byte for byte, at every worker count.
+PATHOS_BENCH(MeshRenderer_BuildBatches)
+{
+	uint32_t const numInstances = bench::IsQuick() ? 8 * 1024 : 128 * 1024;
+	uint32_t const iterations = bench::IsQuick() ? 2 : 8;
+
+	headless::Init();
+
+	{
+		gfx::ResourceManager::MeshIdx meshes[c_numMeshes];
+		CreateBenchMeshes(meshes);
+
+		gfx::InstanceTable table;
+		table.Init(numInstances);
+		gfx::InstanceTable::RangeHandle const range = table.Alloc(numInstances);
+		uint32_t const firstSlot = table.FirstSlot(range);
+
+		// Scattered so depth sorting reorders instances of the same submesh.
+		uint32_t rng = 0x12345678;
+		auto nextRand = [&rng]() -> uint32_t
+		{
+			rng = rng * 1664525u + 1013904223u;
+			return rng >> 8;
+		};
+
+		for (uint32_t i = 0; i < numInstances; ++i)
+		{
+			uint32_t const slot = firstSlot + i;
+			kt::Vec3 const pos(float(nextRand() % 1024), float(nextRand() % 64), float(nextRand() % 1024));
+
+			table.SetMesh(slot, meshes[nextRand() % c_numMeshes]);
+			table.SetTransform(slot, kt::Mat4::Translation(pos));
+			table.SetLod(slot, uint8_t(nextRand() % gfx::c_maxMeshLods));
+		}
+
+		table.Upload(gpu::GetMainThreadCommandCtx());
+
+		gfx::MeshRenderer renderer;
+		renderer.Init(table);
+
+		gfx::DrawSortView sortView;
+		sortView.m_depthPlane = kt::Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		sortView.m_opaqueDepthFirst = true;
+
+		bool const prevParallel = headless::SetCVar("gfx.parallel_batch_build", false);
+
+		double serialMs = 1e30;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			serialMs = kt::Min(serialMs, TimedBuild(renderer, sortView, firstSlot, numInstances));
+		}
+
+		kt::Array<uint8_t> serialArgs;
+		kt::Array<uint8_t> serialInstances;
+		CopyBuiltBuffers(renderer, serialArgs, serialInstances);
+
+		BENCH_CHECK(renderer.NumSortedDraws() > 0);
+		BENCH_CHECK(renderer.GetCullStats().m_numVisible == serialInstances.Size() / sizeof(uint32_t));
+
+		printf("  %u instances, %u submesh instances, %u draws\n", numInstances, renderer.GetCullStats().m_numVisible, renderer.NumSortedDraws());
+		printf("  %8s %12s %12s %10s\n", "workers", "serial ms", "parallel ms", "speedup");
+
+		headless::SetCVar("gfx.parallel_batch_build", true);
+
+		uint32_t workerCounts[32];
+		uint32_t const numWorkerCounts = bench::WorkerCountsToTest(workerCounts);
+
+		kt::Array<uint8_t> args;
+		kt::Array<uint8_t> instances;
+
+		for (uint32_t countIdx = 0; countIdx < numWorkerCounts; ++countIdx)
+		{
+			bench::SetNumWorkers(workerCounts[countIdx]);
+
+			double parallelMs = 1e30;
+			for (uint32_t i = 0; i < iterations; ++i)
+			{
+				parallelMs = kt::Min(parallelMs, TimedBuild(renderer, sortView, firstSlot, numInstances));
+			}
+
+			CopyBuiltBuffers(renderer, args, instances);
+
+			BENCH_CHECK(args.Size() == serialArgs.Size() && !memcmp(args.Data(), serialArgs.Data(), args.Size()));
+			BENCH_CHECK(instances.Size() == serialInstances.Size() && !memcmp(instances.Data(), serialInstances.Data(), instances.Size()));
+
+			printf("  %8u %12.3f %12.3f %9.2fx\n", workerCounts[countIdx], serialMs, parallelMs, serialMs / parallelMs);
+		}
+
+		headless::SetCVar("gfx.parallel_batch_build", prevParallel);
+
+		table.Free(range);
+
+		for (gfx::ResourceManager::MeshIdx mesh : meshes)
+		{
+			gfx::ResourceManager::Release(mesh);
+		}
+	}
+
+	headless::Shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#include <core/Memory.h>
+#include <core/Jobs.h>
+
+namespace bench
+{
+
+struct RegisteredBench
+{
+	char const* m_name;
+	BenchFn m_fn;
+};
+
+static uint32_t const c_maxBenches = 128;
+static uint32_t const c_workerFrameAllocatorSize = 32 * 1024 * 1024;
+
+struct Registry
+{
+	RegisteredBench m_benches[c_maxBenches];
+	uint32_t m_numBenches = 0;
+
+	uint32_t m_numFailedChecks = 0;
+	uint32_t m_numWorkers = 0;
+	bool m_quick = false;
+};
+
+// Function local so registrars in other translation units can run first.
+static Registry& GetRegistry()
+{
+	static Registry s_registry;
+	return s_registry;
+}
+
+Registrar::Registrar(char const* _name, BenchFn _fn)
+{
+	Registry& registry = GetRegistry();
+	KT_ASSERT(registry.m_numBenches < c_maxBenches);
+	registry.m_benches[registry.m_numBenches++] = RegisteredBench{ _name, _fn };
+}
+
+bool IsQuick()
+{
+	return GetRegistry().m_quick;
+}
+
+uint32_t MaxWorkers()
+{
+	uint32_t const hwThreads = std::thread::hardware_concurrency();
+	return hwThreads > 1 ? hwThreads - 1 : 1;
+}
+
+void SetNumWorkers(uint32_t _numWorkers)
+{
+	Registry& registry = GetRegistry();
+	if (registry.m_numWorkers == _numWorkers)
+	{
+		return;
+	}
+
+	core::jobs::Shutdown();
+	core::jobs::Init(c_workerFrameAllocatorSize, _numWorkers);
+	registry.m_numWorkers = _numWorkers;
+}
+
+uint32_t WorkerCountsToTest(uint32_t* o_counts)
+{
+	uint32_t const maxWorkers = MaxWorkers();
+	uint32_t num = 0;
+
+	for (uint32_t count = 1; count < maxWorkers; count *= 2)
+	{
+		o_counts[num++] = count;
+	}
+
+	o_counts[num++] = maxWorkers;
+	return num;
+}
+
+void ReportFailure(char const* _expr, char const* _file, int _line)
+{
+	printf("  %s(%d): check failed: %s\n", _file, _line, _expr);
+	++GetRegistry().m_numFailedChecks;
+}
+
+}
+
+int main(int _argc, char** _argv)
+{
+	bench::Registry& registry = bench::GetRegistry();
+
+	char const* filter = nullptr;
+	for (int i = 1; i < _argc; ++i)
+	{
+		if (!strcmp(_argv[i], "--quick"))
+		{
+			registry.m_quick = true;
+		}
+		else
+		{
+			filter = _argv[i];
+		}
+	}
+
+	uint32_t const c_frameAllocatorSize = 128 * 1024 * 1024;
+	core::InitThreadFrameAllocator(c_frameAllocatorSize);
+	core::jobs::Init(bench::c_workerFrameAllocatorSize, bench::MaxWorkers());
+	registry.m_numWorkers = bench::MaxWorkers();
+
+	for (uint32_t benchIdx = 0; benchIdx < registry.m_numBenches; ++benchIdx)
+	{
+		bench::RegisteredBench const& entry = registry.m_benches[benchIdx];
+		if (filter && !strstr(entry.m_name, filter))
+		{
+			continue;
+		}
+
+		printf("%s\n", entry.m_name);
+		entry.m_fn();
+
+		bench::SetNumWorkers(bench::MaxWorkers());
+		core::ResetThreadFrameAllocator();
+		core::jobs::ResetWorkerFrameAllocators();
+	}
+
+	core::jobs::Shutdown();
+	core::ShutdownThreadFrameAllocator();
+
+	if (registry.m_numFailedChecks)
+	{
+		printf("%u checks failed.\n", registry.m_numFailedChecks);
+		return 1;
+	}
+
+	return 0;
+}
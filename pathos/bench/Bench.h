@@ -0,0 +1,61 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Macros.h>
+#include <kt/Timer.h>
+
+// Minimal self registering benchmarks, all linked into the pathos_bench executable.
+// Arguments: an optional substring to run only matching benchmarks, and --quick for small sizes (used by ctest as a regression run).
+
+namespace bench
+{
+
+using BenchFn = void(*)();
+
+struct Registrar
+{
+	Registrar(char const* _name, BenchFn _fn);
+};
+
+// Benchmarks should shrink sizes and iterations when set.
+bool IsQuick();
+
+// Restarts the job system with _numWorkers workers (plus the calling thread). Restored to the default after each benchmark.
+void SetNumWorkers(uint32_t _numWorkers);
+
+// Default number of workers (hardware threads - 1, at least 1).
+uint32_t MaxWorkers();
+
+// 1, 2, 4 .. MaxWorkers(), o_counts must hold 32.
+uint32_t WorkerCountsToTest(uint32_t* o_counts);
+
+// Logs the failure and fails the run, for benchmarks that also check their results.
+void ReportFailure(char const* _expr, char const* _file, int _line);
+
+// Runs _fn _iterations times, returning the fastest in milliseconds.
+template <typename FnT>
+double MinTimeMs(uint32_t _iterations, FnT&& _fn)
+{
+	double best = 1e30;
+	for (uint32_t i = 0; i < _iterations; ++i)
+	{
+		kt::TimePoint const start = kt::TimePoint::Now();
+		_fn();
+		best = kt::Min(best, (kt::TimePoint::Now() - start).Seconds() * 1000.0);
+	}
+	return best;
+}
+
+}
+
+#define PATHOS_BENCH(_name) \
+	static void _name(); \
+	static bench::Registrar const s_registrar_##_name(#_name, &_name); \
+	static void _name()
+
+#define BENCH_CHECK(_expr) \
+	KT_MACRO_BLOCK_BEGIN \
+		if (!(_expr)) \
+		{ \
+			bench::ReportFailure(#_expr, __FILE__, __LINE__); \
+		} \
+	KT_MACRO_BLOCK_END
@@ -0,0 +1,209 @@
+#include "Bench.h"
+#include "HeadlessGfx.h"
+
+#include <stdio.h>
+
+#include <kt/Array.h>
+
+#include <core/Jobs.h>
+
+#include <gpu/GPUDevice.h>
+#include <gpu/HandleRef.h>
+#include <gpu/CommandStream.h>
+#include <gpu/null/GPUDevice_Null.h>
+
+#include <gfx/Model.h>
+
+#include <shaderlib/DefinesShared.h>
+
+struct StreamResources
+{
+	gpu::PSORef m_graphicsPso;
+	gpu::PSORef m_computePso;
+
+	gpu::BufferRef m_vertexBuffer;
+	gpu::BufferRef m_indexBuffer;
+	gpu::BufferRef m_dynamicBuffer;
+};
+
+static uint32_t const c_dynamicBufferSize = 4096;
+static uint32_t const c_updateSize = 64;
+
+// Draws, dispatches and the state changes between them.
+static uint32_t const c_drawsPerGroup = 2;
+
+static void CreateStreamResources(StreamResources& o_res)
+{
+	gpu::GraphicsPSODesc psoDesc;
+	psoDesc.m_depthFormat = gpu::BackbufferDepthFormat();
+	psoDesc.m_numRenderTargets = 1;
+	psoDesc.m_renderTargetFormats[0] = gpu::BackbufferFormat();
+	psoDesc.m_vertexLayout = gfx::Model::FullVertexLayout();
+	psoDesc.m_vs = gfx::ResourceManager::LoadShader("shaders/ObjectShader.vs.cso", gpu::ShaderType::Vertex);
+	psoDesc.m_ps = gfx::ResourceManager::LoadShader("shaders/ObjectShader.ps.cso", gpu::ShaderType::Pixel);
+	o_res.m_graphicsPso = gpu::CreateGraphicsPSO(psoDesc, "CommandStreamBench Graphics PSO");
+
+	gpu::ShaderRef const cs = gfx::ResourceManager::LoadShader("shaders/BakeIrradianceMap.cs.cso", gpu::ShaderType::Compute);
+	o_res.m_computePso = gpu::CreateComputePSO(cs, "CommandStreamBench Compute PSO");
+
+	gpu::BufferDesc vbDesc;
+	vbDesc.m_flags = gpu::BufferFlags::Vertex;
+	vbDesc.m_strideInBytes = sizeof(float) * 3;
+	vbDesc.m_sizeInBytes = vbDesc.m_strideInBytes * 1024;
+	o_res.m_vertexBuffer = gpu::CreateBuffer(vbDesc, nullptr, "CommandStreamBench Vertex Buffer");
+
+	gpu::BufferDesc ibDesc;
+	ibDesc.m_flags = gpu::BufferFlags::Index;
+	ibDesc.m_format = gpu::Format::R16_Uint;
+	ibDesc.m_strideInBytes = sizeof(uint16_t);
+	ibDesc.m_sizeInBytes = sizeof(uint16_t) * 1024;
+	o_res.m_indexBuffer = gpu::CreateBuffer(ibDesc, nullptr, "CommandStreamBench Index Buffer");
+
+	gpu::BufferDesc dynDesc;
+	dynDesc.m_flags = gpu::BufferFlags::ShaderResource | gpu::BufferFlags::Dynamic;
+	dynDesc.m_strideInBytes = c_updateSize;
+	dynDesc.m_sizeInBytes = c_dynamicBufferSize;
+	o_res.m_dynamicBuffer = gpu::CreateBuffer(dynDesc, nullptr, "CommandStreamBench Dynamic Buffer");
+}
+
+struct RecordJob
+{
+	gpu::cmd::CommandStream* m_stream;
+	StreamResources const* m_res;
+	uint32_t m_numGroups;
+	uint32_t m_seed;
+};
+
+// What a pass recorded on a worker typically looks like: state, constants, a buffer update, draws, then a dispatch.
+static void RecordStreamJob(void* _data)
+{
+	RecordJob const& job = *(RecordJob const*)_data;
+	StreamResources const& res = *job.m_res;
+
+	gpu::cmd::Context* ctx = gpu::cmd::BeginRecording(job.m_stream, gpu::cmd::ContextType::Graphics);
+
+	uint8_t update[c_updateSize];
+	float constants[16] = {};
+
+	for (uint32_t group = 0; group < job.m_numGroups; ++group)
+	{
+		uint32_t const i = job.m_seed + group;
+
+		gpu::cmd::SetPSO(ctx, res.m_graphicsPso);
+		gpu::cmd::SetVertexBuffer(ctx, 0, res.m_vertexBuffer);
+		gpu::cmd::SetIndexBuffer(ctx, res.m_indexBuffer);
+
+		constants[0] = float(i);
+		gpu::DescriptorData cbv;
+		cbv.Set(constants, sizeof(constants));
+		gpu::cmd::SetGraphicsCBVTable(ctx, cbv, PATHOS_PER_FRAME_SPACE);
+
+		for (uint32_t b = 0; b < c_updateSize; ++b)
+		{
+			update[b] = uint8_t(i + b);
+		}
+		gpu::cmd::UpdateDynamicBuffer(ctx, res.m_dynamicBuffer, update, c_updateSize, (i * c_updateSize) % c_dynamicBufferSize);
+
+		gpu::cmd::DrawIndexedInstanced(ctx, 36, 1 + i % 4, 0, 0, i);
+		gpu::cmd::DrawInstanced(ctx, 3, 1, 0, 0);
+
+		gpu::cmd::SetPSO(ctx, res.m_computePso);
+		gpu::cmd::Dispatch(ctx, 1 + i % 8, 1, 1);
+	}
+
+	gpu::cmd::EndRecording(ctx);
+}
+
+// Streams recorded in parallel by jobs at each worker count, then replayed in order onto the null main thread context.
+// Throughput is recorded commands (NumRecordedCommands) per microsecond.
+PATHOS_BENCH(CommandStream_RecordReplay)
+{
+	uint32_t const c_numStreams = 16;
+	uint32_t const groupsPerStream = bench::IsQuick() ? 512 : 8192;
+	uint32_t const iterations = bench::IsQuick() ? 2 : 8;
+
+	uint32_t workerCounts[32];
+	uint32_t const numWorkerCounts = bench::WorkerCountsToTest(workerCounts);
+
+	headless::Init();
+
+	{
+		StreamResources res;
+		CreateStreamResources(res);
+
+		gpu::cmd::CommandStream* streams[c_numStreams];
+		RecordJob recordJobs[c_numStreams];
+		core::jobs::Job jobs[c_numStreams];
+
+		for (uint32_t i = 0; i < c_numStreams; ++i)
+		{
+			streams[i] = gpu::cmd::CreateCommandStream();
+			recordJobs[i] = RecordJob{ streams[i], &res, groupsPerStream, i * groupsPerStream };
+			jobs[i].m_fn = RecordStreamJob;
+			jobs[i].m_userData = &recordJobs[i];
+		}
+
+		auto numRecordedCommands = [&streams]() -> uint64_t
+		{
+			uint64_t total = 0;
+			for (gpu::cmd::CommandStream const* stream : streams)
+			{
+				total += gpu::cmd::NumRecordedCommands(stream);
+			}
+			return total;
+		};
+
+		uint64_t firstNumCommands = 0;
+
+		printf("  %8s %12s %12s %12s %12s\n", "workers", "commands", "record ms", "cmds/us", "MB recorded");
+
+		for (uint32_t countIdx = 0; countIdx < numWorkerCounts; ++countIdx)
+		{
+			bench::SetNumWorkers(workerCounts[countIdx]);
+
+			double const recordMs = bench::MinTimeMs(iterations, [&jobs]()
+			{
+				core::jobs::Counter counter;
+				core::jobs::Run(jobs, c_numStreams, &counter);
+				core::jobs::WaitForCounter(&counter);
+			});
+
+			uint64_t const numCommands = numRecordedCommands();
+			uint64_t recordedBytes = 0;
+			for (gpu::cmd::CommandStream const* stream : streams)
+			{
+				recordedBytes += gpu::cmd::RecordedSizeInBytes(stream);
+			}
+
+			// Recording is deterministic, whatever thread a stream was recorded on.
+			firstNumCommands = countIdx == 0 ? numCommands : firstNumCommands;
+			BENCH_CHECK(numCommands > 0 && numCommands == firstNumCommands);
+
+			printf("  %8u %12llu %12.3f %12.1f %12.2f\n", workerCounts[countIdx], (unsigned long long)numCommands, recordMs, double(numCommands) / (recordMs * 1000.0), double(recordedBytes) / (1024.0 * 1024.0));
+		}
+
+		// Replay is single threaded, onto the one context.
+		headless::NextFrame();
+
+		double const replayMs = bench::MinTimeMs(iterations, [&streams]()
+		{
+			gpu::cmd::Replay(gpu::GetMainThreadCommandCtx(), streams, c_numStreams);
+		});
+
+		headless::NextFrame();
+
+		uint64_t const numCommands = numRecordedCommands();
+		printf("  replay %12llu commands %12.3f ms %12.1f cmds/us\n", (unsigned long long)numCommands, replayMs, double(numCommands) / (replayMs * 1000.0));
+
+		// Every recorded draw reached the null context, each replay.
+		uint64_t const expectedDraws = uint64_t(iterations) * c_numStreams * groupsPerStream * c_drawsPerGroup;
+		BENCH_CHECK(gpu::LastFrameCommandStats_Null().m_numDraws == expectedDraws);
+
+		for (gpu::cmd::CommandStream* stream : streams)
+		{
+			gpu::cmd::DestroyCommandStream(stream);
+		}
+	}
+
+	headless::Shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+
+#include <gfx/Culling.h>
+
+// Cpu reference of the gpu hi-z cull (gfx::DepthPyramidCPU and CullSubmeshHiZ_CPU), on the scene tests/CullingTests.cpp checks.
+
+static float const c_near = 0.1f;
+static float const c_far = 100.0f;
+
+// Right handed, zero to one depth, as gfx::Camera builds them.
+static kt::Mat4 Perspective(float _fovY, float _aspect)
+{
+	float const t = 1.0f / tanf(_fovY * 0.5f);
+
+	kt::Mat4 mtx;
+	mtx.m_cols[0] = kt::Vec4(t / _aspect, 0.0f, 0.0f, 0.0f);
+	mtx.m_cols[1] = kt::Vec4(0.0f, t, 0.0f, 0.0f);
+	mtx.m_cols[2] = kt::Vec4(0.0f, 0.0f, c_far / (c_near - c_far), -1.0f);
+	mtx.m_cols[3] = kt::Vec4(0.0f, 0.0f, c_near * c_far / (c_near - c_far), 0.0f);
+	return mtx;
+}
+
+// Wall at view z = -10 over the left 60% of the screen, the rest at the far plane.
+static void BuildWallDepth(kt::Mat4 const& _proj, uint32_t _width, uint32_t _height, kt::Array<float>& o_depth)
+{
+	float const wallDepth = (_proj.m_cols[2].z * -10.0f + _proj.m_cols[3].z) / 10.0f;
+
+	o_depth.Resize(_width * _height);
+
+	for (uint32_t y = 0; y < _height; ++y)
+	{
+		for (uint32_t x = 0; x < _width; ++x)
+		{
+			o_depth[y * _width + x] = x < _width * 6 / 10 ? wallDepth : 1.0f;
+		}
+	}
+}
+
+PATHOS_BENCH(HiZ_BuildAndCull)
+{
+	uint32_t const c_sizes[][2] = { { 173, 97 }, { 1920, 1080 } };
+	uint32_t const numBoxes = 20000;
+	uint32_t const iterations = bench::IsQuick() ? 2 : 20;
+
+	printf("  %12s %12s %12s %12s %12s\n", "depth", "build ms", "cull ms", "boxes/us", "occluded");
+
+	for (uint32_t const* size : c_sizes)
+	{
+		uint32_t const width = size[0];
+		uint32_t const height = size[1];
+
+		kt::Mat4 const proj = Perspective(1.2f, float(width) / float(height));
+
+		kt::Array<float> depth;
+		BuildWallDepth(proj, width, height, depth);
+
+		gfx::DepthPyramidCPU pyramid;
+		double const buildMs = bench::MinTimeMs(iterations, [&pyramid, &depth, width, height]()
+		{
+			pyramid.Build(depth.Data(), width, height);
+		});
+
+		shaderlib::CullingConstants constants = {};
+		constants.viewProj = proj;
+
+		shaderlib::InstanceData_Xform xform;
+		xform.row0 = kt::Vec4(1.0f, 0.0f, 0.0f, 0.0f);
+		xform.row1 = kt::Vec4(0.0f, 1.0f, 0.0f, 0.0f);
+		xform.row2 = kt::Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+
+		// Same boxes as CullSubmeshHiZ_Conservative, generated up front so only the cull is timed.
+		kt::Array<shaderlib::GPUSubMeshData> boxes;
+		boxes.Resize(numBoxes);
+
+		uint32_t rng = 1;
+		auto rand01 = [&rng]() -> float
+		{
+			rng = rng * 1664525u + 1013904223u;
+			return float(rng >> 8) / float(1 << 24);
+		};
+
+		for (shaderlib::GPUSubMeshData& box : boxes)
+		{
+			float const x = -20.0f + 40.0f * rand01();
+			float const y = -12.0f + 24.0f * rand01();
+			float const z = -40.0f + 39.0f * rand01();
+			float const halfSize = 0.01f + 3.0f * rand01();
+
+			box = {};
+			box.bboxMin = kt::Vec4(x - halfSize, y - halfSize, z - halfSize, 1.0f);
+			box.bboxMax = kt::Vec4(x + halfSize, y + halfSize, z + halfSize, 1.0f);
+		}
+
+		uint32_t numVisible = 0;
+		uint32_t numOccluded = 0;
+
+		double const cullMs = bench::MinTimeMs(iterations, [&boxes, &xform, &constants, &pyramid, &numVisible, &numOccluded]()
+		{
+			numVisible = 0;
+			numOccluded = 0;
+
+			for (shaderlib::GPUSubMeshData const& box : boxes)
+			{
+				bool occluded;
+				numVisible += gfx::CullSubmeshHiZ_CPU(box, xform, constants, &pyramid, occluded);
+				numOccluded += occluded;
+			}
+		});
+
+		char depthName[32];
+		snprintf(depthName, sizeof(depthName), "%ux%u", width, height);
+		printf("  %12s %12.3f %12.3f %12.1f %12u\n", depthName, buildMs, cullMs, double(numBoxes) / (cullMs * 1000.0), numOccluded);
+
+		BENCH_CHECK(pyramid.m_numMips == gfx::DepthPyramidNumMips(width, height));
+		BENCH_CHECK(numOccluded > 0 && numVisible > 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <kt/Array.h>
+
+#include <core/Jobs.h>
+
+static void EmptyJob(void*)
+{
+}
+
+// Spawning and waiting on batches of empty jobs, the fixed cost of the job system.
+PATHOS_BENCH(Jobs_SpawnWait)
+{
+	uint32_t const c_batchSize = 2048;
+	uint32_t const numBatches = bench::IsQuick() ? 16 : 256;
+	uint32_t const iterations = bench::IsQuick() ? 2 : 8;
+
+	kt::Array<core::jobs::Job> jobs;
+	jobs.Resize(c_batchSize);
+	for (core::jobs::Job& job : jobs)
+	{
+		job.m_fn = EmptyJob;
+	}
+
+	uint32_t workerCounts[32];
+	uint32_t const numWorkerCounts = bench::WorkerCountsToTest(workerCounts);
+
+	printf("  %8s %16s %16s\n", "workers", "batch ns/job", "single ns/job");
+
+	for (uint32_t countIdx = 0; countIdx < numWorkerCounts; ++countIdx)
+	{
+		bench::SetNumWorkers(workerCounts[countIdx]);
+
+		double const batchMs = bench::MinTimeMs(iterations, [&jobs, numBatches, c_batchSize]()
+		{
+			for (uint32_t batch = 0; batch < numBatches; ++batch)
+			{
+				core::jobs::Counter counter;
+				core::jobs::Run(jobs.Data(), c_batchSize, &counter);
+				core::jobs::WaitForCounter(&counter);
+			}
+		});
+
+		// One job at a time, round trip latency of Run + WaitForCounter.
+		uint32_t const numSingle = numBatches * 16;
+		double const singleMs = bench::MinTimeMs(iterations, [&jobs, numSingle]()
+		{
+			for (uint32_t i = 0; i < numSingle; ++i)
+			{
+				core::jobs::Counter counter;
+				core::jobs::Run(jobs[0], &counter);
+				core::jobs::WaitForCounter(&counter);
+			}
+		});
+
+		printf("  %8u %16.1f %16.1f\n", workerCounts[countIdx], batchMs * 1e6 / double(numBatches * c_batchSize), singleMs * 1e6 / double(numSingle));
+	}
+}
+
+// ParallelFor over a fixed amount of ALU work, compared to a plain loop.
+PATHOS_BENCH(Jobs_ParallelForScaling)
+{
+	uint32_t const count = bench::IsQuick() ? (1 << 16) : (1 << 22);
+	uint32_t const iterations = bench::IsQuick() ? 2 : 10;
+	uint32_t const grainSizes[] = { 256, 4096 };
+
+	kt::Array<float> input;
+	kt::Array<float> output;
+	input.Resize(count);
+	output.Resize(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		input[i] = float(i % 1000) * 0.01f;
+	}
+
+	auto work = [&input, &output](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t i = _begin; i < _end; ++i)
+		{
+			float v = input[i];
+			for (uint32_t j = 0; j < 16; ++j)
+			{
+				v = sqrtf(v * v + 1.0f) * 0.75f;
+			}
+			output[i] = v;
+		}
+	};
+
+	double const serialMs = bench::MinTimeMs(iterations, [&work, count]() { work(0, count); });
+	kt::Array<float> serialOutput;
+	serialOutput.Resize(count);
+	memcpy(serialOutput.Data(), output.Data(), sizeof(float) * count);
+
+	printf("  %u elements, serial loop: %.3fms\n", count, serialMs);
+	printf("  %8s %8s %12s %10s\n", "workers", "grain", "ms", "speedup");
+
+	uint32_t workerCounts[32];
+	uint32_t const numWorkerCounts = bench::WorkerCountsToTest(workerCounts);
+
+	for (uint32_t countIdx = 0; countIdx < numWorkerCounts; ++countIdx)
+	{
+		bench::SetNumWorkers(workerCounts[countIdx]);
+
+		for (uint32_t grainSize : grainSizes)
+		{
+			double const ms = bench::MinTimeMs(iterations, [&work, count, grainSize]()
+			{
+				core::jobs::ParallelFor(count, grainSize, work);
+			});
+
+			printf("  %8u %8u %12.3f %9.2fx\n", workerCounts[countIdx], grainSize, ms, serialMs / ms);
+
+			// Every element written once, allowing for the loop being vectorised differently.
+			uint32_t numMismatched = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				numMismatched += kt::Abs(output[i] - serialOutput[i]) > 1e-5f;
+			}
+			BENCH_CHECK(numMismatched == 0);
+		}
+	}
+}
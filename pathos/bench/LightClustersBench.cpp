@@ -0,0 +1,137 @@
+#include "Bench.h"
+#include "HeadlessGfx.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <kt/Array.h>
+#include <kt/MathUtil.h>
+
+#include <core/Memory.h>
+#include <core/Jobs.h>
+
+#include <gpu/GPUDevice.h>
+#include <gpu/null/GPUDevice_Null.h>
+
+#include <gfx/Camera.h>
+#include <gfx/LightClusters.h>
+
+// Point lights first, then spot lights, as Scene uploads them. Scattered around the camera on a plane, so some are behind it or past the sliced depth.
+static uint32_t GenerateLights(uint32_t _numLights, kt::Array<shaderlib::LightData>& o_lights)
+{
+	uint32_t rng = 0x2545f491;
+	auto rand01 = [&rng]() -> float
+	{
+		rng = rng * 1664525u + 1013904223u;
+		return float(rng >> 8) / float(1 << 24);
+	};
+
+	uint32_t const numPointLights = _numLights / 2;
+
+	o_lights.Resize(_numLights);
+	memset(o_lights.Data(), 0, sizeof(shaderlib::LightData) * _numLights);
+
+	for (uint32_t i = 0; i < _numLights; ++i)
+	{
+		shaderlib::LightData& light = o_lights[i];
+		light.posWS = kt::Vec3(-400.0f + 800.0f * rand01(), 1.0f + 20.0f * rand01(), -400.0f + 800.0f * rand01());
+		light.rcpRadius = 1.0f / (2.0f + 18.0f * rand01());
+		light.color = kt::Vec3(1.0f);
+		light.intensity = 1.0f;
+
+		if (i < numPointLights)
+		{
+			light.type = PATHOS_LIGHT_TYPE_POINT;
+		}
+		else
+		{
+			light.type = PATHOS_LIGHT_TYPE_SPOT;
+			light.direction = kt::Normalize(kt::Vec3(rand01() - 0.5f, -1.0f, rand01() - 0.5f));
+			light.spotParams.x = cosf(0.2f + 0.8f * rand01());
+			light.spotParams.y = 1.0f;
+		}
+	}
+
+	return numPointLights;
+}
+
+// LightClusters::Build for 1k to 20k lights at each worker count (a job per depth slice).
+// Cluster lists must come out the same whatever the worker count.
+PATHOS_BENCH(LightClusters_Build)
+{
+	uint32_t const fullLightCounts[] = { 1000, 5000, 10000, 20000 };
+	uint32_t const quickLightCounts[] = { 1000 };
+
+	uint32_t const* lightCounts = bench::IsQuick() ? quickLightCounts : fullLightCounts;
+	uint32_t const numLightCounts = bench::IsQuick() ? KT_ARRAY_COUNT(quickLightCounts) : KT_ARRAY_COUNT(fullLightCounts);
+	uint32_t const iterations = bench::IsQuick() ? 2 : 10;
+
+	uint32_t workerCounts[32];
+	uint32_t const numWorkerCounts = bench::WorkerCountsToTest(workerCounts);
+
+	headless::Init();
+
+	{
+		gfx::Camera cam;
+		gfx::Camera::ProjectionParams params;
+		params.SetPerspective(0.1f, 1000.0f, kt::ToRadians(60.0f), 16.0f / 9.0f);
+		cam.SetProjection(params);
+		cam.SetCameraPos(kt::Vec3(0.0f, 5.0f, 0.0f));
+
+		gfx::LightClusters clusters;
+		clusters.Init();
+
+		kt::Array<shaderlib::LightData> lights;
+		kt::Array<uint8_t> firstClusters;
+		kt::Array<uint8_t> firstIndices;
+
+		printf("  %8s %8s %10s %12s %12s %10s\n", "lights", "workers", "ms", "in view", "indices", "max/cluster");
+
+		for (uint32_t countIdx = 0; countIdx < numLightCounts; ++countIdx)
+		{
+			uint32_t const numLights = lightCounts[countIdx];
+			uint32_t const numPointLights = GenerateLights(numLights, lights);
+
+			for (uint32_t workerIdx = 0; workerIdx < numWorkerCounts; ++workerIdx)
+			{
+				bench::SetNumWorkers(workerCounts[workerIdx]);
+
+				shaderlib::FrameConstants constants = {};
+
+				double const ms = bench::MinTimeMs(iterations, [&]()
+				{
+					core::ResetThreadFrameAllocator();
+					core::jobs::ResetWorkerFrameAllocators();
+					clusters.Build(gpu::GetMainThreadCommandCtx(), cam, lights.Data(), numLights, numPointLights, constants);
+				});
+
+				gfx::LightClusters::Stats const& stats = clusters.GetStats();
+
+				kt::Slice<uint8_t const> const clusterData = gpu::BufferContents_Null(clusters.ClusterBuffer());
+				kt::Slice<uint8_t const> const indexData = gpu::BufferContents_Null(clusters.LightIndexBuffer());
+				uint32_t const clusterBytes = gfx::LightClusters::c_numClusters * sizeof(shaderlib::LightCluster);
+				uint32_t const indexBytes = stats.m_numLightIndices * sizeof(uint32_t);
+
+				BENCH_CHECK(stats.m_numLightsInView > 0);
+
+				if (workerIdx == 0)
+				{
+					firstClusters.Resize(clusterBytes);
+					firstIndices.Resize(indexBytes);
+					memcpy(firstClusters.Data(), clusterData.Data(), clusterBytes);
+					memcpy(firstIndices.Data(), indexData.Data(), indexBytes);
+				}
+				else
+				{
+					BENCH_CHECK(!memcmp(firstClusters.Data(), clusterData.Data(), clusterBytes));
+					BENCH_CHECK(indexBytes == firstIndices.Size() && !memcmp(firstIndices.Data(), indexData.Data(), indexBytes));
+				}
+
+				printf("  %8u %8u %10.3f %12u %12u %10u\n", numLights, workerCounts[workerIdx], ms, stats.m_numLightsInView, stats.m_numLightIndices, stats.m_maxLightsPerCluster);
+			}
+		}
+	}
+
+	headless::Shutdown();
+}
\ No newline at end of file
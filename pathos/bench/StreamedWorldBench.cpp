@@ -0,0 +1,229 @@
+#include "Bench.h"
+#include "HeadlessGfx.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+
+#include <thread>
+
+#include <kt/Array.h>
+#include <kt/Strings.h>
+#include <kt/MathUtil.h>
+
+#include <core/CVar.h>
+
+#include <gpu/null/GPUDevice_Null.h>
+
+#include <gfx/Camera.h>
+#include <gfx/Scene.h>
+#include <gfx/StreamedWorld.h>
+#include <gfx/Primitive.h>
+
+// Boxes per generated model, in a row, so parsing (and the tangent space built for it) is more than trivial.
+static uint32_t const c_boxesPerModel = 64;
+
+// With a directory, as cgltf finds buffers relative to the gltf's directory.
+static void ModelPath(uint32_t _modelIdx, char const* _ext, kt::String512& o_path)
+{
+	o_path.Clear();
+	o_path.AppendFmt("./StreamedWorldBench_%u%s", _modelIdx, _ext);
+}
+
+// A gltf model with no textures (so nothing is decoded on the main thread), positions, normals and uvs only so tangents are generated when parsed.
+static bool WriteModel(uint32_t _modelIdx)
+{
+	gfx::PrimitiveBuffers cube;
+	gfx::GenCube(cube);
+
+	uint32_t const numVerts = cube.m_pos.Size() * c_boxesPerModel;
+	uint32_t const numIndices = cube.m_indicies.Size() * c_boxesPerModel;
+
+	kt::Array<kt::Vec3> positions;
+	kt::Array<kt::Vec3> normals;
+	kt::Array<kt::Vec2> uvs;
+	kt::Array<uint16_t> indices;
+
+	kt::Vec3 boundsMin(FLT_MAX);
+	kt::Vec3 boundsMax(-FLT_MAX);
+
+	for (uint32_t box = 0; box < c_boxesPerModel; ++box)
+	{
+		kt::Vec3 const offset(float(box % 8) * 1.5f, float(_modelIdx % 4) * 0.5f, float(box / 8) * 1.5f);
+		uint32_t const firstVtx = positions.Size();
+
+		for (uint32_t i = 0; i < cube.m_pos.Size(); ++i)
+		{
+			kt::Vec3 const pos = cube.m_pos[i] + offset;
+			positions.PushBack(pos);
+			normals.PushBack(cube.m_tangents[i].m_norm);
+			uvs.PushBack(cube.m_uvs[i]);
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				boundsMin[axis] = kt::Min(boundsMin[axis], pos[axis]);
+				boundsMax[axis] = kt::Max(boundsMax[axis], pos[axis]);
+			}
+		}
+
+		for (uint16_t idx : cube.m_indicies)
+		{
+			indices.PushBack(uint16_t(firstVtx + idx));
+		}
+	}
+
+	uint32_t const posBytes = numVerts * sizeof(kt::Vec3);
+	uint32_t const uvBytes = numVerts * sizeof(kt::Vec2);
+	uint32_t const indexBytes = numIndices * sizeof(uint16_t);
+
+	kt::String512 binPath;
+	ModelPath(_modelIdx, ".bin", binPath);
+
+	FILE* bin = fopen(binPath.Data(), "wb");
+	if (!bin)
+	{
+		return false;
+	}
+
+	fwrite(positions.Data(), 1, posBytes, bin);
+	fwrite(normals.Data(), 1, posBytes, bin);
+	fwrite(uvs.Data(), 1, uvBytes, bin);
+	fwrite(indices.Data(), 1, indexBytes, bin);
+	fclose(bin);
+
+	kt::String512 gltfPath;
+	ModelPath(_modelIdx, ".gltf", gltfPath);
+
+	FILE* gltf = fopen(gltfPath.Data(), "wb");
+	if (!gltf)
+	{
+		return false;
+	}
+
+	fprintf(gltf, "{\n\"asset\": { \"version\": \"2.0\" },\n");
+	fprintf(gltf, "\"buffers\": [ { \"uri\": \"StreamedWorldBench_%u.bin\", \"byteLength\": %u } ],\n", _modelIdx, posBytes * 2 + uvBytes + indexBytes);
+	fprintf(gltf, "\"bufferViews\": [ { \"buffer\": 0, \"byteOffset\": 0, \"byteLength\": %u }, { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u }, ", posBytes, posBytes, posBytes);
+	fprintf(gltf, "{ \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u }, { \"buffer\": 0, \"byteOffset\": %u, \"byteLength\": %u } ],\n", posBytes * 2, uvBytes, posBytes * 2 + uvBytes, indexBytes);
+	fprintf(gltf, "\"accessors\": [ { \"bufferView\": 0, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC3\", \"min\": [ %f, %f, %f ], \"max\": [ %f, %f, %f ] }, ",
+		numVerts, boundsMin.x, boundsMin.y, boundsMin.z, boundsMax.x, boundsMax.y, boundsMax.z);
+	fprintf(gltf, "{ \"bufferView\": 1, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC3\" }, { \"bufferView\": 2, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC2\" }, ", numVerts, numVerts);
+	fprintf(gltf, "{ \"bufferView\": 3, \"componentType\": 5123, \"count\": %u, \"type\": \"SCALAR\" } ],\n", numIndices);
+	fprintf(gltf, "\"materials\": [ { \"pbrMetallicRoughness\": { \"baseColorFactor\": [ 0.8, 0.8, 0.8, 1.0 ], \"metallicFactor\": 0.0, \"roughnessFactor\": 0.5 } } ],\n");
+	fprintf(gltf, "\"meshes\": [ { \"primitives\": [ { \"attributes\": { \"POSITION\": 0, \"NORMAL\": 1, \"TEXCOORD_0\": 2 }, \"indices\": 3, \"material\": 0 } ] } ],\n");
+	fprintf(gltf, "\"nodes\": [ { \"mesh\": 0 } ],\n\"scenes\": [ { \"nodes\": [ 0 ] } ],\n\"scene\": 0\n}\n");
+	fclose(gltf);
+
+	return true;
+}
+
+static void RemoveModelFiles(uint32_t _modelIdx)
+{
+	char const* const exts[] = { ".gltf", ".bin", ".gltf.cache" };
+
+	for (char const* ext : exts)
+	{
+		kt::String512 path;
+		ModelPath(_modelIdx, ext, path);
+		remove(path.Data());
+	}
+}
+
+// Flies a camera across a streamed grid of cells on the null backend, rendering each frame, and reports the main thread's stream update times.
+// Models are parsed on the io thread, so updates should only pay for uploads and instancing.
+PATHOS_BENCH(StreamedWorld_FlyThrough)
+{
+	uint32_t const numModels = bench::IsQuick() ? 16 : 48;
+	uint32_t const gridDim = bench::IsQuick() ? 8 : 24;
+	uint32_t const numFrames = bench::IsQuick() ? 120 : 600;
+	uint32_t const instancesPerCell = 4;
+	float const cellSize = 32.0f;
+
+	for (uint32_t modelIdx = 0; modelIdx < numModels; ++modelIdx)
+	{
+		// Stale caches from an earlier run would skip the gltf parse.
+		RemoveModelFiles(modelIdx);
+		BENCH_CHECK(WriteModel(modelIdx));
+	}
+
+	headless::Init();
+
+	{
+		gfx::Scene scene;
+		scene.Init(512);
+
+		float const prevLoadRadius = headless::SetCVar("gfx.world.load_radius", 2.0f * cellSize);
+		float const prevUnloadRadius = headless::SetCVar("gfx.world.unload_radius", 3.0f * cellSize);
+
+		gfx::StreamedWorld world;
+		world.Init(&scene, cellSize);
+
+		for (uint32_t z = 0; z < gridDim; ++z)
+		{
+			for (uint32_t x = 0; x < gridDim; ++x)
+			{
+				// Neighbouring cells share models, so models are released once the camera has passed rows of cells.
+				uint32_t const firstModel = (z / 2) * 4 + x / 4;
+
+				for (uint32_t i = 0; i < instancesPerCell; ++i)
+				{
+					kt::String512 path;
+					ModelPath((firstModel + i % 2) % numModels, ".gltf", path);
+
+					kt::Vec3 const pos((float(x) + 0.25f + 0.5f * float(i % 2)) * cellSize, 0.0f, (float(z) + 0.25f + 0.5f * float(i / 2)) * cellSize);
+					world.AddInstance(path.Data(), kt::Mat4::Translation(pos));
+				}
+			}
+		}
+
+		gfx::Camera cam;
+		gfx::Camera::ProjectionParams params;
+		params.SetPerspective(0.1f, 500.0f, kt::ToRadians(60.0f), 16.0f / 9.0f);
+		cam.SetProjection(params);
+
+		float const gridSize = float(gridDim) * cellSize;
+		float const dt = 1.0f / 60.0f;
+		double totalUpdateMs = 0.0;
+
+		for (uint32_t frame = 0; frame < numFrames; ++frame)
+		{
+			float const t = float(frame) / float(numFrames - 1);
+			kt::Vec3 const pos(gridSize * 0.5f, 10.0f, -2.0f * cellSize + t * (gridSize + 4.0f * cellSize));
+			cam.SetCameraPos(pos);
+
+			world.Update(pos);
+			totalUpdateMs += world.GetStats().m_updateMs;
+
+			headless::RenderSceneFrame(scene, cam, dt);
+			headless::NextFrame();
+		}
+
+		gfx::StreamedWorld::Stats const stats = world.GetStats();
+
+		// Let whatever is still in flight finish, so it's all freed through the world.
+		for (uint32_t i = 0; i < 10000 && world.GetStats().m_numLoadingCells != 0; ++i)
+		{
+			std::this_thread::yield();
+			world.Update(cam.GetPos());
+			headless::NextFrame();
+		}
+
+		BENCH_CHECK(world.GetStats().m_numLoadingCells == 0);
+		BENCH_CHECK(stats.m_numCellLoads > 0);
+		BENCH_CHECK(stats.m_numCellUnloads > 0);
+
+		printf("  %8s %10s %10s %8s %8s %8s\n", "frames", "avg ms", "max ms", "hitches", "loads", "unloads");
+		printf("  %8u %10.3f %10.3f %8u %8u %8u\n", stats.m_numUpdates, totalUpdateMs / double(numFrames), stats.m_maxUpdateMs, stats.m_numHitches, stats.m_numCellLoads, stats.m_numCellUnloads);
+
+		world.Shutdown();
+
+		headless::SetCVar("gfx.world.load_radius", prevLoadRadius);
+		headless::SetCVar("gfx.world.unload_radius", prevUnloadRadius);
+	}
+
+	headless::Shutdown();
+
+	for (uint32_t modelIdx = 0; modelIdx < numModels; ++modelIdx)
+	{
+		RemoveModelFiles(modelIdx);
+	}
+}
\ No newline at end of file
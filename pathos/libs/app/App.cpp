@@ -4,6 +4,7 @@
 #include <stdlib.h>
 
 #include <core/Memory.h>
+#include <core/Jobs.h>
 #include <core/CVar.h>
 #include <editor/Editor.h>
 #include <input/Input.h>
@@ -32,7 +33,9 @@ app::WindowHandle PATHOS_INIT(int _argc, char** _argv)
 {
 	KT_UNUSED2(_argc, _argv);
 	uint32_t const c_frameAllocatorSize = 32 * 1024 * 1024; // 32 mb
+	uint32_t const c_workerFrameAllocatorSize = 8 * 1024 * 1024; // 8 mb
 	core::InitThreadFrameAllocator(c_frameAllocatorSize);
+	core::jobs::Init(c_workerFrameAllocatorSize);
 
 #if PATHOS_CHECK_LEAK
 	s_leakCheckAllocator.SetAllocatorAndClear(kt::GetDefaultAllocator());
@@ -63,6 +66,7 @@ void PATHOS_SHUTDOWN()
 	core::ShutdownCVars();
 	editor::Shutdown();
 	gpu::Shutdown();
+	core::jobs::Shutdown();
 	core::ShutdownThreadFrameAllocator();
 #endif
 }
@@ -136,6 +140,7 @@ void GraphicsApp::Go(WindowHandle _wh, int _argc, char** _argv)
 
 		gpu::EndFrame();
 		core::ResetThreadFrameAllocator();
+		core::jobs::ResetWorkerFrameAllocators();
 	} while (m_keepAlive);
 
 	Shutdown();
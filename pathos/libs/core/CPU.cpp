@@ -0,0 +1,86 @@
+#include "CPU.h"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#else
+	#include <cpuid.h>
+#endif
+
+namespace core
+{
+
+void CpuId(uint32_t _leaf, uint32_t _subLeaf, uint32_t o_regs[4])
+{
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuidex(regs, int(_leaf), int(_subLeaf));
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		o_regs[i] = uint32_t(regs[i]);
+	}
+#else
+	__cpuid_count(_leaf, _subLeaf, o_regs[0], o_regs[1], o_regs[2], o_regs[3]);
+#endif
+}
+
+uint64_t XGetBV(uint32_t _xcr)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(_xcr);
+#else
+	// Inline asm rather than _xgetbv, which needs the xsave target enabled.
+	uint32_t lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(_xcr));
+	return uint64_t(lo) | (uint64_t(hi) << 32);
+#endif
+}
+
+// AVX encoded instructions need the OS to save ymm state.
+static bool OSSupportsAVX(uint32_t const _leaf1Ecx)
+{
+	bool const osxsave = (_leaf1Ecx & (1 << 27)) != 0;
+	bool const avx = (_leaf1Ecx & (1 << 28)) != 0;
+	return osxsave && avx && (XGetBV(0) & 0x6) == 0x6;
+}
+
+static bool DetectAVX2_FMA()
+{
+	uint32_t regs[4];
+	CpuId(0, 0, regs);
+	if (regs[0] < 7)
+	{
+		return false;
+	}
+
+	CpuId(1, 0, regs);
+	bool const fma = (regs[2] & (1 << 12)) != 0;
+	if (!fma || !OSSupportsAVX(regs[2]))
+	{
+		return false;
+	}
+
+	CpuId(7, 0, regs);
+	return (regs[1] & (1 << 5)) != 0;
+}
+
+static bool DetectF16C()
+{
+	uint32_t regs[4];
+	CpuId(1, 0, regs);
+	bool const f16c = (regs[2] & (1 << 29)) != 0;
+	return f16c && OSSupportsAVX(regs[2]);
+}
+
+bool CPUHasAVX2_FMA()
+{
+	static bool const s_hasAVX2 = DetectAVX2_FMA();
+	return s_hasAVX2;
+}
+
+bool CPUHasF16C()
+{
+	static bool const s_hasF16C = DetectF16C();
+	return s_hasF16C;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <kt/kt.h>
+
+namespace core
+{
+
+// cpuid with a sub-leaf, o_regs is eax, ebx, ecx, edx.
+void CpuId(uint32_t _leaf, uint32_t _subLeaf, uint32_t o_regs[4]);
+
+// Extended control register, only valid if cpuid reports OSXSAVE.
+uint64_t XGetBV(uint32_t _xcr);
+
+// True if the cpu (and OS) support AVX2 and FMA, checked once.
+bool CPUHasAVX2_FMA();
+
+// True if the cpu (and OS) support F16C half float conversions, checked once.
+bool CPUHasF16C();
+
+}
+
+// MSVC emits any intrinsic, GCC and Clang need the instruction set enabled on functions using them.
+// Callers must check the matching CPUHas* function first.
+#if defined(_MSC_VER)
+	#define CORE_TARGET_AVX2_FMA
+	#define CORE_TARGET_F16C
+#else
+	#define CORE_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+	#define CORE_TARGET_F16C __attribute__((target("f16c")))
+#endif
@@ -1,5 +1,7 @@
 #include "CVar.h"
 
+#include <string.h>
+
 #include <kt/Strings.h>
 #include <kt/Array.h>
 #include <kt/Sort.h>
@@ -184,6 +186,19 @@ void InitCVars()
 	RegisterCVarGroupsRecursive(s_ctx.m_root, kt::MakeSlice(varArray, CVarBase::s_numVars));
 }
 
+CVarBase* FindCVar(char const* _path)
+{
+	for (CVarBase* it = CVarBase::s_head; it; it = it->m_next)
+	{
+		if (strcmp(it->m_path, _path) == 0)
+		{
+			return it;
+		}
+	}
+
+	return nullptr;
+}
+
 void ShutdownCVars()
 {
 	// Not strictly necessary, but will count as a 'leak' in leak check allocator (since it checks before dtor calls after main)
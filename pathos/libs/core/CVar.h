@@ -15,6 +15,9 @@ void InitCVars();
 void ShutdownCVars();
 void DrawImGuiCVarMenuItems();
 
+// Null if no cvar has the path. Cast to the CVar<T> it was declared as (eg. to set cvars of other modules from tests).
+CVarBase* FindCVar(char const* _path);
+
 namespace CVarDrawHelpers
 {
 void DrawIntImGui(CVarBase* _base, void* _intPtr, void const* _intMin, void const* _intMax, uint32_t _typeSize, bool _isSigned);
@@ -51,7 +54,7 @@ struct CVar : CVarBase
 {
 	CVar()
 	{
-		static_assert(false, "CVar should be specialized.");
+		static_assert(sizeof(T) == 0, "CVar should be specialized.");
 	}
 };
 
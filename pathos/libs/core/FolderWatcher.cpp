@@ -5,8 +5,10 @@
 #include <kt/HashMap.h>
 #include <kt/Timer.h>
 
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+#if KT_PLATFORM_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#endif
 
 namespace core
 {
@@ -134,6 +136,12 @@ void DestroyFolderWatcher(FolderWatcher* _watcher)
 
 void UpdateFolderWatcher(FolderWatcher* _watcher, kt::StaticFunction<void(char const*), 32> const& _changeCb)
 {
+#if KT_PLATFORM_WINDOWS
+	if (!_watcher)
+	{
+		return;
+	}
+
 	kt::TimePoint const timeNow = kt::TimePoint::Now();
 
 	for (FolderWatcher::ChangedFileMap::Iterator it = _watcher->m_changedFiles.Begin();
@@ -157,6 +165,9 @@ void UpdateFolderWatcher(FolderWatcher* _watcher, kt::StaticFunction<void(char c
 	}
 
 	::MsgWaitForMultipleObjectsEx(0, nullptr, 00, QS_ALLINPUT, MWMO_ALERTABLE);
+#else
+	KT_UNUSED2(_watcher, _changeCb);
+#endif
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "Jobs.h"
+#include "Memory.h"
+
+#include <kt/Logging.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <immintrin.h>
+
+namespace core
+{
+
+namespace jobs
+{
+
+struct JobEntry
+{
+	Job m_job;
+	Counter* m_counter;
+};
+
+// Chase-Lev work stealing deque. The owning thread pushes and pops at the bottom, other threads steal from the top.
+class WorkStealingDeque
+{
+public:
+	static uint32_t constexpr c_capacity = 4096;
+
+	// Returns false if full.
+	bool Push(JobEntry const& _job)
+	{
+		int64_t const bottom = m_bottom.load(std::memory_order_relaxed);
+		int64_t const top = m_top.load(std::memory_order_acquire);
+
+		if (bottom - top >= int64_t(c_capacity))
+		{
+			return false;
+		}
+
+		m_jobs[bottom & (c_capacity - 1)] = _job;
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Pop(JobEntry& o_job)
+	{
+		int64_t const bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			// Empty.
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		o_job = m_jobs[bottom & (c_capacity - 1)];
+
+		if (top != bottom)
+		{
+			return true;
+		}
+
+		// Last job, race any thieves for it.
+		bool const won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	bool Steal(JobEntry& o_job)
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t const bottom = m_bottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+		{
+			return false;
+		}
+
+		o_job = m_jobs[top & (c_capacity - 1)];
+		return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> m_top{ 0 };
+	alignas(64) std::atomic<int64_t> m_bottom{ 0 };
+	JobEntry m_jobs[c_capacity];
+};
+
+struct ThreadData
+{
+	WorkStealingDeque m_deque;
+	kt::LinearAllocator* m_frameAllocator = nullptr;
+	uint32_t m_stealSeed = 0;
+};
+
+struct State
+{
+	ThreadData* m_threads = nullptr;
+	std::thread* m_workers = nullptr;
+	uint32_t m_numThreads = 1;
+
+	// Jobs queued but not yet picked up, workers sleep when this is zero.
+	std::atomic<uint32_t> m_numQueued{ 0 };
+	std::atomic<uint32_t> m_numSleeping{ 0 };
+	std::atomic<bool> m_quit{ false };
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCv;
+
+	uint32_t m_workerFrameAllocatorSize = 0;
+};
+
+static State s_state;
+
+// Only the thread that called Init and the workers have a queue.
+static uint32_t const c_invalidThreadIdx = UINT32_MAX;
+
+thread_local uint32_t tls_threadIdx = c_invalidThreadIdx;
+
+static void RunJob(Job const& _job, Counter* _counter)
+{
+	if (_job.m_dependency)
+	{
+		WaitForCounter(_job.m_dependency);
+	}
+
+	_job.m_fn(_job.m_userData);
+
+	if (_counter)
+	{
+		_counter->m_count.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+
+static bool TryGetJob(uint32_t _threadIdx, JobEntry& o_job)
+{
+	ThreadData& self = s_state.m_threads[_threadIdx];
+
+	if (self.m_deque.Pop(o_job))
+	{
+		s_state.m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	uint32_t const numThreads = s_state.m_numThreads;
+	if (numThreads == 1)
+	{
+		return false;
+	}
+
+	// Start stealing from a different victim each time so thieves spread out.
+	self.m_stealSeed = self.m_stealSeed * 1664525u + 1013904223u;
+	uint32_t const start = (self.m_stealSeed >> 16) % numThreads;
+
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		uint32_t const victim = (start + i) % numThreads;
+		if (victim != _threadIdx && s_state.m_threads[victim].m_deque.Steal(o_job))
+		{
+			s_state.m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool TryRunOne(uint32_t _threadIdx)
+{
+	JobEntry entry;
+	if (!TryGetJob(_threadIdx, entry))
+	{
+		return false;
+	}
+
+	RunJob(entry.m_job, entry.m_counter);
+	return true;
+}
+
+static void WorkerMain(uint32_t _threadIdx)
+{
+	tls_threadIdx = _threadIdx;
+	core::InitThreadFrameAllocator(s_state.m_workerFrameAllocatorSize);
+	s_state.m_threads[_threadIdx].m_frameAllocator = core::GetThreadFrameAllocator();
+	s_state.m_threads[_threadIdx].m_stealSeed = _threadIdx;
+
+	uint32_t const c_spinsBeforeSleep = 64;
+
+	while (!s_state.m_quit.load(std::memory_order_relaxed))
+	{
+		bool ranJob = false;
+
+		for (uint32_t spin = 0; spin < c_spinsBeforeSleep; ++spin)
+		{
+			if (TryRunOne(_threadIdx))
+			{
+				ranJob = true;
+				break;
+			}
+
+			_mm_pause();
+		}
+
+		if (ranJob)
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(s_state.m_sleepMutex);
+		s_state.m_numSleeping.fetch_add(1, std::memory_order_seq_cst);
+		s_state.m_sleepCv.wait(lock, []() { return s_state.m_numQueued.load(std::memory_order_seq_cst) != 0 || s_state.m_quit.load(std::memory_order_relaxed); });
+		s_state.m_numSleeping.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	core::ShutdownThreadFrameAllocator();
+}
+
+void Init(uint32_t _workerFrameAllocatorSize, uint32_t _numWorkers)
+{
+	KT_ASSERT(!s_state.m_threads);
+
+	if (!_numWorkers)
+	{
+		uint32_t const hwThreads = std::thread::hardware_concurrency();
+		_numWorkers = hwThreads > 1 ? hwThreads - 1 : 0;
+	}
+
+	s_state.m_numThreads = _numWorkers + 1;
+	s_state.m_workerFrameAllocatorSize = _workerFrameAllocatorSize;
+	s_state.m_quit = false;
+	s_state.m_numQueued = 0;
+
+	s_state.m_threads = new ThreadData[s_state.m_numThreads];
+	s_state.m_workers = new std::thread[_numWorkers];
+
+	tls_threadIdx = 0;
+
+	for (uint32_t i = 0; i < _numWorkers; ++i)
+	{
+		s_state.m_workers[i] = std::thread(WorkerMain, i + 1);
+	}
+
+	KT_LOG_INFO("Job system started with %u worker threads.", _numWorkers);
+}
+
+void Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_state.m_sleepMutex);
+		s_state.m_quit = true;
+	}
+	s_state.m_sleepCv.notify_all();
+
+	for (uint32_t i = 0; i < s_state.m_numThreads - 1; ++i)
+	{
+		s_state.m_workers[i].join();
+	}
+
+	delete[] s_state.m_workers;
+	delete[] s_state.m_threads;
+	s_state.m_workers = nullptr;
+	s_state.m_threads = nullptr;
+	s_state.m_numThreads = 1;
+}
+
+uint32_t NumThreads()
+{
+	return s_state.m_numThreads;
+}
+
+uint32_t ThreadIndex()
+{
+	return tls_threadIdx;
+}
+
+static void WakeWorkers(uint32_t _numJobs)
+{
+	if (s_state.m_numSleeping.load(std::memory_order_seq_cst) == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_state.m_sleepMutex);
+	if (_numJobs == 1)
+	{
+		s_state.m_sleepCv.notify_one();
+	}
+	else
+	{
+		s_state.m_sleepCv.notify_all();
+	}
+}
+
+void Run(Job const* _jobs, uint32_t _numJobs, Counter* _counter)
+{
+	KT_ASSERT(s_state.m_threads);
+	KT_ASSERT(tls_threadIdx < s_state.m_numThreads);
+
+	if (_counter)
+	{
+		_counter->m_count.fetch_add(_numJobs, std::memory_order_relaxed);
+	}
+
+	WorkStealingDeque& deque = s_state.m_threads[tls_threadIdx].m_deque;
+
+	uint32_t numPushed = 0;
+
+	for (uint32_t i = 0; i < _numJobs; ++i)
+	{
+		JobEntry entry;
+		entry.m_job = _jobs[i];
+		entry.m_counter = _counter;
+
+		s_state.m_numQueued.fetch_add(1, std::memory_order_seq_cst);
+
+		if (deque.Push(entry))
+		{
+			++numPushed;
+		}
+		else
+		{
+			// Full, just run it here.
+			s_state.m_numQueued.fetch_sub(1, std::memory_order_relaxed);
+			RunJob(entry.m_job, entry.m_counter);
+		}
+	}
+
+	if (numPushed)
+	{
+		WakeWorkers(numPushed);
+	}
+}
+
+void Run(Job const& _job, Counter* _counter)
+{
+	Run(&_job, 1, _counter);
+}
+
+void WaitForCounter(Counter* _counter)
+{
+	uint32_t const threadIdx = tls_threadIdx;
+	KT_ASSERT(threadIdx < s_state.m_numThreads);
+
+	while (!_counter->IsDone())
+	{
+		if (!TryRunOne(threadIdx))
+		{
+			_mm_pause();
+		}
+	}
+}
+
+void ResetWorkerFrameAllocators()
+{
+	KT_ASSERT(s_state.m_numQueued.load() == 0);
+
+	for (uint32_t i = 1; i < s_state.m_numThreads; ++i)
+	{
+		if (s_state.m_threads[i].m_frameAllocator)
+		{
+			s_state.m_threads[i].m_frameAllocator->Reset();
+		}
+	}
+}
+
+}
+
+}
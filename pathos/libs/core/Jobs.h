@@ -0,0 +1,133 @@
+#pragma once
+#include <kt/kt.h>
+
+#include <atomic>
+#include <type_traits>
+
+namespace core
+{
+
+namespace jobs
+{
+
+using JobFn = void(*)(void* _userData);
+
+// Incremented for every job run against it, decremented as each completes.
+struct Counter
+{
+	std::atomic<uint32_t> m_count{ 0 };
+
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	JobFn m_fn = nullptr;
+	void* m_userData = nullptr;
+
+	// If set, the job waits for this (helping with other work) before it starts.
+	Counter* m_dependency = nullptr;
+};
+
+// Workers default to hardware concurrency - 1, the calling thread is thread 0 and runs jobs while it waits.
+// Each worker gets its own thread frame allocator (see core/Memory.h).
+void Init(uint32_t _workerFrameAllocatorSize, uint32_t _numWorkers = 0);
+void Shutdown();
+
+// Workers + the main thread.
+uint32_t NumThreads();
+
+// 0 for the main thread, [1, NumThreads()) for workers, UINT32_MAX for threads outside the job system.
+uint32_t ThreadIndex();
+
+// Pushes onto the calling thread's queue, _counter (optional) is incremented by _numJobs.
+// Only the thread that called Init and the workers have a queue, other threads (eg. io) must not call Run, WaitForCounter or ParallelFor.
+void Run(Job const* _jobs, uint32_t _numJobs, Counter* _counter);
+void Run(Job const& _job, Counter* _counter);
+
+// Runs other jobs until _counter reaches zero.
+void WaitForCounter(Counter* _counter);
+
+// Resets every worker's frame allocator, must be called with no jobs in flight (eg. at the end of the frame).
+void ResetWorkerFrameAllocators();
+
+// Calls _fn(begin, end) over [0, _count) in chunks of _grainSize, spread over all threads. Blocks until complete.
+template <typename FnT>
+void ParallelFor(uint32_t _count, uint32_t _grainSize, FnT&& _fn);
+
+
+namespace detail
+{
+
+template <typename FnT>
+struct ParallelForData
+{
+	FnT* m_fn;
+	uint32_t m_count;
+	uint32_t m_grainSize;
+	std::atomic<uint32_t> m_nextBegin{ 0 };
+
+	static void Exec(void* _data)
+	{
+		ParallelForData* data = (ParallelForData*)_data;
+
+		// Chunks are claimed dynamically so uneven ranges balance out.
+		for (;;)
+		{
+			uint32_t const begin = data->m_nextBegin.fetch_add(data->m_grainSize, std::memory_order_relaxed);
+			if (begin >= data->m_count)
+			{
+				return;
+			}
+
+			(*data->m_fn)(begin, kt::Min(begin + data->m_grainSize, data->m_count));
+		}
+	}
+};
+
+}
+
+template <typename FnT>
+void ParallelFor(uint32_t _count, uint32_t _grainSize, FnT&& _fn)
+{
+	KT_ASSERT(ThreadIndex() < NumThreads());
+
+	if (!_count)
+	{
+		return;
+	}
+
+	_grainSize = kt::Max(_grainSize, 1u);
+
+	uint32_t const numChunks = (_count + _grainSize - 1) / _grainSize;
+	uint32_t const numHelpers = kt::Min(numChunks, NumThreads()) - 1;
+
+	if (!numHelpers)
+	{
+		_fn(0u, _count);
+		return;
+	}
+
+	using DataT = detail::ParallelForData<typename std::remove_reference<FnT>::type>;
+	DataT data;
+	data.m_fn = &_fn;
+	data.m_count = _count;
+	data.m_grainSize = _grainSize;
+
+	Job job;
+	job.m_fn = &DataT::Exec;
+	job.m_userData = &data;
+
+	Counter counter;
+	for (uint32_t i = 0; i < numHelpers; ++i)
+	{
+		Run(job, &counter);
+	}
+
+	DataT::Exec(&data);
+	WaitForCounter(&counter);
+}
+
+}
+
+}
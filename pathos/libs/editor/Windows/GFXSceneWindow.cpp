@@ -7,6 +7,7 @@
 #include <gfx/Model.h>
 #include <gfx/DebugRender.h>
 #include <gfx/ResourceManager.h>
+#include <gfx/SceneFile.h>
 
 #include "GFXSceneWindow.h"
 
@@ -26,35 +27,51 @@ GFXSceneWindow::~GFXSceneWindow()
 	editor::UnregisterWindow(m_windowHandle);
 }
 
+static void DrawUnifiedBufferStats(char const* _name, gfx::RangeAllocator const& _allocator)
+{
+	ImGui::Text("%s: %u/%u used, largest free block: %u, fragmentation: %.1f%%", _name, _allocator.UsedSize(), _allocator.Capacity(), _allocator.LargestFreeBlock(), _allocator.Fragmentation() * 100.0f);
+}
+
 static void DrawModelsTab(GFXSceneWindow* _window)
 {
-	kt::Slice<gfx::Model> models = gfx::ResourceManager::GetAllModels();
-	for (uint32_t i = 0; i < models.Size(); ++i)
+	gfx::ResourceManager::UnifiedBuffers const& unifiedBuffers = gfx::ResourceManager::GetUnifiedBuffers();
+	DrawUnifiedBufferStats("Vertices", unifiedBuffers.m_vertexAllocator);
+	DrawUnifiedBufferStats("Indices", unifiedBuffers.m_indexAllocator);
+	DrawUnifiedBufferStats("Sub Meshes", unifiedBuffers.m_subMeshAllocator);
+
+	if (ImGui::Button("Compact Unified Buffers"))
 	{
-		ImGui::PushID(i);
-		gfx::Model const& model = models[i];
-		char const* name = model.m_name.c_str();
+		gfx::ResourceManager::CompactUnifiedBuffers();
+	}
+
+	ImGui::SameLine();
+	ImGui::Text("Generation: %u", unifiedBuffers.m_generation);
+
+	ImGui::Separator();
+
+	gfx::ResourceManager::EnumModels([_window](gfx::ResourceManager::ModelIdx _idx, gfx::Model& _model)
+	{
+		ImGui::PushID(int(_idx.m_packed));
+		char const* name = _model.m_name.c_str();
 		if (ImGui::CollapsingHeader(name))
 		{
-			ImGui::Text("Sub Meshes: %u", model.m_meshes.Size());
-			ImGui::Text("Bounding Box Min: x: %.2f, y: %.2f, z: %.2f", model.m_boundingBox.m_min[0], model.m_boundingBox.m_min[1], model.m_boundingBox.m_min[2]);
-			ImGui::Text("Bounding Box Max: x: %.2f, y: %.2f, z: %.2f", model.m_boundingBox.m_max[0], model.m_boundingBox.m_max[1], model.m_boundingBox.m_max[2]);
+			ImGui::Text("Sub Meshes: %u", _model.m_meshes.Size());
+			ImGui::Text("Bounding Box Min: x: %.2f, y: %.2f, z: %.2f", _model.m_boundingBox.m_min[0], _model.m_boundingBox.m_min[1], _model.m_boundingBox.m_min[2]);
+			ImGui::Text("Bounding Box Max: x: %.2f, y: %.2f, z: %.2f", _model.m_boundingBox.m_max[0], _model.m_boundingBox.m_max[1], _model.m_boundingBox.m_max[2]);
 
 			if (ImGui::Button("Add instance"))
 			{
-				gfx::Scene::ModelInstance& instance = _window->m_scene->m_modelInstances.PushBack();
-				instance.m_modelIdx = gfx::ResourceManager::ModelIdx(uint16_t(i));
-				instance.m_mtx = kt::Mat4::Identity();
-				_window->m_selectedInstanceIdx = _window->m_scene->m_modelInstances.Size() - 1;
+				_window->m_selectedInstance = _window->m_scene->AddModelInstance(_idx, kt::Mat4::Identity());
 			}
 		}
 		ImGui::PopID();
-	}
+	});
 }
 
 static void DrawInstancesTab(GFXSceneWindow* _window)
 {
 	ImGui::Text("Total Model Instances: %u", _window->m_scene->m_modelInstances.Size());
+	ImGui::Text("Instance Tree Height: %u", _window->m_scene->m_instanceTree.Height());
 	static bool s_drawsSceneBounds = false;
 	ImGui::Checkbox("Draw Scene Bounds", &s_drawsSceneBounds); 
 
@@ -72,22 +89,42 @@ static void DrawInstancesTab(GFXSceneWindow* _window)
 		ImGui::PushID(i);
 		gfx::Model const& model = *gfx::ResourceManager::GetModel(instanceArray[i].m_modelIdx);
 		char const* modelName = model.m_name.c_str();
-		if (ImGui::Selectable(modelName, i == _window->m_selectedInstanceIdx))
+		if (ImGui::Selectable(modelName, instanceArray[i].m_handle == _window->m_selectedInstance))
 		{
-			_window->m_selectedInstanceIdx = i;
+			_window->m_selectedInstance = instanceArray[i].m_handle;
 		}
 		ImGui::PopID();
 	}
 
 	ImGui::NextColumn();
 
-	if (_window->m_selectedInstanceIdx < _window->m_scene->m_modelInstances.Size())
+	uint32_t const selectedIdx = _window->m_scene->InstanceIndex(_window->m_selectedInstance);
+
+	if (selectedIdx != UINT32_MAX)
 	{
-		gfx::Scene::ModelInstance& instance = instanceArray[_window->m_selectedInstanceIdx];
+		gfx::Scene::ModelInstance const& instance = instanceArray[selectedIdx];
 		gfx::Model const& model = *gfx::ResourceManager::GetModel(instance.m_modelIdx);
 		gfx::DebugRender::LineBox(model.m_boundingBox, instance.m_mtx, kt::Vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
-		ImGuizmo::Manipulate(_window->m_cam->GetView().Data(), _window->m_cam->GetProjection().Data(), _window->m_gizmoOp, _window->m_gizmoMode, instance.m_mtx.Data(), false);
+		kt::Mat4 mtx = instance.m_mtx;
+		ImGuizmo::Manipulate(_window->m_cam->GetView().Data(), _window->m_cam->GetProjection().Data(), _window->m_gizmoOp, _window->m_gizmoMode, mtx.Data(), false);
+
+		if (ImGuizmo::IsUsing())
+		{
+			_window->m_scene->SetInstanceTransform(_window->m_selectedInstance, mtx);
+		}
+
+		bool visible = instance.m_isVisible;
+		if (ImGui::Checkbox("Visible", &visible))
+		{
+			_window->m_scene->SetInstanceVisible(_window->m_selectedInstance, visible);
+		}
+
+		if (ImGui::Button("Remove Instance"))
+		{
+			_window->m_scene->RemoveModelInstance(_window->m_selectedInstance);
+			_window->m_selectedInstance = gfx::Scene::InstanceHandle{};
+		}
 	}
 
 	ImGui::Columns();
@@ -149,7 +186,7 @@ static void DrawLightsTab(GFXSceneWindow* _window)
 		static float s_minIntensity = 100.0f;
 		static float s_maxIntensity = 1000.0f;
 
-		ImGui::DragInt("Num Lights", &s_numLights, 1.0f, 0, 4096 * 4);
+		ImGui::DragInt("Num Lights", &s_numLights, 1.0f, 0, 4096 * 16);
 		ImGui::SliderFloat3("Scene Bounds Scale", &s_sceneBoundScale.x, 0.0f, 1.0f);
 		ImGui::DragFloatRange2("Intensity Range", &s_minIntensity, &s_maxIntensity, 1.0f, 0.0f, 25000.0f);
 
@@ -172,6 +209,9 @@ static void DrawLightsTab(GFXSceneWindow* _window)
 		_window->m_scene->m_lights.Clear();
 	}
 
+	gfx::LightClusters::Stats const& clusterStats = _window->m_scene->m_lightClusters.GetStats();
+	ImGui::Text("Clustered lights: %u in view, %u indices, max %u per cluster, cpu time: %.3fms", clusterStats.m_numLightsInView, clusterStats.m_numLightIndices, clusterStats.m_maxLightsPerCluster, clusterStats.m_cpuTimeMs);
+
 	ImGui::Separator();
 	ImGui::BeginChild("Light List");
 	for (uint32_t i = 0; i < _window->m_scene->m_lights.Size(); ++i)
@@ -251,28 +291,25 @@ static void DrawMaterialsTab(GFXSceneWindow* _window)
 {
 	ImGui::Columns(2);
 
-	kt::Slice<gfx::Material> materials = gfx::ResourceManager::GetAllMaterials();
-
-	for (uint32_t i = 0; i < materials.Size(); ++i)
+	gfx::ResourceManager::EnumMaterials([_window](gfx::ResourceManager::MaterialIdx _idx, gfx::Material& _mat)
 	{
-		ImGui::PushID(i);
-		if (ImGui::Selectable(materials[i].m_name.Data(), _window->m_selectedMaterialidx == i))
+		ImGui::PushID(int(_idx.m_packed));
+		if (ImGui::Selectable(_mat.m_name.Data(), _window->m_selectedMaterialIdx == _idx))
 		{
-			_window->m_selectedMaterialidx = i;
+			_window->m_selectedMaterialIdx = _idx;
 		}
 		ImGui::PopID();
-	}
+	});
 
 	ImGui::NextColumn();
 
-	if (_window->m_selectedMaterialidx < materials.Size())
+	if (gfx::Material* mat = gfx::ResourceManager::GetMaterial(_window->m_selectedMaterialIdx))
 	{
 		bool edited = false;
-		gfx::Material& mat = materials[_window->m_selectedMaterialidx];
-		edited |= ImGui::ColorEdit4("Base Colour", (float*)&mat.m_params.m_baseColour);
-		edited |= ImGui::SliderFloat("Roughness", &mat.m_params.m_roughnessFactor, 0.0f, 1.0f);
-		edited |= ImGui::SliderFloat("Metallic", &mat.m_params.m_metallicFactor, 0.0f, 1.0f);
-		edited |= ImGui::SliderFloat("Alpha Cutoff", &mat.m_params.m_alphaCutoff, 0.0f, 1.0f);
+		edited |= ImGui::ColorEdit4("Base Colour", (float*)&mat->m_params.m_baseColour);
+		edited |= ImGui::SliderFloat("Roughness", &mat->m_params.m_roughnessFactor, 0.0f, 1.0f);
+		edited |= ImGui::SliderFloat("Metallic", &mat->m_params.m_metallicFactor, 0.0f, 1.0f);
+		edited |= ImGui::SliderFloat("Alpha Cutoff", &mat->m_params.m_alphaCutoff, 0.0f, 1.0f);
 		if (edited)
 		{
 			gfx::ResourceManager::SetMaterialsDirty();
@@ -286,6 +323,33 @@ static void DrawMaterialsTab(GFXSceneWindow* _window)
 	ImGui::Columns();
 }
 
+static void DrawSceneFile(GFXSceneWindow* _window)
+{
+	ImGui::InputText("Scene File", _window->m_sceneFilePath, sizeof(_window->m_sceneFilePath));
+
+	if (ImGui::Button("Save Scene"))
+	{
+		gfx::SceneFile::Save(*_window->m_scene, _window->m_sceneFilePath);
+	}
+
+	ImGui::SameLine();
+
+	if (ImGui::Button("Load Scene"))
+	{
+		// Replaces what's in the scene, models no longer instanced are freed unless something else holds them.
+		while (_window->m_scene->m_modelInstances.Size())
+		{
+			_window->m_scene->RemoveModelInstance(_window->m_scene->m_modelInstances.Back().m_handle);
+		}
+
+		_window->m_scene->m_lights.Clear();
+		_window->m_selectedInstance = gfx::Scene::InstanceHandle{};
+		_window->m_selectedLightIdx = 0xFFFFFFFF;
+
+		gfx::SceneFile::Load(*_window->m_scene, _window->m_sceneFilePath);
+	}
+}
+
 void GFXSceneWindow::Draw(float _dt)
 {
 	KT_UNUSED(_dt);
@@ -305,6 +369,45 @@ void GFXSceneWindow::Draw(float _dt)
 		gfx::DebugRender::LineFrustum(m_lockedCam, kt::Vec4(0.0f, 1.0f, 1.0f, 1.0f));
 	}
 
+	// Cull against the locked frustum so culling can be inspected from outside it.
+	m_scene->m_debugCullCamera = m_lockFrustum ? &m_lockedCam : nullptr;
+
+	gfx::MeshRenderer::CullStats const& cullStats = m_scene->m_mainView.m_renderer.GetCullStats();
+	ImGui::Text("Submesh instances visible: %u/%u (%u occluded), cpu cull time: %.3fms", cullStats.m_numVisible, cullStats.m_numTested, cullStats.m_numOccluded, cullStats.m_cpuTimeMs);
+
+	gfx::Scene::LodStats const& lodStats = m_scene->m_lodStats;
+	ImGui::Text("Main view instances per lod:");
+	float lodHistogram[gfx::c_maxMeshLods];
+	for (uint32_t lod = 0; lod < gfx::c_maxMeshLods; ++lod)
+	{
+		ImGui::SameLine();
+		ImGui::Text("%u", lodStats.m_numInstances[lod]);
+		lodHistogram[lod] = float(lodStats.m_numInstances[lod]);
+	}
+	ImGui::SameLine();
+	ImGui::Text("(%u culled as small)", lodStats.m_numCulled);
+	ImGui::PlotHistogram("Lods", lodHistogram, gfx::c_maxMeshLods, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+
+	gfx::OcclusionBuffer::Stats const& occlusionStats = m_scene->m_occlusionBuffer.GetStats();
+	ImGui::Text("Occluders: %u, triangles: %u/%u, raster time: %.3fms, instances occluded: %u", occlusionStats.m_numOccluders, occlusionStats.m_numTrianglesRasterized, occlusionStats.m_numTrianglesSubmitted, occlusionStats.m_rasterTimeMs, m_scene->m_numOccludedInstances);
+
+	gfx::InstanceTable::UploadStats const& uploadStats = m_scene->m_instanceTable.GetUploadStats();
+	ImGui::Text("Instance slots: %u/%u, uploaded: %u (%u ranges, %u bytes)", m_scene->m_instanceTable.NumUsedSlots(), m_scene->m_instanceTable.Capacity(), uploadStats.m_numDirtySlots, uploadStats.m_numRanges, uploadStats.m_numBytes);
+#if PATHOS_COMPACT_INSTANCE_DATA
+	kt::Vec3 const& instanceOrigin = m_scene->m_instanceTable.Origin();
+	ImGui::Text("Compact instances, origin: (%.1f, %.1f, %.1f), max error position: %g basis: %g", instanceOrigin.x, instanceOrigin.y, instanceOrigin.z, uploadStats.m_maxPositionError, uploadStats.m_maxBasisError);
+#endif
+
+	ImGui::Text("Shadow caster instances (of %u):", m_scene->m_modelInstances.Size());
+	for (uint32_t cascadeIdx = 0; cascadeIdx < gfx::Scene::c_numShadowCascades; ++cascadeIdx)
+	{
+		ImGui::SameLine();
+		gfx::Scene::ShadowCascadeCache const& cache = m_scene->m_shadowCascadeCache[cascadeIdx];
+		ImGui::Text("%u%s", m_scene->m_numShadowCasterInstances[cascadeIdx], !cache.m_updateThisFrame ? " (skipped)" : cache.m_renderStaticThisFrame ? " (static redrawn)" : "");
+	}
+
+	DrawSceneFile(this);
+
 	ImGui::ColorEdit3("Sun Color", &m_scene->m_sunColor[0]);
 	ImGui::DragFloat("Sun Intensity", &m_scene->m_sunIntensity, 1.0f, 0.05f, 1000.0f, "%.3f", 7.0f);
 
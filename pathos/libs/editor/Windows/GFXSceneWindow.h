@@ -1,11 +1,12 @@
 #pragma once
 #include <editor/Editor.h>
+#include <gfx/ResourceManager.h>
+#include <gfx/Scene.h>
 
 #include "ImGuizmo.h"
 
 namespace gfx
 {
-class Scene;
 struct Camera;
 }
 
@@ -26,8 +27,8 @@ struct GFXSceneWindow
 	gfx::Camera* m_cam = nullptr;
 
 	uint32_t m_selectedLightIdx = 0xFFFFFFFF;
-	uint32_t m_selectedInstanceIdx = 0xFFFFFFFF;
-	uint32_t m_selectedMaterialidx = 0xFFFFFFFF;
+	gfx::Scene::InstanceHandle m_selectedInstance;
+	gfx::ResourceManager::MaterialIdx m_selectedMaterialIdx;
 
 	editor::ImGuiWindowHandle m_windowHandle;
 
@@ -37,6 +38,8 @@ struct GFXSceneWindow
 	gfx::Camera m_lockedCam;
 	bool m_lockFrustum = false;
 
+	char m_sceneFilePath[256] = "scene.pscn";
+
 };
 
 }
\ No newline at end of file
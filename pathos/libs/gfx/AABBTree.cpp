@@ -0,0 +1,332 @@
+#include "AABBTree.h"
+
+namespace gfx
+{
+
+// Leaves are grown by this fraction of their size (plus a small constant for flat boxes).
+static float const c_fatAABBScale = 0.1f;
+static float const c_fatAABBMinMargin = 0.01f;
+
+static kt::AABB UnionAABB(kt::AABB const& _a, kt::AABB const& _b)
+{
+	kt::AABB ret;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		ret.m_min[i] = kt::Min(_a.m_min[i], _b.m_min[i]);
+		ret.m_max[i] = kt::Max(_a.m_max[i], _b.m_max[i]);
+	}
+	return ret;
+}
+
+static bool Contains(kt::AABB const& _outer, kt::AABB const& _inner)
+{
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		if (_inner.m_min[i] < _outer.m_min[i] || _inner.m_max[i] > _outer.m_max[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static float SurfaceArea(kt::AABB const& _aabb)
+{
+	kt::Vec3 const d = _aabb.m_max - _aabb.m_min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static kt::AABB FattenAABB(kt::AABB const& _aabb)
+{
+	kt::AABB ret;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		float const margin = (_aabb.m_max[i] - _aabb.m_min[i]) * c_fatAABBScale + c_fatAABBMinMargin;
+		ret.m_min[i] = _aabb.m_min[i] - margin;
+		ret.m_max[i] = _aabb.m_max[i] + margin;
+	}
+	return ret;
+}
+
+AABBTree::ProxyId AABBTree::Insert(kt::AABB const& _aabb, uint32_t _userData)
+{
+	uint32_t const leaf = AllocNode();
+	Node& node = m_nodes[leaf];
+	node.m_aabb = FattenAABB(_aabb);
+	node.m_userData = _userData;
+	node.m_height = 0;
+
+	InsertLeaf(leaf);
+	++m_numLeaves;
+	return leaf;
+}
+
+void AABBTree::Remove(ProxyId _proxy)
+{
+	KT_ASSERT(_proxy < m_nodes.Size() && m_nodes[_proxy].IsLeaf() && m_nodes[_proxy].m_height == 0);
+	RemoveLeaf(_proxy);
+	FreeNode(_proxy);
+	--m_numLeaves;
+}
+
+bool AABBTree::Update(ProxyId _proxy, kt::AABB const& _aabb)
+{
+	KT_ASSERT(_proxy < m_nodes.Size() && m_nodes[_proxy].IsLeaf() && m_nodes[_proxy].m_height == 0);
+
+	kt::AABB const& fatAABB = m_nodes[_proxy].m_aabb;
+
+	if (Contains(fatAABB, _aabb))
+	{
+		// Still reinsert if the fat bounds are now much too large, eg. after scaling down.
+		if (SurfaceArea(fatAABB) < SurfaceArea(FattenAABB(_aabb)) * 4.0f)
+		{
+			return false;
+		}
+	}
+
+	RemoveLeaf(_proxy);
+	m_nodes[_proxy].m_aabb = FattenAABB(_aabb);
+	InsertLeaf(_proxy);
+	return true;
+}
+
+void AABBTree::Clear()
+{
+	m_nodes.Clear();
+	m_root = c_null;
+	m_freeList = c_null;
+	m_numLeaves = 0;
+}
+
+uint32_t AABBTree::AllocNode()
+{
+	uint32_t nodeIdx;
+	if (m_freeList != c_null)
+	{
+		nodeIdx = m_freeList;
+		m_freeList = m_nodes[nodeIdx].m_nextFree;
+	}
+	else
+	{
+		nodeIdx = m_nodes.Size();
+		m_nodes.PushBack();
+	}
+
+	Node& node = m_nodes[nodeIdx];
+	node.m_parent = c_null;
+	node.m_children[0] = c_null;
+	node.m_children[1] = c_null;
+	node.m_userData = 0;
+	node.m_height = 0;
+	return nodeIdx;
+}
+
+void AABBTree::FreeNode(uint32_t _nodeIdx)
+{
+	Node& node = m_nodes[_nodeIdx];
+	node.m_nextFree = m_freeList;
+	node.m_height = -1;
+	m_freeList = _nodeIdx;
+}
+
+void AABBTree::InsertLeaf(uint32_t _leaf)
+{
+	if (m_root == c_null)
+	{
+		m_root = _leaf;
+		m_nodes[_leaf].m_parent = c_null;
+		return;
+	}
+
+	kt::AABB const leafAABB = m_nodes[_leaf].m_aabb;
+
+	// Walk down picking the child with the lowest cost increase (surface area heuristic).
+	uint32_t sibling = m_root;
+	while (!m_nodes[sibling].IsLeaf())
+	{
+		Node const& node = m_nodes[sibling];
+		uint32_t const child0 = node.m_children[0];
+		uint32_t const child1 = node.m_children[1];
+
+		float const area = SurfaceArea(node.m_aabb);
+		float const combinedArea = SurfaceArea(UnionAABB(node.m_aabb, leafAABB));
+
+		// Cost of making a new parent for this node and the leaf.
+		float const cost = 2.0f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down.
+		float const inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [this, &leafAABB, inheritanceCost](uint32_t _child)
+		{
+			Node const& child = m_nodes[_child];
+			float const newArea = SurfaceArea(UnionAABB(child.m_aabb, leafAABB));
+			return child.IsLeaf() ? newArea + inheritanceCost : (newArea - SurfaceArea(child.m_aabb)) + inheritanceCost;
+		};
+
+		float const cost0 = descendCost(child0);
+		float const cost1 = descendCost(child1);
+
+		if (cost < cost0 && cost < cost1)
+		{
+			break;
+		}
+
+		sibling = cost0 < cost1 ? child0 : child1;
+	}
+
+	uint32_t const oldParent = m_nodes[sibling].m_parent;
+	uint32_t const newParent = AllocNode();
+
+	// AllocNode can reallocate m_nodes.
+	Node& parentNode = m_nodes[newParent];
+	parentNode.m_parent = oldParent;
+	parentNode.m_aabb = UnionAABB(leafAABB, m_nodes[sibling].m_aabb);
+	parentNode.m_height = m_nodes[sibling].m_height + 1;
+	parentNode.m_children[0] = sibling;
+	parentNode.m_children[1] = _leaf;
+
+	if (oldParent != c_null)
+	{
+		Node& oldParentNode = m_nodes[oldParent];
+		oldParentNode.m_children[oldParentNode.m_children[0] == sibling ? 0 : 1] = newParent;
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	m_nodes[sibling].m_parent = newParent;
+	m_nodes[_leaf].m_parent = newParent;
+
+	FixUpwards(m_nodes[_leaf].m_parent);
+}
+
+void AABBTree::RemoveLeaf(uint32_t _leaf)
+{
+	if (_leaf == m_root)
+	{
+		m_root = c_null;
+		return;
+	}
+
+	uint32_t const parent = m_nodes[_leaf].m_parent;
+	uint32_t const grandParent = m_nodes[parent].m_parent;
+	uint32_t const sibling = m_nodes[parent].m_children[m_nodes[parent].m_children[0] == _leaf ? 1 : 0];
+
+	if (grandParent != c_null)
+	{
+		// Replace parent with sibling.
+		Node& grandParentNode = m_nodes[grandParent];
+		grandParentNode.m_children[grandParentNode.m_children[0] == parent ? 0 : 1] = sibling;
+		m_nodes[sibling].m_parent = grandParent;
+		FreeNode(parent);
+
+		FixUpwards(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].m_parent = c_null;
+		FreeNode(parent);
+	}
+}
+
+void AABBTree::FixUpwards(uint32_t _nodeIdx)
+{
+	while (_nodeIdx != c_null)
+	{
+		_nodeIdx = Balance(_nodeIdx);
+
+		Node& node = m_nodes[_nodeIdx];
+		Node const& child0 = m_nodes[node.m_children[0]];
+		Node const& child1 = m_nodes[node.m_children[1]];
+
+		node.m_height = 1 + kt::Max(child0.m_height, child1.m_height);
+		node.m_aabb = UnionAABB(child0.m_aabb, child1.m_aabb);
+
+		_nodeIdx = node.m_parent;
+	}
+}
+
+// Rotates _a's taller child up if its children are unbalanced. Returns the new root of this subtree.
+uint32_t AABBTree::Balance(uint32_t _a)
+{
+	Node& a = m_nodes[_a];
+	if (a.IsLeaf() || a.m_height < 2)
+	{
+		return _a;
+	}
+
+	uint32_t const iB = a.m_children[0];
+	uint32_t const iC = a.m_children[1];
+	Node& b = m_nodes[iB];
+	Node& c = m_nodes[iC];
+
+	int32_t const balance = c.m_height - b.m_height;
+
+	auto rotateUp = [this, _a](uint32_t _up, uint32_t _down, uint32_t _upSlot)
+	{
+		Node& a = m_nodes[_a];
+		Node& up = m_nodes[_up];
+		Node& down = m_nodes[_down];
+
+		uint32_t const iF = up.m_children[0];
+		uint32_t const iG = up.m_children[1];
+		Node& f = m_nodes[iF];
+		Node& g = m_nodes[iG];
+
+		// Swap a and up.
+		up.m_children[0] = _a;
+		up.m_parent = a.m_parent;
+		a.m_parent = _up;
+
+		if (up.m_parent != c_null)
+		{
+			Node& upParent = m_nodes[up.m_parent];
+			upParent.m_children[upParent.m_children[0] == _a ? 0 : 1] = _up;
+		}
+		else
+		{
+			m_root = _up;
+		}
+
+		// Keep the taller grandchild under up, move the shorter one under a.
+		uint32_t keep = iF;
+		uint32_t move = iG;
+		if (f.m_height < g.m_height)
+		{
+			keep = iG;
+			move = iF;
+		}
+
+		Node& keepNode = m_nodes[keep];
+		Node& moveNode = m_nodes[move];
+
+		up.m_children[1] = keep;
+		a.m_children[_upSlot] = move;
+		moveNode.m_parent = _a;
+
+		a.m_aabb = UnionAABB(down.m_aabb, moveNode.m_aabb);
+		up.m_aabb = UnionAABB(a.m_aabb, keepNode.m_aabb);
+
+		a.m_height = 1 + kt::Max(down.m_height, moveNode.m_height);
+		up.m_height = 1 + kt::Max(a.m_height, keepNode.m_height);
+	};
+
+	if (balance > 1)
+	{
+		rotateUp(iC, iB, 1);
+		return iC;
+	}
+
+	if (balance < -1)
+	{
+		rotateUp(iB, iC, 0);
+		return iB;
+	}
+
+	return _a;
+}
+
+}
@@ -0,0 +1,409 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/AABB.h>
+#include <kt/Vec3.h>
+#include <kt/Vec4.h>
+
+namespace gfx
+{
+
+// Dynamic bounding volume hierarchy, kept balanced with tree rotations on insert/remove.
+// Leaves store a fattened AABB so small movements don't require a reinsert.
+class AABBTree
+{
+public:
+	using ProxyId = uint32_t;
+	static ProxyId constexpr c_invalidProxy = UINT32_MAX;
+
+	ProxyId Insert(kt::AABB const& _aabb, uint32_t _userData);
+	void Remove(ProxyId _proxy);
+
+	// Returns true if the proxy had to be reinserted (_aabb moved out of its fat bounds).
+	bool Update(ProxyId _proxy, kt::AABB const& _aabb);
+
+	uint32_t GetUserData(ProxyId _proxy) const { return m_nodes[_proxy].m_userData; }
+	void SetUserData(ProxyId _proxy, uint32_t _userData) { m_nodes[_proxy].m_userData = _userData; }
+
+	kt::AABB const& GetFatAABB(ProxyId _proxy) const { return m_nodes[_proxy].m_aabb; }
+
+	bool IsEmpty() const { return m_root == c_null; }
+
+	// Bounds of everything in the tree (fattened).
+	kt::AABB const& RootBounds() const { KT_ASSERT(!IsEmpty()); return m_nodes[m_root].m_aabb; }
+
+	uint32_t Height() const { return m_root == c_null ? 0 : uint32_t(m_nodes[m_root].m_height); }
+	uint32_t NumLeaves() const { return m_numLeaves; }
+
+	void Clear();
+
+	// Queries call _fn(uint32_t _userData) for every leaf that may intersect.
+
+	// Inward facing planes (as returned by Camera::GetFrustumPlanes), at most 32.
+	template <typename FnT>
+	void QueryPlanes(kt::Vec4 const* _planes, uint32_t _numPlanes, FnT&& _fn) const;
+
+	struct PlaneSet
+	{
+		kt::Vec4 const* m_planes;
+		uint32_t m_numPlanes;
+	};
+
+	static uint32_t constexpr c_maxPlaneSets = 8;
+
+	// Several sets of planes (eg. one per view) in a single traversal, each node's bounds are loaded once and tested against every set still overlapping it.
+	// Calls _fn(uint32_t _userData, uint32_t _setMask) for every leaf that may intersect any set, with a bit set for each one. A set with no planes takes everything.
+	template <typename FnT>
+	void QueryPlaneSets(PlaneSet const* _sets, uint32_t _numSets, FnT&& _fn) const;
+
+	template <typename FnT>
+	void QuerySphere(kt::Vec3 const& _center, float _radius, FnT&& _fn) const;
+
+	template <typename FnT>
+	void QueryAABB(kt::AABB const& _aabb, FnT&& _fn) const;
+
+	template <typename FnT>
+	void QueryAll(FnT&& _fn) const;
+
+private:
+	static uint32_t constexpr c_null = UINT32_MAX;
+	static uint32_t constexpr c_maxQueryStack = 128;
+
+	struct Node
+	{
+		bool IsLeaf() const { return m_children[0] == c_null; }
+
+		kt::AABB m_aabb;
+
+		union
+		{
+			uint32_t m_parent;
+			uint32_t m_nextFree;
+		};
+
+		uint32_t m_children[2];
+		uint32_t m_userData;
+
+		// Leaf = 0, free = -1.
+		int32_t m_height;
+	};
+
+	uint32_t AllocNode();
+	void FreeNode(uint32_t _nodeIdx);
+
+	void InsertLeaf(uint32_t _leaf);
+	void RemoveLeaf(uint32_t _leaf);
+
+	// Refits and rebalances from _nodeIdx up to the root.
+	void FixUpwards(uint32_t _nodeIdx);
+	uint32_t Balance(uint32_t _nodeIdx);
+
+	// Calls _fn for every leaf under _nodeIdx without any further tests.
+	template <typename FnT>
+	void ReportSubtree(uint32_t _nodeIdx, FnT&& _fn) const;
+
+	kt::Array<Node> m_nodes;
+	uint32_t m_root = c_null;
+	uint32_t m_freeList = c_null;
+	uint32_t m_numLeaves = 0;
+};
+
+namespace aabb_tree_detail
+{
+
+inline bool Overlaps(kt::AABB const& _a, kt::AABB const& _b)
+{
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		if (_a.m_max[i] < _b.m_min[i] || _a.m_min[i] > _b.m_max[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+inline float SqDistPointAABB(kt::Vec3 const& _p, kt::AABB const& _aabb)
+{
+	float sqDist = 0.0f;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		float const v = _p[i];
+		if (v < _aabb.m_min[i])
+		{
+			sqDist += (_aabb.m_min[i] - v) * (_aabb.m_min[i] - v);
+		}
+		else if (v > _aabb.m_max[i])
+		{
+			sqDist += (v - _aabb.m_max[i]) * (v - _aabb.m_max[i]);
+		}
+	}
+	return sqDist;
+}
+
+}
+
+template <typename FnT>
+void AABBTree::ReportSubtree(uint32_t _nodeIdx, FnT&& _fn) const
+{
+	uint32_t stack[c_maxQueryStack];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = _nodeIdx;
+
+	while (stackSize)
+	{
+		Node const& node = m_nodes[stack[--stackSize]];
+		if (node.IsLeaf())
+		{
+			_fn(node.m_userData);
+			continue;
+		}
+
+		KT_ASSERT(stackSize + 2 <= c_maxQueryStack);
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+template <typename FnT>
+void AABBTree::QueryAll(FnT&& _fn) const
+{
+	if (m_root != c_null)
+	{
+		ReportSubtree(m_root, _fn);
+	}
+}
+
+template <typename FnT>
+void AABBTree::QueryPlanes(kt::Vec4 const* _planes, uint32_t _numPlanes, FnT&& _fn) const
+{
+	KT_ASSERT(_numPlanes <= 32);
+
+	if (m_root == c_null)
+	{
+		return;
+	}
+
+	// Planes a node is fully inside of are masked off for its children.
+	struct Entry
+	{
+		uint32_t m_node;
+		uint32_t m_planeMask;
+	};
+
+	Entry stack[c_maxQueryStack];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = Entry{ m_root, _numPlanes == 32 ? UINT32_MAX : (1u << _numPlanes) - 1 };
+
+	while (stackSize)
+	{
+		Entry const entry = stack[--stackSize];
+		Node const& node = m_nodes[entry.m_node];
+
+		kt::Vec3 const center = (node.m_aabb.m_min + node.m_aabb.m_max) * 0.5f;
+		kt::Vec3 const extent = (node.m_aabb.m_max - node.m_aabb.m_min) * 0.5f;
+
+		uint32_t planeMask = entry.m_planeMask;
+		bool outside = false;
+
+		for (uint32_t planeIdx = 0; planeIdx < _numPlanes; ++planeIdx)
+		{
+			if (!(planeMask & (1u << planeIdx)))
+			{
+				continue;
+			}
+
+			kt::Vec4 const& plane = _planes[planeIdx];
+			float const dist = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float const radius = kt::Abs(plane.x) * extent.x + kt::Abs(plane.y) * extent.y + kt::Abs(plane.z) * extent.z;
+
+			if (dist + radius < 0.0f)
+			{
+				outside = true;
+				break;
+			}
+
+			if (dist - radius >= 0.0f)
+			{
+				planeMask &= ~(1u << planeIdx);
+			}
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+		if (!planeMask || node.IsLeaf())
+		{
+			ReportSubtree(entry.m_node, _fn);
+			continue;
+		}
+
+		KT_ASSERT(stackSize + 2 <= c_maxQueryStack);
+		stack[stackSize++] = Entry{ node.m_children[0], planeMask };
+		stack[stackSize++] = Entry{ node.m_children[1], planeMask };
+	}
+}
+
+template <typename FnT>
+void AABBTree::QueryPlaneSets(PlaneSet const* _sets, uint32_t _numSets, FnT&& _fn) const
+{
+	KT_ASSERT(_numSets <= c_maxPlaneSets);
+
+	if (m_root == c_null || !_numSets)
+	{
+		return;
+	}
+
+	// As in QueryPlanes, but with a plane mask per set and the sets that haven't rejected the node.
+	struct Entry
+	{
+		uint32_t m_node;
+		uint32_t m_setMask;
+		uint32_t m_planeMasks[c_maxPlaneSets];
+	};
+
+	Entry stack[c_maxQueryStack];
+	uint32_t stackSize = 0;
+
+	Entry& root = stack[stackSize++];
+	root.m_node = m_root;
+	root.m_setMask = (1u << _numSets) - 1;
+
+	for (uint32_t setIdx = 0; setIdx < _numSets; ++setIdx)
+	{
+		KT_ASSERT(_sets[setIdx].m_numPlanes <= 32);
+		root.m_planeMasks[setIdx] = _sets[setIdx].m_numPlanes == 32 ? UINT32_MAX : (1u << _sets[setIdx].m_numPlanes) - 1;
+	}
+
+	while (stackSize)
+	{
+		Entry entry = stack[--stackSize];
+		Node const& node = m_nodes[entry.m_node];
+
+		kt::Vec3 const center = (node.m_aabb.m_min + node.m_aabb.m_max) * 0.5f;
+		kt::Vec3 const extent = (node.m_aabb.m_max - node.m_aabb.m_min) * 0.5f;
+
+		// Sets that still straddle the node, the rest either rejected it or contain all of it.
+		uint32_t straddlingSets = 0;
+
+		for (uint32_t setBits = entry.m_setMask; setBits; setBits &= setBits - 1)
+		{
+			uint32_t const setIdx = kt::FloorLog2(setBits & (0u - setBits));
+			kt::Vec4 const* planes = _sets[setIdx].m_planes;
+			uint32_t planeMask = entry.m_planeMasks[setIdx];
+
+			for (uint32_t planeBits = planeMask; planeBits; planeBits &= planeBits - 1)
+			{
+				uint32_t const planeIdx = kt::FloorLog2(planeBits & (0u - planeBits));
+				kt::Vec4 const& plane = planes[planeIdx];
+				float const dist = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				float const radius = kt::Abs(plane.x) * extent.x + kt::Abs(plane.y) * extent.y + kt::Abs(plane.z) * extent.z;
+
+				if (dist + radius < 0.0f)
+				{
+					entry.m_setMask &= ~(1u << setIdx);
+					planeMask = 0;
+					break;
+				}
+
+				if (dist - radius >= 0.0f)
+				{
+					planeMask &= ~(1u << planeIdx);
+				}
+			}
+
+			entry.m_planeMasks[setIdx] = planeMask;
+			straddlingSets |= planeMask ? (1u << setIdx) : 0;
+		}
+
+		if (!entry.m_setMask)
+		{
+			continue;
+		}
+
+		if (!straddlingSets || node.IsLeaf())
+		{
+			uint32_t const setMask = entry.m_setMask;
+			ReportSubtree(entry.m_node, [&_fn, setMask](uint32_t _userData) { _fn(_userData, setMask); });
+			continue;
+		}
+
+		KT_ASSERT(stackSize + 2 <= c_maxQueryStack);
+		entry.m_node = node.m_children[0];
+		stack[stackSize++] = entry;
+		entry.m_node = node.m_children[1];
+		stack[stackSize++] = entry;
+	}
+}
+
+template <typename FnT>
+void AABBTree::QuerySphere(kt::Vec3 const& _center, float _radius, FnT&& _fn) const
+{
+	if (m_root == c_null)
+	{
+		return;
+	}
+
+	float const sqRadius = _radius * _radius;
+
+	uint32_t stack[c_maxQueryStack];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = m_root;
+
+	while (stackSize)
+	{
+		Node const& node = m_nodes[stack[--stackSize]];
+
+		if (aabb_tree_detail::SqDistPointAABB(_center, node.m_aabb) > sqRadius)
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			_fn(node.m_userData);
+			continue;
+		}
+
+		KT_ASSERT(stackSize + 2 <= c_maxQueryStack);
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+template <typename FnT>
+void AABBTree::QueryAABB(kt::AABB const& _aabb, FnT&& _fn) const
+{
+	if (m_root == c_null)
+	{
+		return;
+	}
+
+	uint32_t stack[c_maxQueryStack];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = m_root;
+
+	while (stackSize)
+	{
+		Node const& node = m_nodes[stack[--stackSize]];
+
+		if (!aabb_tree_detail::Overlaps(_aabb, node.m_aabb))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			_fn(node.m_userData);
+			continue;
+		}
+
+		KT_ASSERT(stackSize + 2 <= c_maxQueryStack);
+		stack[stackSize++] = node.m_children[0];
+		stack[stackSize++] = node.m_children[1];
+	}
+}
+
+}
@@ -0,0 +1,347 @@
+#include "Culling.h"
+
+#include <immintrin.h>
+#include <string.h>
+
+#include <core/CPU.h>
+
+namespace gfx
+{
+
+static bool const s_hasAVX2 = core::CPUHasAVX2_FMA();
+
+bool CPUSupportsAVX2()
+{
+	return s_hasAVX2;
+}
+
+void CullingAABBs_SoA::Init(kt::LinearAllocator* _allocator, uint32_t _num)
+{
+	m_num = _num;
+	m_capacity = uint32_t(kt::AlignUp(_num, c_cullingSimdWidth));
+
+	float** const arrays[] = { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ };
+	for (float** arr : arrays)
+	{
+		*arr = (float*)_allocator->Alloc(sizeof(float) * m_capacity, 32);
+	}
+}
+
+void CullingAABBs_SoA::Init(kt::Array<float>& _storage, uint32_t _num)
+{
+	m_num = _num;
+	m_capacity = uint32_t(kt::AlignUp(_num, c_cullingSimdWidth));
+
+	// Extra SIMD width so the first array can be aligned.
+	_storage.Resize(m_capacity * 6 + c_cullingSimdWidth);
+	float* ptr = (float*)kt::AlignUp(uintptr_t(_storage.Data()), sizeof(float) * c_cullingSimdWidth);
+
+	float** const arrays[] = { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ };
+	for (float** arr : arrays)
+	{
+		*arr = ptr;
+		ptr += m_capacity;
+	}
+}
+
+void TransformAABBsToSoA(float const* _mtx3x4, kt::AABB const* _aabbs, uint32_t _num, CullingAABBs_SoA& o_soa, uint32_t _writeIdx)
+{
+	KT_ASSERT(_writeIdx + _num <= o_soa.m_num);
+
+	__m128 const signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	// Broadcast every matrix element, then transform 4 bounds at a time.
+	__m128 m[3][4];
+	__m128 absM[3][3];
+
+	for (uint32_t row = 0; row < 3; ++row)
+	{
+		for (uint32_t col = 0; col < 4; ++col)
+		{
+			m[row][col] = _mm_set1_ps(_mtx3x4[row * 4 + col]);
+		}
+
+		for (uint32_t col = 0; col < 3; ++col)
+		{
+			absM[row][col] = _mm_and_ps(m[row][col], signMask);
+		}
+	}
+
+	__m128 const half = _mm_set1_ps(0.5f);
+
+	for (uint32_t i = 0; i < _num; i += 4)
+	{
+		alignas(16) float localCenter[3][4] = {};
+		alignas(16) float localExtent[3][4] = {};
+
+		uint32_t const numThisIter = kt::Min(_num - i, 4u);
+		for (uint32_t lane = 0; lane < numThisIter; ++lane)
+		{
+			kt::AABB const& aabb = _aabbs[i + lane];
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				localCenter[axis][lane] = aabb.m_min[axis] + aabb.m_max[axis];
+				localExtent[axis][lane] = aabb.m_max[axis] - aabb.m_min[axis];
+			}
+		}
+
+		__m128 const cx = _mm_mul_ps(_mm_load_ps(localCenter[0]), half);
+		__m128 const cy = _mm_mul_ps(_mm_load_ps(localCenter[1]), half);
+		__m128 const cz = _mm_mul_ps(_mm_load_ps(localCenter[2]), half);
+
+		__m128 const ex = _mm_mul_ps(_mm_load_ps(localExtent[0]), half);
+		__m128 const ey = _mm_mul_ps(_mm_load_ps(localExtent[1]), half);
+		__m128 const ez = _mm_mul_ps(_mm_load_ps(localExtent[2]), half);
+
+		float* const centerOut[3] = { o_soa.m_centerX, o_soa.m_centerY, o_soa.m_centerZ };
+		float* const extentOut[3] = { o_soa.m_extentX, o_soa.m_extentY, o_soa.m_extentZ };
+
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			__m128 center = _mm_add_ps(_mm_mul_ps(m[row][0], cx), m[row][3]);
+			center = _mm_add_ps(_mm_mul_ps(m[row][1], cy), center);
+			center = _mm_add_ps(_mm_mul_ps(m[row][2], cz), center);
+
+			__m128 extent = _mm_mul_ps(absM[row][0], ex);
+			extent = _mm_add_ps(_mm_mul_ps(absM[row][1], ey), extent);
+			extent = _mm_add_ps(_mm_mul_ps(absM[row][2], ez), extent);
+
+			if (numThisIter == 4)
+			{
+				_mm_storeu_ps(centerOut[row] + _writeIdx + i, center);
+				_mm_storeu_ps(extentOut[row] + _writeIdx + i, extent);
+			}
+			else
+			{
+				// Don't write past _num, other threads may be filling the neighbouring range.
+				alignas(16) float centerTmp[4];
+				alignas(16) float extentTmp[4];
+				_mm_store_ps(centerTmp, center);
+				_mm_store_ps(extentTmp, extent);
+				memcpy(centerOut[row] + _writeIdx + i, centerTmp, sizeof(float) * numThisIter);
+				memcpy(extentOut[row] + _writeIdx + i, extentTmp, sizeof(float) * numThisIter);
+			}
+		}
+	}
+}
+
+static uint32_t CullAABBs_SoA_SSE(CullingAABBs_SoA const& _aabbs, kt::Vec4 const* _planes, uint32_t _numPlanes, uint8_t* o_visible)
+{
+	__m128 const signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 const zero = _mm_setzero_ps();
+
+	uint32_t numVisible = 0;
+
+	for (uint32_t i = 0; i < _aabbs.m_num; i += 4)
+	{
+		__m128 const cx = _mm_loadu_ps(_aabbs.m_centerX + i);
+		__m128 const cy = _mm_loadu_ps(_aabbs.m_centerY + i);
+		__m128 const cz = _mm_loadu_ps(_aabbs.m_centerZ + i);
+		__m128 const ex = _mm_loadu_ps(_aabbs.m_extentX + i);
+		__m128 const ey = _mm_loadu_ps(_aabbs.m_extentY + i);
+		__m128 const ez = _mm_loadu_ps(_aabbs.m_extentZ + i);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (uint32_t planeIdx = 0; planeIdx < _numPlanes; ++planeIdx)
+		{
+			kt::Vec4 const& plane = _planes[planeIdx];
+			__m128 const nx = _mm_set1_ps(plane.x);
+			__m128 const ny = _mm_set1_ps(plane.y);
+			__m128 const nz = _mm_set1_ps(plane.z);
+
+			// Signed distance of the center, plus the extent projected onto the plane normal.
+			__m128 dist = _mm_add_ps(_mm_mul_ps(nx, cx), _mm_set1_ps(plane.w));
+			dist = _mm_add_ps(_mm_mul_ps(ny, cy), dist);
+			dist = _mm_add_ps(_mm_mul_ps(nz, cz), dist);
+
+			__m128 radius = _mm_mul_ps(_mm_and_ps(nx, signMask), ex);
+			radius = _mm_add_ps(_mm_mul_ps(_mm_and_ps(ny, signMask), ey), radius);
+			radius = _mm_add_ps(_mm_mul_ps(_mm_and_ps(nz, signMask), ez), radius);
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		uint32_t const mask = uint32_t(_mm_movemask_ps(inside));
+		uint32_t const numThisIter = kt::Min(_aabbs.m_num - i, 4u);
+
+		for (uint32_t lane = 0; lane < numThisIter; ++lane)
+		{
+			uint8_t const visible = uint8_t((mask >> lane) & 1);
+			o_visible[i + lane] = visible;
+			numVisible += visible;
+		}
+	}
+
+	return numVisible;
+}
+
+CORE_TARGET_AVX2_FMA static uint32_t CullAABBs_SoA_AVX2(CullingAABBs_SoA const& _aabbs, kt::Vec4 const* _planes, uint32_t _numPlanes, uint8_t* o_visible)
+{
+	__m256 const signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 const zero = _mm256_setzero_ps();
+
+	uint32_t numVisible = 0;
+
+	for (uint32_t i = 0; i < _aabbs.m_num; i += 8)
+	{
+		__m256 const cx = _mm256_load_ps(_aabbs.m_centerX + i);
+		__m256 const cy = _mm256_load_ps(_aabbs.m_centerY + i);
+		__m256 const cz = _mm256_load_ps(_aabbs.m_centerZ + i);
+		__m256 const ex = _mm256_load_ps(_aabbs.m_extentX + i);
+		__m256 const ey = _mm256_load_ps(_aabbs.m_extentY + i);
+		__m256 const ez = _mm256_load_ps(_aabbs.m_extentZ + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (uint32_t planeIdx = 0; planeIdx < _numPlanes; ++planeIdx)
+		{
+			kt::Vec4 const& plane = _planes[planeIdx];
+			__m256 const nx = _mm256_set1_ps(plane.x);
+			__m256 const ny = _mm256_set1_ps(plane.y);
+			__m256 const nz = _mm256_set1_ps(plane.z);
+
+			__m256 dist = _mm256_fmadd_ps(nx, cx, _mm256_set1_ps(plane.w));
+			dist = _mm256_fmadd_ps(ny, cy, dist);
+			dist = _mm256_fmadd_ps(nz, cz, dist);
+
+			__m256 radius = _mm256_mul_ps(_mm256_and_ps(nx, signMask), ex);
+			radius = _mm256_fmadd_ps(_mm256_and_ps(ny, signMask), ey, radius);
+			radius = _mm256_fmadd_ps(_mm256_and_ps(nz, signMask), ez, radius);
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_GE_OQ));
+		}
+
+		uint32_t const mask = uint32_t(_mm256_movemask_ps(inside));
+		uint32_t const numThisIter = kt::Min(_aabbs.m_num - i, 8u);
+
+		for (uint32_t lane = 0; lane < numThisIter; ++lane)
+		{
+			uint8_t const visible = uint8_t((mask >> lane) & 1);
+			o_visible[i + lane] = visible;
+			numVisible += visible;
+		}
+	}
+
+	return numVisible;
+}
+
+CullingAABBs_SoA CullingAABBs_SoA::Slice(uint32_t _begin, uint32_t _num) const
+{
+	KT_ASSERT(_begin % c_cullingSimdWidth == 0);
+	KT_ASSERT(_begin + _num <= m_num);
+
+	CullingAABBs_SoA slice;
+	slice.m_centerX = m_centerX + _begin;
+	slice.m_centerY = m_centerY + _begin;
+	slice.m_centerZ = m_centerZ + _begin;
+	slice.m_extentX = m_extentX + _begin;
+	slice.m_extentY = m_extentY + _begin;
+	slice.m_extentZ = m_extentZ + _begin;
+	slice.m_num = _num;
+	slice.m_capacity = m_capacity - _begin;
+	return slice;
+}
+
+uint32_t CullAABBs_SoA(CullingAABBs_SoA const& _aabbs, kt::Vec4 const* _planes, uint32_t _numPlanes, uint8_t* o_visible)
+{
+	return s_hasAVX2 ? CullAABBs_SoA_AVX2(_aabbs, _planes, _numPlanes, o_visible)
+					 : CullAABBs_SoA_SSE(_aabbs, _planes, _numPlanes, o_visible);
+}
+
+uint32_t DepthPyramidNumMips(uint32_t _width, uint32_t _height)
+{
+	uint32_t numMips = 1;
+	while (numMips < PATHOS_HIZ_MAX_MIPS && (shaderlib::HiZ_MipSize(_width, numMips - 1) > 1 || shaderlib::HiZ_MipSize(_height, numMips - 1) > 1))
+	{
+		++numMips;
+	}
+	return numMips;
+}
+
+void DepthPyramidCPU::Build(float const* _depth, uint32_t _width, uint32_t _height)
+{
+	KT_ASSERT(_width && _height);
+
+	m_width = _width;
+	m_height = _height;
+	m_numMips = DepthPyramidNumMips(_width, _height);
+
+	uint32_t totalTexels = 0;
+	for (uint32_t mip = 0; mip < m_numMips; ++mip)
+	{
+		m_mipOffsets[mip] = totalTexels;
+		totalTexels += shaderlib::HiZ_MipSize(_width, mip) * shaderlib::HiZ_MipSize(_height, mip);
+	}
+
+	m_texels.Resize(totalTexels);
+	memcpy(m_texels.Data(), _depth, sizeof(float) * _width * _height);
+
+	for (uint32_t mip = 1; mip < m_numMips; ++mip)
+	{
+		uint32_t const srcWidth = shaderlib::HiZ_MipSize(_width, mip - 1);
+		uint32_t const srcHeight = shaderlib::HiZ_MipSize(_height, mip - 1);
+		uint32_t const dstWidth = shaderlib::HiZ_MipSize(_width, mip);
+		uint32_t const dstHeight = shaderlib::HiZ_MipSize(_height, mip);
+
+		float const* src = m_texels.Data() + m_mipOffsets[mip - 1];
+		float* dst = m_texels.Data() + m_mipOffsets[mip];
+
+		for (uint32_t y = 0; y < dstHeight; ++y)
+		{
+			uint32_t const y0 = kt::Min(y * 2, srcHeight - 1);
+			uint32_t const y1 = kt::Min(y * 2 + 1, srcHeight - 1);
+
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				uint32_t const x0 = kt::Min(x * 2, srcWidth - 1);
+				uint32_t const x1 = kt::Min(x * 2 + 1, srcWidth - 1);
+
+				float const d00 = src[y0 * srcWidth + x0];
+				float const d10 = src[y0 * srcWidth + x1];
+				float const d01 = src[y1 * srcWidth + x0];
+				float const d11 = src[y1 * srcWidth + x1];
+				dst[y * dstWidth + x] = shaderlib::max(shaderlib::max(d00, d10), shaderlib::max(d01, d11));
+			}
+		}
+	}
+}
+
+float DepthPyramidCPU::Load(uint32_t _x, uint32_t _y, uint32_t _mip) const
+{
+	KT_ASSERT(_mip < m_numMips);
+	uint32_t const mipWidth = shaderlib::HiZ_MipSize(m_width, _mip);
+	uint32_t const mipHeight = shaderlib::HiZ_MipSize(m_height, _mip);
+	return m_texels[m_mipOffsets[_mip] + kt::Min(_y, mipHeight - 1) * mipWidth + kt::Min(_x, mipWidth - 1)];
+}
+
+bool CullSubmeshHiZ_CPU
+(
+	shaderlib::GPUSubMeshData const& _subMesh,
+	shaderlib::InstanceData_Xform const& _xform,
+	shaderlib::CullingConstants const& _constants,
+	DepthPyramidCPU const* _pyramid,
+	bool& o_occluded
+)
+{
+	shaderlib::CullingConstants constants = _constants;
+	constants.hizWidth = _pyramid ? _pyramid->m_width : 0;
+	constants.hizHeight = _pyramid ? _pyramid->m_height : 0;
+	constants.hizNumMips = _pyramid ? _pyramid->m_numMips : 0;
+
+	shaderlib::HiZFootprint const footprint = shaderlib::HiZ_CalcFootprint(_subMesh, _xform, constants);
+
+	o_occluded = false;
+
+	if (footprint.result == PATHOS_HIZ_TEST)
+	{
+		uint32_t const x = footprint.texelX;
+		uint32_t const y = footprint.texelY;
+		uint32_t const mip = footprint.mip;
+		o_occluded = shaderlib::HiZ_IsOccluded(footprint, _pyramid->Load(x, y, mip), _pyramid->Load(x + 1, y, mip), _pyramid->Load(x, y + 1, mip), _pyramid->Load(x + 1, y + 1, mip));
+	}
+
+	return footprint.result != PATHOS_HIZ_CULLED && !o_occluded;
+}
+
+}
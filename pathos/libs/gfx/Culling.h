@@ -0,0 +1,82 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Vec4.h>
+#include <kt/AABB.h>
+#include <kt/LinearAllocator.h>
+#include <kt/Array.h>
+
+#include <shaderlib/CullingShared.h>
+
+namespace gfx
+{
+
+// Widest SIMD path, arrays passed to the culling functions are padded to a multiple of this.
+uint32_t constexpr c_cullingSimdWidth = 8;
+
+// True if the cpu (and OS) support AVX2 and FMA, checked once at startup.
+bool CPUSupportsAVX2();
+
+// World space bounds as centers and half extents, in structure of arrays layout so several can be tested at once.
+struct CullingAABBs_SoA
+{
+	// Allocated from _allocator (eg. thread frame allocator), never freed.
+	void Init(kt::LinearAllocator* _allocator, uint32_t _num);
+
+	// Stored in _storage (resized to fit), for bounds kept across frames. Invalidated if _storage is changed.
+	void Init(kt::Array<float>& _storage, uint32_t _num);
+
+	// View of [_begin, _begin + _num), _begin must be a multiple of c_cullingSimdWidth.
+	CullingAABBs_SoA Slice(uint32_t _begin, uint32_t _num) const;
+
+	float* m_centerX;
+	float* m_centerY;
+	float* m_centerZ;
+
+	float* m_extentX;
+	float* m_extentY;
+	float* m_extentZ;
+
+	uint32_t m_num = 0;
+	uint32_t m_capacity = 0;
+};
+
+// Transforms _num local space AABBs by a row major 3x4 matrix and writes them into o_soa starting at _writeIdx.
+// Only [_writeIdx, _writeIdx + _num) is written, so disjoint ranges can be filled in parallel.
+void TransformAABBsToSoA(float const* _mtx3x4, kt::AABB const* _aabbs, uint32_t _num, CullingAABBs_SoA& o_soa, uint32_t _writeIdx);
+
+// Tests every AABB against inward facing planes (as returned by Camera::GetFrustumPlanes).
+// Writes 1 to o_visible[i] if the AABB intersects or is inside all planes, otherwise 0. Returns the number visible.
+uint32_t CullAABBs_SoA(CullingAABBs_SoA const& _aabbs, kt::Vec4 const* _planes, uint32_t _numPlanes, uint8_t* o_visible);
+
+// Mips in a depth pyramid for a _width x _height depth buffer, halving (rounding up) down to 1x1.
+uint32_t DepthPyramidNumMips(uint32_t _width, uint32_t _height);
+
+// Cpu reference of DepthPyramid, reduced the same way as gpu_culling/BuildDepthPyramid.cs so results match the gpu exactly.
+struct DepthPyramidCPU
+{
+	void Build(float const* _depth, uint32_t _width, uint32_t _height);
+
+	// Coordinates are clamped to the mip, like the fetches in gpu_culling/CullSubmeshes.cs.
+	float Load(uint32_t _x, uint32_t _y, uint32_t _mip) const;
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_numMips = 0;
+
+	uint32_t m_mipOffsets[PATHOS_HIZ_MAX_MIPS];
+	kt::Array<float> m_texels;
+};
+
+// Cpu reference of the gpu submesh instance cull (gpu_culling/CullSubmeshes.cs), through the same shaderlib functions.
+// Hi-z dimensions in _constants are taken from _pyramid, which can be null to only frustum cull.
+// Returns true if the submesh instance is drawn. o_occluded is set if it failed the depth test (a late phase candidate).
+bool CullSubmeshHiZ_CPU
+(
+	shaderlib::GPUSubMeshData const& _subMesh,
+	shaderlib::InstanceData_Xform const& _xform,
+	shaderlib::CullingConstants const& _constants,
+	DepthPyramidCPU const* _pyramid,
+	bool& o_occluded
+);
+
+}
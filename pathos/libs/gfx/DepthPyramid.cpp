@@ -0,0 +1,78 @@
+#include "DepthPyramid.h"
+#include "ResourceManager.h"
+#include "Culling.h"
+
+#include <gpu/CommandContext.h>
+#include <gpu/GPUDevice.h>
+
+#include <shaderlib/DefinesShared.h>
+#include <shaderlib/CullingShared.h>
+
+namespace gfx
+{
+
+void DepthPyramid::Build(gpu::cmd::Context* _ctx, gpu::TextureHandle _depth)
+{
+	GPU_PROFILE_SCOPE(_ctx, "DepthPyramid::Build", GPU_PROFILE_COLOUR(0x80, 0x00, 0xff));
+
+	gpu::TextureDesc depthDesc;
+	gpu::GetTextureInfo(_depth, depthDesc);
+
+	if (!m_texture.IsValid() || depthDesc.m_width != m_width || depthDesc.m_height != m_height)
+	{
+		m_width = depthDesc.m_width;
+		m_height = depthDesc.m_height;
+		m_numMips = DepthPyramidNumMips(m_width, m_height);
+
+		gpu::TextureDesc desc = gpu::TextureDesc::Desc2D(m_width, m_height, gpu::TextureUsageFlags::UnorderedAccess | gpu::TextureUsageFlags::ShaderResource, gpu::Format::R32_Float);
+		desc.m_mipLevels = m_numMips;
+		m_texture = gpu::CreateTexture(desc, nullptr, "Depth Pyramid");
+	}
+
+	gpu::cmd::ResourceBarrier(_ctx, _depth, gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, m_texture, gpu::ResourceState::UnorderedAccess);
+
+	gpu::cmd::SetPSO(_ctx, gfx::ResourceManager::GetSharedResources().m_buildDepthPyramidPso);
+
+	gpu::DescriptorData srv;
+	srv.Set(_depth);
+	gpu::cmd::SetComputeSRVTable(_ctx, srv, PATHOS_PER_BATCH_SPACE);
+
+	struct
+	{
+		uint32_t srcDims[2];
+		uint32_t dstDims[2];
+		uint32_t fromDepth;
+	} cbuf;
+
+	// Subresource barriers aren't exposed, so the source mip is read as a uav with a uav barrier between mips.
+	for (uint32_t mip = 0; mip < m_numMips; ++mip)
+	{
+		uint32_t const srcMip = mip == 0 ? 0 : mip - 1;
+
+		cbuf.srcDims[0] = shaderlib::HiZ_MipSize(m_width, srcMip);
+		cbuf.srcDims[1] = shaderlib::HiZ_MipSize(m_height, srcMip);
+		cbuf.dstDims[0] = shaderlib::HiZ_MipSize(m_width, mip);
+		cbuf.dstDims[1] = shaderlib::HiZ_MipSize(m_height, mip);
+		cbuf.fromDepth = mip == 0 ? 1 : 0;
+
+		gpu::DescriptorData uavs[2];
+		uavs[0].Set(m_texture, srcMip);
+		uavs[1].Set(m_texture, mip);
+		gpu::cmd::SetComputeUAVTable(_ctx, uavs, PATHOS_PER_BATCH_SPACE);
+
+		gpu::DescriptorData cbv;
+		cbv.Set(&cbuf, sizeof(cbuf));
+		gpu::cmd::SetComputeCBVTable(_ctx, cbv, PATHOS_PER_BATCH_SPACE);
+
+		gpu::cmd::Dispatch(_ctx, (cbuf.dstDims[0] + 7) / 8, (cbuf.dstDims[1] + 7) / 8, 1);
+		gpu::cmd::UAVBarrier(_ctx, m_texture);
+	}
+
+	gpu::cmd::ResourceBarrier(_ctx, m_texture, gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, _depth, gpu::ResourceState::DepthStencilTarget);
+
+	m_valid = true;
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <gpu/HandleRef.h>
+#include <gpu/CommandContext.h>
+#include <gpu/Types.h>
+
+namespace gfx
+{
+
+// Farthest depth mip chain of a depth buffer for hi-z occlusion culling (see gpu_culling/BuildDepthPyramid.cs).
+// Mip 0 matches the depth buffer, each mip after is ceil(prev / 2) down to 1x1.
+class DepthPyramid
+{
+public:
+	// Recreates the pyramid if _depth changed size. _depth is left as a depth target.
+	void Build(gpu::cmd::Context* _ctx, gpu::TextureHandle _depth);
+
+	// Forget the contents, eg. after a camera cut when last frame's depth says nothing about this one.
+	void Invalidate() { m_valid = false; }
+
+	bool IsValid() const { return m_valid; }
+
+	gpu::TextureHandle Texture() const { return m_texture; }
+
+	uint32_t Width() const { return m_width; }
+	uint32_t Height() const { return m_height; }
+	uint32_t NumMips() const { return m_numMips; }
+
+private:
+	gpu::TextureRef m_texture;
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_numMips = 0;
+
+	bool m_valid = false;
+};
+
+}
@@ -0,0 +1,197 @@
+#include "DrawSort.h"
+
+#include <string.h>
+
+#include <core/Jobs.h>
+#include <core/Memory.h>
+
+#include "Camera.h"
+
+namespace gfx
+{
+
+// Elements per job when sorting, smaller sorts run on the calling thread.
+static uint32_t const c_sortGrainSize = 16 * 1024;
+static uint32_t const c_maxSortChunks = 64;
+
+static uint32_t const c_depthBits = 28;
+static uint32_t const c_depthMask = (1u << c_depthBits) - 1;
+static uint32_t const c_drawBits = 16 + 14 + 2;
+
+DrawBucket AlphaModeDrawBucket(Material::AlphaMode _mode)
+{
+	switch (_mode)
+	{
+		case Material::AlphaMode::Mask: return DrawBucket::AlphaTested;
+		case Material::AlphaMode::Transparent: return DrawBucket::Transparent;
+		default: return DrawBucket::Opaque;
+	}
+}
+
+DrawSortView MakeDrawSortView(Camera const& _cam, uint32_t _pass)
+{
+	// Right handed view, depth is along -z.
+	kt::Mat4 const& view = _cam.GetView();
+
+	DrawSortView sortView;
+	sortView.m_depthPlane = kt::Vec4(-view.m_cols[0].z, -view.m_cols[1].z, -view.m_cols[2].z, -view.m_cols[3].z);
+	sortView.m_pass = _pass;
+	return sortView;
+}
+
+// Positive floats order the same as their bits, dropping the sign bit leaves 31 bits of which the top 28 are kept.
+static uint32_t QuantizeDepth(float _depth)
+{
+	float const depth = kt::Max(_depth, 0.0f);
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return (bits >> (31 - c_depthBits)) & c_depthMask;
+}
+
+uint64_t MakeDrawSortKey(DrawSortView const& _view, DrawBucket _bucket, uint32_t _materialSlot, uint32_t _subMeshId, uint32_t _lod, kt::Vec3 const& _worldPos)
+{
+	KT_ASSERT(_subMeshId < (1u << 14));
+	KT_ASSERT(_lod < 4);
+
+	float const depth = _view.m_depthPlane.x * _worldPos.x + _view.m_depthPlane.y * _worldPos.y + _view.m_depthPlane.z * _worldPos.z + _view.m_depthPlane.w;
+	uint64_t quantizedDepth = QuantizeDepth(depth);
+
+	uint64_t const header = (uint64_t(_view.m_pass & 0x3) << 62) | (uint64_t(_bucket) << 60);
+	uint64_t const draw = (uint64_t(_materialSlot & 0xffff) << 16) | (uint64_t(_subMeshId) << 2) | uint64_t(_lod);
+
+	if (_bucket == DrawBucket::Transparent)
+	{
+		quantizedDepth = c_depthMask - quantizedDepth;
+	}
+	else if (!_view.m_opaqueDepthFirst)
+	{
+		return header | (draw << c_depthBits) | quantizedDepth;
+	}
+
+	return header | (quantizedDepth << c_drawBits) | draw;
+}
+
+void RadixSortKeys64(uint64_t* _keys, uint32_t* _values, uint64_t* _tempKeys, uint32_t* _tempValues, uint32_t _num)
+{
+	if (_num < 2)
+	{
+		return;
+	}
+
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+
+	uint32_t const numChunks = kt::Min((_num + c_sortGrainSize - 1) / c_sortGrainSize, c_maxSortChunks);
+	uint32_t const chunkSize = (_num + numChunks - 1) / numChunks;
+
+	// One 256 entry histogram per chunk, reused for each pass, then turned into that chunk's write offsets.
+	uint32_t* chunkHistograms = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * 256 * numChunks);
+
+	// Counts of every digit don't change as keys move, so are only taken once to find the passes that can be skipped.
+	uint32_t* digitCounts = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * 256 * 8 * numChunks);
+
+	core::jobs::ParallelFor(numChunks, 1, [_keys, _num, chunkSize, digitCounts](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+		{
+			uint32_t* counts = digitCounts + chunkIdx * 256 * 8;
+			memset(counts, 0, sizeof(uint32_t) * 256 * 8);
+
+			uint32_t const end = kt::Min((chunkIdx + 1) * chunkSize, _num);
+			for (uint32_t i = chunkIdx * chunkSize; i < end; ++i)
+			{
+				uint64_t const key = _keys[i];
+				for (uint32_t digit = 0; digit < 8; ++digit)
+				{
+					++counts[digit * 256 + ((key >> (digit * 8)) & 0xff)];
+				}
+			}
+		}
+	});
+
+	uint64_t* srcKeys = _keys;
+	uint32_t* srcValues = _values;
+	uint64_t* destKeys = _tempKeys;
+	uint32_t* destValues = _tempValues;
+
+	for (uint32_t digit = 0; digit < 8; ++digit)
+	{
+		bool skip = false;
+
+		for (uint32_t bucket = 0; bucket < 256 && !skip; ++bucket)
+		{
+			uint32_t total = 0;
+			for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				total += digitCounts[chunkIdx * 256 * 8 + digit * 256 + bucket];
+			}
+
+			skip = total == _num;
+		}
+
+		if (skip)
+		{
+			continue;
+		}
+
+		uint32_t const shift = digit * 8;
+
+		core::jobs::ParallelFor(numChunks, 1, [srcKeys, _num, chunkSize, chunkHistograms, shift](uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+			{
+				uint32_t* hist = chunkHistograms + chunkIdx * 256;
+				memset(hist, 0, sizeof(uint32_t) * 256);
+
+				uint32_t const end = kt::Min((chunkIdx + 1) * chunkSize, _num);
+				for (uint32_t i = chunkIdx * chunkSize; i < end; ++i)
+				{
+					++hist[(srcKeys[i] >> shift) & 0xff];
+				}
+			}
+		});
+
+		// Bucket major, then chunk order, keeps the sort stable.
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; ++bucket)
+		{
+			for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				uint32_t const count = chunkHistograms[chunkIdx * 256 + bucket];
+				chunkHistograms[chunkIdx * 256 + bucket] = offset;
+				offset += count;
+			}
+		}
+
+		core::jobs::ParallelFor(numChunks, 1, [srcKeys, srcValues, destKeys, destValues, _num, chunkSize, chunkHistograms, shift](uint32_t _begin, uint32_t _end)
+		{
+			for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+			{
+				uint32_t* offsets = chunkHistograms + chunkIdx * 256;
+
+				uint32_t const end = kt::Min((chunkIdx + 1) * chunkSize, _num);
+				for (uint32_t i = chunkIdx * chunkSize; i < end; ++i)
+				{
+					uint32_t const writeIdx = offsets[(srcKeys[i] >> shift) & 0xff]++;
+					destKeys[writeIdx] = srcKeys[i];
+					destValues[writeIdx] = srcValues[i];
+				}
+			}
+		});
+
+		uint64_t* const swapKeys = srcKeys;
+		srcKeys = destKeys;
+		destKeys = swapKeys;
+
+		uint32_t* const swapValues = srcValues;
+		srcValues = destValues;
+		destValues = swapValues;
+	}
+
+	if (srcKeys != _keys)
+	{
+		memcpy(_keys, srcKeys, sizeof(uint64_t) * _num);
+		memcpy(_values, srcValues, sizeof(uint32_t) * _num);
+	}
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Vec4.h>
+
+#include "Material.h"
+
+namespace gfx
+{
+
+struct Camera;
+
+// Draws are split into these ranges, drawn in this order.
+enum class DrawBucket : uint8_t
+{
+	Opaque,
+	AlphaTested,
+	Transparent,
+
+	Count
+};
+
+DrawBucket AlphaModeDrawBucket(Material::AlphaMode _mode);
+
+// What draw sort keys are built against.
+struct DrawSortView
+{
+	// Plane giving view depth, zero (the default) sorts everything at the same depth.
+	kt::Vec4 m_depthPlane = kt::Vec4(0.0f);
+
+	// Most significant part of the key, so different passes never interleave.
+	uint32_t m_pass = 0;
+
+	// Opaque and alpha tested draws are sorted front to back before material and mesh, rather than only within a draw.
+	bool m_opaqueDepthFirst = false;
+};
+
+DrawSortView MakeDrawSortView(Camera const& _cam, uint32_t _pass = 0);
+
+// 64 bit sort key, most significant bits first:
+// Opaque and alpha tested:	pass (2) | bucket (2) | material (16) | submesh (14) | lod (2) | depth (28), front to back.
+// Depth first opaque:		pass (2) | bucket (2) | depth (28), front to back | material (16) | submesh (14) | lod (2).
+// Transparent:				pass (2) | bucket (2) | depth (28), back to front | material (16) | submesh (14) | lod (2).
+// Material is the low 16 bits of the material slot, submesh the global submesh id.
+uint64_t MakeDrawSortKey(DrawSortView const& _view, DrawBucket _bucket, uint32_t _materialSlot, uint32_t _subMeshId, uint32_t _lod, kt::Vec3 const& _worldPos);
+
+inline DrawBucket DrawSortKeyBucket(uint64_t _key)
+{
+	return DrawBucket((_key >> 60) & 0x3);
+}
+
+// Sorts _keys ascending, moving _values with them. Stable.
+// Least significant digit first, 8 bits at a time, with each pass histogrammed and scattered in parallel.
+// Digits every key shares are skipped, so keys with constant high bits (eg. one pass) sort in fewer passes.
+// _tempKeys and _tempValues must hold _num elements, the result is always in _keys and _values.
+void RadixSortKeys64(uint64_t* _keys, uint32_t* _values, uint64_t* _tempKeys, uint32_t* _tempValues, uint32_t _num);
+
+}
@@ -0,0 +1,261 @@
+#include "InstanceTable.h"
+
+#include <string.h>
+
+#include <shaderlib/DefinesShared.h>
+
+#include "TransformHierarchy.h"
+
+namespace gfx
+{
+
+// Clean slots between two dirty ones are uploaded anyway if the gap is at most this, rather than starting another copy.
+static uint32_t const c_maxCoalesceGap = 4;
+
+static uint32_t const c_maxSlots = 1u << PATHOS_INSTANCE_ID_REMAP_BITS;
+
+static uint32_t LowestSetBit(uint64_t _bits)
+{
+	KT_ASSERT(_bits);
+	uint32_t const lo = uint32_t(_bits);
+	if (lo)
+	{
+		return kt::FloorLog2(lo & (0u - lo));
+	}
+
+	uint32_t const hi = uint32_t(_bits >> 32);
+	return 32 + kt::FloorLog2(hi & (0u - hi));
+}
+
+template <typename T>
+static void ResizeZeroed(kt::Array<T>& _arr, uint32_t _size)
+{
+	uint32_t const oldSize = _arr.Size();
+	_arr.Resize(_size);
+
+	if (_size > oldSize)
+	{
+		memset(_arr.Data() + oldSize, 0, sizeof(T) * (_size - oldSize));
+	}
+}
+
+void InstanceTable::Init(uint32_t _initialCapacity)
+{
+	KT_ASSERT(_initialCapacity && _initialCapacity <= c_maxSlots);
+
+	m_slotAllocator.Init(_initialCapacity);
+	m_meshes.Resize(_initialCapacity);
+	m_transforms.Resize(_initialCapacity);
+#if PATHOS_COMPACT_INSTANCE_DATA
+	m_compactTransforms.Resize(_initialCapacity);
+#endif
+	ResizeZeroed(m_lods, _initialCapacity);
+
+	uint32_t const numWords = (_initialCapacity + 63) / 64;
+	ResizeZeroed(m_dirtySlots, numWords);
+	ResizeZeroed(m_dirtyWords, (numWords + 63) / 64);
+
+	m_gpuBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::ShaderResource, _initialCapacity, gpu::Format::Unknown, "gfx::InstanceTable transforms");
+}
+
+InstanceTable::RangeHandle InstanceTable::Alloc(uint32_t _numSlots)
+{
+	RangeHandle range = m_slotAllocator.Alloc(_numSlots);
+
+	if (range == c_invalidRange)
+	{
+		// The gpu buffer catches up in Upload.
+		uint32_t const newCapacity = kt::Min(Capacity() + kt::Max(Capacity(), _numSlots), c_maxSlots);
+		m_slotAllocator.Grow(newCapacity);
+		m_meshes.Resize(newCapacity);
+		m_transforms.Resize(newCapacity);
+#if PATHOS_COMPACT_INSTANCE_DATA
+		m_compactTransforms.Resize(newCapacity);
+#endif
+		ResizeZeroed(m_lods, newCapacity);
+
+		uint32_t const numWords = (newCapacity + 63) / 64;
+		ResizeZeroed(m_dirtySlots, numWords);
+		ResizeZeroed(m_dirtyWords, (numWords + 63) / 64);
+
+		range = m_slotAllocator.Alloc(_numSlots);
+	}
+
+	KT_ASSERT(range != c_invalidRange && "Out of instance slots, change PATHOS_INSTANCE_ID_REMAP_BITS.");
+	return range;
+}
+
+void InstanceTable::Free(RangeHandle _range)
+{
+	m_slotAllocator.Free(_range);
+}
+
+void InstanceTable::SetMesh(uint32_t _slot, ResourceManager::MeshIdx _mesh)
+{
+	m_meshes[_slot] = _mesh;
+	SetLod(_slot, 0);
+}
+
+void InstanceTable::SetLod(uint32_t _slot, uint8_t _lod)
+{
+	if (m_lods[_slot] != _lod)
+	{
+		m_lods[_slot] = _lod;
+		++m_lodVersion;
+	}
+}
+
+void InstanceTable::SetTransform(uint32_t _slot, kt::Mat4 const& _mtx)
+{
+	PackTransform3x4(_mtx, &m_transforms[_slot]);
+#if PATHOS_COMPACT_INSTANCE_DATA
+	EncodeSlot(_slot);
+#endif
+	MarkDirty(_slot);
+}
+
+#if PATHOS_COMPACT_INSTANCE_DATA
+void InstanceTable::EncodeSlot(uint32_t _slot)
+{
+	shaderlib::InstanceData_Xform& xform = m_transforms[_slot];
+	EncodeInstanceData(xform, m_origin, &m_compactTransforms[_slot]);
+
+	shaderlib::InstanceData_Xform const decoded = shaderlib::DecodeInstanceData(m_compactTransforms[_slot], m_origin);
+
+	kt::Vec4 const* exactRows = &xform.row0;
+	kt::Vec4 const* decodedRows = &decoded.row0;
+
+	for (uint32_t row = 0; row < 3; ++row)
+	{
+		m_maxPositionError = kt::Max(m_maxPositionError, kt::Abs(exactRows[row].w - decodedRows[row].w));
+		m_maxBasisError = kt::Max(m_maxBasisError, kt::Abs(exactRows[row].x - decodedRows[row].x));
+		m_maxBasisError = kt::Max(m_maxBasisError, kt::Abs(exactRows[row].y - decodedRows[row].y));
+		m_maxBasisError = kt::Max(m_maxBasisError, kt::Abs(exactRows[row].z - decodedRows[row].z));
+	}
+
+	xform = decoded;
+}
+#endif
+
+void InstanceTable::SetOrigin(kt::Vec3 const& _origin)
+{
+#if PATHOS_COMPACT_INSTANCE_DATA
+	kt::Vec3 const delta = m_origin - _origin;
+	m_origin = _origin;
+
+	// Free slots are shifted too, harmlessly. Rotation and scale are untouched, only the decoded position moves.
+	for (uint32_t slot = 0; slot < Capacity(); ++slot)
+	{
+		m_compactTransforms[slot].position = m_compactTransforms[slot].position + delta;
+		m_transforms[slot] = shaderlib::DecodeInstanceData(m_compactTransforms[slot], m_origin);
+		MarkDirty(slot);
+	}
+#else
+	// Full transforms are absolute.
+	m_origin = _origin;
+#endif
+}
+
+void InstanceTable::MarkDirty(uint32_t _slot)
+{
+	uint32_t const wordIdx = _slot / 64;
+	uint64_t const bit = uint64_t(1) << (_slot % 64);
+
+	if (!(m_dirtySlots[wordIdx] & bit))
+	{
+		m_dirtySlots[wordIdx] |= bit;
+		m_dirtyWords[wordIdx / 64] |= uint64_t(1) << (wordIdx % 64);
+		++m_numDirtySlots;
+	}
+}
+
+void InstanceTable::Upload(gpu::cmd::Context* _ctx)
+{
+	m_uploadStats = UploadStats{};
+	m_uploadStats.m_maxPositionError = m_maxPositionError;
+	m_uploadStats.m_maxBasisError = m_maxBasisError;
+	m_maxPositionError = 0.0f;
+	m_maxBasisError = 0.0f;
+
+	if (!m_numDirtySlots)
+	{
+		return;
+	}
+
+	GPU_PROFILE_SCOPE(_ctx, "InstanceTable::Upload", GPU_PROFILE_COLOUR(0x00, 0x00, 0xff));
+
+	// Keeps the existing contents if the table grew.
+	m_gpuBuf.EnsureSize(_ctx, Capacity(), true);
+
+	gpu::cmd::ResourceBarrier(_ctx, m_gpuBuf.m_buffer, gpu::ResourceState::CopyDest);
+	gpu::cmd::FlushBarriers(_ctx);
+
+	uint32_t rangeBegin = UINT32_MAX;
+	uint32_t rangeEnd = 0;
+
+#if PATHOS_COMPACT_INSTANCE_DATA
+	shaderlib::InstanceData_Gpu const* gpuData = m_compactTransforms.Data();
+#else
+	shaderlib::InstanceData_Gpu const* gpuData = m_transforms.Data();
+#endif
+
+	// Each range is one copy from upload memory.
+	auto uploadRange = [this, _ctx, gpuData, &rangeBegin, &rangeEnd]()
+	{
+		uint32_t const numBytes = (rangeEnd - rangeBegin) * sizeof(shaderlib::InstanceData_Gpu);
+		void* dest = gpu::cmd::BeginUpdateDynamicBuffer(_ctx, m_gpuBuf.m_buffer, numBytes, rangeBegin * sizeof(shaderlib::InstanceData_Gpu)).Data();
+		memcpy(dest, gpuData + rangeBegin, numBytes);
+		gpu::cmd::EndUpdateDynamicBuffer(_ctx, m_gpuBuf.m_buffer);
+
+		++m_uploadStats.m_numRanges;
+		m_uploadStats.m_numBytes += numBytes;
+	};
+
+	// Dirty slots come out in increasing order, runs close enough together are merged.
+	for (uint32_t summaryIdx = 0; summaryIdx < m_dirtyWords.Size(); ++summaryIdx)
+	{
+		uint64_t summary = m_dirtyWords[summaryIdx];
+		m_dirtyWords[summaryIdx] = 0;
+
+		while (summary)
+		{
+			uint32_t const wordIdx = summaryIdx * 64 + LowestSetBit(summary);
+			summary &= summary - 1;
+
+			uint64_t bits = m_dirtySlots[wordIdx];
+			m_dirtySlots[wordIdx] = 0;
+
+			while (bits)
+			{
+				uint32_t const slot = wordIdx * 64 + LowestSetBit(bits);
+				bits &= bits - 1;
+
+				if (rangeBegin != UINT32_MAX && slot <= rangeEnd + c_maxCoalesceGap)
+				{
+					rangeEnd = slot + 1;
+					continue;
+				}
+
+				if (rangeBegin != UINT32_MAX)
+				{
+					uploadRange();
+				}
+
+				rangeBegin = slot;
+				rangeEnd = slot + 1;
+			}
+		}
+	}
+
+	if (rangeBegin != UINT32_MAX)
+	{
+		uploadRange();
+	}
+
+	gpu::cmd::ResourceBarrier(_ctx, m_gpuBuf.m_buffer, gpu::ResourceState::ShaderResource);
+
+	m_uploadStats.m_numDirtySlots = m_numDirtySlots;
+	m_numDirtySlots = 0;
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+
+#include <shaderlib/CommonShared.h>
+
+#include <gpu/CommandContext.h>
+#include <gpu/HandleRef.h>
+
+#include "ResourceManager.h"
+#include "RangeAllocator.h"
+#include "Utils.h"
+
+namespace gfx
+{
+
+// Persistent table of mesh instances (mesh and transform), mirrored in a gpu buffer that MeshRenderers index by slot.
+// Slots are allocated in contiguous ranges, one per model instance, and stay put until freed.
+// Writes mark slots in a dirty bitset and Upload only copies the dirty slots, merged into contiguous ranges,
+// so the per frame cost follows what changed rather than the size of the scene.
+// With PATHOS_COMPACT_INSTANCE_DATA transforms are uploaded as shaderlib::InstanceData_Compact, positions relative to Origin().
+class InstanceTable
+{
+public:
+	using RangeHandle = RangeAllocator::Handle;
+	static RangeHandle constexpr c_invalidRange = RangeAllocator::c_invalidHandle;
+
+	// Or'd into a slot's lod when it's too small to draw in the main view.
+	static uint8_t constexpr c_lodCulled = 0x80;
+
+	struct UploadStats
+	{
+		uint32_t m_numDirtySlots = 0;
+		uint32_t m_numRanges = 0;
+		uint32_t m_numBytes = 0;
+
+		// Largest difference between a transform set this frame and what the gpu decodes, compact instance data only.
+		float m_maxPositionError = 0.0f;
+		float m_maxBasisError = 0.0f;
+	};
+
+	void Init(uint32_t _initialCapacity = 4096);
+
+	// Slots in the range are uninitialized until set.
+	RangeHandle Alloc(uint32_t _numSlots);
+	void Free(RangeHandle _range);
+
+	uint32_t FirstSlot(RangeHandle _range) const { return m_slotAllocator.Offset(_range); }
+	uint32_t NumSlots(RangeHandle _range) const { return m_slotAllocator.Size(_range); }
+
+	// Transforms come separately, from the scene's TransformHierarchy.
+	void SetMesh(uint32_t _slot, ResourceManager::MeshIdx _mesh);
+	void SetTransform(uint32_t _slot, kt::Mat4 const& _mtx);
+
+	ResourceManager::MeshIdx Mesh(uint32_t _slot) const { return m_meshes[_slot]; }
+
+	// Detail level picked for the main view, which every view draws the slot at. SetMesh resets it to full detail.
+	void SetLod(uint32_t _slot, uint8_t _lod);
+	uint8_t Lod(uint32_t _slot) const { return m_lods[_slot]; }
+
+	// Changes whenever any slot's lod does, so anything built from them knows to rebuild.
+	uint32_t LodVersion() const { return m_lodVersion; }
+
+	// Row major 3x4, as the gpu sees it (decoded, if compact).
+	shaderlib::InstanceData_Xform const& Transform(uint32_t _slot) const { return m_transforms[_slot]; }
+
+	// Compact positions are relative to this. Moving it re-encodes (and re-uploads) every slot, so it should only move in large steps.
+	void SetOrigin(kt::Vec3 const& _origin);
+	kt::Vec3 const& Origin() const { return m_origin; }
+
+	// Copies dirty slots to the gpu. Call once per frame before anything reads GpuBuffer.
+	void Upload(gpu::cmd::Context* _ctx);
+
+	gpu::BufferRef const& GpuBuffer() const { return m_gpuBuf.m_buffer; }
+
+	uint32_t Capacity() const { return m_slotAllocator.Capacity(); }
+	uint32_t NumUsedSlots() const { return m_slotAllocator.UsedSize(); }
+
+	UploadStats const& GetUploadStats() const { return m_uploadStats; }
+
+private:
+	void MarkDirty(uint32_t _slot);
+
+#if PATHOS_COMPACT_INSTANCE_DATA
+	// Encodes m_transforms[_slot] and replaces it with the decoded result.
+	void EncodeSlot(uint32_t _slot);
+
+	kt::Array<shaderlib::InstanceData_Compact> m_compactTransforms;
+#endif
+
+	RangeAllocator m_slotAllocator;
+
+	kt::Array<ResourceManager::MeshIdx> m_meshes;
+	kt::Array<shaderlib::InstanceData_Xform> m_transforms;
+	kt::Array<uint8_t> m_lods;
+	uint32_t m_lodVersion = 0;
+
+	// One bit per slot, and one bit per word of that for the words with anything set.
+	kt::Array<uint64_t> m_dirtySlots;
+	kt::Array<uint64_t> m_dirtyWords;
+	uint32_t m_numDirtySlots = 0;
+
+	gfx::ResizableDynamicBufferT<shaderlib::InstanceData_Gpu> m_gpuBuf;
+
+	kt::Vec3 m_origin = kt::Vec3(0.0f);
+
+	// Encode error since the last upload.
+	float m_maxPositionError = 0.0f;
+	float m_maxBasisError = 0.0f;
+
+	UploadStats m_uploadStats;
+};
+
+}
@@ -0,0 +1,495 @@
+#include "LightClusters.h"
+
+#include <immintrin.h>
+#include <math.h>
+#include <string.h>
+
+#include <kt/Timer.h>
+
+#include <core/CVar.h>
+#include <core/Jobs.h>
+#include <core/Memory.h>
+
+#include "Camera.h"
+
+namespace gfx
+{
+
+static core::CVar<float> s_clusterMaxDistance("gfx.light_clusters.max_distance", "depth slices are spread out to this distance, the last slice takes everything beyond it", 1000.0f, 10.0f, 10000.0f);
+
+static uint32_t constexpr c_clustersX = PATHOS_LIGHT_CLUSTERS_X;
+static uint32_t constexpr c_clustersY = PATHOS_LIGHT_CLUSTERS_Y;
+static uint32_t constexpr c_clustersZ = PATHOS_LIGHT_CLUSTERS_Z;
+static uint32_t constexpr c_clustersPerSlice = c_clustersX * c_clustersY;
+
+static uint32_t constexpr c_lightSimdWidth = 4;
+
+// Counts per light type are packed into 16 bits each.
+static uint32_t constexpr c_maxClusterLightsPerType = 0xffff;
+
+// Light bounds in view space, with depth along +z.
+// Point lights get a cone that always passes (axis of zero, cos -1, sin 0), so both types go through the same tests.
+struct ClusterLights_SoA
+{
+	void Init(kt::LinearAllocator* _allocator, uint32_t _capacity)
+	{
+		m_num = 0;
+		m_capacity = uint32_t(kt::AlignUp(kt::Max(_capacity, 1u), c_lightSimdWidth));
+
+		float** const arrays[] = { &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius, &m_apexX, &m_apexY, &m_apexZ, &m_axisX, &m_axisY, &m_axisZ, &m_coneLength, &m_coneCos, &m_coneSin };
+		for (float** arr : arrays)
+		{
+			*arr = (float*)_allocator->Alloc(sizeof(float) * m_capacity, 16);
+		}
+
+		m_lightIdx = (uint32_t*)_allocator->Alloc(sizeof(uint32_t) * m_capacity, 16);
+	}
+
+	void Append(ClusterLights_SoA const& _src, uint32_t _srcIdx)
+	{
+		KT_ASSERT(m_num < m_capacity);
+		uint32_t const i = m_num++;
+
+		m_sphereX[i] = _src.m_sphereX[_srcIdx];
+		m_sphereY[i] = _src.m_sphereY[_srcIdx];
+		m_sphereZ[i] = _src.m_sphereZ[_srcIdx];
+		m_sphereRadius[i] = _src.m_sphereRadius[_srcIdx];
+		m_apexX[i] = _src.m_apexX[_srcIdx];
+		m_apexY[i] = _src.m_apexY[_srcIdx];
+		m_apexZ[i] = _src.m_apexZ[_srcIdx];
+		m_axisX[i] = _src.m_axisX[_srcIdx];
+		m_axisY[i] = _src.m_axisY[_srcIdx];
+		m_axisZ[i] = _src.m_axisZ[_srcIdx];
+		m_coneLength[i] = _src.m_coneLength[_srcIdx];
+		m_coneCos[i] = _src.m_coneCos[_srcIdx];
+		m_coneSin[i] = _src.m_coneSin[_srcIdx];
+		m_lightIdx[i] = _src.m_lightIdx[_srcIdx];
+	}
+
+	// Bounding sphere.
+	float* m_sphereX;
+	float* m_sphereY;
+	float* m_sphereZ;
+	float* m_sphereRadius;
+
+	// Spot cone, the axis is normalized.
+	float* m_apexX;
+	float* m_apexY;
+	float* m_apexZ;
+	float* m_axisX;
+	float* m_axisY;
+	float* m_axisZ;
+	float* m_coneLength;
+	float* m_coneCos;
+	float* m_coneSin;
+
+	// Index into the (sorted) light buffer.
+	uint32_t* m_lightIdx;
+
+	uint32_t m_num = 0;
+	uint32_t m_capacity = 0;
+};
+
+struct ClusterBounds
+{
+	kt::Vec3 m_min;
+	kt::Vec3 m_max;
+
+	kt::Vec3 m_center;
+	float m_radius;
+};
+
+static ClusterBounds CalcClusterBounds(float _ndcX0, float _ndcX1, float _ndcY0, float _ndcY1, float _depth0, float _depth1, float _rcpProjX, float _rcpProjY)
+{
+	// Tile edges are lines through the eye, so the extremes are always at the near or far depth of the slice.
+	ClusterBounds bounds;
+	bounds.m_min.x = kt::Min(_ndcX0 * _depth0, _ndcX0 * _depth1) * _rcpProjX;
+	bounds.m_max.x = kt::Max(_ndcX1 * _depth0, _ndcX1 * _depth1) * _rcpProjX;
+	bounds.m_min.y = kt::Min(_ndcY0 * _depth0, _ndcY0 * _depth1) * _rcpProjY;
+	bounds.m_max.y = kt::Max(_ndcY1 * _depth0, _ndcY1 * _depth1) * _rcpProjY;
+	bounds.m_min.z = _depth0;
+	bounds.m_max.z = _depth1;
+
+	bounds.m_center = (bounds.m_min + bounds.m_max) * 0.5f;
+	bounds.m_radius = kt::Length(bounds.m_max - bounds.m_center);
+	return bounds;
+}
+
+// Bit i is set if light _begin + i may touch the cluster.
+// Bounding spheres are tested against the cluster AABB, then cones (when _testCones) against the cluster's bounding sphere.
+static uint32_t TestLightsVsCluster(ClusterLights_SoA const& _lights, uint32_t _begin, ClusterBounds const& _bounds, bool _testCones)
+{
+	__m128 const zero = _mm_setzero_ps();
+
+	__m128 hit;
+
+	{
+		__m128 const sx = _mm_load_ps(_lights.m_sphereX + _begin);
+		__m128 const sy = _mm_load_ps(_lights.m_sphereY + _begin);
+		__m128 const sz = _mm_load_ps(_lights.m_sphereZ + _begin);
+		__m128 const sr = _mm_load_ps(_lights.m_sphereRadius + _begin);
+
+		__m128 const dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(_bounds.m_min.x), sx), _mm_sub_ps(sx, _mm_set1_ps(_bounds.m_max.x))), zero);
+		__m128 const dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(_bounds.m_min.y), sy), _mm_sub_ps(sy, _mm_set1_ps(_bounds.m_max.y))), zero);
+		__m128 const dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(_bounds.m_min.z), sz), _mm_sub_ps(sz, _mm_set1_ps(_bounds.m_max.z))), zero);
+
+		__m128 const distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		hit = _mm_cmple_ps(distSq, _mm_mul_ps(sr, sr));
+	}
+
+	if (_testCones)
+	{
+		// Distance from the cluster sphere's center to the cone surface, after "Cull that cone!" (Wronski 2017).
+		__m128 const vx = _mm_sub_ps(_mm_set1_ps(_bounds.m_center.x), _mm_load_ps(_lights.m_apexX + _begin));
+		__m128 const vy = _mm_sub_ps(_mm_set1_ps(_bounds.m_center.y), _mm_load_ps(_lights.m_apexY + _begin));
+		__m128 const vz = _mm_sub_ps(_mm_set1_ps(_bounds.m_center.z), _mm_load_ps(_lights.m_apexZ + _begin));
+
+		__m128 const lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+
+		__m128 alongAxis = _mm_mul_ps(vx, _mm_load_ps(_lights.m_axisX + _begin));
+		alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(vy, _mm_load_ps(_lights.m_axisY + _begin)));
+		alongAxis = _mm_add_ps(alongAxis, _mm_mul_ps(vz, _mm_load_ps(_lights.m_axisZ + _begin)));
+
+		__m128 const fromAxis = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lenSq, _mm_mul_ps(alongAxis, alongAxis)), zero));
+		__m128 const distToCone = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(_lights.m_coneCos + _begin), fromAxis), _mm_mul_ps(alongAxis, _mm_load_ps(_lights.m_coneSin + _begin)));
+
+		__m128 const radius = _mm_set1_ps(_bounds.m_radius);
+		hit = _mm_and_ps(hit, _mm_cmple_ps(distToCone, radius));
+		hit = _mm_and_ps(hit, _mm_cmple_ps(alongAxis, _mm_add_ps(radius, _mm_load_ps(_lights.m_coneLength + _begin))));
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(alongAxis, _mm_sub_ps(zero, radius)));
+	}
+
+	uint32_t const numLanes = kt::Min(_lights.m_num - _begin, c_lightSimdWidth);
+	return uint32_t(_mm_movemask_ps(hit)) & ((1u << numLanes) - 1u);
+}
+
+struct SliceBuildData
+{
+	ClusterLights_SoA const* m_lights;
+
+	// Lights overlapping each slice's depth range are m_sliceLights[m_sliceOffsets[slice], m_sliceOffsets[slice + 1]).
+	uint32_t const* m_sliceLights;
+	uint32_t const* m_sliceOffsets;
+
+	float const* m_sliceDepths;
+
+	float m_rcpProjX;
+	float m_rcpProjY;
+	uint32_t m_numPointLights;
+};
+
+// Fills the slice's clusters, with offsets relative to o_lightIndices. Returns the most lights in one cluster.
+static uint32_t BuildSlice(SliceBuildData const& _data, uint32_t _slice, shaderlib::LightCluster* o_clusters, kt::Array<uint32_t>& o_lightIndices)
+{
+	o_lightIndices.Clear();
+
+	uint32_t const firstCandidate = _data.m_sliceOffsets[_slice];
+	uint32_t const numCandidates = _data.m_sliceOffsets[_slice + 1] - firstCandidate;
+
+	if (numCandidates == 0)
+	{
+		memset(o_clusters, 0, sizeof(shaderlib::LightCluster) * c_clustersPerSlice);
+		return 0;
+	}
+
+	kt::LinearAllocator* allocator = core::GetThreadFrameAllocator();
+
+	ClusterLights_SoA sliceLights;
+	sliceLights.Init(allocator, numCandidates);
+
+	for (uint32_t i = 0; i < numCandidates; ++i)
+	{
+		sliceLights.Append(*_data.m_lights, _data.m_sliceLights[firstCandidate + i]);
+	}
+
+	ClusterLights_SoA rowLights;
+	rowLights.Init(allocator, numCandidates);
+
+	float const depth0 = _data.m_sliceDepths[_slice];
+	float const depth1 = _data.m_sliceDepths[_slice + 1];
+
+	uint32_t maxClusterLights = 0;
+
+	for (uint32_t y = 0; y < c_clustersY; ++y)
+	{
+		// Row 0 is the top of the screen.
+		float const ndcY0 = 1.0f - 2.0f * float(y + 1) / float(c_clustersY);
+		float const ndcY1 = 1.0f - 2.0f * float(y) / float(c_clustersY);
+
+		// Narrow down to the row first, most lights only touch a few rows.
+		ClusterBounds const rowBounds = CalcClusterBounds(-1.0f, 1.0f, ndcY0, ndcY1, depth0, depth1, _data.m_rcpProjX, _data.m_rcpProjY);
+		rowLights.m_num = 0;
+
+		for (uint32_t i = 0; i < sliceLights.m_num; i += c_lightSimdWidth)
+		{
+			uint32_t const mask = TestLightsVsCluster(sliceLights, i, rowBounds, false);
+
+			for (uint32_t lane = 0; lane < c_lightSimdWidth; ++lane)
+			{
+				if (mask & (1u << lane))
+				{
+					rowLights.Append(sliceLights, i + lane);
+				}
+			}
+		}
+
+		for (uint32_t x = 0; x < c_clustersX; ++x)
+		{
+			float const ndcX0 = -1.0f + 2.0f * float(x) / float(c_clustersX);
+			float const ndcX1 = -1.0f + 2.0f * float(x + 1) / float(c_clustersX);
+
+			ClusterBounds const bounds = CalcClusterBounds(ndcX0, ndcX1, ndcY0, ndcY1, depth0, depth1, _data.m_rcpProjX, _data.m_rcpProjY);
+
+			uint32_t const indexOffset = o_lightIndices.Size();
+			uint32_t numPointLights = 0;
+			uint32_t numSpotLights = 0;
+
+			// Candidates are in light buffer order, so point lights end up first.
+			for (uint32_t i = 0; i < rowLights.m_num; i += c_lightSimdWidth)
+			{
+				uint32_t const mask = TestLightsVsCluster(rowLights, i, bounds, true);
+
+				for (uint32_t lane = 0; lane < c_lightSimdWidth; ++lane)
+				{
+					if (mask & (1u << lane))
+					{
+						uint32_t const lightIdx = rowLights.m_lightIdx[i + lane];
+						o_lightIndices.PushBack(lightIdx);
+
+						if (lightIdx < _data.m_numPointLights)
+						{
+							++numPointLights;
+						}
+						else
+						{
+							++numSpotLights;
+						}
+					}
+				}
+			}
+
+			KT_ASSERT(numPointLights <= c_maxClusterLightsPerType && numSpotLights <= c_maxClusterLightsPerType);
+
+			shaderlib::LightCluster& cluster = o_clusters[y * c_clustersX + x];
+			cluster.lightIndexOffset = indexOffset;
+			cluster.lightCounts = numPointLights | (numSpotLights << 16);
+
+			maxClusterLights = kt::Max(maxClusterLights, numPointLights + numSpotLights);
+		}
+	}
+
+	return maxClusterLights;
+}
+
+void LightClusters::Init()
+{
+	m_clusterGpuBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::ShaderResource, c_numClusters, gpu::Format::Unknown, "Light Clusters");
+	m_lightIndexGpuBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::ShaderResource, 16 * 1024, gpu::Format::Unknown, "Light Cluster Indices");
+}
+
+void LightClusters::Build(gpu::cmd::Context* _ctx, Camera const& _view, shaderlib::LightData const* _lights, uint32_t _numLights, uint32_t _numPointLights, shaderlib::FrameConstants& io_constants)
+{
+	GPU_PROFILE_SCOPE(_ctx, "LightClusters::Build", GPU_PROFILE_COLOUR(0xf0, 0xff, 0x00));
+
+	kt::TimePoint const buildStart = kt::TimePoint::Now();
+
+	Camera::ProjectionParams const& projParams = _view.GetProjectionParams();
+	KT_ASSERT(projParams.m_type == Camera::ProjType::Perspective);
+
+	float const nearDepth = projParams.m_nearPlane;
+	float const farDepth = projParams.m_farPlane;
+	float const slicedDepth = kt::Max(kt::Min(float(s_clusterMaxDistance), farDepth), nearDepth * 2.0f);
+
+	float const depthScale = float(c_clustersZ) / log2f(slicedDepth / nearDepth);
+	float const depthBias = -log2f(nearDepth) * depthScale;
+
+	io_constants.clusterDepthScale = depthScale;
+	io_constants.clusterDepthBias = depthBias;
+
+	float sliceDepths[c_clustersZ + 1];
+	for (uint32_t slice = 0; slice <= c_clustersZ; ++slice)
+	{
+		sliceDepths[slice] = nearDepth * powf(slicedDepth / nearDepth, float(slice) / float(c_clustersZ));
+	}
+
+	// The shader clamps to the last slice, so it runs out to the far plane.
+	sliceDepths[c_clustersZ] = kt::Max(farDepth, slicedDepth);
+
+	auto sliceForDepth = [depthScale, depthBias, nearDepth](float _depth) -> uint32_t
+	{
+		float const slice = _depth <= nearDepth ? 0.0f : log2f(_depth) * depthScale + depthBias;
+		return uint32_t(kt::Clamp(slice, 0.0f, float(c_clustersZ - 1)));
+	};
+
+	kt::LinearAllocator* allocator = core::GetThreadFrameAllocator();
+
+	// Bounds in view space, dropping anything outside the sliced depth range.
+	ClusterLights_SoA lights;
+	lights.Init(allocator, _numLights);
+
+	uint8_t* firstSlice = (uint8_t*)allocator->Alloc(kt::Max(_numLights, 1u));
+	uint8_t* lastSlice = (uint8_t*)allocator->Alloc(kt::Max(_numLights, 1u));
+
+	kt::Mat4 const& view = _view.GetView();
+
+	for (uint32_t lightIdx = 0; lightIdx < _numLights; ++lightIdx)
+	{
+		shaderlib::LightData const& light = _lights[lightIdx];
+
+		kt::Vec4 const posVS = kt::Mul(view, kt::Vec4(light.posWS.x, light.posWS.y, light.posWS.z, 1.0f));
+		kt::Vec3 const apex(posVS.x, posVS.y, -posVS.z);
+		float const range = 1.0f / light.rcpRadius;
+
+		kt::Vec3 axis(0.0f);
+		float coneCos = -1.0f;
+		float coneSin = 0.0f;
+
+		kt::Vec3 sphereCenter = apex;
+		float sphereRadius = range;
+
+		// Cones of 90 degrees or more are bounded just as well by the point light sphere.
+		if (light.type == PATHOS_LIGHT_TYPE_SPOT && light.spotParams.x > 0.0f)
+		{
+			kt::Vec4 const dirVS = kt::Mul(view, kt::Vec4(light.direction.x, light.direction.y, light.direction.z, 0.0f));
+			axis = kt::Normalize(kt::Vec3(dirVS.x, dirVS.y, -dirVS.z));
+			coneCos = light.spotParams.x;
+			coneSin = sqrtf(kt::Max(1.0f - coneCos * coneCos, 0.0f));
+
+			// Tightest sphere around the cone, see "Cull that cone!" (Wronski 2017).
+			if (coneCos < 0.70710678f)
+			{
+				sphereCenter = apex + axis * (range * coneCos);
+				sphereRadius = range * coneSin;
+			}
+			else
+			{
+				float const halfLength = range / (2.0f * coneCos);
+				sphereCenter = apex + axis * halfLength;
+				sphereRadius = halfLength;
+			}
+		}
+
+		if (sphereCenter.z + sphereRadius < nearDepth || sphereCenter.z - sphereRadius > sliceDepths[c_clustersZ])
+		{
+			continue;
+		}
+
+		uint32_t const i = lights.m_num++;
+		lights.m_sphereX[i] = sphereCenter.x;
+		lights.m_sphereY[i] = sphereCenter.y;
+		lights.m_sphereZ[i] = sphereCenter.z;
+		lights.m_sphereRadius[i] = sphereRadius;
+		lights.m_apexX[i] = apex.x;
+		lights.m_apexY[i] = apex.y;
+		lights.m_apexZ[i] = apex.z;
+		lights.m_axisX[i] = axis.x;
+		lights.m_axisY[i] = axis.y;
+		lights.m_axisZ[i] = axis.z;
+		lights.m_coneLength[i] = range;
+		lights.m_coneCos[i] = coneCos;
+		lights.m_coneSin[i] = coneSin;
+		lights.m_lightIdx[i] = lightIdx;
+
+		firstSlice[i] = uint8_t(sliceForDepth(sphereCenter.z - sphereRadius));
+		lastSlice[i] = uint8_t(sliceForDepth(sphereCenter.z + sphereRadius));
+	}
+
+	// Bucket lights by the depth slices they overlap, keeping light buffer order within each slice.
+	uint32_t sliceOffsets[c_clustersZ + 1] = {};
+
+	for (uint32_t i = 0; i < lights.m_num; ++i)
+	{
+		for (uint32_t slice = firstSlice[i]; slice <= lastSlice[i]; ++slice)
+		{
+			++sliceOffsets[slice + 1];
+		}
+	}
+
+	for (uint32_t slice = 0; slice < c_clustersZ; ++slice)
+	{
+		sliceOffsets[slice + 1] += sliceOffsets[slice];
+	}
+
+	uint32_t* sliceLights = (uint32_t*)allocator->Alloc(sizeof(uint32_t) * kt::Max(sliceOffsets[c_clustersZ], 1u));
+
+	{
+		uint32_t sliceWrite[c_clustersZ];
+		memcpy(sliceWrite, sliceOffsets, sizeof(sliceWrite));
+
+		for (uint32_t i = 0; i < lights.m_num; ++i)
+		{
+			for (uint32_t slice = firstSlice[i]; slice <= lastSlice[i]; ++slice)
+			{
+				sliceLights[sliceWrite[slice]++] = i;
+			}
+		}
+	}
+
+	SliceBuildData buildData;
+	buildData.m_lights = &lights;
+	buildData.m_sliceLights = sliceLights;
+	buildData.m_sliceOffsets = sliceOffsets;
+	buildData.m_sliceDepths = sliceDepths;
+	buildData.m_rcpProjX = 1.0f / _view.GetProjection().m_cols[0].x;
+	buildData.m_rcpProjY = 1.0f / _view.GetProjection().m_cols[1].y;
+	buildData.m_numPointLights = _numPointLights;
+
+	uint32_t sliceMaxClusterLights[c_clustersZ] = {};
+
+	core::jobs::ParallelFor(c_clustersZ, 1, [this, &buildData, &sliceMaxClusterLights](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t slice = _begin; slice < _end; ++slice)
+		{
+			sliceMaxClusterLights[slice] = BuildSlice(buildData, slice, m_clusters + slice * c_clustersPerSlice, m_sliceLightIndices[slice]);
+		}
+	});
+
+	// Upload, rebasing each slice's offsets onto the combined index list.
+	uint32_t sliceIndexBase[c_clustersZ];
+	uint32_t numLightIndices = 0;
+	uint32_t maxClusterLights = 0;
+
+	for (uint32_t slice = 0; slice < c_clustersZ; ++slice)
+	{
+		sliceIndexBase[slice] = numLightIndices;
+		numLightIndices += m_sliceLightIndices[slice].Size();
+		maxClusterLights = kt::Max(maxClusterLights, sliceMaxClusterLights[slice]);
+	}
+
+	gpu::cmd::ResourceBarrier(_ctx, m_clusterGpuBuf.m_buffer, gpu::ResourceState::CopyDest);
+	gpu::cmd::ResourceBarrier(_ctx, m_lightIndexGpuBuf.m_buffer, gpu::ResourceState::CopyDest);
+	gpu::cmd::FlushBarriers(_ctx);
+
+	shaderlib::LightCluster* clusterWrite = m_clusterGpuBuf.BeginUpdate(_ctx, c_numClusters);
+
+	for (uint32_t slice = 0; slice < c_clustersZ; ++slice)
+	{
+		for (uint32_t i = 0; i < c_clustersPerSlice; ++i)
+		{
+			shaderlib::LightCluster cluster = m_clusters[slice * c_clustersPerSlice + i];
+			cluster.lightIndexOffset += sliceIndexBase[slice];
+			*clusterWrite++ = cluster;
+		}
+	}
+
+	m_clusterGpuBuf.EndUpdate(_ctx);
+
+	uint32_t* indexWrite = m_lightIndexGpuBuf.BeginUpdate(_ctx, kt::Max(numLightIndices, 1u));
+
+	for (uint32_t slice = 0; slice < c_clustersZ; ++slice)
+	{
+		memcpy(indexWrite + sliceIndexBase[slice], m_sliceLightIndices[slice].Data(), sizeof(uint32_t) * m_sliceLightIndices[slice].Size());
+	}
+
+	m_lightIndexGpuBuf.EndUpdate(_ctx);
+
+	gpu::cmd::ResourceBarrier(_ctx, m_clusterGpuBuf.m_buffer, gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, m_lightIndexGpuBuf.m_buffer, gpu::ResourceState::ShaderResource);
+
+	m_stats.m_numLightsInView = lights.m_num;
+	m_stats.m_numLightIndices = numLightIndices;
+	m_stats.m_maxLightsPerCluster = maxClusterLights;
+	m_stats.m_cpuTimeMs = float((kt::TimePoint::Now() - buildStart).Seconds() * 1000.0);
+}
+
+}
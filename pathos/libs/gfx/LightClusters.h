@@ -0,0 +1,55 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+
+#include <shaderlib/CommonShared.h>
+
+#include <gpu/CommandContext.h>
+#include <gpu/HandleRef.h>
+
+#include "Utils.h"
+
+namespace gfx
+{
+
+struct Camera;
+
+// Clustered forward lighting. The main view is split into a froxel grid of PATHOS_LIGHT_CLUSTERS_X * PATHOS_LIGHT_CLUSTERS_Y screen tiles
+// by PATHOS_LIGHT_CLUSTERS_Z exponential depth slices, and every cluster gets a list of the lights that may touch it.
+// Lists are built on the cpu each frame (one job per depth slice) and read by ObjectShader.ps, see shaderlib::LightCluster.
+class LightClusters
+{
+public:
+	static uint32_t constexpr c_numClusters = PATHOS_LIGHT_CLUSTERS_X * PATHOS_LIGHT_CLUSTERS_Y * PATHOS_LIGHT_CLUSTERS_Z;
+
+	struct Stats
+	{
+		uint32_t m_numLightsInView = 0;
+		uint32_t m_numLightIndices = 0;
+		uint32_t m_maxLightsPerCluster = 0;
+		float m_cpuTimeMs = 0.0f;
+	};
+
+	void Init();
+
+	// _lights must be sorted with the point lights first, like the gpu light buffer, and cluster lists index into it.
+	// _view must be a perspective camera. Writes the depth slice parameters into io_constants.
+	void Build(gpu::cmd::Context* _ctx, Camera const& _view, shaderlib::LightData const* _lights, uint32_t _numLights, uint32_t _numPointLights, shaderlib::FrameConstants& io_constants);
+
+	gpu::BufferRef const& ClusterBuffer() const { return m_clusterGpuBuf.m_buffer; }
+	gpu::BufferRef const& LightIndexBuffer() const { return m_lightIndexGpuBuf.m_buffer; }
+
+	Stats const& GetStats() const { return m_stats; }
+
+private:
+	ResizableDynamicBufferT<shaderlib::LightCluster> m_clusterGpuBuf;
+	ResizableDynamicBufferT<uint32_t> m_lightIndexGpuBuf;
+
+	// Offsets are relative to the slice's own index list until they're uploaded.
+	shaderlib::LightCluster m_clusters[c_numClusters];
+	kt::Array<uint32_t> m_sliceLightIndices[PATHOS_LIGHT_CLUSTERS_Z];
+
+	Stats m_stats;
+};
+
+}
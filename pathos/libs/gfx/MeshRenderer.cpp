@@ -1,168 +1,786 @@
 #include "MeshRenderer.h"
 
-#include <intrin.h>
+#include <atomic>
+#include <string.h>
 
-#include <kt/Sort.h>
+#include <kt/Timer.h>
 
 #include <core/Memory.h>
+#include <core/Jobs.h>
+#include <core/CVar.h>
 #include <shaderlib/DefinesShared.h>
 #include <shaderlib/CullingShared.h>
 
 #include "Model.h"
+#include "Culling.h"
+#include "OcclusionBuffer.h"
+#include "DepthPyramid.h"
+#include "InstanceTable.h"
+#include "Material.h"
 
 namespace gfx
 {
 
-static void PackMat44_to_Mat34_Transpose(kt::Mat4 const& _mat4, MeshRenderer::Matrix3x4* o_mat34)
+static core::CVar<bool> s_parallelBatchBuild("gfx.parallel_batch_build", "build draw batches on the job system", true);
+
+// Work per job for each stage of the cpu batch build.
+static uint32_t const c_instanceGrainSize = 256;
+static uint32_t const c_cullBlockGrainSize = 128;
+static uint32_t const c_submeshGrainSize = 2048;
+static uint32_t const c_staticRunGrainSize = 64;
+
+MeshRenderer::MeshRenderer()
 {
-	float const* mtxPtr = _mat4.Data();
+	m_indirectArgsBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::UnorderedAccess, 1024, gpu::Format::Unknown, "gfx::Scene indirect args");
+	m_instanceIdx_MeshIdx_Buf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::Vertex | gpu::BufferFlags::UnorderedAccess, 4096, gpu::Format::Unknown, "gfx::Scene instanceIdx_meshIdx");
+	m_lateIndirectArgsBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::UnorderedAccess, 1024, gpu::Format::Unknown, "gfx::Scene late indirect args");
+	m_lateInstanceIdx_MeshIdx_Buf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::Vertex | gpu::BufferFlags::UnorderedAccess, 4096, gpu::Format::Unknown, "gfx::Scene late instanceIdx_meshIdx");
+	m_staticIndirectArgsBuf.Init(gpu::BufferFlags::Dynamic, 256, gpu::Format::Unknown, "gfx::Scene static indirect args");
+	m_staticInstanceIdx_MeshIdx_Buf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::Vertex, 1024, gpu::Format::Unknown, "gfx::Scene static instanceIdx_meshIdx");
+	m_staticCulledIndirectArgsBuf.Init(gpu::BufferFlags::Dynamic, 256, gpu::Format::Unknown, "gfx::Scene static culled indirect args");
+	m_staticCulledInstanceIdx_MeshIdx_Buf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::Vertex, 1024, gpu::Format::Unknown, "gfx::Scene static culled instanceIdx_meshIdx");
+}
+
+void MeshRenderer::Init(InstanceTable const& _instances, bool _cullSmallInstances)
+{
+	m_instanceTable = &_instances;
+	m_cullSmallInstances = _cullSmallInstances;
+}
+
+void MeshRenderer::Submit(uint32_t _instanceSlot)
+{
+	KT_ASSERT(m_instanceTable);
+	gfx::ResourceManager::MeshIdx const meshIdx = m_instanceTable->Mesh(_instanceSlot);
+	m_numSubmeshesSubmittedThisFrame += gfx::ResourceManager::GetMesh(meshIdx)->m_subMeshes.Size();
+	m_instanceSlots.PushBack(_instanceSlot);
+	m_meshes.PushBack(meshIdx);
+}
+
+// Calls _countFn(begin, end) for fixed chunks of [0, _num), then _writeFn(begin, end, writeOffset) with each chunk's
+// offset into the output, so chunks write disjoint ranges in input order. Returns the total counted.
+template <typename CountFnT, typename WriteFnT>
+static uint32_t ParallelCompact(uint32_t _num, uint32_t _grainSize, CountFnT&& _countFn, WriteFnT&& _writeFn)
+{
+	if (!_num)
+	{
+		return 0;
+	}
+
+	// Chunks are fixed up front rather than left to ParallelFor, both passes must see the same ones.
+	uint32_t const grain = s_parallelBatchBuild ? _grainSize : _num;
+	uint32_t const numChunks = (_num + grain - 1) / grain;
+	uint32_t* chunkOffsets = (uint32_t*)core::GetThreadFrameAllocator()->Alloc(sizeof(uint32_t) * numChunks);
 
-	for (uint32_t row = 0; row < 3; ++row)
+	core::jobs::ParallelFor(numChunks, 1, [&_countFn, chunkOffsets, grain, _num](uint32_t _begin, uint32_t _end)
 	{
-		o_mat34->data[row * 4 + 0] = mtxPtr[row + 0];
-		o_mat34->data[row * 4 + 1] = mtxPtr[row + 4];
-		o_mat34->data[row * 4 + 2] = mtxPtr[row + 8];
-		o_mat34->data[row * 4 + 3] = mtxPtr[row + 12];
+		for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+		{
+			chunkOffsets[chunkIdx] = _countFn(chunkIdx * grain, kt::Min((chunkIdx + 1) * grain, _num));
+		}
+	});
+
+	uint32_t total = 0;
+
+	for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		uint32_t const count = chunkOffsets[chunkIdx];
+		chunkOffsets[chunkIdx] = total;
+		total += count;
 	}
+
+	core::jobs::ParallelFor(numChunks, 1, [&_writeFn, chunkOffsets, grain, _num](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+		{
+			_writeFn(chunkIdx * grain, kt::Min((chunkIdx + 1) * grain, _num), chunkOffsets[chunkIdx]);
+		}
+	});
+
+	return total;
 }
 
-MeshRenderer::MeshRenderer()
+static DrawBucket SubMeshDrawBucket(gfx::Mesh::SubMesh const& _subMesh)
 {
-	m_instanceXformBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::ShaderResource, 4096, gpu::Format::Unknown, "gfx::Scene instance xforms");
-	m_indirectArgsBuf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::UnorderedAccess, 1024, gpu::Format::Unknown, "gfx::Scene indirect args");
-	m_instanceIdx_MeshIdx_Buf.Init(gpu::BufferFlags::Dynamic | gpu::BufferFlags::Vertex | gpu::BufferFlags::UnorderedAccess, 4096, gpu::Format::Unknown, "gfx::Scene instanceIdx_meshIdx");
+	gfx::Material const* material = ResourceManager::GetMaterial(_subMesh.m_materialIdx);
+	return material ? AlphaModeDrawBucket(material->m_params.m_alphaMode) : DrawBucket::Opaque;
+}
+
+static uint64_t SubMeshSortKey(DrawSortView const& _view, gfx::Mesh const& _mesh, uint32_t _subMeshIdx, uint32_t _lod, kt::Vec3 const& _worldPos)
+{
+	gfx::Mesh::SubMesh const& subMesh = _mesh.m_subMeshes[_subMeshIdx];
+	return MakeDrawSortKey(_view, SubMeshDrawBucket(subMesh), subMesh.m_materialIdx.Slot(), _mesh.m_gpuSubMeshDataOffset + _subMeshIdx, _lod, _worldPos);
+}
+
+// Slot's lod, clamped to the levels its mesh has.
+static uint16_t InstanceLod(InstanceTable const& _table, uint32_t _slot, gfx::Mesh const& _mesh)
+{
+	return uint16_t(kt::Min(uint32_t(_table.Lod(_slot) & ~InstanceTable::c_lodCulled), _mesh.m_numLods - 1));
+}
+
+static_assert(InstanceTable::c_lodCulled == PATHOS_LOD_CULLED, "Cull shader expects the table's culled bit.");
+
+// shaderlib::MeshInstanceCullData::lod of a slot whose mesh has _maxLod + 1 levels.
+static uint32_t CullDataLod(InstanceTable const& _table, uint32_t _slot, uint32_t _maxLod, bool _cullSmallInstances)
+{
+	uint32_t const lod = _table.Lod(_slot);
+	if (_cullSmallInstances && (lod & InstanceTable::c_lodCulled))
+	{
+		return PATHOS_LOD_CULLED;
+	}
+
+	return kt::Min(lod & ~uint32_t(InstanceTable::c_lodCulled), _maxLod);
 }
 
-void MeshRenderer::Submit(gfx::ResourceManager::MeshIdx _meshIdx, kt::Mat4 const& _mtx)
+// Center of the submesh bounds, transformed by a row major 3x4.
+static kt::Vec3 SubMeshWorldCenter(shaderlib::InstanceData_Xform const& _xform, kt::AABB const& _localBounds)
 {
-	PackMat44_to_Mat34_Transpose(_mtx, m_transforms3x4.PushBack_Raw());
-	m_numSubmeshesSubmittedThisFrame += gfx::ResourceManager::GetMesh(_meshIdx)->m_subMeshes.Size();
-	m_meshes.PushBack(_meshIdx);
+	kt::Vec3 const c = (_localBounds.m_min + _localBounds.m_max) * 0.5f;
+
+	return kt::Vec3
+	(
+		_xform.row0.x * c.x + _xform.row0.y * c.y + _xform.row0.z * c.z + _xform.row0.w,
+		_xform.row1.x * c.x + _xform.row1.y * c.y + _xform.row1.z * c.z + _xform.row1.w,
+		_xform.row2.x * c.x + _xform.row2.y * c.y + _xform.row2.z * c.z + _xform.row2.w
+	);
 }
 
-void MeshRenderer::BuildMultiDrawBuffersCPU(gpu::cmd::Context* _ctx)
+void MeshRenderer::SetStaticInstances(uint32_t const* _instanceSlots, uint32_t _numInstances)
 {
-	if (m_meshes.Size() == 0)
+	KT_ASSERT(m_instanceTable);
+
+	m_staticSortedKeys.Clear();
+	m_staticSortedInstances.Clear();
+	m_staticSortedAABBIdx.Clear();
+	m_staticRunBegins.Clear();
+	m_staticTransparentInstances.Clear();
+	m_staticTransparentAABBIdx.Clear();
+	m_staticGPUCullingData.Clear();
+	m_numStaticGPUSubmeshes = 0;
+	m_staticBuffersBuilt = false;
+	m_numStaticDraws = 0;
+
+	if (!_numInstances)
 	{
-		m_batchesBuiltThisFrame = 0;
+		m_staticAABBs = CullingAABBs_SoA{};
 		return;
 	}
 
-	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::BuildMultiDrawBuffersCPU", GPU_PROFILE_COLOUR(0x00, 0x00, 0xff));
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+
+	uint32_t* submeshOffsets = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * _numInstances);
+	uint32_t numSubmeshInstances = 0;
+
+	for (uint32_t instanceIdx = 0; instanceIdx < _numInstances; ++instanceIdx)
+	{
+		submeshOffsets[instanceIdx] = numSubmeshInstances;
+		numSubmeshInstances += ResourceManager::GetMesh(m_instanceTable->Mesh(_instanceSlots[instanceIdx]))->m_subMeshes.Size();
+	}
+
+	m_staticAABBs.Init(m_staticAABBStorage, numSubmeshInstances);
+
+	uint32_t const instanceGrain = s_parallelBatchBuild ? c_instanceGrainSize : _numInstances;
+
+	core::jobs::ParallelFor(_numInstances, instanceGrain, [this, _instanceSlots, submeshOffsets](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t instanceIdx = _begin; instanceIdx < _end; ++instanceIdx)
+		{
+			uint32_t const slot = _instanceSlots[instanceIdx];
+			gfx::Mesh const& mesh = *ResourceManager::GetMesh(m_instanceTable->Mesh(slot));
+			TransformAABBsToSoA(&m_instanceTable->Transform(slot).row0.x, mesh.m_subMeshBoundingBoxes.Data(), mesh.m_subMeshBoundingBoxes.Size(), m_staticAABBs, submeshOffsets[instanceIdx]);
+		}
+	});
+
+	// Without a depth plane every key has the same depth, so this order holds for any view.
+	DrawSortView const viewIndependent;
+
+	kt::Array<SubmeshInstance> unsortedInstances(frameAllocator);
+	kt::Array<uint32_t> unsortedAABBIdx(frameAllocator);
+	kt::Array<uint32_t> sortOrder(frameAllocator);
+
+	for (uint32_t instanceIdx = 0; instanceIdx < _numInstances; ++instanceIdx)
+	{
+		uint32_t const slot = _instanceSlots[instanceIdx];
+		gfx::ResourceManager::MeshIdx const meshIdx = m_instanceTable->Mesh(slot);
+		gfx::Mesh const& mesh = *ResourceManager::GetMesh(meshIdx);
+
+		// Lod holds the mesh's last level until the record goes up with the slot's current one.
+		m_staticGPUCullingData.PushBack(shaderlib::MeshInstanceCullData{ slot | (mesh.m_gpuSubMeshDataOffset << PATHOS_SUBMESH_ID_REMAP_SHIFT), submeshOffsets[instanceIdx], mesh.m_numLods - 1 });
+
+		for (uint32_t subMeshIdx = 0; subMeshIdx < mesh.m_subMeshes.Size(); ++subMeshIdx)
+		{
+			SubmeshInstance const instance{ slot, meshIdx, uint16_t(subMeshIdx), 0 };
+			uint32_t const aabbIdx = submeshOffsets[instanceIdx] + subMeshIdx;
+
+			if (SubMeshDrawBucket(mesh.m_subMeshes[subMeshIdx]) == DrawBucket::Transparent)
+			{
+				m_staticTransparentInstances.PushBack(instance);
+				m_staticTransparentAABBIdx.PushBack(aabbIdx);
+				continue;
+			}
+
+			sortOrder.PushBack(unsortedInstances.Size());
+			m_staticSortedKeys.PushBack(SubMeshSortKey(viewIndependent, mesh, subMeshIdx, 0, kt::Vec3(0.0f)));
+			unsortedInstances.PushBack(instance);
+			unsortedAABBIdx.PushBack(aabbIdx);
+		}
+	}
+
+	uint32_t const numSorted = m_staticSortedKeys.Size();
+
+	uint64_t* tempKeys = (uint64_t*)frameAllocator->Alloc(sizeof(uint64_t) * kt::Max(numSorted, 1u));
+	uint32_t* tempOrder = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * kt::Max(numSorted, 1u));
+	RadixSortKeys64(m_staticSortedKeys.Data(), sortOrder.Data(), tempKeys, tempOrder, numSorted);
 
+	m_staticSortedInstances.Resize(numSorted);
+	m_staticSortedAABBIdx.Resize(numSorted);
+
+	for (uint32_t sortedIdx = 0; sortedIdx < numSorted; ++sortedIdx)
+	{
+		m_staticSortedInstances[sortedIdx] = unsortedInstances[sortOrder[sortedIdx]];
+		m_staticSortedAABBIdx[sortedIdx] = unsortedAABBIdx[sortOrder[sortedIdx]];
+
+		SubmeshInstance const& instance = m_staticSortedInstances[sortedIdx];
+
+		if (!sortedIdx
+			|| instance.m_mesh != m_staticSortedInstances[sortedIdx - 1].m_mesh
+			|| instance.m_subMeshIdx != m_staticSortedInstances[sortedIdx - 1].m_subMeshIdx
+			|| DrawSortKeyBucket(m_staticSortedKeys[sortedIdx]) != DrawSortKeyBucket(m_staticSortedKeys[sortedIdx - 1]))
+		{
+			m_staticRunBegins.PushBack(sortedIdx);
+		}
+	}
+
+	m_staticRunBegins.PushBack(numSorted);
+	m_numStaticGPUSubmeshes = numSubmeshInstances;
+}
+
+// Frustum culls every AABB, then tests what passed against _occlusion (if set). Adds to io_stats.
+static void CullAABBs(CullingAABBs_SoA const& _aabbs, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion, uint8_t* o_visible, MeshRenderer::CullStats& io_stats)
+{
+	// Split into SIMD width aligned blocks so every slice starts on an aligned boundary.
+	uint32_t const numBlocks = (_aabbs.m_num + c_cullingSimdWidth - 1) / c_cullingSimdWidth;
+	uint32_t const blockGrain = s_parallelBatchBuild ? c_cullBlockGrainSize : numBlocks;
+
+	std::atomic<uint32_t> numVisible{ 0 };
+	std::atomic<uint32_t> numOccluded{ 0 };
+
+	core::jobs::ParallelFor(numBlocks, blockGrain, [&_aabbs, &numVisible, &numOccluded, _cullPlanes, _numCullPlanes, _occlusion, o_visible](uint32_t _begin, uint32_t _end)
+	{
+		uint32_t const begin = _begin * c_cullingSimdWidth;
+		uint32_t const end = kt::Min(_end * c_cullingSimdWidth, _aabbs.m_num);
+		uint32_t visible = CullAABBs_SoA(_aabbs.Slice(begin, end - begin), _cullPlanes, _numCullPlanes, o_visible + begin);
+
+		if (_occlusion)
+		{
+			uint32_t occluded = 0;
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				if (!o_visible[i])
+				{
+					continue;
+				}
+
+				kt::Vec3 const center(_aabbs.m_centerX[i], _aabbs.m_centerY[i], _aabbs.m_centerZ[i]);
+				kt::Vec3 const extent(_aabbs.m_extentX[i], _aabbs.m_extentY[i], _aabbs.m_extentZ[i]);
+
+				if (!_occlusion->IsVisible(kt::AABB{ center - extent, center + extent }))
+				{
+					o_visible[i] = 0;
+					++occluded;
+				}
+			}
+
+			visible -= occluded;
+			numOccluded.fetch_add(occluded, std::memory_order_relaxed);
+		}
+
+		numVisible.fetch_add(visible, std::memory_order_relaxed);
+	});
+
+	io_stats.m_numTested += _aabbs.m_num;
+	io_stats.m_numVisible += numVisible.load();
+	io_stats.m_numOccluded += numOccluded.load();
+}
+
+void MeshRenderer::CullSubmeshInstances(kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion, uint32_t const* _submeshInstanceOffsets, uint8_t* o_visible)
+{
 	uint32_t const numMeshInstances = m_meshes.Size();
 
-	// add end of buffer sentinel.
-	m_meshes.PushBack(gfx::ResourceManager::MeshIdx{});
+	CullingAABBs_SoA aabbs;
+	aabbs.Init(core::GetThreadFrameAllocator(), m_numSubmeshesSubmittedThisFrame);
+
+	uint32_t const instanceGrain = s_parallelBatchBuild ? c_instanceGrainSize : numMeshInstances;
+
+	core::jobs::ParallelFor(numMeshInstances, instanceGrain, [this, &aabbs, _submeshInstanceOffsets](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t instanceIdx = _begin; instanceIdx < _end; ++instanceIdx)
+		{
+			gfx::Mesh const& mesh = *ResourceManager::GetMesh(m_meshes[instanceIdx]);
+			TransformAABBsToSoA(&m_instanceTable->Transform(m_instanceSlots[instanceIdx]).row0.x, mesh.m_subMeshBoundingBoxes.Data(), mesh.m_subMeshBoundingBoxes.Size(), aabbs, _submeshInstanceOffsets[instanceIdx]);
+		}
+	});
+
+	CullAABBs(aabbs, _cullPlanes, _numCullPlanes, _occlusion, o_visible, m_cullStats);
+}
+
+void MeshRenderer::BuildMultiDrawBuffersCPU(gpu::cmd::Context* _ctx, DrawSortView const& _sortView, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion)
+{
+	m_cullStats = CullStats{};
+	m_batchesBuiltThisFrame = 0;
+	m_staticBatchesBuiltThisFrame = 0;
+	m_ranges = BucketRanges{};
+
+	if (m_meshes.Size() == 0 && m_staticAABBs.m_num == 0)
+	{
+		return;
+	}
 
-	uint32_t* sortIndices = (uint32_t*)core::GetThreadFrameAllocator()->Alloc(sizeof(uint32_t) * m_meshes.Size());
+	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::BuildMultiDrawBuffersCPU", GPU_PROFILE_COLOUR(0x00, 0x00, 0xff));
 
-	for (uint32_t i = 0; i < m_meshes.Size(); ++i)
+	kt::TimePoint const cullStart = kt::TimePoint::Now();
+
+	uint8_t const* staticVisibility = nullptr;
+
+	if (m_staticAABBs.m_num)
 	{
-		sortIndices[i] = i;
+		staticVisibility = BuildStaticBatchesCPU(_ctx, _cullPlanes, _numCullPlanes, _occlusion);
 	}
 
+	if (m_meshes.Size() || m_staticTransparentInstances.Size())
 	{
-		// Sort by just mesh for now.
-		uint32_t* sortIndicesTemp = (uint32_t*)core::GetThreadFrameAllocator()->Alloc(sizeof(uint32_t) * m_meshes.Size());
-		kt::RadixSort(sortIndices, sortIndices + m_meshes.Size() - 1, sortIndicesTemp, [this](uint32_t _v) -> uint16_t { return m_meshes[_v].idx; });
+		BuildSortedBatchesCPU(_ctx, _sortView, _cullPlanes, _numCullPlanes, _occlusion, staticVisibility);
 	}
 
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceIdx_MeshIdx_Buf.m_buffer, gpu::ResourceState::CopyDest);
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceXformBuf.m_buffer, gpu::ResourceState::CopyDest);
+	m_cullStats.m_cpuTimeMs = float((kt::TimePoint::Now() - cullStart).Seconds() * 1000.0);
+}
 
-	uint32_t* instanceIdx_meshIdxWrite = m_instanceIdx_MeshIdx_Buf.BeginUpdate(_ctx, m_numSubmeshesSubmittedThisFrame);
-	shaderlib::InstanceData_Xform* xformWrite = m_instanceXformBuf.BeginUpdate(_ctx, numMeshInstances);
+void MeshRenderer::ReserveMultiDrawBuffersCPU(gpu::cmd::Context* _ctx)
+{
+	// Each build writes at most one id per submesh instance it considers, and no more draws than ids.
+	uint32_t const maxSorted = kt::Max(m_numSubmeshesSubmittedThisFrame + m_staticTransparentInstances.Size(), 1u);
+	m_indirectArgsBuf.EnsureSize(_ctx, maxSorted, false);
+	m_instanceIdx_MeshIdx_Buf.EnsureSize(_ctx, maxSorted, false);
+
+	uint32_t const maxStatic = kt::Max(m_staticSortedKeys.Size(), 1u);
+	m_staticIndirectArgsBuf.EnsureSize(_ctx, maxStatic, false);
+	m_staticInstanceIdx_MeshIdx_Buf.EnsureSize(_ctx, maxStatic, false);
+	m_staticCulledIndirectArgsBuf.EnsureSize(_ctx, maxStatic, false);
+	m_staticCulledInstanceIdx_MeshIdx_Buf.EnsureSize(_ctx, maxStatic, false);
+}
+
+uint32_t MeshRenderer::BuildStaticBatches
+(
+	gpu::cmd::Context* _ctx,
+	uint8_t const* _visibility,
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+	gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx,
+	BucketRanges& o_ranges
+)
+{
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+
+	uint32_t const numSorted = m_staticSortedKeys.Size();
+	uint64_t* visibleKeys = (uint64_t*)frameAllocator->Alloc(sizeof(uint64_t) * kt::Max(numSorted, 1u));
+	SubmeshInstance* visibleInstances = (SubmeshInstance*)frameAllocator->Alloc(sizeof(SubmeshInstance) * kt::Max(numSorted, 1u));
 
-	kt::Array<gpu::IndexedDrawArguments> drawArgsData(core::GetThreadFrameAllocator());
+	auto isVisible = [this, _visibility](uint32_t _sortedIdx) -> bool
+	{
+		if (_visibility && !_visibility[m_staticSortedAABBIdx[_sortedIdx]])
+		{
+			return false;
+		}
 
-	drawArgsData.Reserve(numMeshInstances);
+		return !m_cullSmallInstances || !(m_instanceTable->Lod(m_staticSortedInstances[_sortedIdx].m_slot) & InstanceTable::c_lodCulled);
+	};
 
-	uint32_t const* beginInstanceIdx = sortIndices;
+	// Keeps the sorted order, apart from splitting each run by lod.
+	uint32_t const numVisible = ParallelCompact
+	(
+		m_staticRunBegins.Size() - 1,
+		c_staticRunGrainSize,
+		[this, &isVisible](uint32_t _beginRun, uint32_t _endRun)
+		{
+			uint32_t count = 0;
+			for (uint32_t i = m_staticRunBegins[_beginRun]; i < m_staticRunBegins[_endRun]; ++i)
+			{
+				count += isVisible(i);
+			}
+			return count;
+		},
+		[this, &isVisible, visibleKeys, visibleInstances](uint32_t _beginRun, uint32_t _endRun, uint32_t _writeIdx)
+		{
+			for (uint32_t runIdx = _beginRun; runIdx < _endRun; ++runIdx)
+			{
+				uint32_t const runBegin = m_staticRunBegins[runIdx];
+				uint32_t const runEnd = m_staticRunBegins[runIdx + 1];
+				gfx::Mesh const& mesh = *ResourceManager::GetMesh(m_staticSortedInstances[runBegin].m_mesh);
+
+				uint32_t lodOffsets[c_maxMeshLods] = {};
+
+				for (uint32_t i = runBegin; i < runEnd; ++i)
+				{
+					if (isVisible(i))
+					{
+						++lodOffsets[InstanceLod(*m_instanceTable, m_staticSortedInstances[i].m_slot, mesh)];
+					}
+				}
+
+				for (uint32_t lod = 0; lod < c_maxMeshLods; ++lod)
+				{
+					uint32_t const count = lodOffsets[lod];
+					lodOffsets[lod] = _writeIdx;
+					_writeIdx += count;
+				}
+
+				for (uint32_t i = runBegin; i < runEnd; ++i)
+				{
+					if (isVisible(i))
+					{
+						uint16_t const lod = InstanceLod(*m_instanceTable, m_staticSortedInstances[i].m_slot, mesh);
+						uint32_t const writeIdx = lodOffsets[lod]++;
+						visibleKeys[writeIdx] = m_staticSortedKeys[i];
+						visibleInstances[writeIdx] = m_staticSortedInstances[i];
+						visibleInstances[writeIdx].m_lod = lod;
+					}
+				}
+			}
+		}
+	);
 
-	uint32_t numBatches = 0;
-	uint32_t globalInstanceIndex = 0;
-	uint32_t globalTransformIdx = 0;
+	return BuildBatches(_ctx, visibleKeys, visibleInstances, nullptr, numVisible, _indirectArgs, _instanceIdx_MeshIdx, o_ranges);
+}
 
-	for (;;)
+uint8_t const* MeshRenderer::BuildStaticBatchesCPU(gpu::cmd::Context* _ctx, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion)
+{
+	if (!_numCullPlanes)
 	{
- 		ResourceManager::MeshIdx const curMeshIdx = m_meshes[*beginInstanceIdx];
+		// The draws from the last rebuild are used as is, unless lods have changed since.
+		if (!m_staticBuffersBuilt || m_staticBuffersLodVersion != m_instanceTable->LodVersion())
+		{
+			m_numStaticDraws = BuildStaticBatches(_ctx, nullptr, m_staticIndirectArgsBuf, m_staticInstanceIdx_MeshIdx_Buf, m_staticRanges);
+			m_staticBuffersLodVersion = m_instanceTable->LodVersion();
+			m_staticBuffersBuilt = true;
+		}
+
+		m_staticBatchesBuiltThisFrame = m_numStaticDraws;
+		m_staticBatchesCulledThisFrame = false;
+		m_cullStats.m_numTested += m_staticAABBs.m_num;
+		m_cullStats.m_numVisible += m_staticAABBs.m_num;
+		return nullptr;
+	}
+
+	// Sorting and world bounds are kept, only culling and writing visible submesh instances is done per frame.
+	uint8_t* visibility = (uint8_t*)core::GetThreadFrameAllocator()->Alloc(m_staticAABBs.m_num);
+	CullAABBs(m_staticAABBs, _cullPlanes, _numCullPlanes, _occlusion, visibility, m_cullStats);
+
+	m_staticBatchesBuiltThisFrame = BuildStaticBatches(_ctx, visibility, m_staticCulledIndirectArgsBuf, m_staticCulledInstanceIdx_MeshIdx_Buf, m_staticCulledRanges);
+	m_staticBatchesCulledThisFrame = true;
+
+	return visibility;
+}
+
+void MeshRenderer::BuildSortedBatchesCPU(gpu::cmd::Context* _ctx, DrawSortView const& _sortView, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion, uint8_t const* _staticVisibility)
+{
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+
+	uint32_t const numMeshInstances = m_meshes.Size();
+
+	// Submesh j of instance i is at submeshInstanceOffsets[i] + j in submeshVisibility.
+	uint32_t* submeshInstanceOffsets = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * kt::Max(numMeshInstances, 1u));
+	uint8_t* submeshVisibility = nullptr;
 
-		ResourceManager::MeshIdx nextMeshIdx;
-		uint32_t numInstancesForThisBatch = 0;
+	{
+		uint32_t offset = 0;
 
-		do
+		for (uint32_t instanceIdx = 0; instanceIdx < numMeshInstances; ++instanceIdx)
 		{
-			Matrix3x4 const& mtx34 = m_transforms3x4[*beginInstanceIdx];
-			
-			_mm_store_ps((float*)&xformWrite->row0, _mm_load_ps(mtx34.data));
-			_mm_store_ps((float*)&xformWrite->row1, _mm_load_ps(mtx34.data + 4));
-			_mm_store_ps((float*)&xformWrite->row2, _mm_load_ps(mtx34.data + 8));
-			++xformWrite;
-			++numInstancesForThisBatch;
-			++beginInstanceIdx;
+			submeshInstanceOffsets[instanceIdx] = offset;
+			offset += ResourceManager::GetMesh(m_meshes[instanceIdx])->m_subMeshes.Size();
+		}
 
-			nextMeshIdx = m_meshes[*beginInstanceIdx];
+		KT_ASSERT(offset == m_numSubmeshesSubmittedThisFrame);
+	}
 
-		} while (nextMeshIdx == curMeshIdx);
+	if (_numCullPlanes && numMeshInstances)
+	{
+		submeshVisibility = (uint8_t*)frameAllocator->Alloc(m_numSubmeshesSubmittedThisFrame);
+		CullSubmeshInstances(_cullPlanes, _numCullPlanes, _occlusion, submeshInstanceOffsets, submeshVisibility);
+	}
+	else
+	{
+		m_cullStats.m_numTested += m_numSubmeshesSubmittedThisFrame;
+		m_cullStats.m_numVisible += m_numSubmeshesSubmittedThisFrame;
+	}
+
+	uint32_t const maxSubmeshInstances = kt::Max(m_numSubmeshesSubmittedThisFrame + m_staticTransparentInstances.Size(), 1u);
+
+	SubmeshInstance* instances = (SubmeshInstance*)frameAllocator->Alloc(sizeof(SubmeshInstance) * maxSubmeshInstances);
+	uint64_t* keys = (uint64_t*)frameAllocator->Alloc(sizeof(uint64_t) * maxSubmeshInstances);
+	uint32_t* order = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * maxSubmeshInstances);
+
+	// Visible submitted submesh instances, in submission order.
+	uint32_t numVisible = ParallelCompact
+	(
+		numMeshInstances,
+		c_instanceGrainSize,
+		[this, submeshInstanceOffsets, submeshVisibility](uint32_t _begin, uint32_t _end)
+		{
+			if (!submeshVisibility)
+			{
+				return (_end < m_meshes.Size() ? submeshInstanceOffsets[_end] : m_numSubmeshesSubmittedThisFrame) - submeshInstanceOffsets[_begin];
+			}
+
+			uint32_t count = 0;
+			uint32_t const end = _end < m_meshes.Size() ? submeshInstanceOffsets[_end] : m_numSubmeshesSubmittedThisFrame;
+			for (uint32_t i = submeshInstanceOffsets[_begin]; i < end; ++i)
+			{
+				count += submeshVisibility[i] != 0;
+			}
+			return count;
+		},
+		[this, &_sortView, submeshInstanceOffsets, submeshVisibility, instances, keys, order](uint32_t _begin, uint32_t _end, uint32_t _writeIdx)
+		{
+			for (uint32_t instanceIdx = _begin; instanceIdx < _end; ++instanceIdx)
+			{
+				uint32_t const slot = m_instanceSlots[instanceIdx];
+				shaderlib::InstanceData_Xform const& xform = m_instanceTable->Transform(slot);
+				gfx::Mesh const& mesh = *ResourceManager::GetMesh(m_meshes[instanceIdx]);
+				uint16_t const lod = InstanceLod(*m_instanceTable, slot, mesh);
+
+				for (uint32_t subMeshIdx = 0; subMeshIdx < mesh.m_subMeshes.Size(); ++subMeshIdx)
+				{
+					if (submeshVisibility && !submeshVisibility[submeshInstanceOffsets[instanceIdx] + subMeshIdx])
+					{
+						continue;
+					}
+
+					instances[_writeIdx] = SubmeshInstance{ slot, m_meshes[instanceIdx], uint16_t(subMeshIdx), lod };
+					keys[_writeIdx] = SubMeshSortKey(_sortView, mesh, subMeshIdx, lod, SubMeshWorldCenter(xform, mesh.m_subMeshBoundingBoxes[subMeshIdx]));
+					order[_writeIdx] = _writeIdx;
+					++_writeIdx;
+				}
+			}
+		}
+	);
 
-		gfx::Mesh const& mesh = *ResourceManager::GetMesh(curMeshIdx);
+	// Transparent statics need their depth against this view, so are sorted with everything else.
+	uint32_t const staticBegin = numVisible;
 
-		numBatches += mesh.m_subMeshes.Size();
-		gpu::IndexedDrawArguments* drawArgs = drawArgsData.PushBack_Raw(mesh.m_subMeshes.Size());
+	auto isStaticTransparentVisible = [this, _staticVisibility](uint32_t _idx) -> bool
+	{
+		if (_staticVisibility && !_staticVisibility[m_staticTransparentAABBIdx[_idx]])
+		{
+			return false;
+		}
 
-		uint32_t subMeshGpuOffset = mesh.m_gpuSubMeshDataOffset;
+		return !m_cullSmallInstances || !(m_instanceTable->Lod(m_staticTransparentInstances[_idx].m_slot) & InstanceTable::c_lodCulled);
+	};
 
-		for (gfx::Mesh::SubMesh const& subMesh : mesh.m_subMeshes)
+	numVisible += ParallelCompact
+	(
+		m_staticTransparentInstances.Size(),
+		c_submeshGrainSize,
+		[&isStaticTransparentVisible](uint32_t _begin, uint32_t _end)
+		{
+			uint32_t count = 0;
+			for (uint32_t i = _begin; i < _end; ++i)
+			{
+				count += isStaticTransparentVisible(i);
+			}
+			return count;
+		},
+		[this, &_sortView, &isStaticTransparentVisible, staticBegin, instances, keys, order](uint32_t _begin, uint32_t _end, uint32_t _writeIdx)
 		{
-			uint32_t transformIdxBegin = globalTransformIdx;
-			KT_ASSERT((transformIdxBegin + numInstancesForThisBatch) <= (1 << PATHOS_INSTANCE_ID_REMAP_BITS)); // if we hit this, change bit allocations or break into batches.
-			KT_ASSERT((subMeshGpuOffset + mesh.m_subMeshes.Size()) <= (1 << PATHOS_SUBMESH_ID_REMAP_BITS));
-			
-			drawArgs->m_baseVertex = 0; // This is completely useless with manual vertex fetch, because SV_VertexID does not take it into account.
-			drawArgs->m_indexStart = subMesh.m_indexBufferStartOffset + mesh.m_unifiedBufferIndexOffset;
-			drawArgs->m_indicesPerInstance = subMesh.m_numIndices;
-			drawArgs->m_instanceCount = numInstancesForThisBatch;
-			drawArgs->m_startInstance = globalInstanceIndex;
-			++drawArgs;
-
-			uint32_t instancesToWrite = numInstancesForThisBatch;
-
-			do
+			_writeIdx += staticBegin;
+
+			for (uint32_t i = _begin; i < _end; ++i)
 			{
-				*instanceIdx_meshIdxWrite++ = (transformIdxBegin++) | (subMeshGpuOffset << PATHOS_SUBMESH_ID_REMAP_SHIFT);
-			} while (--instancesToWrite);
+				if (!isStaticTransparentVisible(i))
+				{
+					continue;
+				}
+
+				uint32_t const aabbIdx = m_staticTransparentAABBIdx[i];
+				SubmeshInstance instance = m_staticTransparentInstances[i];
+				gfx::Mesh const& mesh = *ResourceManager::GetMesh(instance.m_mesh);
+				instance.m_lod = InstanceLod(*m_instanceTable, instance.m_slot, mesh);
+
+				kt::Vec3 const center(m_staticAABBs.m_centerX[aabbIdx], m_staticAABBs.m_centerY[aabbIdx], m_staticAABBs.m_centerZ[aabbIdx]);
+
+				instances[_writeIdx] = instance;
+				keys[_writeIdx] = SubMeshSortKey(_sortView, mesh, instance.m_subMeshIdx, instance.m_lod, center);
+				order[_writeIdx] = _writeIdx;
+				++_writeIdx;
+			}
+		}
+	);
+
+	{
+		uint64_t* tempKeys = (uint64_t*)frameAllocator->Alloc(sizeof(uint64_t) * maxSubmeshInstances);
+		uint32_t* tempOrder = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * maxSubmeshInstances);
+		RadixSortKeys64(keys, order, tempKeys, tempOrder, numVisible);
+	}
+
+	m_batchesBuiltThisFrame = BuildBatches(_ctx, keys, instances, order, numVisible, m_indirectArgsBuf, m_instanceIdx_MeshIdx_Buf, m_ranges);
+}
+
+uint32_t MeshRenderer::BuildBatches
+(
+	gpu::cmd::Context* _ctx,
+	uint64_t const* _sortedKeys,
+	SubmeshInstance const* _instances,
+	uint32_t const* _sortedOrder,
+	uint32_t _num,
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+	gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx,
+	BucketRanges& o_ranges
+)
+{
+	o_ranges = BucketRanges{};
 
-			globalInstanceIndex += numInstancesForThisBatch;
-			++subMeshGpuOffset;
+	if (!_num)
+	{
+		return 0;
+	}
+
+	auto sortedInstance = [_instances, _sortedOrder](uint32_t _sortedIdx) -> SubmeshInstance const&
+	{
+		return _instances[_sortedOrder ? _sortedOrder[_sortedIdx] : _sortedIdx];
+	};
+
+	auto startsDraw = [_sortedKeys, &sortedInstance](uint32_t _sortedIdx) -> bool
+	{
+		if (!_sortedIdx)
+		{
+			return true;
 		}
 
-		globalTransformIdx += numInstancesForThisBatch;
+		SubmeshInstance const& prev = sortedInstance(_sortedIdx - 1);
+		SubmeshInstance const& cur = sortedInstance(_sortedIdx);
+		return prev.m_mesh != cur.m_mesh || prev.m_subMeshIdx != cur.m_subMeshIdx || prev.m_lod != cur.m_lod || DrawSortKeyBucket(_sortedKeys[_sortedIdx - 1]) != DrawSortKeyBucket(_sortedKeys[_sortedIdx]);
+	};
+
+	// Draws are counted per chunk first, so chunks can write into disjoint parts of the buffers.
+	uint32_t const grain = s_parallelBatchBuild ? c_submeshGrainSize : _num;
+	uint32_t const numChunks = (_num + grain - 1) / grain;
+
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+	uint32_t* chunkFirstDraw = (uint32_t*)frameAllocator->Alloc(sizeof(uint32_t) * numChunks);
 
-		// Check sentinel.
-		if (!nextMeshIdx.IsValid())
+	core::jobs::ParallelFor(numChunks, 1, [&startsDraw, chunkFirstDraw, grain, _num](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
 		{
-			break;
+			uint32_t numDraws = 0;
+			uint32_t const end = kt::Min((chunkIdx + 1) * grain, _num);
+
+			for (uint32_t i = chunkIdx * grain; i < end; ++i)
+			{
+				numDraws += startsDraw(i);
+			}
+
+			chunkFirstDraw[chunkIdx] = numDraws;
 		}
+	});
+
+	uint32_t numDraws = 0;
+
+	for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		uint32_t const chunkDraws = chunkFirstDraw[chunkIdx];
+		chunkFirstDraw[chunkIdx] = numDraws;
+		numDraws += chunkDraws;
 	}
 
-	gpu::cmd::ResourceBarrier(_ctx, m_indirectArgsBuf.m_buffer, gpu::ResourceState::CopyDest);
+	uint8_t* drawBuckets = (uint8_t*)frameAllocator->Alloc(numDraws);
+
+	gpu::cmd::ResourceBarrier(_ctx, _instanceIdx_MeshIdx.m_buffer, gpu::ResourceState::CopyDest);
+	gpu::cmd::ResourceBarrier(_ctx, _indirectArgs.m_buffer, gpu::ResourceState::CopyDest);
+
+	uint32_t* instanceIdx_meshIdxWrite = _instanceIdx_MeshIdx.BeginUpdate(_ctx, _num);
+	gpu::IndexedDrawArguments* drawArgsWrite = _indirectArgs.BeginUpdate(_ctx, numDraws);
+
+	// A chunk that starts partway through a draw leaves it to the chunk that started it, which counts past its own end.
+	core::jobs::ParallelFor(numChunks, 1, [&startsDraw, &sortedInstance, _sortedKeys, chunkFirstDraw, drawBuckets, grain, _num, instanceIdx_meshIdxWrite, drawArgsWrite](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t chunkIdx = _begin; chunkIdx < _end; ++chunkIdx)
+		{
+			uint32_t const begin = chunkIdx * grain;
+			uint32_t const end = kt::Min(begin + grain, _num);
+
+			uint32_t drawIdx = chunkFirstDraw[chunkIdx];
+			gfx::Mesh const* mesh = ResourceManager::GetMesh(sortedInstance(begin).m_mesh);
+
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				SubmeshInstance const& instance = sortedInstance(i);
+
+				if (startsDraw(i))
+				{
+					mesh = ResourceManager::GetMesh(instance.m_mesh);
+					KT_ASSERT((mesh->m_gpuSubMeshDataOffset + mesh->m_subMeshes.Size()) <= (1 << PATHOS_SUBMESH_ID_REMAP_BITS));
+
+					uint32_t drawEnd = i + 1;
+					while (drawEnd < _num && !startsDraw(drawEnd))
+					{
+						++drawEnd;
+					}
+
+					uint32_t indexStart;
+					uint32_t numIndices;
+					mesh->GetSubMeshLodIndices(instance.m_subMeshIdx, instance.m_lod, indexStart, numIndices);
+
+					gpu::IndexedDrawArguments& drawArgs = drawArgsWrite[drawIdx];
+					drawArgs.m_baseVertex = 0; // This is completely useless with manual vertex fetch, because SV_VertexID does not take it into account.
+					drawArgs.m_indexStart = indexStart + mesh->m_unifiedBufferIndexOffset;
+					drawArgs.m_indicesPerInstance = numIndices;
+					drawArgs.m_instanceCount = drawEnd - i;
+					drawArgs.m_startInstance = i;
+
+					drawBuckets[drawIdx] = uint8_t(DrawSortKeyBucket(_sortedKeys[i]));
+					++drawIdx;
+				}
+
+				instanceIdx_meshIdxWrite[i] = instance.m_slot | ((mesh->m_gpuSubMeshDataOffset + instance.m_subMeshIdx) << PATHOS_SUBMESH_ID_REMAP_SHIFT);
+			}
+		}
+	});
 
 	gpu::cmd::FlushBarriers(_ctx);
-	m_indirectArgsBuf.Update(_ctx, drawArgsData.Data(), drawArgsData.Size());
-	m_instanceXformBuf.EndUpdate(_ctx);
-	m_instanceIdx_MeshIdx_Buf.EndUpdate(_ctx);
+	_indirectArgs.EndUpdate(_ctx);
+	_instanceIdx_MeshIdx.EndUpdate(_ctx);
 
-	gpu::cmd::ResourceBarrier(_ctx, m_indirectArgsBuf.m_buffer, gpu::ResourceState::IndirectArg);
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceXformBuf.m_buffer, gpu::ResourceState::ShaderResource);
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceIdx_MeshIdx_Buf.m_buffer, gpu::ResourceState::VertexBuffer);
+	gpu::cmd::ResourceBarrier(_ctx, _indirectArgs.m_buffer, gpu::ResourceState::IndirectArg);
+	gpu::cmd::ResourceBarrier(_ctx, _instanceIdx_MeshIdx.m_buffer, gpu::ResourceState::VertexBuffer);
 
-	m_batchesBuiltThisFrame = numBatches;
+	// Keys sort by bucket first, so each bucket's draws are contiguous.
+	for (uint32_t drawIdx = 0; drawIdx < numDraws; ++drawIdx)
+	{
+		uint32_t const bucket = drawBuckets[drawIdx];
+		KT_ASSERT(!o_ranges.m_numDraws[bucket] || o_ranges.m_firstDraw[bucket] + o_ranges.m_numDraws[bucket] == drawIdx);
+
+		if (!o_ranges.m_numDraws[bucket])
+		{
+			o_ranges.m_firstDraw[bucket] = drawIdx;
+		}
+
+		++o_ranges.m_numDraws[bucket];
+	}
+
+	return numDraws;
 }
 
-void MeshRenderer::BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers)
+void MeshRenderer::BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers, kt::Mat4 const& _viewProj, DepthPyramid const* _prevDepthPyramid)
 {
-	if (m_meshes.Size() == 0)
+	m_lateBatchesBuiltThisFrame = 0;
+	m_staticBatchesBuiltThisFrame = 0;
+
+	// Static instances go through the same gpu cull, their culling data is only built when they change.
+	m_numGPUCulledMeshInstances = m_meshes.Size() + m_staticGPUCullingData.Size();
+	m_numGPUCulledSubmeshes = m_numSubmeshesSubmittedThisFrame + m_numStaticGPUSubmeshes;
+
+	if (m_numGPUCulledSubmeshes == 0)
 	{
 		m_batchesBuiltThisFrame = 0;
 		return;
@@ -170,60 +788,116 @@ void MeshRenderer::BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingB
 
 	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::BuildMultiDrawBuffersGPU", GPU_PROFILE_COLOUR(0x00, 0x00, 0xff));
 
-	uint32_t const numMeshInstances = m_meshes.Size();
-
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceXformBuf.m_buffer, gpu::ResourceState::CopyDest);
 	gpu::cmd::ResourceBarrier(_ctx, _scratchCullBuffers.instanceCullingData.m_buffer, gpu::ResourceState::CopyDest);
 
-	shaderlib::InstanceData_Xform* xformWrite = m_instanceXformBuf.BeginUpdate(_ctx, numMeshInstances);
-	uint32_t* cullingDataWrite = _scratchCullBuffers.instanceCullingData.BeginUpdate(_ctx, m_numSubmeshesSubmittedThisFrame);
-
+	shaderlib::MeshInstanceCullData* cullingDataWrite = _scratchCullBuffers.instanceCullingData.BeginUpdate(_ctx, m_numGPUCulledMeshInstances);
 
-	for (uint32_t transformIdx = 0; transformIdx < m_meshes.Size(); ++transformIdx)
+	// Static records are kept across frames, but their lods change.
+	for (shaderlib::MeshInstanceCullData const& staticData : m_staticGPUCullingData)
 	{
-		gfx::Mesh const* mesh = gfx::ResourceManager::GetMesh(m_meshes[transformIdx]);
-		Matrix3x4 const& mtx = m_transforms3x4[transformIdx];
-
-		_mm_store_ps((float*)&xformWrite->row0, _mm_load_ps(mtx.data));
-		_mm_store_ps((float*)&xformWrite->row1, _mm_load_ps(mtx.data + 4));
-		_mm_store_ps((float*)&xformWrite->row2, _mm_load_ps(mtx.data + 8));
-		++xformWrite;
+		uint32_t const slot = staticData.packedInstance & PATHOS_INSTANCE_ID_REMAP_MASK;
+		*cullingDataWrite++ = shaderlib::MeshInstanceCullData{ staticData.packedInstance, staticData.firstSubmeshInstance, CullDataLod(*m_instanceTable, slot, staticData.lod, m_cullSmallInstances) };
+	}
 
-		uint32_t submeshIdx = mesh->m_gpuSubMeshDataOffset;
+	// Transforms are already resident in the instance table, only the slot and mesh of each instance go up. The cull shader expands them into submeshes.
+	uint32_t firstSubmeshInstance = m_numStaticGPUSubmeshes;
 
-		for (uint32_t j = 0; j < mesh->m_subMeshes.Size(); ++j)
-		{
-			*cullingDataWrite++ = transformIdx | (submeshIdx++ << PATHOS_SUBMESH_ID_REMAP_SHIFT);
-		}
+	for (uint32_t instanceIdx = 0; instanceIdx < m_meshes.Size(); ++instanceIdx)
+	{
+		gfx::Mesh const* mesh = gfx::ResourceManager::GetMesh(m_meshes[instanceIdx]);
+		uint32_t const slot = m_instanceSlots[instanceIdx];
+		*cullingDataWrite++ = shaderlib::MeshInstanceCullData{ slot | (mesh->m_gpuSubMeshDataOffset << PATHOS_SUBMESH_ID_REMAP_SHIFT), firstSubmeshInstance, CullDataLod(*m_instanceTable, slot, mesh->m_numLods - 1, m_cullSmallInstances) };
+		firstSubmeshInstance += mesh->m_subMeshes.Size();
 	}
 
 	gpu::cmd::FlushBarriers(_ctx);
-	m_instanceXformBuf.EndUpdate(_ctx);
 	_scratchCullBuffers.instanceCullingData.EndUpdate(_ctx);
 
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceXformBuf.m_buffer, gpu::ResourceState::ShaderResource);
 	gpu::cmd::ResourceBarrier(_ctx, _scratchCullBuffers.instanceCullingData.m_buffer, gpu::ResourceState::ShaderResource);
 
+	_scratchCullBuffers.lateCandidates.EnsureSize(_ctx, m_numGPUCulledSubmeshes, false);
+
+	shaderlib::CullingConstants constants = {};
+	constants.viewProj = _viewProj;
+	constants.numSubmeshInstances = m_numGPUCulledSubmeshes;
+	constants.numMeshInstances = m_numGPUCulledMeshInstances;
+	constants.cullPhase = PATHOS_CULL_PHASE_EARLY;
+
+	DepthPyramid const* depthPyramid = _prevDepthPyramid && _prevDepthPyramid->IsValid() ? _prevDepthPyramid : nullptr;
+	DispatchCullSubmeshes(_ctx, _scratchCullBuffers, constants, depthPyramid, m_indirectArgsBuf, m_instanceIdx_MeshIdx_Buf);
+
+	m_builtThisFrameOnGPU = true;
+	m_batchesBuiltThisFrame = m_numGPUCulledSubmeshes;
+}
+
+void MeshRenderer::BuildLateDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers, kt::Mat4 const& _viewProj, DepthPyramid const& _depthPyramid)
+{
+	m_lateBatchesBuiltThisFrame = 0;
+
+	if (!m_builtThisFrameOnGPU || !m_batchesBuiltThisFrame || !_depthPyramid.IsValid())
+	{
+		return;
+	}
+
+	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::BuildLateDrawBuffersGPU", GPU_PROFILE_COLOUR(0x00, 0x00, 0xff));
+
+	shaderlib::CullingConstants constants = {};
+	constants.viewProj = _viewProj;
+	constants.numSubmeshInstances = m_numGPUCulledSubmeshes;
+	constants.numMeshInstances = m_numGPUCulledMeshInstances;
+	constants.cullPhase = PATHOS_CULL_PHASE_LATE;
+
+	DispatchCullSubmeshes(_ctx, _scratchCullBuffers, constants, &_depthPyramid, m_lateIndirectArgsBuf, m_lateInstanceIdx_MeshIdx_Buf);
+
+	m_lateBatchesBuiltThisFrame = m_numGPUCulledSubmeshes;
+}
+
+void MeshRenderer::DispatchCullSubmeshes
+(
+	gpu::cmd::Context* _ctx,
+	GPUCullingBuffers& _scratchCullBuffers,
+	shaderlib::CullingConstants const& _constants,
+	DepthPyramid const* _depthPyramid,
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+	gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx
+)
+{
 	// Both of these are filled by gpu.
-	m_instanceIdx_MeshIdx_Buf.EnsureSize(_ctx, m_numSubmeshesSubmittedThisFrame, false);
-	m_indirectArgsBuf.EnsureSize(_ctx, m_numSubmeshesSubmittedThisFrame + 1, false); // +1 for counter
+	_instanceIdx_MeshIdx.EnsureSize(_ctx, m_numGPUCulledSubmeshes, false);
+	_indirectArgs.EnsureSize(_ctx, m_numGPUCulledSubmeshes + 1, false); // +1 for counter
 
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceIdx_MeshIdx_Buf.m_buffer, gpu::ResourceState::UnorderedAccess);
-	gpu::cmd::ResourceBarrier(_ctx, m_indirectArgsBuf.m_buffer, gpu::ResourceState::UnorderedAccess);
+	gpu::cmd::ResourceBarrier(_ctx, _instanceIdx_MeshIdx.m_buffer, gpu::ResourceState::UnorderedAccess);
+	gpu::cmd::ResourceBarrier(_ctx, _indirectArgs.m_buffer, gpu::ResourceState::UnorderedAccess);
+	gpu::cmd::ResourceBarrier(_ctx, _scratchCullBuffers.lateCandidates.m_buffer, gpu::ResourceState::UnorderedAccess);
 
-	gpu::DescriptorData srvs[3];
-	gpu::DescriptorData uavs[2];
+	shaderlib::CullingConstants constants = _constants;
+	constants.instanceOrigin = m_instanceTable->Origin();
+
+	gpu::DescriptorData srvs[4];
+	gpu::DescriptorData uavs[3];
 	gpu::DescriptorData cbvs[1];
 
 	srvs[0].Set(_scratchCullBuffers.instanceCullingData.m_buffer);
-	srvs[1].Set(m_instanceXformBuf.m_buffer);
+	srvs[1].Set(m_instanceTable->GpuBuffer());
 	srvs[2].Set(gfx::ResourceManager::GetUnifiedBuffers().m_submeshGpuBuf.m_buffer);
 
-	uavs[0].Set(m_indirectArgsBuf.m_buffer);
-	uavs[1].Set(m_instanceIdx_MeshIdx_Buf.m_buffer);
+	if (_depthPyramid)
+	{
+		srvs[3].Set(_depthPyramid->Texture());
+		constants.hizWidth = _depthPyramid->Width();
+		constants.hizHeight = _depthPyramid->Height();
+		constants.hizNumMips = _depthPyramid->NumMips();
+	}
+	else
+	{
+		srvs[3].SetNull();
+		constants.hizNumMips = 0;
+	}
+
+	uavs[0].Set(_indirectArgs.m_buffer);
+	uavs[1].Set(_instanceIdx_MeshIdx.m_buffer);
+	uavs[2].Set(_scratchCullBuffers.lateCandidates.m_buffer);
 
-	shaderlib::CullingConstants constants;
-	constants.numSubmeshInstances = m_numSubmeshesSubmittedThisFrame;
 	cbvs[0].Set(&constants, sizeof(constants));
 
 	gpu::cmd::SetComputeCBVTable(_ctx, cbvs, PATHOS_PER_BATCH_SPACE);
@@ -234,58 +908,117 @@ void MeshRenderer::BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingB
 	{
 		gpu::cmd::SetPSO(_ctx, gfx::ResourceManager::GetSharedResources().m_clearDrawCountPso);
 		gpu::cmd::Dispatch(_ctx, 1, 1, 1);
-		gpu::cmd::UAVBarrier(_ctx, m_indirectArgsBuf.m_buffer);
+		gpu::cmd::UAVBarrier(_ctx, _indirectArgs.m_buffer);
 	}
 
 	{
 		gpu::cmd::SetPSO(_ctx, gfx::ResourceManager::GetSharedResources().m_cullSubmeshPso);
-		gpu::cmd::Dispatch(_ctx, (m_numSubmeshesSubmittedThisFrame + 63) / 64, 1, 1);
+		gpu::cmd::Dispatch(_ctx, (m_numGPUCulledSubmeshes + 63) / 64, 1, 1);
 	}
 
-	gpu::cmd::ResourceBarrier(_ctx, m_indirectArgsBuf.m_buffer, gpu::ResourceState::IndirectArg);
-	gpu::cmd::ResourceBarrier(_ctx, m_instanceIdx_MeshIdx_Buf.m_buffer, gpu::ResourceState::ShaderResource);
+	// The late phase reads the candidates written here.
+	gpu::cmd::UAVBarrier(_ctx, _scratchCullBuffers.lateCandidates.m_buffer);
 
-	m_builtThisFrameOnGPU = true;
-	m_batchesBuiltThisFrame = m_numSubmeshesSubmittedThisFrame;
+	gpu::cmd::ResourceBarrier(_ctx, _indirectArgs.m_buffer, gpu::ResourceState::IndirectArg);
+	gpu::cmd::ResourceBarrier(_ctx, _instanceIdx_MeshIdx.m_buffer, gpu::ResourceState::ShaderResource);
 }
 
 
 void MeshRenderer::RenderInstances(gpu::cmd::Context* _ctx)
 {
-	if (!m_batchesBuiltThisFrame)
+	if (!m_batchesBuiltThisFrame && !m_staticBatchesBuiltThisFrame)
 	{
 		return;
 	}
 
 	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::RenderInstances", GPU_PROFILE_COLOUR(0x00, 0xff, 0xff));
 
-	gpu::cmd::SetVertexBuffer(_ctx, 0, m_instanceIdx_MeshIdx_Buf.m_buffer);
+	for (uint32_t bucket = 0; bucket < uint32_t(DrawBucket::Count); ++bucket)
+	{
+		RenderBucket(_ctx, DrawBucket(bucket));
+	}
+}
+
+void MeshRenderer::RenderBucket(gpu::cmd::Context* _ctx, DrawBucket _bucket)
+{
+	uint32_t const bucketIdx = uint32_t(_bucket);
+
+	if (m_builtThisFrameOnGPU)
+	{
+		if (_bucket == DrawBucket::Opaque && m_batchesBuiltThisFrame)
+		{
+			DrawFromBuffers(_ctx, m_indirectArgsBuf.m_buffer, m_instanceIdx_MeshIdx_Buf.m_buffer, 0, m_batchesBuiltThisFrame, true);
+		}
+
+		return;
+	}
+
+	if (m_staticBatchesBuiltThisFrame)
+	{
+		gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments> const& args = m_staticBatchesCulledThisFrame ? m_staticCulledIndirectArgsBuf : m_staticIndirectArgsBuf;
+		gfx::ResizableDynamicBufferT<uint32_t> const& ids = m_staticBatchesCulledThisFrame ? m_staticCulledInstanceIdx_MeshIdx_Buf : m_staticInstanceIdx_MeshIdx_Buf;
+		BucketRanges const& ranges = m_staticBatchesCulledThisFrame ? m_staticCulledRanges : m_staticRanges;
+
+		if (ranges.m_numDraws[bucketIdx])
+		{
+			DrawFromBuffers(_ctx, args.m_buffer, ids.m_buffer, ranges.m_firstDraw[bucketIdx], ranges.m_numDraws[bucketIdx], false);
+		}
+	}
+
+	if (m_batchesBuiltThisFrame && m_ranges.m_numDraws[bucketIdx])
+	{
+		DrawFromBuffers(_ctx, m_indirectArgsBuf.m_buffer, m_instanceIdx_MeshIdx_Buf.m_buffer, m_ranges.m_firstDraw[bucketIdx], m_ranges.m_numDraws[bucketIdx], false);
+	}
+}
+
+void MeshRenderer::RenderLateInstances(gpu::cmd::Context* _ctx)
+{
+	if (!m_lateBatchesBuiltThisFrame)
+	{
+		return;
+	}
+
+	GPU_PROFILE_SCOPE(_ctx, "MeshRenderer::RenderLateInstances", GPU_PROFILE_COLOUR(0x00, 0xff, 0xff));
+
+	DrawFromBuffers(_ctx, m_lateIndirectArgsBuf.m_buffer, m_lateInstanceIdx_MeshIdx_Buf.m_buffer, 0, m_lateBatchesBuiltThisFrame, true);
+}
+
+void MeshRenderer::DrawFromBuffers(gpu::cmd::Context* _ctx, gpu::BufferHandle _indirectArgs, gpu::BufferHandle _instanceIdx_MeshIdx, uint32_t _firstDraw, uint32_t _maxDraws, bool _countInBuffer)
+{
+	gpu::cmd::SetVertexBuffer(_ctx, 0, _instanceIdx_MeshIdx);
 
 	gpu::cmd::SetIndexBuffer(_ctx, gfx::ResourceManager::GetUnifiedBuffers().m_indexBufferRef);
 
 	gpu::DescriptorData viewDescriptors[1];
-	viewDescriptors[0].Set(m_instanceXformBuf.m_buffer);
+	viewDescriptors[0].Set(m_instanceTable->GpuBuffer());
 	gpu::cmd::SetGraphicsSRVTable(_ctx, viewDescriptors, PATHOS_PER_VIEW_SPACE);
 
-	if (m_builtThisFrameOnGPU)
+	if (_countInBuffer)
 	{
-		gpu::cmd::DrawIndexedInstancedIndirect(_ctx, m_indirectArgsBuf.m_buffer, sizeof(uint32_t), m_batchesBuiltThisFrame, m_indirectArgsBuf.m_buffer, 0);
+		// Gpu built, the draw count is stored before the arguments.
+		gpu::cmd::DrawIndexedInstancedIndirect(_ctx, _indirectArgs, sizeof(uint32_t), _maxDraws, _indirectArgs, 0);
 	}
 	else
 	{
-		gpu::cmd::DrawIndexedInstancedIndirect(_ctx, m_indirectArgsBuf.m_buffer, 0, m_batchesBuiltThisFrame);
+		gpu::cmd::DrawIndexedInstancedIndirect(_ctx, _indirectArgs, _firstDraw * sizeof(gpu::IndexedDrawArguments), _maxDraws);
 	}
 }
 
 
 void MeshRenderer::Clear()
 {
-	m_transforms3x4.Clear();
+	m_instanceSlots.Clear();
 	m_meshes.Clear();
 
 	m_batchesBuiltThisFrame = 0;
+	m_lateBatchesBuiltThisFrame = 0;
+	m_staticBatchesBuiltThisFrame = 0;
 	m_numSubmeshesSubmittedThisFrame = 0;
+	m_numGPUCulledMeshInstances = 0;
+	m_numGPUCulledSubmeshes = 0;
 	m_builtThisFrameOnGPU = false;
+	m_ranges = BucketRanges{};
+	m_cullStats = CullStats{};
 }
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <kt/Mat4.h>
+#include <kt/Vec4.h>
 
 #include <gpu/HandleRef.h>
 #include <gpu/CommandContext.h>
@@ -8,19 +9,30 @@
 #include <shaderlib/CullingShared.h>
 
 #include "ResourceManager.h"
+#include "Culling.h"
+#include "DrawSort.h"
 #include "Utils.h"
 
 namespace gfx
 {
 
+class OcclusionBuffer;
+class DepthPyramid;
+class InstanceTable;
+
 struct GPUCullingBuffers
 {
 	GPUCullingBuffers()
 	{
 		instanceCullingData.Init(gpu::BufferFlags::ShaderResource | gpu::BufferFlags::Dynamic, 4096, gpu::Format::Unknown, "Scratch Mesh/Instance Culling Buffer");
+		lateCandidates.Init(gpu::BufferFlags::UnorderedAccess | gpu::BufferFlags::Dynamic, 4096, gpu::Format::R32_Uint, "Scratch Late Cull Candidates");
 	}
 
-	gfx::ResizableDynamicBufferT<uint32_t> instanceCullingData;
+	// One per mesh instance, submesh instances are expanded on the gpu.
+	gfx::ResizableDynamicBufferT<shaderlib::MeshInstanceCullData> instanceCullingData;
+
+	// Written by the early cull phase, one per submesh instance.
+	gfx::ResizableDynamicBufferT<uint32_t> lateCandidates;
 };
 
 class MeshRenderer
@@ -28,33 +40,193 @@ class MeshRenderer
 public:
 	MeshRenderer();
 
-	void Submit(gfx::ResourceManager::MeshIdx _meshIdx, kt::Mat4 const& _mtx);
+	// Instances are submitted by slot in _instances, which must outlive the renderer. Each is drawn at its lod in the table.
+	// If _cullSmallInstances, static instances with InstanceTable::c_lodCulled set are skipped (submitted ones are expected to be skipped by the caller).
+	void Init(InstanceTable const& _instances, bool _cullSmallInstances = false);
+
+	void Submit(uint32_t _instanceSlot);
+
+	// Static instances are sorted and batched once here and kept across frames, until the next call.
+	// They are drawn along with whatever is submitted each frame, so shouldn't also be submitted.
+	// Transparent static submeshes are the exception, they're sorted by depth with the submitted ones every build.
+	// Mesh unified buffer offsets are baked in, so this must be called again after ResourceManager::CompactUnifiedBuffers.
+	void SetStaticInstances(uint32_t const* _instanceSlots, uint32_t _numInstances);
 
-	void BuildMultiDrawBuffersCPU(gpu::cmd::Context* _ctx);
+	// Submesh instances are sorted by their MakeDrawSortKey against _sortView, then batched into a draw range per DrawBucket.
+	// If _numCullPlanes is non zero, submesh instances outside the planes are not drawn.
+	// Submesh instances that pass are then tested against _occlusion (if set), which must already be rasterized.
+	void BuildMultiDrawBuffersCPU(gpu::cmd::Context* _ctx, DrawSortView const& _sortView, kt::Vec4 const* _cullPlanes = nullptr, uint32_t _numCullPlanes = 0, OcclusionBuffer const* _occlusion = nullptr);
 
-	void BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers);
+	// Grows the buffers BuildMultiDrawBuffersCPU writes to fit everything submitted, growing creates buffers on the device.
+	// Call on the main thread after submitting, so the build can then be recorded into a gpu::cmd::CommandStream on any thread.
+	void ReserveMultiDrawBuffersCPU(gpu::cmd::Context* _ctx);
 
+	// Early phase of two phase occlusion culling: frustum culls and tests against _prevDepthPyramid (last frame's depth, if set).
+	// Submesh instances that look occluded are remembered for BuildLateDrawBuffersGPU.
+	void BuildMultiDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers, kt::Mat4 const& _viewProj, DepthPyramid const* _prevDepthPyramid = nullptr);
+
+	// Late phase: retests what the early phase rejected against _depthPyramid, built from the depth of RenderInstances.
+	// Anything that passes is drawn by RenderLateInstances.
+	void BuildLateDrawBuffersGPU(gpu::cmd::Context* _ctx, GPUCullingBuffers& _scratchCullBuffers, kt::Mat4 const& _viewProj, DepthPyramid const& _depthPyramid);
+
+	// Draws every bucket, in bucket order.
 	void RenderInstances(gpu::cmd::Context* _ctx);
 
+	// Draws a single bucket, so each can be drawn with its own pso.
+	// Gpu built batches aren't split by bucket, they're all drawn with DrawBucket::Opaque.
+	void RenderBucket(gpu::cmd::Context* _ctx, DrawBucket _bucket);
+
+	void RenderLateInstances(gpu::cmd::Context* _ctx);
+
+	bool HasLateInstances() const { return m_lateBatchesBuiltThisFrame != 0; }
+
 	void Clear();
 
-	struct alignas(16) Matrix3x4
+	struct CullStats
 	{
-		float data[3 * 4];
+		uint32_t m_numTested = 0;
+		uint32_t m_numVisible = 0;
+		uint32_t m_numOccluded = 0;
+		float m_cpuTimeMs = 0.0f;
 	};
 
+	// Submesh instance culling stats from the last CPU build.
+	CullStats const& GetCullStats() const { return m_cullStats; }
+
+	// Draws of the submitted (and transparent static) submesh instances from the last CPU build, eg. to compare builds in benchmarks.
+	// Draw i covers m_instanceCount entries of the instance buffer from m_startInstance.
+	gpu::BufferHandle SortedIndirectArgsBuffer() const { return m_indirectArgsBuf.m_buffer; }
+	gpu::BufferHandle SortedInstanceIdx_MeshIdxBuffer() const { return m_instanceIdx_MeshIdx_Buf.m_buffer; }
+	uint32_t NumSortedDraws() const { return m_batchesBuiltThisFrame; }
+
 private:
+	// A submesh of an instance, what sort keys are built for.
+	struct SubmeshInstance
+	{
+		uint32_t m_slot;
+		gfx::ResourceManager::MeshIdx m_mesh;
+		uint16_t m_subMeshIdx;
+		uint16_t m_lod;
+	};
+
+	// Draws of each bucket, which are contiguous in sorted order.
+	struct BucketRanges
+	{
+		uint32_t m_firstDraw[uint32_t(DrawBucket::Count)] = {};
+		uint32_t m_numDraws[uint32_t(DrawBucket::Count)] = {};
+	};
 
+	// Writes the opaque and alpha tested static draws visible in _visibility (all if null), at their current lods.
+	uint32_t BuildStaticBatches
+	(
+		gpu::cmd::Context* _ctx,
+		uint8_t const* _visibility,
+		gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+		gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx,
+		BucketRanges& o_ranges
+	);
+
+	// Culls (if there are planes) and writes the visible opaque and alpha tested static draws.
+	// Returns visibility of m_staticAABBs for the transparent ones, or null if nothing was culled.
+	uint8_t const* BuildStaticBatchesCPU(gpu::cmd::Context* _ctx, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion);
+
+	// Culls, keys and sorts submitted submesh instances, along with the visible transparent static ones, then writes their draws.
+	void BuildSortedBatchesCPU(gpu::cmd::Context* _ctx, DrawSortView const& _sortView, kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion, uint8_t const* _staticVisibility);
+
+	// Writes draws for sorted submesh instances and returns the number of draws.
+	// A draw is started wherever the submesh, lod or bucket changes. The i'th sorted instance is _instances[_sortedOrder[i]], or _instances[i] if _sortedOrder is null.
+	uint32_t BuildBatches
+	(
+		gpu::cmd::Context* _ctx,
+		uint64_t const* _sortedKeys,
+		SubmeshInstance const* _instances,
+		uint32_t const* _sortedOrder,
+		uint32_t _num,
+		gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+		gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx,
+		BucketRanges& o_ranges
+	);
+
+	// Culls every submesh of every submitted instance, submesh j of instance i is at _submeshInstanceOffsets[i] + j in o_visible.
+	void CullSubmeshInstances(kt::Vec4 const* _cullPlanes, uint32_t _numCullPlanes, OcclusionBuffer const* _occlusion, uint32_t const* _submeshInstanceOffsets, uint8_t* o_visible);
+
+	void DispatchCullSubmeshes
+	(
+		gpu::cmd::Context* _ctx,
+		GPUCullingBuffers& _scratchCullBuffers,
+		shaderlib::CullingConstants const& _constants,
+		DepthPyramid const* _depthPyramid,
+		gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments>& _indirectArgs,
+		gfx::ResizableDynamicBufferT<uint32_t>& _instanceIdx_MeshIdx
+	);
+
+	// _firstDraw is ignored if _countInBuffer.
+	void DrawFromBuffers(gpu::cmd::Context* _ctx, gpu::BufferHandle _indirectArgs, gpu::BufferHandle _instanceIdx_MeshIdx, uint32_t _firstDraw, uint32_t _maxDraws, bool _countInBuffer);
+
+	InstanceTable const* m_instanceTable = nullptr;
+	bool m_cullSmallInstances = false;
+
+	// Submitted instance slots, and their meshes copied from the table.
+	kt::Array<uint32_t> m_instanceSlots;
 	kt::Array<gfx::ResourceManager::MeshIdx> m_meshes;
-	kt::Array<Matrix3x4> m_transforms3x4;
 
 	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments> m_indirectArgsBuf;
-	gfx::ResizableDynamicBufferT<shaderlib::InstanceData_Xform> m_instanceXformBuf;
 	gfx::ResizableDynamicBufferT<uint32_t> m_instanceIdx_MeshIdx_Buf;
 
+	// Draws found by the late gpu cull phase.
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments> m_lateIndirectArgsBuf;
+	gfx::ResizableDynamicBufferT<uint32_t> m_lateInstanceIdx_MeshIdx_Buf;
+
+	// Opaque and alpha tested static submesh instances, sorted by keys without depth as that changes with the view.
+	kt::Array<uint64_t> m_staticSortedKeys;
+	kt::Array<SubmeshInstance> m_staticSortedInstances;
+	kt::Array<uint32_t> m_staticSortedAABBIdx;
+
+	// Where each run of the same submesh in the same bucket starts in the sorted statics, with the end last.
+	// Runs are split by lod each build, as lods change without a resort.
+	kt::Array<uint32_t> m_staticRunBegins;
+
+	// Transparent static submesh instances, unsorted.
+	kt::Array<SubmeshInstance> m_staticTransparentInstances;
+	kt::Array<uint32_t> m_staticTransparentAABBIdx;
+
+	// World bounds of every static submesh instance.
+	kt::Array<float> m_staticAABBStorage;
+	CullingAABBs_SoA m_staticAABBs;
+
+	// Culling data of every static mesh instance, and their total submeshes, for the gpu path.
+	kt::Array<shaderlib::MeshInstanceCullData> m_staticGPUCullingData;
+	uint32_t m_numStaticGPUSubmeshes = 0;
+
+	// Every static submesh instance, built once after SetStaticInstances.
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments> m_staticIndirectArgsBuf;
+	gfx::ResizableDynamicBufferT<uint32_t> m_staticInstanceIdx_MeshIdx_Buf;
+	BucketRanges m_staticRanges;
+	uint32_t m_numStaticDraws = 0;
+	uint32_t m_staticBuffersLodVersion = 0;
+	bool m_staticBuffersBuilt = false;
+
+	// Static submesh instances that passed culling this frame.
+	gfx::ResizableDynamicBufferT<gpu::IndexedDrawArguments> m_staticCulledIndirectArgsBuf;
+	gfx::ResizableDynamicBufferT<uint32_t> m_staticCulledInstanceIdx_MeshIdx_Buf;
+	BucketRanges m_staticCulledRanges;
+
+	// Of m_indirectArgsBuf when built on the cpu.
+	BucketRanges m_ranges;
+
 	uint32_t m_numSubmeshesSubmittedThisFrame = 0;
 
+	// Submitted and static mesh instances, and their submesh instances, when culling on the gpu.
+	uint32_t m_numGPUCulledMeshInstances = 0;
+	uint32_t m_numGPUCulledSubmeshes = 0;
+
 	uint32_t m_batchesBuiltThisFrame = 0;
+	uint32_t m_lateBatchesBuiltThisFrame = 0;
+
+	uint32_t m_staticBatchesBuiltThisFrame = 0;
+	bool m_staticBatchesCulledThisFrame = false;
+
+	CullStats m_cullStats;
 
 	bool m_builtThisFrameOnGPU;
 };
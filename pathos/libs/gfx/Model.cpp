@@ -1,5 +1,7 @@
 #include "Model.h"
 
+#include <utility>
+
 #include <kt/Logging.h>
 #include <kt/FilePath.h>
 #include <kt/Serialization.h>
@@ -21,6 +23,15 @@ static TextureLoadFlags const c_normalTexLoadFlags		=	TextureLoadFlags::Normaliz
 static TextureLoadFlags const c_metalRoughTexLoadFlags	=	TextureLoadFlags::GenMips;
 static TextureLoadFlags const c_occlusionTexLoadFlags	=	TextureLoadFlags::GenMips;
 
+// Textures a model loads (and its cache keeps), in cache order.
+static Material::TextureType const c_modelTextureTypes[] = { Material::Albedo, Material::Normal, Material::MetallicRoughness, Material::Occlusion };
+
+// Grid cells along the largest axis of a submesh's bounds, for each simplified detail level.
+static uint32_t const c_lodGridCells[c_maxMeshLods - 1] = { 48, 20, 8 };
+
+// A simplified level is only kept if it has at most this fraction of the previous level's indices.
+static float const c_maxLodIndexRatio = 0.75f;
+
 
 gpu::VertexLayout Model::FullVertexLayout()
 {
@@ -175,8 +186,39 @@ static void GenMikktTangents(Mesh* _model, uint32_t _idxBegin, uint32_t _idxEnd)
 	KT_ASSERT(mikktOk);
 }
 
-static void LoadNodes(Model& io_model, cgltf_data* _data)
+static void LoadNodes(ParsedModel& io_model, cgltf_data* _data)
 {
+	// Depth first from each root, so parents always come before their children.
+	uint32_t* gltfToTransformIdx = (uint32_t*)KT_ALLOCA(sizeof(uint32_t) * _data->nodes_count);
+	cgltf_node** stack = (cgltf_node**)KT_ALLOCA(sizeof(cgltf_node*) * _data->nodes_count);
+	uint32_t stackSize = 0;
+
+	for (uint32_t i = 0; i < _data->nodes_count; ++i)
+	{
+		if (!_data->nodes[i].parent)
+		{
+			stack[stackSize++] = _data->nodes + i;
+		}
+	}
+
+	while (stackSize)
+	{
+		cgltf_node* gltfNode = stack[--stackSize];
+		uint32_t const gltfIdx = uint32_t(gltfNode - _data->nodes);
+
+		gltfToTransformIdx[gltfIdx] = io_model.m_transformNodes.Size();
+
+		Model::TransformNode& transformNode = io_model.m_transformNodes.PushBack();
+		transformNode.m_local = kt::Mat4::Identity();
+		transformNode.m_parent = gltfNode->parent ? gltfToTransformIdx[gltfNode->parent - _data->nodes] : UINT32_MAX;
+		cgltf_node_transform_local(gltfNode, transformNode.m_local.Data());
+
+		for (uint32_t childIdx = 0; childIdx < gltfNode->children_count; ++childIdx)
+		{
+			stack[stackSize++] = gltfNode->children[childIdx];
+		}
+	}
+
 	for (uint32_t i = 0; i < _data->nodes_count; ++i)
 	{
 		cgltf_node* gltfNode = _data->nodes + i;
@@ -190,16 +232,108 @@ static void LoadNodes(Model& io_model, cgltf_data* _data)
 		Model::Node& instance = io_model.m_nodes.PushBack();
 		instance.m_mtx = kt::Mat4::Identity();
 		instance.m_internalMeshIdx = uint32_t(gltfNode->mesh - _data->meshes);
+		instance.m_transformIdx = gltfToTransformIdx[i];
 		cgltf_node_transform_world(gltfNode, instance.m_mtx.Data());
 	}
 }
 
-static bool LoadMeshes(Model* _model, cgltf_data* _data, kt::Slice<ResourceManager::MaterialIdx> const& _materialIndicies)
+// Simplifies each submesh by vertex clustering: vertices snap to the first vertex found in their grid cell, and triangles that collapse are dropped.
+// Simplified indices are appended to m_indices and reuse the full detail vertices, so only the index range changes between levels.
+static void GenerateLods(Mesh& io_mesh)
+{
+	kt::Array<uint32_t> cellVertices;
+	kt::Array<uint32_t> lodIndices;
+
+	io_mesh.m_numLods = 1;
+
+	for (uint32_t subMeshIdx = 0; subMeshIdx < io_mesh.m_subMeshes.Size(); ++subMeshIdx)
+	{
+		Mesh::SubMesh& subMesh = io_mesh.m_subMeshes[subMeshIdx];
+		kt::AABB const& bounds = io_mesh.m_subMeshBoundingBoxes[subMeshIdx];
+		kt::Vec3 const size = bounds.m_max - bounds.m_min;
+		float const largestAxis = kt::Max(size.x, kt::Max(size.y, size.z));
+
+		uint32_t prevIndexStart = subMesh.m_indexBufferStartOffset;
+		uint32_t prevNumIndices = subMesh.m_numIndices;
+		uint32_t numLods = 1;
+
+		for (uint32_t lod = 1; lod < c_maxMeshLods; ++lod)
+		{
+			// Once a level isn't worth keeping, coarser grids won't be either.
+			if (numLods == lod && largestAxis > 0.0f)
+			{
+				uint32_t const numCells = c_lodGridCells[lod - 1];
+				float const cellScale = float(numCells) / largestAxis;
+
+				uint32_t dims[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					dims[axis] = kt::Min(uint32_t(size[axis] * cellScale) + 1, numCells);
+				}
+
+				cellVertices.Resize(dims[0] * dims[1] * dims[2]);
+				memset(cellVertices.Data(), 0xff, sizeof(uint32_t) * cellVertices.Size());
+
+				auto clusterVertex = [&io_mesh, &bounds, &cellVertices, &dims, cellScale](uint32_t _vtx) -> uint32_t
+				{
+					kt::Vec3 const local = (io_mesh.m_posStream[_vtx] - bounds.m_min) * cellScale;
+					uint32_t cell = 0;
+
+					for (uint32_t axis = 3; axis-- > 0;)
+					{
+						cell = cell * dims[axis] + kt::Min(uint32_t(kt::Max(local[axis], 0.0f)), dims[axis] - 1);
+					}
+
+					uint32_t& cellVtx = cellVertices[cell];
+					if (cellVtx == UINT32_MAX)
+					{
+						cellVtx = _vtx;
+					}
+
+					return cellVtx;
+				};
+
+				lodIndices.Clear();
+
+				// Always clustered from full detail, so errors don't build up level to level.
+				for (uint32_t i = subMesh.m_indexBufferStartOffset; i < subMesh.m_indexBufferStartOffset + subMesh.m_numIndices; i += 3)
+				{
+					uint32_t const a = clusterVertex(io_mesh.m_indices[i + 0]);
+					uint32_t const b = clusterVertex(io_mesh.m_indices[i + 1]);
+					uint32_t const c = clusterVertex(io_mesh.m_indices[i + 2]);
+
+					if (a != b && b != c && a != c)
+					{
+						lodIndices.PushBack(a);
+						lodIndices.PushBack(b);
+						lodIndices.PushBack(c);
+					}
+				}
+
+				if (lodIndices.Size() && lodIndices.Size() <= uint32_t(float(prevNumIndices) * c_maxLodIndexRatio))
+				{
+					prevIndexStart = io_mesh.m_indices.Size();
+					prevNumIndices = lodIndices.Size();
+					io_mesh.m_indices.Resize(prevIndexStart + prevNumIndices);
+					memcpy(io_mesh.m_indices.Data() + prevIndexStart, lodIndices.Data(), sizeof(uint32_t) * prevNumIndices);
+					++numLods;
+				}
+			}
+
+			subMesh.m_lodIndexBufferStartOffset[lod - 1] = prevIndexStart;
+			subMesh.m_lodNumIndices[lod - 1] = prevNumIndices;
+		}
+
+		io_mesh.m_numLods = kt::Max(io_mesh.m_numLods, numLods);
+	}
+}
+
+static bool LoadMeshes(ParsedModel& io_model, cgltf_data* _data)
 {
 	for (cgltf_size gltfMeshIdx = 0; gltfMeshIdx < _data->meshes_count; ++gltfMeshIdx)
 	{
-		_model->m_meshes.PushBack(gfx::ResourceManager::CreateMesh());
-		gfx::Mesh& mesh = *gfx::ResourceManager::GetMesh(_model->m_meshes.Back());
+		ParsedModel::ParsedMesh& parsedMesh = io_model.m_meshes.PushBack();
+		gfx::Mesh& mesh = parsedMesh.m_mesh;
 		cgltf_mesh& gltfMesh = _data->meshes[gltfMeshIdx];
 		
 		if (gltfMesh.name)
@@ -208,7 +342,7 @@ static bool LoadMeshes(Model* _model, cgltf_data* _data, kt::Slice<ResourceManag
 		}
 		else
 		{
-			mesh.m_name.AppendFmt("%s_mesh%u", _model->m_name.c_str(), uint32_t(gltfMeshIdx));
+			mesh.m_name.AppendFmt("%s_mesh%u", io_model.m_name.c_str(), uint32_t(gltfMeshIdx));
 		}
 
 		for (cgltf_size primIdx = 0; primIdx < gltfMesh.primitives_count; ++primIdx)
@@ -225,13 +359,12 @@ static bool LoadMeshes(Model* _model, cgltf_data* _data, kt::Slice<ResourceManag
 
 			if (gltfPrim.material)
 			{
-				cgltf_size const materialIdx = gltfPrim.material - _data->materials;
-				subMesh.m_materialIdx = _materialIndicies[uint32_t(materialIdx)];
+				parsedMesh.m_subMeshMaterials.PushBack(uint32_t(gltfPrim.material - _data->materials));
 			}
 			else
 			{
 				// TODO: gltf specifies a default material in this case.
-				subMesh.m_materialIdx = ResourceManager::MaterialIdx{};
+				parsedMesh.m_subMeshMaterials.PushBack(UINT32_MAX);
 			}
 
 			subMesh.m_indexBufferStartOffset = mesh.m_indices.Size();
@@ -370,8 +503,10 @@ static bool LoadMeshes(Model* _model, cgltf_data* _data, kt::Slice<ResourceManag
 
 		for (kt::AABB const& aabb : mesh.m_subMeshBoundingBoxes)
 		{
-			mesh.m_boundingBox = kt::Union(_model->m_boundingBox, aabb);
+			mesh.m_boundingBox = kt::Union(mesh.m_boundingBox, aabb);
 		}
+
+		GenerateLods(mesh);
 	}
 
 	return true;
@@ -436,22 +571,68 @@ static void CreateStandaloneBuffers(Mesh* _m)
 }
 #endif
 
+void Mesh::GetSubMeshLodIndices(uint32_t _subMeshIdx, uint32_t _lod, uint32_t& o_indexStart, uint32_t& o_numIndices) const
+{
+	KT_ASSERT(_lod < m_numLods);
+	SubMesh const& subMesh = m_subMeshes[_subMeshIdx];
+
+	if (_lod == 0)
+	{
+		o_indexStart = subMesh.m_indexBufferStartOffset;
+		o_numIndices = subMesh.m_numIndices;
+	}
+	else
+	{
+		o_indexStart = subMesh.m_lodIndexBufferStartOffset[_lod - 1];
+		o_numIndices = subMesh.m_lodNumIndices[_lod - 1];
+	}
+}
+
+// Copies the coarsest detail level of every submesh and the vertices it uses into the occluder streams.
+static void BuildOccluderMesh(Mesh& io_mesh)
+{
+	io_mesh.m_occluderPositions.Clear();
+	io_mesh.m_occluderIndices.Clear();
+
+	kt::Array<uint32_t> remap;
+	remap.Resize(io_mesh.m_posStream.Size());
+	memset(remap.Data(), 0xff, sizeof(uint32_t) * remap.Size());
+
+	for (uint32_t subMeshIdx = 0; subMeshIdx < io_mesh.m_subMeshes.Size(); ++subMeshIdx)
+	{
+		uint32_t indexStart;
+		uint32_t numIndices;
+		io_mesh.GetSubMeshLodIndices(subMeshIdx, io_mesh.m_numLods - 1, indexStart, numIndices);
+
+		Mesh::SubMesh& subMesh = io_mesh.m_subMeshes[subMeshIdx];
+		subMesh.m_occluderIndexStartOffset = io_mesh.m_occluderIndices.Size();
+		subMesh.m_occluderNumIndices = numIndices;
+
+		for (uint32_t i = indexStart; i < indexStart + numIndices; ++i)
+		{
+			uint32_t const vtx = io_mesh.m_indices[i];
+			if (remap[vtx] == UINT32_MAX)
+			{
+				remap[vtx] = io_mesh.m_occluderPositions.Size();
+				io_mesh.m_occluderPositions.PushBack(io_mesh.m_posStream[vtx]);
+			}
+
+			io_mesh.m_occluderIndices.PushBack(remap[vtx]);
+		}
+	}
+}
+
 void Mesh::CreateGPUBuffers(bool _keepDataOnCpu)
 {
-	ResourceManager::WriteIntoUnifiedBuffers
-	(
-		(float const*)m_posStream.Data(),
-		(float const*)m_uvStream0.Data(),
-		m_tangentStream.Data(),
-		m_indices.Data(),
-		m_posStream.Size(),
-		m_indices.Size(),
-		&m_unifiedBufferIndexOffset,
-		&m_unifiedBufferVertexOffset
-	);
+	ResourceManager::WriteIntoUnifiedBuffers(*this);
 
 	ResourceManager::AddSubMeshGPUData(*this);
 
+	m_numVertices = m_posStream.Size();
+	m_numIndices = m_indices.Size();
+
+	BuildOccluderMesh(*this);
+
 	if (!_keepDataOnCpu)
 	{
 		m_posStream.ClearAndFree();
@@ -467,21 +648,33 @@ static ResourceManager::TextureIdx LoadTexture(char const* _path, TextureLoadFla
 	return ResourceManager::CreateTextureFromFile(_path, _loadFlags);
 }
 
-static ResourceManager::TextureIdx LoadTexture(char const* _gltfPath, char const* _imageUri, TextureLoadFlags _loadFlags)
+static TextureLoadFlags ModelTextureLoadFlags(Material::TextureType _type)
+{
+	switch (_type)
+	{
+		case Material::Albedo:				return c_albedoTexLoadFlags;
+		case Material::Normal:				return c_normalTexLoadFlags;
+		case Material::MetallicRoughness:	return c_metalRoughTexLoadFlags;
+		case Material::Occlusion:			return c_occlusionTexLoadFlags;
+		default:							KT_ASSERT(!"Unexpected model texture type."); return TextureLoadFlags::GenMips;
+	}
+}
+
+static void SetTexturePath(kt::StaticString<512>& o_path, char const* _gltfPath, char const* _imageUri)
 {
 	kt::FilePath path(_gltfPath);
 	path = path.GetPath();
 
 	path.Append(_imageUri);
 
-	return LoadTexture(path.Data(), _loadFlags);
+	o_path = path.Data();
 }
 
-static void LoadMaterials(Model* io_model, cgltf_data* _data, char const* _basePath, kt::Slice<ResourceManager::MaterialIdx> const& _materialIndicies)
+static void LoadMaterials(ParsedModel& io_model, cgltf_data* _data, char const* _basePath)
 {
 	for (uint32_t materialIdx = 0; materialIdx < _data->materials_count; ++materialIdx)
 	{
-		gfx::Material& modelMat = *ResourceManager::GetMaterial(_materialIndicies[materialIdx]);
+		ParsedModel::ParsedMaterial& modelMat = io_model.m_materials.PushBack();
 		cgltf_material const& gltfMat = _data->materials[materialIdx];
 
 		if (gltfMat.name)
@@ -490,7 +683,7 @@ static void LoadMaterials(Model* io_model, cgltf_data* _data, char const* _baseP
 		}
 		else
 		{
-			modelMat.m_name.AppendFmt("%s_mat%u", io_model->m_name.c_str(), materialIdx);
+			modelMat.m_name.AppendFmt("%s_mat%u", io_model.m_name.c_str(), materialIdx);
 		}
 
 		if (gltfMat.has_pbr_metallic_roughness)
@@ -517,12 +710,12 @@ static void LoadMaterials(Model* io_model, cgltf_data* _data, char const* _baseP
 			// TOdo: Transform
 			if (pbrMetalRough.base_color_texture.texture)
 			{
-				modelMat.m_textures[Material::Albedo] = LoadTexture(_basePath, pbrMetalRough.base_color_texture.texture->image->uri, c_albedoTexLoadFlags);
+				SetTexturePath(modelMat.m_texturePaths[Material::Albedo], _basePath, pbrMetalRough.base_color_texture.texture->image->uri);
 			}
 
 			if (pbrMetalRough.metallic_roughness_texture.texture)
 			{
-				modelMat.m_textures[Material::MetallicRoughness] = LoadTexture(_basePath, pbrMetalRough.metallic_roughness_texture.texture->image->uri, c_metalRoughTexLoadFlags);
+				SetTexturePath(modelMat.m_texturePaths[Material::MetallicRoughness], _basePath, pbrMetalRough.metallic_roughness_texture.texture->image->uri);
 			}
 			
 		}
@@ -533,56 +726,35 @@ static void LoadMaterials(Model* io_model, cgltf_data* _data, char const* _baseP
 
 		if (gltfMat.normal_texture.texture)
 		{
-			modelMat.m_textures[Material::Normal] = LoadTexture(_basePath, gltfMat.normal_texture.texture->image->uri, c_normalTexLoadFlags);
+			SetTexturePath(modelMat.m_texturePaths[Material::Normal], _basePath, gltfMat.normal_texture.texture->image->uri);
 		}
 
 		if (gltfMat.occlusion_texture.texture)
 		{
-			modelMat.m_textures[Material::Occlusion] = LoadTexture(_basePath, gltfMat.occlusion_texture.texture->image->uri, TextureLoadFlags::GenMips);
+			SetTexturePath(modelMat.m_texturePaths[Material::Occlusion], _basePath, gltfMat.occlusion_texture.texture->image->uri);
 		}
 	}
 }
 
-void SerializeMaterial(kt::ISerializer* _s, Material& _mat)
+static void SerializeMaterial(kt::ISerializer* _s, ParsedModel::ParsedMaterial& io_mat)
 {
-	kt::Serialize(_s, _mat.m_params);
-	kt::Serialize(_s, _mat.m_name);
+	kt::Serialize(_s, io_mat.m_params);
+	kt::Serialize(_s, io_mat.m_name);
 
-	auto serializeTex = [&_s](ResourceManager::TextureIdx& _handle, TextureLoadFlags _flags)
+	for (Material::TextureType texType : c_modelTextureTypes)
 	{
-		bool ok;
-		kt::StaticString<512> pathSerialize;
+		kt::StaticString<512>& path = io_mat.m_texturePaths[texType];
+		bool ok = !path.Empty();
+		kt::Serialize(_s, ok);
 
-		if (_s->SerializeMode() == kt::ISerializer::Mode::Read)
+		if (ok)
 		{
-			kt::Serialize(_s, ok);
-			if (ok)
-			{
-				kt::Serialize(_s, pathSerialize);
-				_handle = LoadTexture(pathSerialize.Data(), _flags);
-			}
+			kt::Serialize(_s, path);
 		}
-		else
-		{
-			gfx::Texture* tex = ResourceManager::GetTexture(_handle);
-			ok = tex != nullptr;
-			kt::Serialize(_s, ok);
-			if(ok)
-			{
-				pathSerialize = tex->m_path.c_str();
-				kt::Serialize(_s, pathSerialize);
-			}
-		}
-
-	};
-	
-	serializeTex(_mat.m_textures[Material::Albedo], c_albedoTexLoadFlags);
-	serializeTex(_mat.m_textures[Material::Normal], c_normalTexLoadFlags);
-	serializeTex(_mat.m_textures[Material::MetallicRoughness], c_metalRoughTexLoadFlags);
-	serializeTex(_mat.m_textures[Material::Occlusion], c_occlusionTexLoadFlags);
+	}
 }
 
-uint32_t constexpr c_modelCacheVersion = 10;
+uint32_t constexpr c_modelCacheVersion = 14;
 
 static void SerializeMesh(kt::ISerializer* _s, Mesh& _mesh)
 {
@@ -594,9 +766,10 @@ static void SerializeMesh(kt::ISerializer* _s, Mesh& _mesh)
 	kt::Serialize(_s, _mesh.m_subMeshes);
 	kt::Serialize(_s, _mesh.m_boundingBox);
 	kt::Serialize(_s, _mesh.m_subMeshBoundingBoxes);
+	kt::Serialize(_s, _mesh.m_numLods);
 }
 
-bool SerializeModelCache(char const* _initialPath, kt::ISerializer* _s, Model& _model, kt::Slice<ResourceManager::MaterialIdx> const* _matsToWrite = nullptr)
+static bool SerializeModelCache(char const* _initialPath, kt::ISerializer* _s, ParsedModel& io_model)
 {
 	uint32_t cache = c_modelCacheVersion;
 	kt::Serialize(_s, cache);
@@ -609,88 +782,137 @@ bool SerializeModelCache(char const* _initialPath, kt::ISerializer* _s, Model& _
 		}
 	}
 
-	// Do the easy stuff first.
-	kt::Serialize(_s, _model.m_boundingBox);
-	kt::Serialize(_s, _model.m_nodes);
+	bool const reading = _s->SerializeMode() == kt::ISerializer::Mode::Read;
 
-	struct MaterialRemapData
-	{
-		gfx::ResourceManager::MaterialIdx m_serializedIdx;
-		gfx::ResourceManager::MaterialIdx m_newIdx;
-	};
-	kt::Array<MaterialRemapData> remapData;
+	// Do the easy stuff first.
+	kt::Serialize(_s, io_model.m_boundingBox);
+	kt::Serialize(_s, io_model.m_transformNodes);
+	kt::Serialize(_s, io_model.m_nodes);
 
-	uint32_t materialSize = _matsToWrite ? _matsToWrite->Size() : 0;
+	// Submeshes refer to materials by handle in the cache. Parsed materials have none yet, so each is written with a made up one.
+	uint32_t materialSize = io_model.m_materials.Size();
 	kt::Serialize(_s, materialSize);
-	
-	// First, serialize material remapping data.
-	if (_s->SerializeMode() == kt::ISerializer::Mode::Write)
-	{
-		KT_ASSERT(_matsToWrite);
-		for (uint32_t i = 0; i < _matsToWrite->Size(); ++i)
-		{
-			ResourceManager::MaterialIdx matIdx = (*_matsToWrite)[i];
-			kt::Serialize(_s, matIdx);
-			SerializeMaterial(_s, *ResourceManager::GetMaterial(matIdx));
-		}
-	}
-	else
+
+	kt::Array<ResourceManager::MaterialIdx> serializedIndices;
+	serializedIndices.Resize(materialSize);
+
+	for (uint32_t i = 0; i < materialSize; ++i)
 	{
-		remapData.Resize(materialSize);
-		for (MaterialRemapData& remapMaterial : remapData)
-		{
-			kt::Serialize(_s, remapMaterial.m_serializedIdx);
-			remapMaterial.m_newIdx = ResourceManager::CreateMaterial();
-			gfx::Material* newMat = ResourceManager::GetMaterial(remapMaterial.m_newIdx);
-			SerializeMaterial(_s, *newMat);
-		}
+		ResourceManager::MaterialIdx& serializedIdx = serializedIndices[i];
+		serializedIdx = ResourceManager::MaterialIdx(i, 1);
+		kt::Serialize(_s, serializedIdx);
+		SerializeMaterial(_s, reading ? io_model.m_materials.PushBack() : io_model.m_materials[i]);
 	}
 
 	// Now serialize meshes.
-	uint32_t meshCount = _model.m_meshes.Size();
-
+	uint32_t meshCount = io_model.m_meshes.Size();
 	kt::Serialize(_s, meshCount);
 
-	if (_s->SerializeMode() == kt::ISerializer::Mode::Read)
+	for (uint32_t meshIdx = 0; meshIdx < meshCount; ++meshIdx)
 	{
-		_model.m_meshes.Resize(meshCount);
-		for (ResourceManager::MeshIdx& meshIdx : _model.m_meshes)
+		ParsedModel::ParsedMesh& parsedMesh = reading ? io_model.m_meshes.PushBack() : io_model.m_meshes[meshIdx];
+		Mesh& mesh = parsedMesh.m_mesh;
+
+		if (!reading)
+		{
+			for (uint32_t subMeshIdx = 0; subMeshIdx < mesh.m_subMeshes.Size(); ++subMeshIdx)
+			{
+				uint32_t const materialIdx = parsedMesh.m_subMeshMaterials[subMeshIdx];
+				mesh.m_subMeshes[subMeshIdx].m_materialIdx = materialIdx == UINT32_MAX ? ResourceManager::MaterialIdx{} : serializedIndices[materialIdx];
+			}
+		}
+
+		SerializeMesh(_s, mesh);
+
+		if (reading)
 		{
-			meshIdx = ResourceManager::CreateMesh();
-			gfx::Mesh& newMesh = *ResourceManager::GetMesh(meshIdx);
-			SerializeMesh(_s, newMesh);
-			// if we are reading, we need to remap submesh material indices.
-			for (gfx::Mesh::SubMesh& subMesh : newMesh.m_subMeshes)
+			// Back to indices into the parsed materials.
+			for (Mesh::SubMesh const& subMesh : mesh.m_subMeshes)
 			{
-				bool remapped = false;
-				for (MaterialRemapData const& remapMaterial : remapData)
+				uint32_t materialIdx = UINT32_MAX;
+				for (uint32_t i = 0; i < serializedIndices.Size(); ++i)
 				{
-					if (remapMaterial.m_serializedIdx == subMesh.m_materialIdx)
+					if (serializedIndices[i] == subMesh.m_materialIdx)
 					{
-						remapped = true;
-						subMesh.m_materialIdx = remapMaterial.m_newIdx;
+						materialIdx = i;
 						break;
 					}
 				}
-				KT_ASSERT(remapped);
-			}
 
-			newMesh.CreateGPUBuffers();
+				KT_ASSERT(materialIdx != UINT32_MAX || !subMesh.m_materialIdx.IsValid());
+				parsedMesh.m_subMeshMaterials.PushBack(materialIdx);
+			}
 		}
+	}
+
+	return true;
+}
+
+bool Model::LoadFromGLTF(char const* _path)
+{
+	ParsedModel parsed;
+	bool const ok = parsed.LoadFromGLTF(_path);
+	CreateFromParsed(parsed);
+	return ok;
+}
+
+void Model::CreateFromParsed(ParsedModel& io_parsed)
+{
+	m_name = io_parsed.m_name;
+	m_transformNodes = io_parsed.m_transformNodes;
+	m_nodes = io_parsed.m_nodes;
+	m_boundingBox = io_parsed.m_boundingBox;
 
+	ResourceManager::MaterialIdx* materialIndices = (ResourceManager::MaterialIdx*)KT_ALLOCA(sizeof(ResourceManager::MaterialIdx) * io_parsed.m_materials.Size());
+
+	for (uint32_t i = 0; i < io_parsed.m_materials.Size(); ++i)
+	{
+		ParsedModel::ParsedMaterial const& parsedMat = io_parsed.m_materials[i];
+
+		materialIndices[i] = ResourceManager::CreateMaterial();
+		gfx::Material& mat = *ResourceManager::GetMaterial(materialIndices[i]);
+		mat.m_params = parsedMat.m_params;
+		mat.m_name = parsedMat.m_name;
+
+		for (Material::TextureType texType : c_modelTextureTypes)
+		{
+			if (!parsedMat.m_texturePaths[texType].Empty())
+			{
+				mat.m_textures[texType] = LoadTexture(parsedMat.m_texturePaths[texType].Data(), ModelTextureLoadFlags(texType));
+			}
+		}
 	}
-	else
+
+	for (ParsedModel::ParsedMesh& parsedMesh : io_parsed.m_meshes)
 	{
-		for (ResourceManager::MeshIdx& meshIdx : _model.m_meshes)
+		m_meshes.PushBack(ResourceManager::CreateMesh());
+		gfx::Mesh& mesh = *ResourceManager::GetMesh(m_meshes.Back());
+		mesh = std::move(parsedMesh.m_mesh);
+
+		for (uint32_t subMeshIdx = 0; subMeshIdx < mesh.m_subMeshes.Size(); ++subMeshIdx)
 		{
-			SerializeMesh(_s, *ResourceManager::GetMesh(meshIdx));
+			uint32_t const materialIdx = parsedMesh.m_subMeshMaterials[subMeshIdx];
+			Mesh::SubMesh& subMesh = mesh.m_subMeshes[subMeshIdx];
+
+			subMesh.m_materialIdx = materialIdx == UINT32_MAX ? ResourceManager::MaterialIdx{} : materialIndices[materialIdx];
+			if (subMesh.m_materialIdx.IsValid())
+			{
+				ResourceManager::AddRef(subMesh.m_materialIdx);
+			}
 		}
+
+		// Create gpu buffers and free data on cpu.
+		mesh.CreateGPUBuffers();
+	}
+
+	// Submeshes take their own references to materials, unused materials are freed here.
+	for (uint32_t i = 0; i < io_parsed.m_materials.Size(); ++i)
+	{
+		ResourceManager::Release(materialIndices[i]);
 	}
-	
-	return true;
 }
 
-bool Model::LoadFromGLTF(char const* _path)
+bool ParsedModel::LoadFromGLTF(char const* _path)
 {
 	m_name = _path;
 
@@ -741,21 +963,12 @@ bool Model::LoadFromGLTF(char const* _path)
 		return false;
 	}
 
-	kt::FilePath const path(_path);
-
-	ResourceManager::MaterialIdx* materialIndices = (ResourceManager::MaterialIdx*)KT_ALLOCA(sizeof(ResourceManager::MaterialIdx) * data->materials_count);
-
-	kt::Slice<ResourceManager::MaterialIdx> materialSlice = kt::MakeSlice(materialIndices, materialIndices + data->materials_count);
-
-	for (ResourceManager::MaterialIdx& materialIdx : materialSlice)
-	{
-		materialIdx = ResourceManager::CreateMaterial();
-	}
-
-	LoadMaterials(this, data, _path, materialSlice);
+	LoadMaterials(*this, data, _path);
 
-	if (!LoadMeshes(this, data, materialSlice))
+	if (!LoadMeshes(*this, data))
 	{
+		// Nothing is created from a partly loaded model.
+		m_meshes.Clear();
 		return false;
 	}
 
@@ -765,7 +978,7 @@ bool Model::LoadFromGLTF(char const* _path)
 
 	for (Model::Node const& node : m_nodes)
 	{
-		gfx::Mesh const& mesh = *gfx::ResourceManager::GetMesh(m_meshes[node.m_internalMeshIdx]);
+		gfx::Mesh const& mesh = m_meshes[node.m_internalMeshIdx].m_mesh;
 		m_boundingBox = kt::Union(mesh.m_boundingBox.Transformed(node.m_mtx), m_boundingBox);
 	}
 
@@ -783,16 +996,10 @@ bool Model::LoadFromGLTF(char const* _path)
 			KT_SCOPE_EXIT(fclose(file));
 			kt::FileWriter writer(file);
 			kt::ISerializer serializer(&writer, c_modelCacheVersion);
-			SerializeModelCache(_path, &serializer, *this, &materialSlice);
+			SerializeModelCache(_path, &serializer, *this);
 		}
 	}
 
-	// Create gpu buffers and free data on cpu.
-	for (ResourceManager::MeshIdx meshIdx : m_meshes)
-	{
-		ResourceManager::GetMesh(meshIdx)->CreateGPUBuffers();
-	}
-
 	return true;
 }
 
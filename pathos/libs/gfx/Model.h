@@ -9,6 +9,9 @@
 #include <gpu/HandleRef.h>
 
 #include "Scene.h"
+#include "ResourceManager.h"
+#include "Material.h"
+#include "RangeAllocator.h"
 
 namespace kt
 {
@@ -34,8 +37,19 @@ struct Mesh
 
 		uint32_t m_indexBufferStartOffset;
 		uint32_t m_numIndices;
+
+		// Simplified detail levels 1 to c_maxMeshLods - 1, also in m_indices. Levels the submesh couldn't be simplified to repeat the last one.
+		uint32_t m_lodIndexBufferStartOffset[c_maxMeshLods - 1] = {};
+		uint32_t m_lodNumIndices[c_maxMeshLods - 1] = {};
+
+		// Coarsest detail level, in m_occluderIndices.
+		uint32_t m_occluderIndexStartOffset = 0;
+		uint32_t m_occluderNumIndices = 0;
 	};
 
+	// Index range of a submesh at a detail level, 0 is full detail. _lod must be less than m_numLods.
+	void GetSubMeshLodIndices(uint32_t _subMeshIdx, uint32_t _lod, uint32_t& o_indexStart, uint32_t& o_numIndices) const;
+
 	kt::AABB m_boundingBox;
 	kt::String64 m_name;
 
@@ -48,12 +62,29 @@ struct Mesh
 	kt::Array<SubMesh> m_subMeshes;
 	kt::Array<kt::AABB> m_subMeshBoundingBoxes;
 
+	// Coarsest detail level of every submesh, kept on the cpu to rasterize as occluders (gfx::OcclusionBuffer) once the streams above are freed.
+	kt::Array<kt::Vec3> m_occluderPositions;
+	kt::Array<uint32_t> m_occluderIndices;
+
+	// Size of the streams when uploaded.
+	uint32_t m_numVertices = 0;
+	uint32_t m_numIndices = 0;
+
+	// Most detail levels of any submesh.
+	uint32_t m_numLods = 1;
+
 	uint32_t m_unifiedBufferIndexOffset;
 	uint32_t m_unifiedBufferVertexOffset;
 
 	uint32_t m_gpuSubMeshDataOffset;
+
+	RangeAllocator::Handle m_unifiedBufferIndexRange = RangeAllocator::c_invalidHandle;
+	RangeAllocator::Handle m_unifiedBufferVertexRange = RangeAllocator::c_invalidHandle;
+	RangeAllocator::Handle m_gpuSubMeshDataRange = RangeAllocator::c_invalidHandle;
 };
 
+struct ParsedModel;
+
 struct Model
 {
 	Model() = default;
@@ -62,14 +93,27 @@ struct Model
 
 	bool LoadFromGLTF(char const* _path);
 
+	// Creates the materials, textures and meshes of _parsed and uploads the meshes, taking their data. Main thread only.
+	void CreateFromParsed(ParsedModel& io_parsed);
+
 	std::string m_name;
 
 	kt::Array<ResourceManager::MeshIdx> m_meshes;
 
+	// Local transform of every gltf node, parents before children so they can go straight into a TransformHierarchy range.
+	struct TransformNode
+	{
+		kt::Mat4 m_local;
+		uint32_t m_parent;	// Index into m_transformNodes, UINT32_MAX for roots.
+	};
+
+	kt::Array<TransformNode> m_transformNodes;
+
 	struct Node
 	{
-		kt::Mat4 m_mtx;
+		kt::Mat4 m_mtx;	// Model space, at rest.
 		uint32_t m_internalMeshIdx;
+		uint32_t m_transformIdx;
 	};
 
 	kt::Array<Node> m_nodes;
@@ -77,5 +121,39 @@ struct Model
 	kt::AABB m_boundingBox;
 };
 
+// A model loaded from gltf (or its .cache) on the cpu only, nothing is created through ResourceManager so it can be loaded on any thread.
+struct ParsedModel
+{
+	bool LoadFromGLTF(char const* _path);
+
+	struct ParsedMaterial
+	{
+		Material::Params m_params = {};
+		kt::String64 m_name;
+
+		// Resolved image paths, empty for none.
+		kt::StaticString<512> m_texturePaths[Material::Num_TextureType];
+	};
+
+	struct ParsedMesh
+	{
+		// Submesh material handles aren't set, see m_subMeshMaterials.
+		Mesh m_mesh;
+
+		// Into m_materials for each submesh, UINT32_MAX for none.
+		kt::Array<uint32_t> m_subMeshMaterials;
+	};
+
+	std::string m_name;
+
+	kt::Array<ParsedMaterial> m_materials;
+	kt::Array<ParsedMesh> m_meshes;
+
+	kt::Array<Model::TransformNode> m_transformNodes;
+	kt::Array<Model::Node> m_nodes;
+
+	kt::AABB m_boundingBox = kt::AABB::FloatMax();
+};
+
 
 }
\ No newline at end of file
@@ -0,0 +1,469 @@
+#include "OcclusionBuffer.h"
+
+#include <immintrin.h>
+#include <string.h>
+#include <float.h>
+
+#include <kt/Timer.h>
+
+#include <core/CPU.h>
+#include <core/Jobs.h>
+#include <core/Memory.h>
+
+#include "Culling.h"
+
+namespace gfx
+{
+
+static uint32_t const c_setupOccludersPerJob = 4;
+static uint32_t const c_rasterTileRowsPerJob = 1;
+
+enum class EdgeType : uint8_t
+{
+	Left,		// Pixel centres right of the edge are inside.
+	Right,		// Pixel centres left of the edge are inside.
+	Horizontal	// Whole rows are inside or outside.
+};
+
+struct OcclusionBuffer::ScreenTriangle
+{
+	// Left/Right: the edge crosses row y at x = y * m_edgeSlope + m_edgeOffset.
+	// Horizontal: rows with y * m_edgeSlope + m_edgeOffset >= 0 are inside.
+	float m_edgeSlope[3];
+	float m_edgeOffset[3];
+	EdgeType m_edgeType[3];
+
+	// z = x * m_zDx + y * m_zDy + m_z0, in screen space.
+	float m_zDx;
+	float m_zDy;
+	float m_z0;
+	float m_zMax;
+
+	float m_minX;
+	float m_minY;
+	float m_maxX;
+	float m_maxY;
+
+	// Inclusive, m_tileMinY > m_tileMaxY if the triangle was rejected.
+	uint32_t m_tileMinX;
+	uint32_t m_tileMaxX;
+	uint32_t m_tileMinY;
+	uint32_t m_tileMaxY;
+};
+
+void OcclusionBuffer::Init(uint32_t _width, uint32_t _height)
+{
+	m_tilesX = (_width + c_tileWidth - 1) / c_tileWidth;
+	m_tilesY = (_height + c_tileHeight - 1) / c_tileHeight;
+	m_width = m_tilesX * c_tileWidth;
+	m_height = m_tilesY * c_tileHeight;
+
+	uint32_t const numTiles = m_tilesX * m_tilesY;
+	m_masks.Resize(numTiles * c_tileHeight);
+	m_zRef.Resize(numTiles);
+	m_zMask.Resize(numTiles);
+
+	BeginFrame(kt::Mat4::Identity());
+}
+
+void OcclusionBuffer::BeginFrame(kt::Mat4 const& _worldToClip)
+{
+	m_worldToClip = _worldToClip;
+
+	memset(m_masks.Data(), 0, m_masks.Size() * sizeof(uint32_t));
+
+	for (uint32_t tileIdx = 0; tileIdx < m_zRef.Size(); ++tileIdx)
+	{
+		m_zRef[tileIdx] = 1.0f;
+		m_zMask[tileIdx] = 0.0f;
+	}
+
+	m_occluders.Clear();
+	m_numQueuedTriangles = 0;
+	m_stats = Stats{};
+}
+
+void OcclusionBuffer::AddOccluder(kt::Mat4 const& _localToWorld, kt::Vec3 const* _positions, uint32_t const* _indices, uint32_t _numIndices)
+{
+	uint32_t const numTriangles = _numIndices / 3;
+	if (!numTriangles)
+	{
+		return;
+	}
+
+	Occluder& occluder = m_occluders.PushBack();
+	occluder.m_localToClip = kt::Mul(m_worldToClip, _localToWorld);
+	occluder.m_positions = _positions;
+	occluder.m_indices = _indices;
+	occluder.m_numIndices = numTriangles * 3;
+	occluder.m_firstTriangle = m_numQueuedTriangles;
+
+	m_numQueuedTriangles += numTriangles;
+
+	++m_stats.m_numOccluders;
+	m_stats.m_numTrianglesSubmitted += numTriangles;
+}
+
+bool OcclusionBuffer::IsEnabled() const
+{
+	return m_tilesX != 0 && CPUSupportsAVX2();
+}
+
+static __m128 TransformPoint(__m128 const _cols[4], kt::Vec3 const& _p)
+{
+	__m128 ret = _mm_add_ps(_mm_mul_ps(_cols[0], _mm_set1_ps(_p.x)), _cols[3]);
+	ret = _mm_add_ps(_mm_mul_ps(_cols[1], _mm_set1_ps(_p.y)), ret);
+	return _mm_add_ps(_mm_mul_ps(_cols[2], _mm_set1_ps(_p.z)), ret);
+}
+
+void OcclusionBuffer::SetupTriangles(Occluder const& _occluder, ScreenTriangle* o_tris) const
+{
+	float const* mtx = _occluder.m_localToClip.Data();
+	__m128 const cols[4] = { _mm_loadu_ps(mtx), _mm_loadu_ps(mtx + 4), _mm_loadu_ps(mtx + 8), _mm_loadu_ps(mtx + 12) };
+
+	float const width = float(m_width);
+	float const height = float(m_height);
+
+	for (uint32_t triIdx = 0; triIdx < _occluder.m_numIndices / 3; ++triIdx)
+	{
+		ScreenTriangle& tri = o_tris[triIdx];
+		tri.m_tileMinY = 1;
+		tri.m_tileMaxY = 0;
+
+		float x[3];
+		float y[3];
+		float z[3];
+		bool nearClipped = false;
+
+		for (uint32_t vtx = 0; vtx < 3; ++vtx)
+		{
+			alignas(16) float clip[4];
+			_mm_store_ps(clip, TransformPoint(cols, _occluder.m_positions[_occluder.m_indices[triIdx * 3 + vtx]]));
+
+			// No clipping, anything crossing the near plane just doesn't occlude.
+			if (clip[2] < 0.0f || clip[3] <= 0.0f)
+			{
+				nearClipped = true;
+				break;
+			}
+
+			float const rcpW = 1.0f / clip[3];
+			x[vtx] = (clip[0] * rcpW * 0.5f + 0.5f) * width;
+			y[vtx] = (0.5f - clip[1] * rcpW * 0.5f) * height;
+			z[vtx] = clip[2] * rcpW;
+		}
+
+		if (nearClipped)
+		{
+			continue;
+		}
+
+		// Screen space y is down, so front facing (clockwise) triangles have positive area.
+		float const area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (!(area > 0.0f))
+		{
+			continue;
+		}
+
+		tri.m_minX = kt::Min(x[0], kt::Min(x[1], x[2]));
+		tri.m_minY = kt::Min(y[0], kt::Min(y[1], y[2]));
+		tri.m_maxX = kt::Max(x[0], kt::Max(x[1], x[2]));
+		tri.m_maxY = kt::Max(y[0], kt::Max(y[1], y[2]));
+
+		if (tri.m_maxX < 0.0f || tri.m_maxY < 0.0f || tri.m_minX >= width || tri.m_minY >= height)
+		{
+			continue;
+		}
+
+		tri.m_zMax = kt::Max(z[0], kt::Max(z[1], z[2]));
+		if (tri.m_zMax >= 1.0f)
+		{
+			// Can't occlude anything within the far plane.
+			continue;
+		}
+
+		for (uint32_t edge = 0; edge < 3; ++edge)
+		{
+			uint32_t const next = edge == 2 ? 0 : edge + 1;
+
+			// Inside where a * x + b * y + c >= 0.
+			float const a = y[edge] - y[next];
+			float const b = x[next] - x[edge];
+			float const c = -(a * x[edge] + b * y[edge]);
+
+			if (a == 0.0f)
+			{
+				tri.m_edgeType[edge] = EdgeType::Horizontal;
+				tri.m_edgeSlope[edge] = b;
+				tri.m_edgeOffset[edge] = c;
+			}
+			else
+			{
+				tri.m_edgeType[edge] = a > 0.0f ? EdgeType::Left : EdgeType::Right;
+				tri.m_edgeSlope[edge] = -b / a;
+				tri.m_edgeOffset[edge] = -c / a;
+			}
+		}
+
+		float const rcpArea = 1.0f / area;
+		tri.m_zDx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * rcpArea;
+		tri.m_zDy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * rcpArea;
+		tri.m_z0 = z[0] - tri.m_zDx * x[0] - tri.m_zDy * y[0];
+
+		tri.m_tileMinX = uint32_t(kt::Max(tri.m_minX, 0.0f)) / c_tileWidth;
+		tri.m_tileMinY = uint32_t(kt::Max(tri.m_minY, 0.0f)) / c_tileHeight;
+		tri.m_tileMaxX = kt::Min(uint32_t(kt::Min(tri.m_maxX, width)) / c_tileWidth, m_tilesX - 1);
+		tri.m_tileMaxY = kt::Min(uint32_t(kt::Min(tri.m_maxY, height)) / c_tileHeight, m_tilesY - 1);
+	}
+}
+
+CORE_TARGET_AVX2_FMA void OcclusionBuffer::RasterizeTileRows(ScreenTriangle const* _tris, uint32_t _numTris, uint32_t _tileRowBegin, uint32_t _tileRowEnd)
+{
+	__m256i const allOnes = _mm256_set1_epi32(-1);
+	__m256 const rowCentres = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	__m256 const half = _mm256_set1_ps(0.5f);
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const tileWidth = _mm256_set1_ps(float(c_tileWidth));
+
+	for (uint32_t triIdx = 0; triIdx < _numTris; ++triIdx)
+	{
+		ScreenTriangle const& tri = _tris[triIdx];
+
+		uint32_t const tileRowBegin = kt::Max(tri.m_tileMinY, _tileRowBegin);
+		uint32_t const tileRowEnd = kt::Min(tri.m_tileMaxY + 1, _tileRowEnd);
+
+		for (uint32_t tileY = tileRowBegin; tileY < tileRowEnd; ++tileY)
+		{
+			float const rowTop = float(tileY * c_tileHeight);
+			__m256 const rowY = _mm256_add_ps(_mm256_set1_ps(rowTop), rowCentres);
+
+			// Covered pixels of each row are [spanStart, spanEnd).
+			__m256 spanStart = _mm256_set1_ps(-1e30f);
+			__m256 spanEnd = _mm256_set1_ps(1e30f);
+			__m256 rowInside = _mm256_castsi256_ps(allOnes);
+
+			for (uint32_t edge = 0; edge < 3; ++edge)
+			{
+				__m256 const v = _mm256_add_ps(_mm256_mul_ps(rowY, _mm256_set1_ps(tri.m_edgeSlope[edge])), _mm256_set1_ps(tri.m_edgeOffset[edge]));
+
+				switch (tri.m_edgeType[edge])
+				{
+					case EdgeType::Left:
+					{
+						spanStart = _mm256_max_ps(spanStart, _mm256_ceil_ps(_mm256_sub_ps(v, half)));
+					} break;
+
+					case EdgeType::Right:
+					{
+						spanEnd = _mm256_min_ps(spanEnd, _mm256_add_ps(_mm256_floor_ps(_mm256_sub_ps(v, half)), _mm256_set1_ps(1.0f)));
+					} break;
+
+					case EdgeType::Horizontal:
+					{
+						rowInside = _mm256_and_ps(rowInside, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+					} break;
+				}
+			}
+
+			float const tileMinY = kt::Max(rowTop, tri.m_minY);
+			float const tileMaxY = kt::Min(rowTop + float(c_tileHeight), tri.m_maxY);
+			float const zRow = tri.m_z0 + (tri.m_zDy > 0.0f ? tileMaxY : tileMinY) * tri.m_zDy;
+
+			for (uint32_t tileX = tri.m_tileMinX; tileX <= tri.m_tileMaxX; ++tileX)
+			{
+				float const tileLeft = float(tileX * c_tileWidth);
+				__m256 const tileLeftV = _mm256_set1_ps(tileLeft);
+
+				__m256i const start = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(spanStart, tileLeftV), zero), tileWidth));
+				__m256i const end = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(spanEnd, tileLeftV), zero), tileWidth));
+
+				// Bit i is pixel i of the row, shifts of 32 give zero so full and empty rows fall out naturally.
+				__m256i triMask = _mm256_andnot_si256(_mm256_sllv_epi32(allOnes, end), _mm256_sllv_epi32(allOnes, start));
+				triMask = _mm256_and_si256(triMask, _mm256_castps_si256(rowInside));
+
+				if (_mm256_testz_si256(triMask, triMask))
+				{
+					continue;
+				}
+
+				// Farthest point of the triangle's plane within the tile, conservative for an occluder.
+				float const tileMinX = kt::Max(tileLeft, tri.m_minX);
+				float const tileMaxX = kt::Min(tileLeft + float(c_tileWidth), tri.m_maxX);
+				float const zTri = kt::Min(zRow + (tri.m_zDx > 0.0f ? tileMaxX : tileMinX) * tri.m_zDx, tri.m_zMax);
+
+				uint32_t const tileIdx = tileY * m_tilesX + tileX;
+				float const zRef = m_zRef[tileIdx];
+
+				if (zTri >= zRef)
+				{
+					continue;
+				}
+
+				uint32_t* maskPtr = m_masks.Data() + tileIdx * c_tileHeight;
+				__m256i tileMask = _mm256_loadu_si256((__m256i const*)maskPtr);
+				float zMask = m_zMask[tileIdx];
+
+				// If the triangle is much nearer than the current layer, drop the layer (its pixels fall back to the reference depth)
+				// rather than merging and pushing the layer depth back.
+				if (zMask - zTri > zRef - zMask)
+				{
+					tileMask = _mm256_setzero_si256();
+					zMask = 0.0f;
+				}
+
+				tileMask = _mm256_or_si256(tileMask, triMask);
+				zMask = kt::Max(zMask, zTri);
+
+				if (_mm256_testc_si256(tileMask, allOnes))
+				{
+					// Fully covered, the layer becomes the new reference.
+					m_zRef[tileIdx] = zMask;
+					tileMask = _mm256_setzero_si256();
+					zMask = 0.0f;
+				}
+
+				_mm256_storeu_si256((__m256i*)maskPtr, tileMask);
+				m_zMask[tileIdx] = zMask;
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::RasterizeOccluders()
+{
+	if (!IsEnabled() || !m_numQueuedTriangles)
+	{
+		return;
+	}
+
+	kt::TimePoint const rasterStart = kt::TimePoint::Now();
+
+	ScreenTriangle* tris = (ScreenTriangle*)core::GetThreadFrameAllocator()->Alloc(sizeof(ScreenTriangle) * m_numQueuedTriangles);
+	uint32_t const numTris = m_numQueuedTriangles;
+
+	core::jobs::ParallelFor(m_occluders.Size(), c_setupOccludersPerJob, [this, tris](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t occluderIdx = _begin; occluderIdx < _end; ++occluderIdx)
+		{
+			SetupTriangles(m_occluders[occluderIdx], tris + m_occluders[occluderIdx].m_firstTriangle);
+		}
+	});
+
+	// Each job owns whole rows of tiles, so no synchronisation is needed and results match a serial raster.
+	core::jobs::ParallelFor(m_tilesY, c_rasterTileRowsPerJob, [this, tris, numTris](uint32_t _begin, uint32_t _end)
+	{
+		RasterizeTileRows(tris, numTris, _begin, _end);
+	});
+
+	for (uint32_t triIdx = 0; triIdx < numTris; ++triIdx)
+	{
+		m_stats.m_numTrianglesRasterized += tris[triIdx].m_tileMinY <= tris[triIdx].m_tileMaxY;
+	}
+
+	m_stats.m_rasterTimeMs = float((kt::TimePoint::Now() - rasterStart).Seconds() * 1000.0);
+}
+
+CORE_TARGET_AVX2_FMA bool OcclusionBuffer::IsVisible(kt::AABB const& _aabb) const
+{
+	if (!IsEnabled())
+	{
+		return true;
+	}
+
+	float const* mtx = m_worldToClip.Data();
+	__m128 const cols[4] = { _mm_loadu_ps(mtx), _mm_loadu_ps(mtx + 4), _mm_loadu_ps(mtx + 8), _mm_loadu_ps(mtx + 12) };
+
+	float const width = float(m_width);
+	float const height = float(m_height);
+
+	float minX = FLT_MAX;
+	float minY = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float maxY = -FLT_MAX;
+	float zNear = FLT_MAX;
+
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		kt::Vec3 const p((corner & 1) ? _aabb.m_max.x : _aabb.m_min.x, (corner & 2) ? _aabb.m_max.y : _aabb.m_min.y, (corner & 4) ? _aabb.m_max.z : _aabb.m_min.z);
+
+		alignas(16) float clip[4];
+		_mm_store_ps(clip, TransformPoint(cols, p));
+
+		if (clip[2] < 0.0f || clip[3] <= 0.0f)
+		{
+			// Crosses the near plane.
+			return true;
+		}
+
+		float const rcpW = 1.0f / clip[3];
+		float const x = (clip[0] * rcpW * 0.5f + 0.5f) * width;
+		float const y = (0.5f - clip[1] * rcpW * 0.5f) * height;
+
+		minX = kt::Min(minX, x);
+		minY = kt::Min(minY, y);
+		maxX = kt::Max(maxX, x);
+		maxY = kt::Max(maxY, y);
+		zNear = kt::Min(zNear, clip[2] * rcpW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+	{
+		return false;
+	}
+
+	// Every pixel the bounds touch.
+	uint32_t const pixelMinX = uint32_t(kt::Max(minX, 0.0f));
+	uint32_t const pixelMinY = uint32_t(kt::Max(minY, 0.0f));
+	uint32_t const pixelEndX = kt::Min(uint32_t(kt::Min(maxX, width)) + 1, m_width);
+	uint32_t const pixelEndY = kt::Min(uint32_t(kt::Min(maxY, height)) + 1, m_height);
+
+	__m256i const rowIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	for (uint32_t tileY = pixelMinY / c_tileHeight; tileY <= (pixelEndY - 1) / c_tileHeight; ++tileY)
+	{
+		int32_t const rowBegin = int32_t(pixelMinY) - int32_t(tileY * c_tileHeight);
+		int32_t const rowEnd = int32_t(pixelEndY) - int32_t(tileY * c_tileHeight);
+		__m256i const rowMask = _mm256_and_si256(_mm256_cmpgt_epi32(rowIndices, _mm256_set1_epi32(rowBegin - 1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(rowEnd), rowIndices));
+
+		for (uint32_t tileX = pixelMinX / c_tileWidth; tileX <= (pixelEndX - 1) / c_tileWidth; ++tileX)
+		{
+			uint32_t const tileIdx = tileY * m_tilesX + tileX;
+
+			if (zNear > m_zRef[tileIdx])
+			{
+				continue;
+			}
+
+			if (zNear > m_zMask[tileIdx])
+			{
+				// Hidden if every pixel it touches in this tile is in the layer.
+				uint32_t const colBegin = kt::Max(pixelMinX, tileX * c_tileWidth) - tileX * c_tileWidth;
+				uint32_t const colEnd = kt::Min(pixelEndX, (tileX + 1) * c_tileWidth) - tileX * c_tileWidth;
+				uint32_t const colBits = (colEnd == 32 ? UINT32_MAX : (1u << colEnd) - 1) & ~((1u << colBegin) - 1);
+
+				__m256i const rectMask = _mm256_and_si256(_mm256_set1_epi32(int32_t(colBits)), rowMask);
+				__m256i const tileMask = _mm256_loadu_si256((__m256i const*)(m_masks.Data() + tileIdx * c_tileHeight));
+
+				if (_mm256_testc_si256(tileMask, rectMask))
+				{
+					continue;
+				}
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+float OcclusionBuffer::PixelDepth(uint32_t _x, uint32_t _y) const
+{
+	KT_ASSERT(_x < m_width && _y < m_height);
+
+	uint32_t const tileIdx = (_y / c_tileHeight) * m_tilesX + _x / c_tileWidth;
+	uint32_t const row = m_masks[tileIdx * c_tileHeight + _y % c_tileHeight];
+	return (row & (1u << (_x % c_tileWidth))) ? m_zMask[tileIdx] : m_zRef[tileIdx];
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/AABB.h>
+#include <kt/Mat4.h>
+#include <kt/Vec3.h>
+
+namespace gfx
+{
+
+// Low resolution software depth buffer for occlusion culling on the cpu, after "Masked Software Occlusion Culling" (Hasselgren et al. 2016).
+// The screen is split into 32x8 pixel tiles. Each tile has a coverage mask (one 32 bit row per AVX2 lane) and two depths:
+// a reference depth that every pixel in the tile is at or in front of, and the farthest depth of the pixels set in the mask.
+// Once the mask is full it becomes the new reference, so each tile acts as one level of depth hierarchy above its pixels.
+// Depth is post projection z/w with 0 at the near plane. Requires AVX2, otherwise everything is treated as visible.
+class OcclusionBuffer
+{
+public:
+	static uint32_t constexpr c_tileWidth = 32;
+	static uint32_t constexpr c_tileHeight = 8;
+
+	struct Stats
+	{
+		uint32_t m_numOccluders = 0;
+		uint32_t m_numTrianglesSubmitted = 0;
+		uint32_t m_numTrianglesRasterized = 0;
+		float m_rasterTimeMs = 0.0f;
+	};
+
+	// Dimensions are rounded up to whole tiles.
+	void Init(uint32_t _width, uint32_t _height);
+
+	// Clears depth and any queued occluders. _worldToClip is used for all following occluders and tests.
+	void BeginFrame(kt::Mat4 const& _worldToClip);
+
+	// Queues an indexed triangle list for RasterizeOccluders. The data is referenced rather than copied.
+	// Only front faces (clockwise, matching the default raster state) are rasterized, triangles crossing the near plane are skipped.
+	void AddOccluder(kt::Mat4 const& _localToWorld, kt::Vec3 const* _positions, uint32_t const* _indices, uint32_t _numIndices);
+
+	// Rasterizes every queued occluder, spread over the job system by rows of tiles.
+	void RasterizeOccluders();
+
+	// False if _aabb is off screen or completely behind rasterized occluders. Thread safe once rasterized.
+	bool IsVisible(kt::AABB const& _aabb) const;
+
+	bool IsEnabled() const;
+
+	uint32_t Width() const { return m_width; }
+	uint32_t Height() const { return m_height; }
+
+	// Farthest depth the pixel could have, 1 if nothing is known (eg. for debug visualisation).
+	float PixelDepth(uint32_t _x, uint32_t _y) const;
+
+	Stats const& GetStats() const { return m_stats; }
+
+private:
+	struct Occluder
+	{
+		kt::Mat4 m_localToClip;
+		kt::Vec3 const* m_positions;
+		uint32_t const* m_indices;
+		uint32_t m_numIndices;
+		uint32_t m_firstTriangle;
+	};
+
+	struct ScreenTriangle;
+
+	void SetupTriangles(Occluder const& _occluder, ScreenTriangle* o_tris) const;
+	void RasterizeTileRows(ScreenTriangle const* _tris, uint32_t _numTris, uint32_t _tileRowBegin, uint32_t _tileRowEnd);
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_tilesX = 0;
+	uint32_t m_tilesY = 0;
+
+	kt::Mat4 m_worldToClip;
+
+	// Per tile, c_tileHeight rows of coverage bits each.
+	kt::Array<uint32_t> m_masks;
+	kt::Array<float> m_zRef;
+	kt::Array<float> m_zMask;
+
+	kt::Array<Occluder> m_occluders;
+	uint32_t m_numQueuedTriangles = 0;
+
+	Stats m_stats;
+};
+
+}
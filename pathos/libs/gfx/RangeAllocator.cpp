@@ -0,0 +1,383 @@
+#include "RangeAllocator.h"
+
+namespace gfx
+{
+
+static uint32_t SizeClass(uint32_t _size)
+{
+	KT_ASSERT(_size);
+	return kt::FloorLog2(_size);
+}
+
+void RangeAllocator::Init(uint32_t _capacity)
+{
+	m_blocks.Clear();
+	m_unusedBlocks.Clear();
+
+	for (uint32_t& head : m_binHeads)
+	{
+		head = c_null;
+	}
+
+	m_nonEmptyBins = 0;
+	m_firstPhys = c_null;
+	m_lastPhys = c_null;
+	m_capacity = 0;
+	m_used = 0;
+
+	Grow(_capacity);
+}
+
+void RangeAllocator::Grow(uint32_t _newCapacity)
+{
+	KT_ASSERT(_newCapacity >= m_capacity);
+	uint32_t const added = _newCapacity - m_capacity;
+	if (!added)
+	{
+		return;
+	}
+
+	if (m_lastPhys != c_null && m_blocks[m_lastPhys].m_isFree)
+	{
+		RemoveFree(m_lastPhys);
+		m_blocks[m_lastPhys].m_size += added;
+		InsertFree(m_lastPhys);
+	}
+	else
+	{
+		uint32_t const blockIdx = NewBlock();
+		Block& block = m_blocks[blockIdx];
+		block.m_offset = m_capacity;
+		block.m_size = added;
+		block.m_prevPhys = m_lastPhys;
+		block.m_nextPhys = c_null;
+
+		if (m_lastPhys != c_null)
+		{
+			m_blocks[m_lastPhys].m_nextPhys = blockIdx;
+		}
+		else
+		{
+			m_firstPhys = blockIdx;
+		}
+
+		m_lastPhys = blockIdx;
+		InsertFree(blockIdx);
+	}
+
+	m_capacity = _newCapacity;
+}
+
+RangeAllocator::Handle RangeAllocator::Alloc(uint32_t _size)
+{
+	if (!_size)
+	{
+		return c_invalidHandle;
+	}
+
+	uint32_t const firstBin = SizeClass(_size);
+	uint32_t found = c_null;
+
+	// Blocks in the requested size class may still be too small, so search that bin first.
+	for (uint32_t it = m_binHeads[firstBin]; it != c_null; it = m_blocks[it].m_nextFree)
+	{
+		if (m_blocks[it].m_size >= _size)
+		{
+			found = it;
+			break;
+		}
+	}
+
+	if (found == c_null)
+	{
+		// Anything in a larger size class will fit.
+		uint32_t const largerBins = firstBin + 1 < c_numBins ? m_nonEmptyBins & ~((2u << firstBin) - 1) : 0;
+		if (!largerBins)
+		{
+			return c_invalidHandle;
+		}
+
+		uint32_t bin = firstBin + 1;
+		while (!(largerBins & (1u << bin)))
+		{
+			++bin;
+		}
+		found = m_binHeads[bin];
+	}
+
+	RemoveFree(found);
+
+	uint32_t const remainder = m_blocks[found].m_size - _size;
+
+	if (remainder)
+	{
+		uint32_t const splitIdx = NewBlock();
+
+		// NewBlock can reallocate m_blocks.
+		Block& block = m_blocks[found];
+		Block& split = m_blocks[splitIdx];
+
+		split.m_offset = block.m_offset + _size;
+		split.m_size = remainder;
+		split.m_prevPhys = found;
+		split.m_nextPhys = block.m_nextPhys;
+
+		if (block.m_nextPhys != c_null)
+		{
+			m_blocks[block.m_nextPhys].m_prevPhys = splitIdx;
+		}
+		else
+		{
+			m_lastPhys = splitIdx;
+		}
+
+		block.m_nextPhys = splitIdx;
+		block.m_size = _size;
+		InsertFree(splitIdx);
+	}
+
+	m_blocks[found].m_isFree = false;
+	m_used += _size;
+	return found;
+}
+
+void RangeAllocator::Free(Handle _handle)
+{
+	if (_handle == c_invalidHandle)
+	{
+		return;
+	}
+
+	KT_ASSERT(_handle < m_blocks.Size() && !m_blocks[_handle].m_isFree);
+
+	m_used -= m_blocks[_handle].m_size;
+
+	uint32_t blockIdx = _handle;
+
+	// Merge with previous.
+	uint32_t const prevIdx = m_blocks[blockIdx].m_prevPhys;
+	if (prevIdx != c_null && m_blocks[prevIdx].m_isFree)
+	{
+		RemoveFree(prevIdx);
+		Block& prev = m_blocks[prevIdx];
+		Block const& cur = m_blocks[blockIdx];
+		prev.m_size += cur.m_size;
+		prev.m_nextPhys = cur.m_nextPhys;
+
+		if (cur.m_nextPhys != c_null)
+		{
+			m_blocks[cur.m_nextPhys].m_prevPhys = prevIdx;
+		}
+		else
+		{
+			m_lastPhys = prevIdx;
+		}
+
+		ReleaseBlock(blockIdx);
+		blockIdx = prevIdx;
+	}
+
+	// Merge with next.
+	uint32_t const nextIdx = m_blocks[blockIdx].m_nextPhys;
+	if (nextIdx != c_null && m_blocks[nextIdx].m_isFree)
+	{
+		RemoveFree(nextIdx);
+		Block& cur = m_blocks[blockIdx];
+		Block const& next = m_blocks[nextIdx];
+		cur.m_size += next.m_size;
+		cur.m_nextPhys = next.m_nextPhys;
+
+		if (next.m_nextPhys != c_null)
+		{
+			m_blocks[next.m_nextPhys].m_prevPhys = blockIdx;
+		}
+		else
+		{
+			m_lastPhys = blockIdx;
+		}
+
+		ReleaseBlock(nextIdx);
+	}
+
+	InsertFree(blockIdx);
+}
+
+uint32_t RangeAllocator::Offset(Handle _handle) const
+{
+	KT_ASSERT(_handle < m_blocks.Size() && !m_blocks[_handle].m_isFree);
+	return m_blocks[_handle].m_offset;
+}
+
+uint32_t RangeAllocator::Size(Handle _handle) const
+{
+	KT_ASSERT(_handle < m_blocks.Size() && !m_blocks[_handle].m_isFree);
+	return m_blocks[_handle].m_size;
+}
+
+uint32_t RangeAllocator::LargestFreeBlock() const
+{
+	if (!m_nonEmptyBins)
+	{
+		return 0;
+	}
+
+	uint32_t bin = c_numBins - 1;
+	while (!(m_nonEmptyBins & (1u << bin)))
+	{
+		--bin;
+	}
+
+	uint32_t largest = 0;
+	for (uint32_t it = m_binHeads[bin]; it != c_null; it = m_blocks[it].m_nextFree)
+	{
+		largest = kt::Max(largest, m_blocks[it].m_size);
+	}
+
+	return largest;
+}
+
+float RangeAllocator::Fragmentation() const
+{
+	uint32_t const freeSize = FreeSize();
+	if (!freeSize)
+	{
+		return 0.0f;
+	}
+
+	return 1.0f - float(LargestFreeBlock()) / float(freeSize);
+}
+
+void RangeAllocator::Compact(kt::Array<Move>& o_moves)
+{
+	uint32_t writeOffset = 0;
+	uint32_t lastLive = c_null;
+
+	uint32_t it = m_firstPhys;
+	m_firstPhys = c_null;
+
+	while (it != c_null)
+	{
+		uint32_t const next = m_blocks[it].m_nextPhys;
+
+		if (m_blocks[it].m_isFree)
+		{
+			RemoveFree(it);
+			ReleaseBlock(it);
+		}
+		else
+		{
+			Block& block = m_blocks[it];
+			if (block.m_offset != writeOffset)
+			{
+				Move& move = o_moves.PushBack();
+				move.m_handle = it;
+				move.m_srcOffset = block.m_offset;
+				move.m_destOffset = writeOffset;
+				move.m_size = block.m_size;
+				block.m_offset = writeOffset;
+			}
+
+			block.m_prevPhys = lastLive;
+			block.m_nextPhys = c_null;
+
+			if (lastLive != c_null)
+			{
+				m_blocks[lastLive].m_nextPhys = it;
+			}
+			else
+			{
+				m_firstPhys = it;
+			}
+
+			lastLive = it;
+			writeOffset += block.m_size;
+		}
+
+		it = next;
+	}
+
+	KT_ASSERT(writeOffset == m_used);
+	m_lastPhys = lastLive;
+
+	// All remaining space is now a single block at the end.
+	uint32_t const capacity = m_capacity;
+	m_capacity = writeOffset;
+	Grow(capacity);
+}
+
+uint32_t RangeAllocator::NewBlock()
+{
+	uint32_t idx;
+	if (m_unusedBlocks.Size())
+	{
+		idx = m_unusedBlocks.Back();
+		m_unusedBlocks.PopBack();
+	}
+	else
+	{
+		idx = m_blocks.Size();
+		m_blocks.PushBack();
+	}
+
+	Block& block = m_blocks[idx];
+	block.m_prevFree = c_null;
+	block.m_nextFree = c_null;
+	block.m_isFree = false;
+	return idx;
+}
+
+void RangeAllocator::ReleaseBlock(uint32_t _blockIdx)
+{
+	m_blocks[_blockIdx].m_isFree = false;
+	m_unusedBlocks.PushBack(_blockIdx);
+}
+
+void RangeAllocator::InsertFree(uint32_t _blockIdx)
+{
+	Block& block = m_blocks[_blockIdx];
+	uint32_t const bin = SizeClass(block.m_size);
+
+	block.m_isFree = true;
+	block.m_prevFree = c_null;
+	block.m_nextFree = m_binHeads[bin];
+
+	if (m_binHeads[bin] != c_null)
+	{
+		m_blocks[m_binHeads[bin]].m_prevFree = _blockIdx;
+	}
+
+	m_binHeads[bin] = _blockIdx;
+	m_nonEmptyBins |= 1u << bin;
+}
+
+void RangeAllocator::RemoveFree(uint32_t _blockIdx)
+{
+	Block& block = m_blocks[_blockIdx];
+	KT_ASSERT(block.m_isFree);
+	uint32_t const bin = SizeClass(block.m_size);
+
+	if (block.m_prevFree != c_null)
+	{
+		m_blocks[block.m_prevFree].m_nextFree = block.m_nextFree;
+	}
+	else
+	{
+		KT_ASSERT(m_binHeads[bin] == _blockIdx);
+		m_binHeads[bin] = block.m_nextFree;
+		if (m_binHeads[bin] == c_null)
+		{
+			m_nonEmptyBins &= ~(1u << bin);
+		}
+	}
+
+	if (block.m_nextFree != c_null)
+	{
+		m_blocks[block.m_nextFree].m_prevFree = block.m_prevFree;
+	}
+
+	block.m_isFree = false;
+	block.m_prevFree = c_null;
+	block.m_nextFree = c_null;
+}
+
+}
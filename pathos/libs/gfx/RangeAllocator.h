@@ -0,0 +1,88 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+
+namespace gfx
+{
+
+// Segregated fit allocator for ranges of a linear resource (eg. the unified vertex/index buffers), in whatever units the user wants.
+// Free blocks are binned by power of two size class and coalesced with their neighbours when freed.
+// Only does bookkeeping - doesn't touch the resource itself.
+class RangeAllocator
+{
+public:
+	using Handle = uint32_t;
+	static Handle constexpr c_invalidHandle = UINT32_MAX;
+
+	struct Move
+	{
+		Handle m_handle;
+		uint32_t m_srcOffset;
+		uint32_t m_destOffset;
+		uint32_t m_size;
+	};
+
+	void Init(uint32_t _capacity);
+
+	// Adds free space to the end of the range.
+	void Grow(uint32_t _newCapacity);
+
+	// Returns c_invalidHandle if there is no free block large enough.
+	Handle Alloc(uint32_t _size);
+	void Free(Handle _handle);
+
+	uint32_t Offset(Handle _handle) const;
+	uint32_t Size(Handle _handle) const;
+
+	uint32_t Capacity() const { return m_capacity; }
+	uint32_t UsedSize() const { return m_used; }
+	uint32_t FreeSize() const { return m_capacity - m_used; }
+	uint32_t LargestFreeBlock() const;
+
+	// 0 when all free space is in one block, approaching 1 as free space is split into many small blocks.
+	float Fragmentation() const;
+
+	// Packs all allocations towards offset zero, keeping their order. Handles stay valid but their offsets change.
+	// o_moves receives every allocation that moved, in increasing address order. Anything before the first move is untouched.
+	void Compact(kt::Array<Move>& o_moves);
+
+private:
+	static uint32_t constexpr c_numBins = 32;
+	static uint32_t constexpr c_null = UINT32_MAX;
+
+	struct Block
+	{
+		uint32_t m_offset;
+		uint32_t m_size;
+
+		// Neighbours in address order.
+		uint32_t m_prevPhys;
+		uint32_t m_nextPhys;
+
+		// Neighbours in this blocks size class bin, if free.
+		uint32_t m_prevFree;
+		uint32_t m_nextFree;
+
+		bool m_isFree;
+	};
+
+	uint32_t NewBlock();
+	void ReleaseBlock(uint32_t _blockIdx);
+
+	void InsertFree(uint32_t _blockIdx);
+	void RemoveFree(uint32_t _blockIdx);
+
+	kt::Array<Block> m_blocks;
+	kt::Array<uint32_t> m_unusedBlocks;
+
+	uint32_t m_binHeads[c_numBins];
+	uint32_t m_nonEmptyBins = 0;
+
+	uint32_t m_firstPhys = c_null;
+	uint32_t m_lastPhys = c_null;
+
+	uint32_t m_capacity = 0;
+	uint32_t m_used = 0;
+};
+
+}
@@ -0,0 +1,51 @@
+#include "RenderView.h"
+#include "AABBTree.h"
+
+namespace gfx
+{
+
+void RenderView::Init(InstanceTable const& _instances, bool _cullSmallInstances)
+{
+	m_renderer.Init(_instances, _cullSmallInstances);
+	m_cachedRenderer.Init(_instances);
+}
+
+void RenderView::SetCullPlanes(kt::Vec4 const* _planes, uint32_t _numPlanes)
+{
+	KT_ASSERT(_numPlanes <= c_maxCullPlanes);
+	m_numCullPlanes = _numPlanes;
+
+	for (uint32_t i = 0; i < _numPlanes; ++i)
+	{
+		m_cullPlanes[i] = _planes[i];
+	}
+}
+
+void RenderView::Clear()
+{
+	m_renderer.Clear();
+	m_cachedRenderer.Clear();
+}
+
+void CullRenderViews(AABBTree const& _tree, RenderView* const* _views, uint32_t _numViews)
+{
+	KT_ASSERT(_numViews <= AABBTree::c_maxPlaneSets);
+
+	AABBTree::PlaneSet planeSets[AABBTree::c_maxPlaneSets];
+
+	for (uint32_t viewIdx = 0; viewIdx < _numViews; ++viewIdx)
+	{
+		planeSets[viewIdx] = AABBTree::PlaneSet{ _views[viewIdx]->m_cullPlanes, _views[viewIdx]->m_numCullPlanes };
+		_views[viewIdx]->m_visibleInstances.Clear();
+	}
+
+	_tree.QueryPlaneSets(planeSets, _numViews, [_views](uint32_t _instanceIdx, uint32_t _viewMask)
+	{
+		for (; _viewMask; _viewMask &= _viewMask - 1)
+		{
+			_views[kt::FloorLog2(_viewMask & (0u - _viewMask))]->m_visibleInstances.PushBack(_instanceIdx);
+		}
+	});
+}
+
+}
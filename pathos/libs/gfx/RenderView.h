@@ -0,0 +1,48 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/Vec4.h>
+
+#include "Camera.h"
+#include "DrawSort.h"
+#include "MeshRenderer.h"
+
+namespace gfx
+{
+
+class AABBTree;
+class InstanceTable;
+
+// A camera and what's drawn from it: the planes instances are culled against, the instances that passed, and the renderers their draws are built into.
+// Views are culled together by CullRenderViews, so another view (cascade, probe, split screen camera) adds plane tests to a shared traversal rather than another pass over the scene.
+struct RenderView
+{
+	static uint32_t constexpr c_maxCullPlanes = Camera::Num_FrustumPlane;
+
+	void Init(InstanceTable const& _instances, bool _cullSmallInstances = false);
+
+	// No planes keeps every instance.
+	void SetCullPlanes(kt::Vec4 const* _planes, uint32_t _numPlanes);
+
+	// Clears submitted instances of both renderers.
+	void Clear();
+
+	gfx::Camera m_camera;
+	DrawSortView m_sortView;
+
+	kt::Vec4 m_cullPlanes[c_maxCullPlanes];
+	uint32_t m_numCullPlanes = 0;
+
+	// Instances that may be visible (indices into Scene::m_modelInstances), from the last CullRenderViews.
+	kt::Array<uint32_t> m_visibleInstances;
+
+	MeshRenderer m_renderer;
+
+	// For draws into a cache that's only redrawn when invalidated (eg. static shadow casters), built and drawn separately.
+	MeshRenderer m_cachedRenderer;
+};
+
+// Fills every view's m_visibleInstances from one traversal of _tree, whose leaves hold instance indices. At most AABBTree::c_maxPlaneSets views.
+void CullRenderViews(AABBTree const& _tree, RenderView* const* _views, uint32_t _numViews);
+
+}
@@ -6,6 +6,7 @@
 #include <core/Memory.h>
 #include <core/FolderWatcher.h>
 #include <shaderlib/CommonShared.h>
+#include <shaderlib/DefinesShared.h>
 
 #include <kt/Strings.h>
 #include <kt/HashMap.h>
@@ -39,6 +40,94 @@ struct StdStringHashI
 };
 
 
+// Slot storage for generational handles. Freed slots are recycled through a free list with their version bumped.
+template <typename T>
+struct ResourcePool
+{
+	struct SlotInfo
+	{
+		uint32_t m_version = 1;
+		uint32_t m_refCount = 0;
+	};
+
+	void Reserve(uint32_t _capacity)
+	{
+		m_data.Reserve(_capacity);
+		m_slots.Reserve(_capacity);
+	}
+
+	Index<T> Alloc()
+	{
+		uint32_t slot;
+		if (m_freeList.Size())
+		{
+			slot = m_freeList.Back();
+			m_freeList.PopBack();
+		}
+		else
+		{
+			slot = m_data.Size();
+			m_data.PushBack();
+			m_slots.PushBack();
+		}
+
+		m_slots[slot].m_refCount = 1;
+		return Index<T>(slot, m_slots[slot].m_version);
+	}
+
+	bool IsLive(Index<T> _idx) const
+	{
+		uint32_t const slot = _idx.Slot();
+		return _idx.IsValid() && slot < m_slots.Size() && m_slots[slot].m_version == _idx.Version() && m_slots[slot].m_refCount;
+	}
+
+	T* Lookup(Index<T> _idx)
+	{
+		return IsLive(_idx) ? &m_data[_idx.Slot()] : nullptr;
+	}
+
+	void AddRef(Index<T> _idx)
+	{
+		KT_ASSERT(IsLive(_idx));
+		++m_slots[_idx.Slot()].m_refCount;
+	}
+
+	// Returns true if this was the last reference, in which case the caller must clean up and call Free().
+	bool Release(Index<T> _idx)
+	{
+		KT_ASSERT(IsLive(_idx));
+		return --m_slots[_idx.Slot()].m_refCount == 0;
+	}
+
+	void Free(Index<T> _idx)
+	{
+		uint32_t const slot = _idx.Slot();
+		KT_ASSERT(m_slots[slot].m_version == _idx.Version() && m_slots[slot].m_refCount == 0);
+
+		m_data[slot] = T{};
+		uint32_t const nextVersion = m_slots[slot].m_version + 1;
+		m_slots[slot].m_version = nextVersion > Index<T>::c_maxVersion ? 1 : nextVersion;
+		m_freeList.PushBack(slot);
+	}
+
+	template <typename FnT>
+	void ForEachLive(FnT&& _fn)
+	{
+		for (uint32_t slot = 0; slot < m_slots.Size(); ++slot)
+		{
+			if (m_slots[slot].m_refCount)
+			{
+				_fn(Index<T>(slot, m_slots[slot].m_version), m_data[slot]);
+			}
+		}
+	}
+
+	// Indexed by slot, includes free slots.
+	kt::Array<T> m_data;
+	kt::Array<SlotInfo> m_slots;
+	kt::Array<uint32_t> m_freeList;
+};
+
 struct State
 {
 	static uint32_t constexpr c_maxBindlessTextures = 1024;
@@ -47,16 +136,17 @@ struct State
 	using TextureCache = kt::HashMap<std::string, TextureIdx, StdStringHashI>;
 	using ShaderCache = kt::HashMap<std::string, gpu::ShaderRef, StdStringHashI>;
 
-	kt::Array<gfx::Mesh> m_meshes;
-	kt::Array<gfx::Model> m_models;
-	kt::Array<gfx::Texture> m_textures;
-	kt::Array<gfx::Material> m_materials;
+	ResourcePool<gfx::Mesh> m_meshes;
+	ResourcePool<gfx::Model> m_models;
+	ResourcePool<gfx::Texture> m_textures;
+	ResourcePool<gfx::Material> m_materials;
 
 	gpu::PersistentDescriptorTableRef m_bindlessTextureHandle;
 
 	SharedResources m_sharedResources;
 
 	// TODO: Doesn't handle different texture load flags (unlikely to be an issue for now).
+	// Entries for unloaded textures are left in place and fail IsLive, they are overwritten if the path is loaded again.
 	TextureCache m_loadedTextureCache;
 	ShaderCache m_shaderCache;
 
@@ -69,6 +159,9 @@ struct State
 	gpu::BufferRef m_counterBuffer;
 	uint32_t m_nextCounterIdx = 0;
 
+	// Set while models are being loaded, so compaction knows which state to leave new buffers in.
+	bool m_unifiedBuffersInCopyDest = false;
+
 	bool m_materialsDirty = false;
 } s_state;
 
@@ -104,6 +197,9 @@ static void InitSharedResources()
 	gpu::ShaderRef clearDrawCounterCs = ResourceManager::LoadShader("shaders/gpu_culling/ClearDrawCounter.cs.cso", gpu::ShaderType::Compute);
 	s_state.m_sharedResources.m_clearDrawCountPso = gpu::CreateComputePSO(clearDrawCounterCs, "Cull_ClearDrawCounter");
 
+	gpu::ShaderRef buildDepthPyramidCs = ResourceManager::LoadShader("shaders/gpu_culling/BuildDepthPyramid.cs.cso", gpu::ShaderType::Compute);
+	s_state.m_sharedResources.m_buildDepthPyramidPso = gpu::CreateComputePSO(buildDepthPyramidCs, "Cull_BuildDepthPyramid");
+
 	{
 		uint32_t const c_blackWhiteDim = 4;
 		uint32_t texels[c_blackWhiteDim * c_blackWhiteDim];
@@ -156,7 +252,7 @@ void Init()
 
 	s_state.m_bindlessTextureHandle = gpu::CreatePersistentDescriptorTable(State::c_maxBindlessTextures);
 
-	CreateMaterialGpuBuffer(s_state.m_materials.Capacity());
+	CreateMaterialGpuBuffer(s_state.m_materials.m_data.Capacity());
 
 	s_state.m_shaderWatcher = core::CreateFolderWatcher(kt::FilePath("shaders/"));
 
@@ -170,10 +266,11 @@ void Shutdown()
 
 void InitUnifiedBuffers(uint32_t _vertexCapacity /*= 2500000*/, uint32_t _indexCapacity /*= 2000000*/)
 {
-	s_state.m_unifiedBuffers.m_vertexCapacity = _vertexCapacity;
-	s_state.m_unifiedBuffers.m_indexCapacity = _indexCapacity;
-	s_state.m_unifiedBuffers.m_indexUsed = 0;
-	s_state.m_unifiedBuffers.m_vertexUsed = 0;
+	uint32_t constexpr c_initialSubMeshCapacity = 4096;
+
+	s_state.m_unifiedBuffers.m_vertexAllocator.Init(_vertexCapacity);
+	s_state.m_unifiedBuffers.m_indexAllocator.Init(_indexCapacity);
+	s_state.m_unifiedBuffers.m_subMeshAllocator.Init(c_initialSubMeshCapacity);
 
 	{
 		gpu::BufferDesc indexDesc;
@@ -208,7 +305,7 @@ void InitUnifiedBuffers(uint32_t _vertexCapacity /*= 2500000*/, uint32_t _indexC
 		s_state.m_unifiedBuffers.m_uv0VertexBuf = gpu::CreateBuffer(uvDesc, nullptr, "Unified Vertex Buffer (UV0)");
 	}
 
-	s_state.m_unifiedBuffers.m_submeshGpuBuf.Init(gpu::BufferFlags::ShaderResource | gpu::BufferFlags::Dynamic, 4096, gpu::Format::Unknown, "SubMesh_GPUData");
+	s_state.m_unifiedBuffers.m_submeshGpuBuf.Init(gpu::BufferFlags::ShaderResource | gpu::BufferFlags::Dynamic, c_initialSubMeshCapacity, gpu::Format::Unknown, "SubMesh_GPUData");
 }
 
 UnifiedBuffers const& GetUnifiedBuffers()
@@ -227,54 +324,51 @@ uint32_t AllocateCounterBufferIndex()
 	return s_state.m_nextCounterIdx++;
 }
 
-void WriteIntoUnifiedBuffers
-(
-	float const* _positions, 
-	float const* _uvs, 
-	gfx::TangentSpace const* _tangentSpace, 
-	uint32_t const* _indices, 
-	uint32_t _numVertices,
-	uint32_t _numIndices, 
-	uint32_t* o_idxOffset,
-	uint32_t* o_vtxOffset
-)
+static void TransitionUnifiedBuffers(gpu::cmd::Context* _ctx, bool _copyDest)
 {
-	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
 
-	GPU_PROFILE_SCOPE(ctx, "ResourceManager::WriteIntoUnifiedBuffers", GPU_PROFILE_COLOUR(0xff, 0x00, 0xff));
+	gpu::cmd::ResourceBarrier(_ctx, buffers.m_indexBufferRef, _copyDest ? gpu::ResourceState::CopyDest : gpu::ResourceState::IndexBuffer);
+	gpu::cmd::ResourceBarrier(_ctx, buffers.m_posVertexBuf, _copyDest ? gpu::ResourceState::CopyDest : gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, buffers.m_uv0VertexBuf, _copyDest ? gpu::ResourceState::CopyDest : gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, buffers.m_tangentSpaceVertexBuf, _copyDest ? gpu::ResourceState::CopyDest : gpu::ResourceState::ShaderResource);
+	gpu::cmd::ResourceBarrier(_ctx, buffers.m_submeshGpuBuf.m_buffer, _copyDest ? gpu::ResourceState::CopyDest : gpu::ResourceState::ShaderResource);
 
-	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
+	// TODO: Unecessary barriers if we load multiple models, unecessary flush. Barrier batching needs fixing.
+	gpu::cmd::FlushBarriers(_ctx);
+}
 
-	KT_ASSERT(buffers.m_indexUsed + _numIndices < buffers.m_indexCapacity);
-	KT_ASSERT(buffers.m_vertexUsed + _numVertices < buffers.m_vertexCapacity);
-	*o_idxOffset = buffers.m_indexUsed;
-	*o_vtxOffset = buffers.m_vertexUsed;
+static RangeAllocator::Handle AllocUnifiedRange(RangeAllocator& _allocator, uint32_t _size, char const* _bufferName)
+{
+	RangeAllocator::Handle handle = _allocator.Alloc(_size);
 
-	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_posVertexBuf, _positions, sizeof(float[3]) * _numVertices, buffers.m_vertexUsed * sizeof(float[3]));
-	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_uv0VertexBuf, _uvs, sizeof(float[2]) * _numVertices, buffers.m_vertexUsed * sizeof(float[2]));
-	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_tangentSpaceVertexBuf, _tangentSpace, sizeof(gfx::TangentSpace) * _numVertices, buffers.m_vertexUsed * sizeof(gfx::TangentSpace));
-	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_indexBufferRef, _indices, sizeof(uint32_t) * _numIndices, sizeof(uint32_t) * buffers.m_indexUsed); // TODO: 16 bit
+	if (handle == RangeAllocator::c_invalidHandle && _allocator.FreeSize() >= _size)
+	{
+		// Enough space in total, it's just fragmented.
+		CompactUnifiedBuffers();
+		handle = _allocator.Alloc(_size);
+	}
+
+	if (handle == RangeAllocator::c_invalidHandle)
+	{
+		KT_LOG_ERROR("Unified %s buffer out of space (requested %u, %u free of %u).", _bufferName, _size, _allocator.FreeSize(), _allocator.Capacity());
+		KT_ASSERT(false);
+	}
 
-	buffers.m_indexUsed += _numIndices;
-	buffers.m_vertexUsed += _numVertices;
+	return handle;
 }
 
-void AddSubMeshGPUData(gfx::Mesh& _mesh)
+static void WriteSubMeshGPUData(gpu::cmd::Context* _ctx, gfx::Mesh const& _mesh)
 {
-	uint32_t submeshesToAdd = _mesh.m_subMeshes.Size();
-	if (!submeshesToAdd)
+	uint32_t submeshesToWrite = _mesh.m_subMeshes.Size();
+	if (!submeshesToWrite)
 	{
 		return;
 	}
-	
-	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
-
-	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
 
-	_mesh.m_gpuSubMeshDataOffset = buffers.m_numSubMeshes;
+	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
 
-	shaderlib::GPUSubMeshData* dataWrite = buffers.m_submeshGpuBuf.BeginUpdateAtOffset(ctx, buffers.m_numSubMeshes, submeshesToAdd);
-	buffers.m_numSubMeshes += submeshesToAdd;
+	shaderlib::GPUSubMeshData* dataWrite = buffers.m_submeshGpuBuf.BeginUpdateAtOffset(_ctx, _mesh.m_gpuSubMeshDataOffset, submeshesToWrite);
 
 	gfx::Mesh::SubMesh const* subMeshRead = _mesh.m_subMeshes.Data();
 	kt::AABB const* aabbRead = _mesh.m_subMeshBoundingBoxes.Data();
@@ -283,10 +377,15 @@ void AddSubMeshGPUData(gfx::Mesh& _mesh)
 
 	do
 	{
-		dataWrite->materialIdx = subMeshRead->m_materialIdx.idx;
+		dataWrite->materialIdx = subMeshRead->m_materialIdx.Slot();
 		dataWrite->numIndices = subMeshRead->m_numIndices;
 		dataWrite->unifiedVertexBufferOffset = _mesh.m_unifiedBufferVertexOffset;
 		dataWrite->unifiedIndexBufferOffset = _mesh.m_unifiedBufferIndexOffset + subMeshRead->m_indexBufferStartOffset;
+		for (uint32_t lod = 0; lod < c_maxMeshLods - 1; ++lod)
+		{
+			dataWrite->lodUnifiedIndexBufferOffset[lod] = _mesh.m_unifiedBufferIndexOffset + subMeshRead->m_lodIndexBufferStartOffset[lod];
+			dataWrite->lodNumIndices[lod] = subMeshRead->m_lodNumIndices[lod];
+		}
 		memcpy(&dataWrite->bboxMin, &aabbRead->m_min, sizeof(float) * 3);
 		memcpy(&dataWrite->bboxMax, &aabbRead->m_max, sizeof(float) * 3);
 		dataWrite->bboxMin.w = 1.0f;
@@ -294,9 +393,191 @@ void AddSubMeshGPUData(gfx::Mesh& _mesh)
 
 		++dataWrite;
 		++subMeshRead;
-	} while (--submeshesToAdd);
+		++aabbRead;
+	} while (--submeshesToWrite);
+
+	buffers.m_submeshGpuBuf.EndUpdate(_ctx);
+}
+
+void WriteIntoUnifiedBuffers(gfx::Mesh& _mesh)
+{
+	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+
+	GPU_PROFILE_SCOPE(ctx, "ResourceManager::WriteIntoUnifiedBuffers", GPU_PROFILE_COLOUR(0xff, 0x00, 0xff));
+
+	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
+
+	uint32_t const numVertices = _mesh.m_posStream.Size();
+	uint32_t const numIndices = _mesh.m_indices.Size();
+
+	_mesh.m_unifiedBufferVertexRange = AllocUnifiedRange(buffers.m_vertexAllocator, numVertices, "vertex");
+	_mesh.m_unifiedBufferIndexRange = AllocUnifiedRange(buffers.m_indexAllocator, numIndices, "index");
+
+	if (_mesh.m_unifiedBufferVertexRange == RangeAllocator::c_invalidHandle || _mesh.m_unifiedBufferIndexRange == RangeAllocator::c_invalidHandle)
+	{
+		return;
+	}
+
+	// Read offsets after both allocations, the second may have compacted.
+	_mesh.m_unifiedBufferVertexOffset = buffers.m_vertexAllocator.Offset(_mesh.m_unifiedBufferVertexRange);
+	_mesh.m_unifiedBufferIndexOffset = buffers.m_indexAllocator.Offset(_mesh.m_unifiedBufferIndexRange);
+
+	uint32_t const vtxOffset = _mesh.m_unifiedBufferVertexOffset;
+	uint32_t const idxOffset = _mesh.m_unifiedBufferIndexOffset;
+
+	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_posVertexBuf, _mesh.m_posStream.Data(), sizeof(float[3]) * numVertices, vtxOffset * sizeof(float[3]));
+	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_uv0VertexBuf, _mesh.m_uvStream0.Data(), sizeof(float[2]) * numVertices, vtxOffset * sizeof(float[2]));
+	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_tangentSpaceVertexBuf, _mesh.m_tangentStream.Data(), sizeof(gfx::TangentSpace) * numVertices, vtxOffset * sizeof(gfx::TangentSpace));
+	gpu::cmd::UpdateDynamicBuffer(ctx, buffers.m_indexBufferRef, _mesh.m_indices.Data(), sizeof(uint32_t) * numIndices, sizeof(uint32_t) * idxOffset); // TODO: 16 bit
+}
+
+void AddSubMeshGPUData(gfx::Mesh& _mesh)
+{
+	uint32_t const numSubMeshes = _mesh.m_subMeshes.Size();
+	if (!numSubMeshes)
+	{
+		return;
+	}
+
+	RangeAllocator& allocator = s_state.m_unifiedBuffers.m_subMeshAllocator;
+
+	if (allocator.FreeSize() < numSubMeshes)
+	{
+		// The submesh buffer is resizable, it is grown on write.
+		allocator.Grow(kt::Max(allocator.Capacity() * 2, allocator.Capacity() + numSubMeshes));
+	}
 
-	buffers.m_submeshGpuBuf.EndUpdate(ctx);
+	_mesh.m_gpuSubMeshDataRange = AllocUnifiedRange(allocator, numSubMeshes, "submesh");
+	_mesh.m_gpuSubMeshDataOffset = allocator.Offset(_mesh.m_gpuSubMeshDataRange);
+	KT_ASSERT(_mesh.m_gpuSubMeshDataOffset + numSubMeshes <= (1 << PATHOS_SUBMESH_ID_REMAP_BITS));
+
+	WriteSubMeshGPUData(gpu::GetMainThreadCommandCtx(), _mesh);
+}
+
+static void FreeUnifiedBufferRanges(gfx::Mesh& _mesh)
+{
+	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
+
+	buffers.m_vertexAllocator.Free(_mesh.m_unifiedBufferVertexRange);
+	buffers.m_indexAllocator.Free(_mesh.m_unifiedBufferIndexRange);
+	buffers.m_subMeshAllocator.Free(_mesh.m_gpuSubMeshDataRange);
+
+	_mesh.m_unifiedBufferVertexRange = RangeAllocator::c_invalidHandle;
+	_mesh.m_unifiedBufferIndexRange = RangeAllocator::c_invalidHandle;
+	_mesh.m_gpuSubMeshDataRange = RangeAllocator::c_invalidHandle;
+}
+
+// Copies all live ranges of _buffer into a new buffer of the same size at their compacted offsets.
+// Copying into a new buffer rather than in place means no copy has an overlapping source and destination.
+static void RepackUnifiedBuffer(gpu::cmd::Context* _ctx, gpu::BufferRef& _buffer, uint32_t _stride, kt::Array<RangeAllocator::Move> const& _moves)
+{
+	KT_ASSERT(_moves.Size());
+
+	char const* name;
+	gpu::ResourceType ty;
+	gpu::BufferDesc desc;
+	gpu::GetResourceInfo(_buffer, ty, &desc, nullptr, &name);
+	gpu::BufferRef newBuffer = gpu::CreateBuffer(desc, nullptr, name);
+
+	gpu::cmd::ResourceBarrier(_ctx, _buffer, gpu::ResourceState::CopySrc);
+	gpu::cmd::ResourceBarrier(_ctx, newBuffer, gpu::ResourceState::CopyDest);
+	gpu::cmd::FlushBarriers(_ctx);
+
+	// Everything before the first move stayed where it was.
+	if (_moves[0].m_destOffset)
+	{
+		gpu::cmd::CopyBufferRegion(_ctx, newBuffer, 0, _buffer, 0, _moves[0].m_destOffset * _stride);
+	}
+
+	// Moves are in address order, so consecutive allocations shifted by the same amount become one copy.
+	uint32_t moveIdx = 0;
+	while (moveIdx < _moves.Size())
+	{
+		uint32_t const srcOffset = _moves[moveIdx].m_srcOffset;
+		uint32_t const destOffset = _moves[moveIdx].m_destOffset;
+		uint32_t size = _moves[moveIdx].m_size;
+
+		while (++moveIdx < _moves.Size() && _moves[moveIdx].m_srcOffset == srcOffset + size && _moves[moveIdx].m_destOffset == destOffset + size)
+		{
+			size += _moves[moveIdx].m_size;
+		}
+
+		gpu::cmd::CopyBufferRegion(_ctx, newBuffer, destOffset * _stride, _buffer, srcOffset * _stride, size * _stride);
+	}
+
+	_buffer = newBuffer;
+}
+
+void CompactUnifiedBuffers()
+{
+	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+
+	GPU_PROFILE_SCOPE(ctx, "ResourceManager::CompactUnifiedBuffers", GPU_PROFILE_COLOUR(0xff, 0x00, 0xff));
+
+	UnifiedBuffers& buffers = s_state.m_unifiedBuffers;
+
+	kt::Array<RangeAllocator::Move> moves(core::GetThreadFrameAllocator());
+
+	buffers.m_vertexAllocator.Compact(moves);
+	if (moves.Size())
+	{
+		RepackUnifiedBuffer(ctx, buffers.m_posVertexBuf, sizeof(float[3]), moves);
+		RepackUnifiedBuffer(ctx, buffers.m_uv0VertexBuf, sizeof(float[2]), moves);
+		RepackUnifiedBuffer(ctx, buffers.m_tangentSpaceVertexBuf, sizeof(gfx::TangentSpace), moves);
+	}
+
+	moves.Clear();
+	buffers.m_indexAllocator.Compact(moves);
+	if (moves.Size())
+	{
+		RepackUnifiedBuffer(ctx, buffers.m_indexBufferRef, sizeof(uint32_t), moves);
+	}
+
+	// Submesh data is rewritten from the meshes below, so there is nothing to copy.
+	moves.Clear();
+	buffers.m_subMeshAllocator.Compact(moves);
+
+	TransitionUnifiedBuffers(ctx, true);
+
+	// Meshes part way through loading may not have all of their ranges yet.
+	s_state.m_meshes.ForEachLive([ctx, &buffers](MeshIdx, gfx::Mesh& _mesh)
+	{
+		if (_mesh.m_unifiedBufferVertexRange != RangeAllocator::c_invalidHandle)
+		{
+			_mesh.m_unifiedBufferVertexOffset = buffers.m_vertexAllocator.Offset(_mesh.m_unifiedBufferVertexRange);
+		}
+
+		if (_mesh.m_unifiedBufferIndexRange != RangeAllocator::c_invalidHandle)
+		{
+			_mesh.m_unifiedBufferIndexOffset = buffers.m_indexAllocator.Offset(_mesh.m_unifiedBufferIndexRange);
+		}
+
+		if (_mesh.m_gpuSubMeshDataRange != RangeAllocator::c_invalidHandle)
+		{
+			_mesh.m_gpuSubMeshDataOffset = buffers.m_subMeshAllocator.Offset(_mesh.m_gpuSubMeshDataRange);
+			WriteSubMeshGPUData(ctx, _mesh);
+		}
+	});
+
+	++buffers.m_generation;
+
+	TransitionUnifiedBuffers(ctx, s_state.m_unifiedBuffersInCopyDest);
+}
+
+uint32_t UnifiedBuffersGeneration()
+{
+	return s_state.m_unifiedBuffers.m_generation;
+}
+
+static bool FileExists(char const* _path)
+{
+	FILE* f = fopen(_path, "rb");
+	if (!f)
+	{
+		return false;
+	}
+	fclose(f);
+	return true;
 }
 
 static kt::Array<uint8_t> ReadEntireFile(char const* _path)
@@ -350,17 +631,19 @@ void Update()
 		gpu::GetResourceInfo(s_state.m_materialGpuBuf, ty, &desc);
 
 		// ensure we have enough space.
+		uint32_t const numMaterialSlots = s_state.m_materials.m_data.Size();
 		uint32_t const gpuElementMax = desc.m_sizeInBytes / sizeof(shaderlib::MaterialData);
-		if (gpuElementMax < s_state.m_materials.Size())
+		if (gpuElementMax < numMaterialSlots)
 		{
-			CreateMaterialGpuBuffer(s_state.m_materials.Size() + s_state.m_materials.Size() / 4);
+			CreateMaterialGpuBuffer(numMaterialSlots + numMaterialSlots / 4);
 		}
 
 		gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
 
 		// TODO: We don't need to update everything if we just appended some materials, but whatever.
 
-		uint32_t const updateSize = s_state.m_materials.Size() * sizeof(shaderlib::MaterialData);
+		// Materials are indexed by slot on the gpu, free slots are written with default textures.
+		uint32_t const updateSize = numMaterialSlots * sizeof(shaderlib::MaterialData);
 		
 		gpu::cmd::ResourceBarrier(ctx, s_state.m_materialGpuBuf, gpu::ResourceState::CopyDest);
 		gpu::cmd::FlushBarriers(ctx);
@@ -368,10 +651,10 @@ void Update()
 
 		auto textureIdxOrDefault = [](gfx::ResourceManager::TextureIdx _myTexIdx, gfx::ResourceManager::TextureIdx _defaultTexIdx) -> uint32_t
 		{
-			return _myTexIdx.IsValid() ? uint32_t(_myTexIdx.idx) : uint32_t(_defaultTexIdx.idx);
+			return _myTexIdx.IsValid() ? _myTexIdx.Slot() : _defaultTexIdx.Slot();
 		};
 
-		for (gfx::Material const& mat : s_state.m_materials)
+		for (gfx::Material const& mat : s_state.m_materials.m_data)
 		{
 			gfx::Material::Params const& params = mat.m_params;
 
@@ -401,84 +684,107 @@ void Update()
 
 MeshIdx CreateMesh()
 {
-	MeshIdx const idx = MeshIdx(uint16_t(s_state.m_meshes.Size()));
-	s_state.m_meshes.PushBack();
-	return idx;
+	return s_state.m_meshes.Alloc();
 }
 
 gfx::Mesh* GetMesh(MeshIdx _idx)
 {
-	if (!_idx.IsValid())
+	return s_state.m_meshes.Lookup(_idx);
+}
+
+void AddRef(MeshIdx _idx)
+{
+	s_state.m_meshes.AddRef(_idx);
+}
+
+void Release(MeshIdx _idx)
+{
+	if (!_idx.IsValid() || !s_state.m_meshes.Release(_idx))
+	{
+		return;
+	}
+
+	gfx::Mesh& mesh = s_state.m_meshes.m_data[_idx.Slot()];
+	FreeUnifiedBufferRanges(mesh);
+
+	for (gfx::Mesh::SubMesh const& subMesh : mesh.m_subMeshes)
 	{
-		return nullptr;
+		Release(subMesh.m_materialIdx);
 	}
 
-	KT_ASSERT(_idx.idx < s_state.m_meshes.Size());
-	return &s_state.m_meshes[_idx.idx];
+	s_state.m_meshes.Free(_idx);
 }
 
 ModelIdx CreateModel()
 {
-	ModelIdx const idx = ModelIdx(uint16_t(s_state.m_meshes.Size()));
-	s_state.m_models.PushBack();
-	return idx;
+	return s_state.m_models.Alloc();
 }
 
 ModelIdx CreateModelFromGLTF(char const* _path)
+{
+	// A model that fails to load is still created, empty.
+	ParsedModel parsed;
+	parsed.LoadFromGLTF(_path);
+	return CreateModelFromParsed(parsed);
+}
+
+ModelIdx CreateModelFromParsed(ParsedModel& io_parsed)
 {
 	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
 
 	// For copying into unified buffers.
-	{
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_indexBufferRef, gpu::ResourceState::CopyDest);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_posVertexBuf, gpu::ResourceState::CopyDest);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_uv0VertexBuf, gpu::ResourceState::CopyDest);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_tangentSpaceVertexBuf, gpu::ResourceState::CopyDest);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_submeshGpuBuf.m_buffer, gpu::ResourceState::CopyDest);
-		gpu::cmd::FlushBarriers(ctx);
-	}
+	s_state.m_unifiedBuffersInCopyDest = true;
+	TransitionUnifiedBuffers(ctx, true);
 
-	ModelIdx const idx = ModelIdx(uint16_t(s_state.m_models.Size()));
-	s_state.m_models.PushBack().LoadFromGLTF(_path);
-	
-	{
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_indexBufferRef, gpu::ResourceState::IndexBuffer);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_posVertexBuf, gpu::ResourceState::ShaderResource);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_uv0VertexBuf, gpu::ResourceState::ShaderResource);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_tangentSpaceVertexBuf, gpu::ResourceState::ShaderResource);
-		gpu::cmd::ResourceBarrier(ctx, s_state.m_unifiedBuffers.m_submeshGpuBuf.m_buffer, gpu::ResourceState::ShaderResource);
+	ModelIdx const idx = CreateModel();
+	s_state.m_models.Lookup(idx)->CreateFromParsed(io_parsed);
 
-		// TODO: Unecessary barriers if we load multiple models, unecessary flush. Barrier batching needs fixing.
-		gpu::cmd::FlushBarriers(ctx);
-	}
+	s_state.m_unifiedBuffersInCopyDest = false;
+	TransitionUnifiedBuffers(ctx, false);
 
 	return idx;
 }
 
 gfx::Model* GetModel(ModelIdx _idx)
 {
-	if (!_idx.IsValid())
+	return s_state.m_models.Lookup(_idx);
+}
+
+void AddRef(ModelIdx _idx)
+{
+	s_state.m_models.AddRef(_idx);
+}
+
+void Release(ModelIdx _idx)
+{
+	if (!_idx.IsValid() || !s_state.m_models.Release(_idx))
 	{
-		return nullptr;
+		return;
 	}
 
-	KT_ASSERT(_idx.idx < s_state.m_models.Size());
-	return &s_state.m_models[_idx.idx];
+	for (MeshIdx meshIdx : s_state.m_models.m_data[_idx.Slot()].m_meshes)
+	{
+		Release(meshIdx);
+	}
+
+	s_state.m_models.Free(_idx);
 }
 
-kt::Slice<gfx::Model> GetAllModels()
+void EnumModels(kt::StaticFunction<void(ModelIdx, gfx::Model&), 32> const& _ftor)
 {
-	return kt::MakeSlice(s_state.m_models.Begin(), s_state.m_models.End());
+	s_state.m_models.ForEachLive(_ftor);
 }
 
-kt::Slice<gfx::Mesh> GetAllMeshes()
+void EnumMaterials(kt::StaticFunction<void(MaterialIdx, gfx::Material&), 32> const& _ftor)
 {
-	return kt::MakeSlice(s_state.m_meshes.Begin(), s_state.m_meshes.End());
+	s_state.m_materials.ForEachLive(_ftor);
 }
 
-kt::Slice<gfx::Material> GetAllMaterials()
+static TextureIdx AllocTextureSlot()
 {
-	return kt::MakeSlice(s_state.m_materials.Begin(), s_state.m_materials.End());
+	TextureIdx const idx = s_state.m_textures.Alloc();
+	KT_ASSERT(idx.Slot() < State::c_maxBindlessTextures);
+	return idx;
 }
 
 TextureIdx CreateTextureFromFile(char const* _fileName, TextureLoadFlags _flags /*= TextureLoadFlags::None*/)
@@ -486,40 +792,62 @@ TextureIdx CreateTextureFromFile(char const* _fileName, TextureLoadFlags _flags
 	// TODO: Unecessary string alloc/hash map lookup.
 	State::TextureCache::Iterator it = s_state.m_loadedTextureCache.Find(std::string(_fileName));
 
-	if (it != s_state.m_loadedTextureCache.End())
+	if (it != s_state.m_loadedTextureCache.End() && s_state.m_textures.IsLive(it->m_val))
 	{
+		s_state.m_textures.AddRef(it->m_val);
 		return it->m_val;
 	}
 
-	TextureIdx const idx = TextureIdx(uint16_t(s_state.m_textures.Size()));
-	Texture& tex = s_state.m_textures.PushBack();
+	TextureIdx const idx = AllocTextureSlot();
+	Texture& tex = *s_state.m_textures.Lookup(idx);
 	tex.LoadFromFile(_fileName, _flags);
 
-	gpu::SetPersistentTableSRV(s_state.m_bindlessTextureHandle, tex.m_gpuTex, idx.idx);
+	gpu::SetPersistentTableSRV(s_state.m_bindlessTextureHandle, tex.m_gpuTex, idx.Slot());
 
-	kt::FilePath fp(_fileName);
-	s_state.m_loadedTextureCache.Insert(std::string(fp.Data()), idx);
+	if (it != s_state.m_loadedTextureCache.End())
+	{
+		it->m_val = idx;
+	}
+	else
+	{
+		kt::FilePath fp(_fileName);
+		s_state.m_loadedTextureCache.Insert(std::string(fp.Data()), idx);
+	}
 	return idx;
 }
 
 gfx::ResourceManager::TextureIdx CreateTextureFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags, char const* _debugName)
 {
-	TextureIdx const idx = TextureIdx(uint16_t(s_state.m_textures.Size()));
-	Texture& tex = s_state.m_textures.PushBack();
+	TextureIdx const idx = AllocTextureSlot();
+	Texture& tex = *s_state.m_textures.Lookup(idx);
 	tex.LoadFromRGBA8(_texels, _width, _height, _flags, _debugName);
-	gpu::SetPersistentTableSRV(s_state.m_bindlessTextureHandle, tex.m_gpuTex, idx.idx);
+	tex.m_texelData.ClearAndFree();
+	gpu::SetPersistentTableSRV(s_state.m_bindlessTextureHandle, tex.m_gpuTex, idx.Slot());
 	return idx;
 }
 
 gfx::Texture* GetTexture(TextureIdx _idx)
 {
-	if (!_idx.IsValid())
+	return s_state.m_textures.Lookup(_idx);
+}
+
+void AddRef(TextureIdx _idx)
+{
+	s_state.m_textures.AddRef(_idx);
+}
+
+void Release(TextureIdx _idx)
+{
+	if (!_idx.IsValid() || !s_state.m_textures.Release(_idx))
 	{
-		return nullptr;
+		return;
 	}
 
-	KT_ASSERT(_idx.idx < s_state.m_textures.Size());
-	return &s_state.m_textures[_idx.idx];
+	// Point the bindless slot back at a live texture until it is reused, the gpu texture itself is released with the slot.
+	gfx::Texture const* whiteTex = s_state.m_textures.Lookup(s_state.m_sharedResources.m_texWhiteIdx);
+	gpu::SetPersistentTableSRV(s_state.m_bindlessTextureHandle, whiteTex->m_gpuTex, _idx.Slot());
+
+	s_state.m_textures.Free(_idx);
 }
 
 gpu::PersistentDescriptorTableHandle GetTextureDescriptorTable()
@@ -529,21 +857,35 @@ gpu::PersistentDescriptorTableHandle GetTextureDescriptorTable()
 
 MaterialIdx CreateMaterial()
 {
-	MaterialIdx const idx = MaterialIdx(uint16_t(s_state.m_materials.Size()));
-	s_state.m_materials.PushBack();
+	MaterialIdx const idx = s_state.m_materials.Alloc();
 	SetMaterialsDirty();
 	return idx;
 }
 
 gfx::Material* GetMaterial(MaterialIdx _idx)
 {
-	if (!_idx.IsValid())
+	return s_state.m_materials.Lookup(_idx);
+}
+
+void AddRef(MaterialIdx _idx)
+{
+	s_state.m_materials.AddRef(_idx);
+}
+
+void Release(MaterialIdx _idx)
+{
+	if (!_idx.IsValid() || !s_state.m_materials.Release(_idx))
+	{
+		return;
+	}
+
+	for (TextureIdx texIdx : s_state.m_materials.m_data[_idx.Slot()].m_textures)
 	{
-		return nullptr;
+		Release(texIdx);
 	}
 
-	KT_ASSERT(_idx.idx < s_state.m_materials.Size());
-	return &s_state.m_materials[_idx.idx];
+	s_state.m_materials.Free(_idx);
+	SetMaterialsDirty();
 }
 
 void SetMaterialsDirty()
@@ -566,18 +908,28 @@ gpu::ShaderHandle LoadShader(char const* _path, gpu::ShaderType _type)
 		return it->m_val;
 	}
 
-	kt::Array<uint8_t> shaderData = ReadEntireFile(_path);
+	gpu::ShaderHandle handle;
 
-	if (shaderData.Size() == 0)
+	if (gpu::GetCaps().headless && !FileExists(_path))
 	{
-		return gpu::ShaderHandle{};
+		// Compiled shaders only exist where the shader compiler runs, a headless device never executes them.
+		handle = gpu::CreateShader(_type, gpu::ShaderBytecode{}, _path);
 	}
+	else
+	{
+		kt::Array<uint8_t> shaderData = ReadEntireFile(_path);
+
+		if (shaderData.Size() == 0)
+		{
+			return gpu::ShaderHandle{};
+		}
 
-	gpu::ShaderBytecode bytecode;
-	bytecode.m_data = shaderData.Data();
-	bytecode.m_size = shaderData.Size();
+		gpu::ShaderBytecode bytecode;
+		bytecode.m_data = shaderData.Data();
+		bytecode.m_size = shaderData.Size();
 
-	gpu::ShaderHandle const handle = gpu::CreateShader(_type, bytecode, _path);
+		handle = gpu::CreateShader(_type, bytecode, _path);
+	}
 
 	s_state.m_shaderCache.Insert(std::string(sanitizedPath.Data()), gpu::ShaderRef(handle));
 	return handle;
@@ -1,53 +1,77 @@
 #pragma once
 #include <kt/Slice.h>
+#include <kt/StaticFunction.h>
 
 #include <gpu/Types.h>
 #include <shaderlib/CommonShared.h>
 
 #include "Texture.h"
 #include "Utils.h"
+#include "RangeAllocator.h"
 
 namespace gfx
 {
 
 struct Mesh;
 struct Model;
+struct ParsedModel;
 struct Texture;
 struct Material;
 struct TangentSpace;
 
+// Detail levels a mesh can have, including full detail.
+static uint32_t constexpr c_maxMeshLods = PATHOS_MAX_MESH_LODS;
+
 namespace ResourceManager
 {
 
+// Generational handle, the low c_slotBits are a slot index and the remaining bits are the version of that slot.
+// Freeing a resource bumps the version of its slot, so stale handles fail lookup rather than aliasing whatever reuses the slot.
 template <typename T>
 struct Index
 {
-	static uint16_t const c_invalidIdx = UINT16_MAX;
+	static uint32_t constexpr c_slotBits = 20;
+	static uint32_t constexpr c_maxSlots = 1u << c_slotBits;
+	static uint32_t constexpr c_slotMask = c_maxSlots - 1;
+	static uint32_t constexpr c_maxVersion = (1u << (32 - c_slotBits)) - 1;
 
 	Index() = default;
-	explicit Index(uint16_t _idx)
-		: idx(_idx)
+	Index(uint32_t _slot, uint32_t _version)
+		: m_packed(_slot | (_version << c_slotBits))
 	{
+		KT_ASSERT(_slot < c_maxSlots);
+		KT_ASSERT(_version != 0 && _version <= c_maxVersion);
 	}
 
+	// Versions start at 1, so zero is never a live handle.
 	bool IsValid() const
 	{
-		return idx != c_invalidIdx;
+		return m_packed != 0;
+	}
+
+	uint32_t Slot() const
+	{
+		return m_packed & c_slotMask;
 	}
 
-	uint16_t idx = c_invalidIdx;
+	uint32_t Version() const
+	{
+		return m_packed >> c_slotBits;
+	}
+
+	uint32_t m_packed = 0;
 };
 
 template <typename T>
 inline bool operator==(Index<T> _lhs, Index<T> _rhs)
 {
-	return _lhs.idx == _rhs.idx;
+	return _lhs.m_packed == _rhs.m_packed;
 }
 
 template <typename T>
 inline bool operator!=(Index<T> _lhs, Index<T> _rhs)
 {
-	return _lhs.idx != _rhs.idx;
+	return _lhs.m_packed != _rhs.m_packed;
 }
 
 using MaterialIdx = Index<Material>;
@@ -75,6 +99,7 @@ struct SharedResources
 	// Culling
 	gpu::PSORef m_cullSubmeshPso;
 	gpu::PSORef m_clearDrawCountPso;
+	gpu::PSORef m_buildDepthPyramidPso;
 };
 
 SharedResources const& GetSharedResources();
@@ -85,18 +110,19 @@ void Shutdown();
 struct UnifiedBuffers
 {
 	gfx::ResizableDynamicBufferT<shaderlib::GPUSubMeshData> m_submeshGpuBuf;
-	uint32_t m_numSubMeshes = 0;
 
 	gpu::BufferRef m_posVertexBuf;
 	gpu::BufferRef m_tangentSpaceVertexBuf;
 	gpu::BufferRef m_uv0VertexBuf;
 	gpu::BufferRef m_indexBufferRef;
 
-	uint32_t m_vertexCapacity;
-	uint32_t m_indexCapacity;
+	// In elements (vertices, indices and submeshes).
+	gfx::RangeAllocator m_vertexAllocator;
+	gfx::RangeAllocator m_indexAllocator;
+	gfx::RangeAllocator m_subMeshAllocator;
 
-	uint32_t m_vertexUsed;
-	uint32_t m_indexUsed;
+	// Bumped whenever ranges move, anything caching mesh offsets (eg. static batches) must rebuild when it changes.
+	uint32_t m_generation = 0;
 };
 
 // All models load vertex/index data into unified buffers. This is mainly for easy experimenting with GPU culling. 
@@ -105,45 +131,53 @@ struct UnifiedBuffers
 void InitUnifiedBuffers(uint32_t _vertexCapacity = 2500000, uint32_t _indexCapacity = 2000000);
 UnifiedBuffers const& GetUnifiedBuffers();
 
+// Repacks all unified buffer ranges to remove fragmentation, patching mesh offsets and submesh gpu data.
+// Happens automatically if an allocation fails while there is enough total free space.
+void CompactUnifiedBuffers();
+
+// See UnifiedBuffers::m_generation.
+uint32_t UnifiedBuffersGeneration();
+
 // A global R32_UINT buffer for use as UAV counters. Use AllocateCounterBufferIndex to allocate an index inside of it.
 gpu::BufferHandle GetCounterBuffer();
 uint32_t AllocateCounterBufferIndex();
 
-void WriteIntoUnifiedBuffers
-(
-	float const* _positions,
-	float const* _uvs,
-	gfx::TangentSpace const* _tangentSpace,
-	uint32_t const* _indices,
-	uint32_t _numVertices,
-	uint32_t _numIndices,
-	uint32_t* o_idxOffset,
-	uint32_t* o_vtxOffset
-);
-
+void WriteIntoUnifiedBuffers(gfx::Mesh& _mesh);
 void AddSubMeshGPUData(gfx::Mesh& _model);
 
 void Update();
 
+// Create* functions return a handle holding a single reference. Releasing the last reference frees the resource 
+// and releases anything it references (model -> meshes -> materials -> textures).
 MeshIdx CreateMesh();
 gfx::Mesh* GetMesh(MeshIdx _idx);
+void AddRef(MeshIdx _idx);
+void Release(MeshIdx _idx);
 
 ModelIdx CreateModel();
 ModelIdx CreateModelFromGLTF(char const* _path);
+
+// Creates a model from one parsed off the main thread (see ParsedModel), taking its mesh data.
+ModelIdx CreateModelFromParsed(ParsedModel& io_parsed);
 gfx::Model* GetModel(ModelIdx _idx);
+void AddRef(ModelIdx _idx);
+void Release(ModelIdx _idx);
 
-kt::Slice<gfx::Model> GetAllModels();
-kt::Slice<gfx::Mesh> GetAllMeshes();
-kt::Slice<gfx::Material> GetAllMaterials();
+void EnumModels(kt::StaticFunction<void(ModelIdx, gfx::Model&), 32> const& _ftor);
+void EnumMaterials(kt::StaticFunction<void(MaterialIdx, gfx::Material&), 32> const& _ftor);
 
 TextureIdx CreateTextureFromFile(char const* _fileName, TextureLoadFlags _flags = TextureLoadFlags::None);
 TextureIdx CreateTextureFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags = TextureLoadFlags::None, char const* _debugName = nullptr);
 gfx::Texture* GetTexture(TextureIdx _idx);
+void AddRef(TextureIdx _idx);
+void Release(TextureIdx _idx);
 
 gpu::PersistentDescriptorTableHandle GetTextureDescriptorTable();
 
 MaterialIdx CreateMaterial();
 Material* GetMaterial(MaterialIdx _idx);
+void AddRef(MaterialIdx _idx);
+void Release(MaterialIdx _idx);
 void SetMaterialsDirty();
 
 gpu::BufferRef GetMaterialGpuBuffer();
@@ -1,8 +1,9 @@
 #include <string>
-#include <intrin.h>
+#include <immintrin.h>
 
 #include <gpu/Types.h>
 #include <core/Memory.h>
+#include <core/Jobs.h>
 
 #include <shaderlib/DefinesShared.h>
 #include <shaderlib/CommonShared.h>
@@ -26,24 +27,187 @@ namespace gfx
 {
 
 core::CVar<bool> s_gpuCulling("gfx.gpu_culling", "use gpu culling", false);
+core::CVar<bool> s_gpuOcclusionCulling("gfx.gpu_occlusion", "two phase hi-z occlusion culling when gpu culling", true);
+core::CVar<bool> s_staticBatches("gfx.static_batches", "keep draw batches of static instances across frames, only dynamic instances are batched every frame", true);
+core::CVar<bool> s_opaqueDepthFirst("gfx.draw_sort.opaque_depth_first", "sort opaque draws front to back before material, rather than by material with depth only ordering instances of a draw", false);
+core::CVar<bool> s_cpuFrustumCulling("gfx.cpu_frustum_culling", "frustum cull submesh instances when building batches on the cpu", true);
+core::CVar<bool> s_shadowCasterCulling("gfx.shadow_caster_culling", "cull shadow casters against each cascade", true);
+core::CVar<bool> s_shadowCache("gfx.shadow_cache.enabled", "cache static shadow casters per cascade, only dynamic casters are drawn each frame", true);
+core::CVar<float> s_shadowCacheMargin("gfx.shadow_cache.margin", "cascades are grown by this fraction so the view can move that far before a cached cascade is re-rendered", 0.1f, 0.0f, 1.0f);
+core::CVar<uint32_t> s_farCascadeInterval("gfx.shadow_cache.far_cascade_interval", "cached cascades past the first two only update every N frames", 1, 1, 16);
+core::CVar<bool> s_occlusionCulling("gfx.occlusion.enabled", "cull instances hidden behind large occluders on the cpu (requires cpu frustum culling)", true);
+core::CVar<uint32_t> s_occluderTriangleBudget("gfx.occlusion.triangle_budget", "max occluder triangles rasterized per frame", 32 * 1024, 0, 1024 * 1024);
+core::CVar<bool> s_lodEnabled("gfx.lod.enabled", "draw simplified mesh detail levels for instances that are small on screen", true);
+core::CVar<float> s_lodPixelThreshold("gfx.lod.pixel_threshold", "projected size in pixels below which an instance uses its first simplified detail level", 512.0f, 1.0f, 8192.0f);
+core::CVar<float> s_lodLevelRatio("gfx.lod.level_ratio", "each further detail level starts at this fraction of the previous level's threshold", 0.5f, 0.05f, 0.95f);
+core::CVar<float> s_lodHysteresis("gfx.lod.hysteresis", "fraction the projected size must move past a threshold before an instance changes level or is culled", 0.1f, 0.0f, 0.5f);
+core::CVar<float> s_smallInstanceCullSize("gfx.lod.cull_pixel_size", "instances with a projected size in pixels below this aren't drawn in the main view, 0 to disable", 2.0f, 0.0f, 64.0f);
+core::CVar<float> s_instanceOriginRebaseDistance("gfx.instances.origin_rebase_distance", "compact instance positions are relative to an origin that's moved to the camera once it's this far away, re-encoding every instance", 1024.0f, 1.0f, 65536.0f);
+core::CVar<float> s_minOccluderSize("gfx.occlusion.min_occluder_size", "bounding radius over distance an instance needs to be picked as an occluder", 0.2f, 0.0f, 10.0f);
+
+// Width of the occlusion buffer, height follows the screen aspect ratio.
+static uint32_t const c_occlusionBufferWidth = 384;
+
+static kt::AABB InstanceWorldBounds(Scene::ModelInstance const& _instance)
+{
+	gfx::Model const& model = *ResourceManager::GetModel(_instance.m_modelIdx);
+	return model.m_boundingBox.Transformed(_instance.m_mtx);
+}
 
-static kt::AABB CalcSceneBounds(gfx::Scene const& _scene)
+// Diameter in pixels of a bounding sphere projected by _cam, along the viewport height.
+static float ProjectedSizePixels(gfx::Camera const& _cam, float _viewportHeight, kt::Vec3 const& _center, float _radius)
 {
-	if (_scene.m_modelInstances.Size() == 0)
+	float const yScale = _cam.GetProjection().m_cols[1].y;
+
+	if (_cam.GetProjectionParams().m_type == gfx::Camera::ProjType::Orthographic)
 	{
-		return kt::AABB{ kt::Vec3(0.0f), kt::Vec3(0.0f) };
+		return _radius * yScale * _viewportHeight;
 	}
 
-	kt::AABB sceneBounds = kt::AABB::FloatMax();
+	float const dist = kt::Max(kt::Length(_center - _cam.GetPos()), _radius);
+	return _radius * yScale * _viewportHeight / dist;
+}
+
+static uint32_t LodForSize(float _pixelSize)
+{
+	uint32_t lod = 0;
+	float threshold = s_lodPixelThreshold;
 
-	for (Scene::ModelInstance const& instance : _scene.m_modelInstances)
+	while (lod < gfx::c_maxMeshLods - 1 && _pixelSize < threshold)
 	{
-		gfx::Model const& model = *ResourceManager::GetModel(instance.m_modelIdx);
-		kt::AABB const& modelAABB = model.m_boundingBox;
-		sceneBounds = kt::Union(modelAABB.Transformed(instance.m_mtx), sceneBounds);
+		++lod;
+		threshold *= s_lodLevelRatio;
+	}
+
+	return lod;
+}
+
+// The size has to move past a threshold by the hysteresis fraction to change level or culling, so instances sitting on one don't pop back and forth.
+static uint8_t SelectLod(float _pixelSize, uint8_t _prevLod)
+{
+	float const hysteresis = s_lodHysteresis;
+	uint32_t const prevLevel = _prevLod & ~InstanceTable::c_lodCulled;
+
+	uint32_t level = prevLevel;
+	uint32_t const coarserLevel = LodForSize(_pixelSize * (1.0f + hysteresis));
+	uint32_t const finerLevel = LodForSize(_pixelSize * (1.0f - hysteresis));
+
+	if (coarserLevel > prevLevel)
+	{
+		level = coarserLevel;
+	}
+	else if (finerLevel < prevLevel)
+	{
+		level = finerLevel;
+	}
+
+	bool const wasCulled = (_prevLod & InstanceTable::c_lodCulled) != 0;
+	bool const culled = _pixelSize * (wasCulled ? 1.0f - hysteresis : 1.0f + hysteresis) < s_smallInstanceCullSize;
+
+	return uint8_t(level | (culled ? InstanceTable::c_lodCulled : 0));
+}
+
+// Picks the detail level of each instance from its model bounds in the main view. Every slot of an instance shares the level.
+static void UpdateInstanceLods(Scene& _scene, gfx::Camera const& _cam, uint32_t const* _instanceIndices, uint32_t _numInstances)
+{
+	bool const enabled = s_lodEnabled;
+	float const viewportHeight = _scene.m_frameConstants.screenDims.y;
+
+	for (uint32_t i = 0; i < _numInstances; ++i)
+	{
+		Scene::ModelInstance const& instance = _scene.m_modelInstances[_instanceIndices[i]];
+
+		if (!instance.m_isVisible)
+		{
+			continue;
+		}
+
+		uint32_t const firstSlot = _scene.m_instanceTable.FirstSlot(instance.m_instanceSlots);
+		uint32_t const numSlots = _scene.m_instanceTable.NumSlots(instance.m_instanceSlots);
+
+		if (!numSlots)
+		{
+			continue;
+		}
+
+		uint8_t lod = 0;
+
+		if (enabled)
+		{
+			kt::AABB const bounds = InstanceWorldBounds(instance);
+			lod = SelectLod(ProjectedSizePixels(_cam, viewportHeight, bounds.Center(), kt::Length(bounds.HalfSize())), _scene.m_instanceTable.Lod(firstSlot));
+		}
+
+		for (uint32_t slot = firstSlot; slot < firstSlot + numSlots; ++slot)
+		{
+			_scene.m_instanceTable.SetLod(slot, lod);
+		}
+
+		if (lod & InstanceTable::c_lodCulled)
+		{
+			++_scene.m_lodStats.m_numCulled;
+		}
+		else
+		{
+			++_scene.m_lodStats.m_numInstances[lod];
+		}
+	}
+}
+
+static bool IsCulledAsSmall(Scene const& _scene, Scene::ModelInstance const& _instance)
+{
+	return _scene.m_instanceTable.NumSlots(_instance.m_instanceSlots)
+		&& (_scene.m_instanceTable.Lod(_scene.m_instanceTable.FirstSlot(_instance.m_instanceSlots)) & InstanceTable::c_lodCulled);
+}
+
+// Cascade frustum without its near plane, anything between the light and the cascade can cast into it.
+static uint32_t const c_numShadowCasterCullPlanes = gfx::Camera::Num_FrustumPlane - 1;
+
+static kt::Vec4 const* ShadowCasterCullPlanes(gfx::Camera const& _cascade)
+{
+	static_assert(gfx::Camera::FrustumPlane::Near == 0, "Near plane is expected first.");
+	return _cascade.GetFrustumPlanes() + 1;
+}
+
+// Cascades before this always update when caching, the rest follow gfx.shadow_cache.far_cascade_interval.
+static uint32_t const c_numFullRateCascades = 2;
+
+static bool AABBIntersectsPlanes(kt::AABB const& _aabb, kt::Vec4 const* _planes, uint32_t _numPlanes)
+{
+	kt::Vec3 const center = (_aabb.m_min + _aabb.m_max) * 0.5f;
+	kt::Vec3 const extent = (_aabb.m_max - _aabb.m_min) * 0.5f;
+
+	for (uint32_t planeIdx = 0; planeIdx < _numPlanes; ++planeIdx)
+	{
+		kt::Vec4 const& plane = _planes[planeIdx];
+		float const dist = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float const radius = kt::Abs(plane.x) * extent.x + kt::Abs(plane.y) * extent.y + kt::Abs(plane.z) * extent.z;
+
+		if (dist + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void MarkStaticInstancesChanged(Scene& _scene, kt::AABB const& _bounds)
+{
+	_scene.m_staticBatchesDirty = true;
+
+	if (!_scene.m_hasStaticCasterChanges)
+	{
+		_scene.m_staticCasterChangeBounds = _bounds;
+		_scene.m_hasStaticCasterChanges = true;
+		return;
 	}
 
-	return sceneBounds;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		_scene.m_staticCasterChangeBounds.m_min[i] = kt::Min(_scene.m_staticCasterChangeBounds.m_min[i], _bounds.m_min[i]);
+		_scene.m_staticCasterChangeBounds.m_max[i] = kt::Max(_scene.m_staticCasterChangeBounds.m_max[i], _bounds.m_max[i]);
+	}
 }
 
 gpu::BufferRef CreateLightStructuredBuffer(uint32_t _capacity)
@@ -68,6 +232,16 @@ Scene::Scene()
 	m_frameConstants.sunColor = kt::Vec3(1.0f);
 
 	m_lightGpuBuf = CreateLightStructuredBuffer(1024);
+	m_lightClusters.Init();
+
+	m_instanceTable.Init();
+	m_transforms.Init();
+	m_mainView.Init(m_instanceTable, true);
+
+	for (uint32_t cascadeIdx = 0; cascadeIdx < c_numShadowCascades; ++cascadeIdx)
+	{
+		m_shadowViews[cascadeIdx].Init(m_instanceTable);
+	}
 
 	{
 		gpu::BufferDesc frameConstDesc;
@@ -76,6 +250,18 @@ Scene::Scene()
 		m_frameConstantsGpuBuf = gpu::CreateBuffer(frameConstDesc, nullptr, "Frame Constants Buffer");
 	}
 
+	for (gpu::cmd::CommandStream*& stream : m_viewCommandStreams)
+	{
+		stream = gpu::cmd::CreateCommandStream();
+	}
+}
+
+Scene::~Scene()
+{
+	for (gpu::cmd::CommandStream* stream : m_viewCommandStreams)
+	{
+		gpu::cmd::DestroyCommandStream(stream);
+	}
 }
 
 void Scene::Init(uint32_t _shadowMapResolution /*= 2048*/)
@@ -84,29 +270,43 @@ void Scene::Init(uint32_t _shadowMapResolution /*= 2048*/)
 	gpu::TextureDesc desc = gpu::TextureDesc::Desc2D(_shadowMapResolution, _shadowMapResolution, flags, gpu::Format::D32_Float);
 	desc.m_arraySlices = c_numShadowCascades;
 	m_shadowCascadeTex = gpu::CreateTexture(desc, nullptr, "Shadow Cascades");
+
+	desc.m_usageFlags = gpu::TextureUsageFlags::DepthStencil;
+	m_shadowStaticCacheTex = gpu::CreateTexture(desc, nullptr, "Shadow Cascades Static Cache");
+
+	for (ShadowCascadeCache& cache : m_shadowCascadeCache)
+	{
+		cache = ShadowCascadeCache{};
+	}
 }
 
-static void UpdateLights(Scene* _scene)
+static void UpdateLights(Scene* _scene, gfx::Camera const& _mainView)
 {
 	uint32_t const numLights = _scene->m_lights.Size();
 
+	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+	GPU_PROFILE_SCOPE(ctx, "Scene::UpdateLights", GPU_PROFILE_COLOUR(0xf0, 0xff, 0x00));
+
 	if (numLights == 0)
 	{
 		_scene->m_frameConstants.numLights = 0;
 		_scene->m_frameConstants.numPointLights = 0;
 		_scene->m_frameConstants.numSpotLights = 0;
+
+		// Still uploads an empty grid.
+		_scene->m_lightClusters.Build(ctx, _mainView, nullptr, 0, 0, _scene->m_frameConstants);
 		return;
 	}
 
-	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
-	GPU_PROFILE_SCOPE(ctx, "Scene::UpdateLights", GPU_PROFILE_COLOUR(0xf0, 0xff, 0x00));
+	// Frame allocator rather than the stack, there can be tens of thousands of lights.
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
 
-	Light* sortedLights = (Light*)KT_ALLOCA(numLights * sizeof(Light));
+	Light* sortedLights = (Light*)frameAllocator->Alloc(numLights * sizeof(Light), alignof(Light));
 	memcpy(sortedLights, _scene->m_lights.Data(), _scene->m_lights.Size() * sizeof(Light));
 
 	{
 		// TODO: Could partition if light types == 2. 
-		Light* radixTemp = (Light*)KT_ALLOCA(_scene->m_lights.Size() * sizeof(Light));
+		Light* radixTemp = (Light*)frameAllocator->Alloc(numLights * sizeof(Light), alignof(Light));
 		kt::RadixSort(sortedLights, sortedLights + _scene->m_lights.Size(), radixTemp, [](Light const& _light) { return uint8_t(_light.m_type); });
 	}
 
@@ -121,7 +321,9 @@ static void UpdateLights(Scene* _scene)
 		}
 	}
 
-	shaderlib::LightData* gpuLightData = (shaderlib::LightData*)gpu::cmd::BeginUpdateDynamicBuffer(ctx, _scene->m_lightGpuBuf, numLights * sizeof(shaderlib::LightData), 0).Data();
+	// Built in cpu memory first, the clusters read it back.
+	shaderlib::LightData* const cpuLightData = (shaderlib::LightData*)frameAllocator->Alloc(numLights * sizeof(shaderlib::LightData), 16);
+	shaderlib::LightData* gpuLightData = cpuLightData;
 	
 	uint32_t lightCounts[uint32_t(Light::Type::Count)] = {};
 
@@ -148,16 +350,99 @@ static void UpdateLights(Scene* _scene)
 	_scene->m_frameConstants.numSpotLights = lightCounts[uint32_t(Light::Type::Spot)];
 	_scene->m_frameConstants.numLights = numLights;
 
+	memcpy(gpu::cmd::BeginUpdateDynamicBuffer(ctx, _scene->m_lightGpuBuf, numLights * sizeof(shaderlib::LightData), 0).Data(), cpuLightData, numLights * sizeof(shaderlib::LightData));
 	gpu::cmd::EndUpdateDynamicBuffer(ctx, _scene->m_lightGpuBuf);
+
+	_scene->m_lightClusters.Build(ctx, _mainView, cpuLightData, numLights, _scene->m_frameConstants.numPointLights, _scene->m_frameConstants);
+}
+
+// Keeps last frame's cascade (and its cached static casters) while it still covers its slice of the view, otherwise takes the fresh one.
+static void UpdateShadowCascadeCache(Scene& _scene, gfx::Camera const* _freshCascades, float _margin)
+{
+	kt::Vec3 const lightDir = _scene.m_frameConstants.sunDir;
+	float const c_minLightDirCos = 0.99999f;
+
+	for (uint32_t cascadeIdx = 0; cascadeIdx < Scene::c_numShadowCascades; ++cascadeIdx)
+	{
+		Scene::ShadowCascadeCache& cache = _scene.m_shadowCascadeCache[cascadeIdx];
+		gfx::Camera& cascade = _scene.m_shadowViews[cascadeIdx].m_camera;
+		gfx::Camera const& fresh = _freshCascades[cascadeIdx];
+
+		if (!s_shadowCache)
+		{
+			cascade = fresh;
+			cache.m_staticValid = false;
+			cache.m_renderStaticThisFrame = false;
+			cache.m_updateThisFrame = true;
+			continue;
+		}
+
+		bool valid = cache.m_staticValid && kt::Dot(cache.m_lightDir, lightDir) >= c_minLightDirCos;
+
+		if (valid)
+		{
+			// Half size of the grown cascade is r * (1 + margin), so the slice (radius r) stays inside while its center moves up to r * margin.
+			float const halfSize = fresh.GetProjectionParams().m_ortho.right;
+			float const cachedHalfSize = cascade.GetProjectionParams().m_ortho.right;
+			float const maxMove = halfSize * _margin / (1.0f + _margin);
+
+			valid = kt::Abs(halfSize - cachedHalfSize) <= halfSize * 0.001f
+				&& kt::Length(fresh.GetPos() - cascade.GetPos()) <= maxMove;
+		}
+
+		if (valid && _scene.m_hasStaticCasterChanges)
+		{
+			valid = !AABBIntersectsPlanes(_scene.m_staticCasterChangeBounds, ShadowCasterCullPlanes(cascade), c_numShadowCasterCullPlanes);
+		}
+
+		if (!valid)
+		{
+			cascade = fresh;
+			cache.m_lightDir = lightDir;
+			cache.m_staticValid = true;
+			cache.m_renderStaticThisFrame = true;
+			cache.m_updateThisFrame = true;
+			continue;
+		}
+
+		cache.m_renderStaticThisFrame = false;
+		cache.m_updateThisFrame = cascadeIdx < c_numFullRateCascades || (_scene.m_frameIdx + cascadeIdx) % s_farCascadeInterval == 0;
+	}
+
+	_scene.m_hasStaticCasterChanges = false;
+	++_scene.m_frameIdx;
+}
+
+// Recomputes world transforms below anything that moved and copies the mesh nodes' into their instance slots.
+static void UpdateInstanceTransforms(Scene& _scene)
+{
+	_scene.m_transforms.Update();
+
+	for (uint32_t node : _scene.m_transforms.ChangedNodes())
+	{
+		uint32_t const slot = _scene.m_transforms.UserData(node);
+
+		if (slot != TransformHierarchy::c_noUserData)
+		{
+			_scene.m_instanceTable.SetTransform(slot, _scene.m_transforms.World(node));
+		}
+	}
 }
 
 void Scene::BeginFrameAndUpdateBuffers(gpu::cmd::Context* _ctx, gfx::Camera const& _mainView, float _dt)
 {
 	GPU_PROFILE_SCOPE(_ctx, "Scene::BeginFrameAndUpdateBuffers", GPU_PROFILE_COLOUR(0xf0, 0xff, 0x00));
 
-	m_meshRenderer.Clear();
+	m_mainView.Clear();
+
+	for (uint32_t cascadeIdx = 0; cascadeIdx < c_numShadowCascades; ++cascadeIdx)
+	{
+		m_shadowViews[cascadeIdx].Clear();
+	}
+
+	m_mainView.m_camera = _mainView;
 
-	m_sceneBounds = CalcSceneBounds(*this);
+	m_sceneBounds = m_instanceTree.IsEmpty() ? kt::AABB{ kt::Vec3(0.0f), kt::Vec3(0.0f) } : m_instanceTree.RootBounds();
 
 	m_frameConstants.mainViewProj = _mainView.GetViewProj();
 	m_frameConstants.mainProj = _mainView.GetProjection();
@@ -193,15 +478,30 @@ void Scene::BeginFrameAndUpdateBuffers(gpu::cmd::Context* _ctx, gfx::Camera cons
 		// calculate cascades
 		gpu::TextureDesc desc;
 		gpu::GetTextureInfo(m_shadowCascadeTex, desc);
-		gfx::CalculateShadowCascades(_mainView, m_frameConstants.sunDir, desc.m_width, c_numShadowCascades, m_shadowCascades, &m_frameConstants.cascadeSplits[0]);
+
+		float const margin = s_shadowCache ? float(s_shadowCacheMargin) : 0.0f;
+		gfx::Camera freshCascades[c_numShadowCascades];
+		gfx::CalculateShadowCascades(_mainView, m_frameConstants.sunDir, desc.m_width, c_numShadowCascades, freshCascades, &m_frameConstants.cascadeSplits[0], 1.0f + margin);
+		UpdateShadowCascadeCache(*this, freshCascades, margin);
 
 		for (uint32_t cascadeIdx = 0; cascadeIdx < c_numShadowCascades; ++cascadeIdx)
 		{
-			m_frameConstants.cascadeMatrices[cascadeIdx] = kt::Mul(gfx::NDC_To_UV_Matrix(), m_shadowCascades[cascadeIdx].GetViewProj());
+			m_frameConstants.cascadeMatrices[cascadeIdx] = kt::Mul(gfx::NDC_To_UV_Matrix(), m_shadowViews[cascadeIdx].m_camera.GetViewProj());
 		}
 	}
 
-	UpdateLights(this);
+	UpdateLights(this, _mainView);
+
+	if (kt::Length(m_frameConstants.camPos - m_instanceTable.Origin()) > s_instanceOriginRebaseDistance)
+	{
+		m_instanceTable.SetOrigin(m_frameConstants.camPos);
+	}
+
+	m_frameConstants.instanceOrigin = m_instanceTable.Origin();
+
+	UpdateInstanceTransforms(*this);
+
+	m_instanceTable.Upload(_ctx);
 
 	gpu::cmd::ResourceBarrier(_ctx, m_lightGpuBuf, gpu::ResourceState::CopyDest);
 	gpu::cmd::ResourceBarrier(_ctx, m_frameConstantsGpuBuf, gpu::ResourceState::CopyDest);
@@ -213,28 +513,323 @@ void Scene::BeginFrameAndUpdateBuffers(gpu::cmd::Context* _ctx, gfx::Camera cons
 	gpu::cmd::ResourceBarrier(_ctx, m_frameConstantsGpuBuf, gpu::ResourceState::ConstantBuffer);
 }
 
+static void SubmitModelInstance(Scene const& _scene, Scene::ModelInstance const& _instance, MeshRenderer& _renderer)
+{
+	uint32_t const firstSlot = _scene.m_instanceTable.FirstSlot(_instance.m_instanceSlots);
+	uint32_t const numSlots = _scene.m_instanceTable.NumSlots(_instance.m_instanceSlots);
+
+	for (uint32_t slot = firstSlot; slot < firstSlot + numSlots; ++slot)
+	{
+		_renderer.Submit(slot);
+	}
+}
+
+// Rebuilds the main view's static batches if static instances changed or the unified buffers were compacted, or clears them if disabled.
+static void UpdateStaticBatches(Scene& _scene, bool _enabled)
+{
+	uint32_t const unifiedGeneration = ResourceManager::UnifiedBuffersGeneration();
+
+	if (_enabled == _scene.m_staticBatchesEnabled && !_scene.m_staticBatchesDirty && unifiedGeneration == _scene.m_staticBatchesUnifiedGeneration)
+	{
+		return;
+	}
+
+	kt::Array<uint32_t> slots(core::GetThreadFrameAllocator());
+
+	if (_enabled)
+	{
+		for (Scene::ModelInstance const& instance : _scene.m_modelInstances)
+		{
+			if (!instance.m_isStatic || !instance.m_isVisible)
+			{
+				continue;
+			}
+
+			uint32_t const firstSlot = _scene.m_instanceTable.FirstSlot(instance.m_instanceSlots);
+			uint32_t const numSlots = _scene.m_instanceTable.NumSlots(instance.m_instanceSlots);
+
+			for (uint32_t slot = firstSlot; slot < firstSlot + numSlots; ++slot)
+			{
+				slots.PushBack(slot);
+			}
+		}
+	}
+
+	_scene.m_mainView.m_renderer.SetStaticInstances(slots.Data(), slots.Size());
+	_scene.m_staticBatchesEnabled = _enabled;
+	_scene.m_staticBatchesDirty = false;
+	_scene.m_staticBatchesUnifiedGeneration = unifiedGeneration;
+}
+
+// Picks the visible instances covering the most screen as occluders, up to the triangle budget, and rasterizes their coarsest detail level.
+static void RasterizeOccluders(Scene& _scene, gfx::Camera const& _cullCam, kt::Array<uint32_t> const& _visibleInstances)
+{
+	struct OccluderCandidate
+	{
+		float m_size;
+		uint32_t m_instanceIdx;
+	};
+
+	kt::LinearAllocator* frameAllocator = core::GetThreadFrameAllocator();
+
+	kt::Vec3 const camPos = _cullCam.GetInverseView().GetPos();
+
+	kt::Array<OccluderCandidate> candidates(frameAllocator);
+	candidates.Reserve(_visibleInstances.Size());
+
+	for (uint32_t instanceIdx : _visibleInstances)
+	{
+		kt::AABB const bounds = InstanceWorldBounds(_scene.m_modelInstances[instanceIdx]);
+		float const radius = kt::Length(bounds.HalfSize());
+		float const dist = kt::Max(kt::Length(bounds.Center() - camPos), radius);
+		float const size = radius / dist;
+
+		if (size >= s_minOccluderSize)
+		{
+			candidates.PushBack(OccluderCandidate{ size, instanceIdx });
+		}
+	}
+
+	if (candidates.Size())
+	{
+		// Sizes are positive, so their bits sort as integers.
+		OccluderCandidate* radixTemp = (OccluderCandidate*)frameAllocator->Alloc(sizeof(OccluderCandidate) * candidates.Size());
+		kt::RadixSort(candidates.Data(), candidates.Data() + candidates.Size(), radixTemp, [](OccluderCandidate const& _c) { uint32_t bits; memcpy(&bits, &_c.m_size, sizeof(bits)); return bits; });
+	}
+
+	uint32_t trianglesLeft = s_occluderTriangleBudget;
+
+	// Largest last.
+	for (uint32_t candidateIdx = candidates.Size(); candidateIdx-- > 0;)
+	{
+		Scene::ModelInstance const& instance = _scene.m_modelInstances[candidates[candidateIdx].m_instanceIdx];
+		gfx::Model const& model = *ResourceManager::GetModel(instance.m_modelIdx);
+		uint32_t const firstNode = _scene.m_transforms.FirstNode(instance.m_transformNodes);
+
+		for (gfx::Model::Node const& node : model.m_nodes)
+		{
+			gfx::Mesh const& mesh = *ResourceManager::GetMesh(model.m_meshes[node.m_internalMeshIdx]);
+			kt::Mat4 const& mtx = _scene.m_transforms.World(firstNode + node.m_transformIdx + 1);
+
+			for (gfx::Mesh::SubMesh const& subMesh : mesh.m_subMeshes)
+			{
+				uint32_t const numTriangles = subMesh.m_occluderNumIndices / 3;
+				if (!numTriangles || numTriangles > trianglesLeft)
+				{
+					continue;
+				}
+
+				// Alpha tested or blended surfaces may not hide what's behind them.
+				gfx::Material const* material = ResourceManager::GetMaterial(subMesh.m_materialIdx);
+				if (!material || material->m_params.m_alphaMode != gfx::Material::AlphaMode::Opaque)
+				{
+					continue;
+				}
+
+				_scene.m_occlusionBuffer.AddOccluder(mtx, mesh.m_occluderPositions.Data(), mesh.m_occluderIndices.Data() + subMesh.m_occluderIndexStartOffset, subMesh.m_occluderNumIndices);
+				trianglesLeft -= numTriangles;
+			}
+		}
+	}
+
+	_scene.m_occlusionBuffer.RasterizeOccluders();
+}
+
+// Submits the casters found for a cascade, static ones go to its cached renderer when caching.
+static void SubmitShadowCasters(Scene& _scene, uint32_t _cascadeIdx)
+{
+	bool const splitStatic = s_shadowCache;
+
+	Scene::ShadowCascadeCache const& cache = _scene.m_shadowCascadeCache[_cascadeIdx];
+	gfx::RenderView& view = _scene.m_shadowViews[_cascadeIdx];
+	uint32_t& numCasters = _scene.m_numShadowCasterInstances[_cascadeIdx];
+	numCasters = 0;
+
+	for (uint32_t instanceIdx : view.m_visibleInstances)
+	{
+		Scene::ModelInstance const& instance = _scene.m_modelInstances[instanceIdx];
+
+		if (splitStatic && instance.m_isStatic)
+		{
+			if (!cache.m_renderStaticThisFrame)
+			{
+				continue;
+			}
+
+			SubmitModelInstance(_scene, instance, view.m_cachedRenderer);
+		}
+		else
+		{
+			SubmitModelInstance(_scene, instance, view.m_renderer);
+		}
+
+		++numCasters;
+	}
+}
+
+// Picks lods and rasterizes occluders from the main view's visible instances, then submits what's left after static batching, small instance and occlusion culling.
+static void SubmitMainView(Scene& _scene, bool _occlusionCulling, bool _staticBatches)
+{
+	gfx::RenderView& view = _scene.m_mainView;
+	gfx::Camera const& cullCam = _scene.m_debugCullCamera ? *_scene.m_debugCullCamera : view.m_camera;
+
+	// Only visible instances need their level picked, the rest keep theirs until they're back in view.
+	UpdateInstanceLods(_scene, view.m_camera, view.m_visibleInstances.Data(), view.m_visibleInstances.Size());
+
+	gfx::OcclusionBuffer const* occlusion = nullptr;
+
+	if (_occlusionCulling)
+	{
+		uint32_t const occlusionHeight = uint32_t(float(c_occlusionBufferWidth) * _scene.m_frameConstants.screenDims.y / kt::Max(_scene.m_frameConstants.screenDims.x, 1.0f));
+		if (_scene.m_occlusionBuffer.Width() != c_occlusionBufferWidth || _scene.m_occlusionBuffer.Height() != kt::AlignUp(occlusionHeight, OcclusionBuffer::c_tileHeight))
+		{
+			_scene.m_occlusionBuffer.Init(c_occlusionBufferWidth, occlusionHeight);
+		}
+
+		_scene.m_occlusionBuffer.BeginFrame(cullCam.GetViewProj());
+		RasterizeOccluders(_scene, cullCam, view.m_visibleInstances);
+
+		if (_scene.m_occlusionBuffer.IsEnabled())
+		{
+			occlusion = &_scene.m_occlusionBuffer;
+		}
+	}
+
+	for (uint32_t instanceIdx : view.m_visibleInstances)
+	{
+		Scene::ModelInstance const& instance = _scene.m_modelInstances[instanceIdx];
+
+		if (_staticBatches && instance.m_isStatic)
+		{
+			continue;
+		}
+
+		if (IsCulledAsSmall(_scene, instance))
+		{
+			continue;
+		}
+
+		if (occlusion && !occlusion->IsVisible(InstanceWorldBounds(instance)))
+		{
+			++_scene.m_numOccludedInstances;
+			continue;
+		}
+
+		SubmitModelInstance(_scene, instance, view.m_renderer);
+	}
+}
+
 void Scene::SubmitInstances()
 {
-	for (Scene::ModelInstance const& modelInstance : m_modelInstances)
+	bool const cpuCulling = !s_gpuCulling && s_cpuFrustumCulling;
+	bool const occlusionCulling = cpuCulling && s_occlusionCulling;
+	gfx::Camera const& cullCam = m_debugCullCamera ? *m_debugCullCamera : m_mainView.m_camera;
+
+	m_numOccludedInstances = 0;
+	m_lodStats = LodStats{};
+
+	// Static instances are drawn from the cached batches, and culled per submesh there.
+	bool const staticBatches = s_staticBatches;
+	UpdateStaticBatches(*this, staticBatches);
+
+	// Every view is culled in one pass over the instance tree, views without planes take everything in it.
+	// Only instances the tree can't reject are considered, their submeshes are culled individually later.
+	gfx::RenderView* views[1 + c_numShadowCascades];
+	uint32_t numViews = 0;
+
+	m_mainView.SetCullPlanes(cullCam.GetFrustumPlanes(), cpuCulling ? gfx::Camera::Num_FrustumPlane : 0);
+	m_mainView.m_sortView = gfx::MakeDrawSortView(m_mainView.m_camera);
+	m_mainView.m_sortView.m_opaqueDepthFirst = s_opaqueDepthFirst;
+	views[numViews++] = &m_mainView;
+
+	for (uint32_t cascadeIdx = 0; cascadeIdx < c_numShadowCascades; ++cascadeIdx)
+	{
+		gfx::RenderView& view = m_shadowViews[cascadeIdx];
+		view.m_visibleInstances.Clear();
+		m_numShadowCasterInstances[cascadeIdx] = 0;
+
+		if (!m_shadowCascadeCache[cascadeIdx].m_updateThisFrame)
+		{
+			continue;
+		}
+
+		view.SetCullPlanes(ShadowCasterCullPlanes(view.m_camera), s_shadowCasterCulling ? c_numShadowCasterCullPlanes : 0);
+		view.m_sortView = gfx::MakeDrawSortView(view.m_camera);
+		view.m_sortView.m_opaqueDepthFirst = s_opaqueDepthFirst;
+		views[numViews++] = &view;
+	}
+
+	gfx::CullRenderViews(m_instanceTree, views, numViews);
+
+	// Views only submit to their own renderers. The main view also writes lods, which are only read when building draws.
+	core::jobs::ParallelFor(numViews, 1, [this, views, occlusionCulling, staticBatches](uint32_t _begin, uint32_t _end)
 	{
-		gfx::Model const& model = *ResourceManager::GetModel(modelInstance.m_modelIdx);
-		for (gfx::Model::Node const& modelMeshInstance : model.m_nodes)
+		for (uint32_t viewIdx = _begin; viewIdx < _end; ++viewIdx)
 		{
-			ResourceManager::MeshIdx const meshIdx = model.m_meshes[modelMeshInstance.m_internalMeshIdx];
-			m_meshRenderer.Submit(meshIdx, kt::Mul(modelInstance.m_mtx, modelMeshInstance.m_mtx));
+			if (views[viewIdx] == &m_mainView)
+			{
+				SubmitMainView(*this, occlusionCulling, staticBatches);
+			}
+			else
+			{
+				SubmitShadowCasters(*this, uint32_t(views[viewIdx] - m_shadowViews));
+			}
 		}
+	});
+
+	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+
+	// The pyramid is only built from the main view when gpu occlusion culling runs, otherwise it's stale or for a different camera.
+	if (!s_gpuCulling || !s_gpuOcclusionCulling || m_debugCullCamera)
+	{
+		m_depthPyramid.Invalidate();
 	}
 
+	// The main view comes first, so building its gpu cull straight into the context keeps the views in order.
+	uint32_t firstRecordedView = 0;
+
 	if (s_gpuCulling)
 	{
-		m_meshRenderer.BuildMultiDrawBuffersGPU(gpu::GetMainThreadCommandCtx(), m_scratchCullingBuffers);
+		m_mainView.m_renderer.BuildMultiDrawBuffersGPU(ctx, m_scratchCullingBuffers, cullCam.GetViewProj(), &m_depthPyramid);
+		firstRecordedView = 1;
 	}
-	else
+
+	// Cpu builds only create buffers when growing them, which must happen here.
+	for (uint32_t viewIdx = firstRecordedView; viewIdx < numViews; ++viewIdx)
 	{
-		m_meshRenderer.BuildMultiDrawBuffersCPU(gpu::GetMainThreadCommandCtx());
+		views[viewIdx]->m_renderer.ReserveMultiDrawBuffersCPU(ctx);
+		views[viewIdx]->m_cachedRenderer.ReserveMultiDrawBuffersCPU(ctx);
 	}
-}
 
+	// Each view records its uploads into its own stream, so views build at the same time. Each build is also spread over the job threads.
+	OcclusionBuffer const* occlusion = occlusionCulling && m_occlusionBuffer.IsEnabled() ? &m_occlusionBuffer : nullptr;
+
+	core::jobs::ParallelFor(numViews - firstRecordedView, 1, [this, views, firstRecordedView, occlusion](uint32_t _begin, uint32_t _end)
+	{
+		for (uint32_t viewIdx = firstRecordedView + _begin; viewIdx < firstRecordedView + _end; ++viewIdx)
+		{
+			gfx::RenderView& view = *views[viewIdx];
+			kt::Vec4 const* planes = view.m_numCullPlanes ? view.m_cullPlanes : nullptr;
+
+			gpu::cmd::Context* recordCtx = gpu::cmd::BeginRecording(m_viewCommandStreams[viewIdx], gpu::cmd::ContextType::Graphics);
+
+			if (&view == &m_mainView)
+			{
+				// Sorted against the camera rendered from, which isn't the cull camera when debugging culling.
+				view.m_renderer.BuildMultiDrawBuffersCPU(recordCtx, view.m_sortView, planes, view.m_numCullPlanes, occlusion);
+			}
+			else
+			{
+				view.m_renderer.BuildMultiDrawBuffersCPU(recordCtx, view.m_sortView, planes, view.m_numCullPlanes);
+				view.m_cachedRenderer.BuildMultiDrawBuffersCPU(recordCtx, view.m_sortView, planes, view.m_numCullPlanes);
+			}
+
+			gpu::cmd::EndRecording(recordCtx);
+		}
+	});
+
+	gpu::cmd::Replay(ctx, m_viewCommandStreams + firstRecordedView, numViews - firstRecordedView);
+}
 
 void Scene::RenderCascadeViews(gpu::cmd::Context* _ctx)
 {
@@ -247,19 +842,57 @@ void Scene::RenderCascadeViews(gpu::cmd::Context* _ctx)
 	// TODO: Hack because barrier handling is bad atm.
 	gpu::cmd::FlushBarriers(_ctx);
 
+	bool const useCache = s_shadowCache;
+
 	for (uint32_t cascadeIdx = 0; cascadeIdx < c_numShadowCascades; ++cascadeIdx)
 	{
+		ShadowCascadeCache const& cache = m_shadowCascadeCache[cascadeIdx];
+
+		if (!cache.m_updateThisFrame)
+		{
+			// Last update is still in the slice, drawn with the same (unchanged) cascade matrix.
+			continue;
+		}
+
+		gpu::DescriptorData cbv;
+		cbv.Set(m_shadowViews[cascadeIdx].m_camera.GetViewProj().Data(), sizeof(kt::Mat4));
+
+		if (useCache)
+		{
+			GPU_PROFILE_SCOPE(_ctx, "Scene::RestoreShadowCascadeCache", GPU_PROFILE_COLOUR(0x00, 0xff, 0x00));
+
+			if (cache.m_renderStaticThisFrame)
+			{
+				gpu::cmd::ResourceBarrier(_ctx, m_shadowStaticCacheTex, gpu::ResourceState::DepthStencilTarget);
+				gpu::cmd::FlushBarriers(_ctx);
+
+				gpu::cmd::ClearDepth(_ctx, m_shadowStaticCacheTex, 1.0f, cascadeIdx);
+				gpu::cmd::SetDepthBuffer(_ctx, m_shadowStaticCacheTex, cascadeIdx);
+				gpu::cmd::SetGraphicsCBVTable(_ctx, cbv, PATHOS_PER_VIEW_SPACE);
+				m_shadowViews[cascadeIdx].m_cachedRenderer.RenderInstances(_ctx);
+			}
+
+			// Dynamic casters are drawn on top of a copy of the static ones.
+			gpu::cmd::SetDepthBuffer(_ctx, gpu::TextureHandle{});
+			gpu::cmd::ResourceBarrier(_ctx, m_shadowStaticCacheTex, gpu::ResourceState::CopySrc);
+			gpu::cmd::ResourceBarrier(_ctx, m_shadowCascadeTex, gpu::ResourceState::CopyDest);
+			gpu::cmd::FlushBarriers(_ctx);
+
+			gpu::cmd::CopyTextureSubresource(_ctx, m_shadowCascadeTex, cascadeIdx, 0, m_shadowStaticCacheTex, cascadeIdx, 0);
+
+			gpu::cmd::ResourceBarrier(_ctx, m_shadowCascadeTex, gpu::ResourceState::DepthStencilTarget);
+			gpu::cmd::FlushBarriers(_ctx);
+		}
+		else
 		{
 			GPU_PROFILE_SCOPE(_ctx, "Scene::ClearShadowCascade", GPU_PROFILE_COLOUR(0x00, 0xff, 0x00));
 			gpu::cmd::ClearDepth(_ctx, m_shadowCascadeTex, 1.0f, cascadeIdx);
 		}
-		gpu::cmd::SetDepthBuffer(_ctx, m_shadowCascadeTex, cascadeIdx);
-		gpu::DescriptorData cbv;
-		cbv.Set(m_shadowCascades[cascadeIdx].GetViewProj().Data(), sizeof(kt::Mat4));
 
+		gpu::cmd::SetDepthBuffer(_ctx, m_shadowCascadeTex, cascadeIdx);
 		gpu::cmd::SetGraphicsCBVTable(_ctx, cbv, PATHOS_PER_VIEW_SPACE);
 
-		m_meshRenderer.RenderInstances(_ctx);
+		m_shadowViews[cascadeIdx].m_renderer.RenderInstances(_ctx);
 	}
 
 	gpu::cmd::ResourceBarrier(_ctx, m_shadowCascadeTex, gpu::ResourceState::ShaderResource);
@@ -267,11 +900,30 @@ void Scene::RenderCascadeViews(gpu::cmd::Context* _ctx)
 
 void Scene::RenderInstances(gpu::cmd::Context* _ctx)
 {
-	m_meshRenderer.RenderInstances(_ctx);
+	m_mainView.m_renderer.RenderInstances(_ctx);
+}
+
+bool Scene::BuildDepthPyramidAndCullLate(gpu::cmd::Context* _ctx, gpu::TextureHandle _depth)
+{
+	if (!s_gpuCulling || !s_gpuOcclusionCulling || m_debugCullCamera)
+	{
+		return false;
+	}
+
+	m_depthPyramid.Build(_ctx, _depth);
+	m_mainView.m_renderer.BuildLateDrawBuffersGPU(_ctx, m_scratchCullingBuffers, m_mainView.m_camera.GetViewProj(), m_depthPyramid);
+	return m_mainView.m_renderer.HasLateInstances();
+}
+
+void Scene::RenderLateInstances(gpu::cmd::Context* _ctx)
+{
+	m_mainView.m_renderer.RenderLateInstances(_ctx);
 }
 
 void Scene::EndFrame()
 {
+	m_instanceEvents.Clear();
+
 	gpu::DescriptorData cbv;
 	cbv.Set(m_frameConstantsGpuBuf);
 	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
@@ -280,11 +932,212 @@ void Scene::EndFrame()
 }
 
 
-void Scene::AddModelInstance(ResourceManager::ModelIdx _idx, kt::Mat4 const& _mtx)
+Scene::InstanceHandle Scene::AddModelInstance(ResourceManager::ModelIdx _idx, kt::Mat4 const& _mtx, bool _isStatic)
 {
+	// Instances keep their model loaded.
+	ResourceManager::AddRef(_idx);
+
+	uint32_t handleSlot;
+	if (m_freeInstanceHandleSlots.Size())
+	{
+		handleSlot = m_freeInstanceHandleSlots.Back();
+		m_freeInstanceHandleSlots.PopBack();
+	}
+	else
+	{
+		handleSlot = m_instanceHandleSlots.Size();
+		m_instanceHandleSlots.PushBack();
+	}
+
+	uint32_t const instanceIdx = m_modelInstances.Size();
+	m_instanceHandleSlots[handleSlot].m_instanceIdx = instanceIdx;
+
 	ModelInstance& inst = m_modelInstances.PushBack();
 	inst.m_modelIdx = _idx;
 	inst.m_mtx = _mtx;
+	inst.m_isStatic = _isStatic;
+	inst.m_handle = InstanceHandle(handleSlot, m_instanceHandleSlots[handleSlot].m_version);
+
+	kt::AABB const bounds = InstanceWorldBounds(inst);
+	inst.m_treeProxy = m_instanceTree.Insert(bounds, instanceIdx);
+	gfx::Model const& model = *ResourceManager::GetModel(_idx);
+
+	inst.m_instanceSlots = m_instanceTable.Alloc(model.m_nodes.Size());
+
+	// Node 0 is the instance itself, the model's nodes follow with their roots parented to it.
+	uint32_t const numTransformNodes = model.m_transformNodes.Size() + 1;
+	kt::Array<uint32_t> parents;
+	kt::Array<kt::Mat4> locals;
+	parents.Resize(numTransformNodes);
+	locals.Resize(numTransformNodes);
+
+	parents[0] = TransformHierarchy::c_noParent;
+	locals[0] = _mtx;
+
+	for (uint32_t i = 0; i < model.m_transformNodes.Size(); ++i)
+	{
+		uint32_t const parent = model.m_transformNodes[i].m_parent;
+		parents[i + 1] = parent == UINT32_MAX ? 0 : parent + 1;
+		locals[i + 1] = model.m_transformNodes[i].m_local;
+	}
+
+	inst.m_transformNodes = m_transforms.Alloc(numTransformNodes, parents.Data(), locals.Data());
+
+	uint32_t const firstSlot = m_instanceTable.FirstSlot(inst.m_instanceSlots);
+	uint32_t const firstNode = m_transforms.FirstNode(inst.m_transformNodes);
+
+	for (uint32_t i = 0; i < model.m_nodes.Size(); ++i)
+	{
+		m_instanceTable.SetMesh(firstSlot + i, model.m_meshes[model.m_nodes[i].m_internalMeshIdx]);
+		m_transforms.SetUserData(firstNode + model.m_nodes[i].m_transformIdx + 1, firstSlot + i);
+	}
+
+	if (_isStatic)
+	{
+		MarkStaticInstancesChanged(*this, bounds);
+	}
+
+	m_instanceEvents.PushBack(InstanceEvent{ InstanceEvent::Type::Added, inst.m_handle });
+
+	return inst.m_handle;
+}
+
+uint32_t Scene::InstanceIndex(InstanceHandle _handle) const
+{
+	uint32_t const slot = _handle.Slot();
+
+	if (!_handle.IsValid() || slot >= m_instanceHandleSlots.Size() || m_instanceHandleSlots[slot].m_version != _handle.Version())
+	{
+		return UINT32_MAX;
+	}
+
+	return m_instanceHandleSlots[slot].m_instanceIdx;
+}
+
+void Scene::RemoveModelInstance(InstanceHandle _handle)
+{
+	uint32_t const instanceIdx = InstanceIndex(_handle);
+	KT_ASSERT(instanceIdx != UINT32_MAX);
+
+	ModelInstance& inst = m_modelInstances[instanceIdx];
+
+	if (inst.m_treeProxy != AABBTree::c_invalidProxy)
+	{
+		m_instanceTree.Remove(inst.m_treeProxy);
+	}
+
+	m_instanceTable.Free(inst.m_instanceSlots);
+	m_transforms.Free(inst.m_transformNodes);
+
+	if (inst.m_isStatic && inst.m_isVisible)
+	{
+		MarkStaticInstancesChanged(*this, InstanceWorldBounds(inst));
+	}
+
+	ResourceManager::Release(inst.m_modelIdx);
+
+	InstanceHandleSlot& handleSlot = m_instanceHandleSlots[_handle.Slot()];
+	uint32_t const nextVersion = handleSlot.m_version + 1;
+	handleSlot.m_version = nextVersion > InstanceHandle::c_maxVersion ? 1 : nextVersion;
+	handleSlot.m_instanceIdx = UINT32_MAX;
+	m_freeInstanceHandleSlots.PushBack(_handle.Slot());
+
+	m_modelInstances.EraseSwap(instanceIdx);
+
+	if (instanceIdx < m_modelInstances.Size())
+	{
+		ModelInstance const& moved = m_modelInstances[instanceIdx];
+		m_instanceHandleSlots[moved.m_handle.Slot()].m_instanceIdx = instanceIdx;
+
+		if (moved.m_treeProxy != AABBTree::c_invalidProxy)
+		{
+			m_instanceTree.SetUserData(moved.m_treeProxy, instanceIdx);
+		}
+	}
+
+	m_instanceEvents.PushBack(InstanceEvent{ InstanceEvent::Type::Removed, _handle });
+}
+
+void Scene::SetInstanceTransform(InstanceHandle _handle, kt::Mat4 const& _mtx)
+{
+	uint32_t const instanceIdx = InstanceIndex(_handle);
+	KT_ASSERT(instanceIdx != UINT32_MAX);
+
+	ModelInstance& inst = m_modelInstances[instanceIdx];
+	bool const markStatic = inst.m_isStatic && inst.m_isVisible;
+
+	if (markStatic)
+	{
+		// Both where it was and where it's going need re-rendering.
+		MarkStaticInstancesChanged(*this, InstanceWorldBounds(inst));
+	}
+
+	inst.m_mtx = _mtx;
+	kt::AABB const bounds = InstanceWorldBounds(inst);
+	m_transforms.SetLocal(m_transforms.FirstNode(inst.m_transformNodes), _mtx);
+
+	if (inst.m_treeProxy != AABBTree::c_invalidProxy)
+	{
+		m_instanceTree.Update(inst.m_treeProxy, bounds);
+	}
+
+	if (markStatic)
+	{
+		MarkStaticInstancesChanged(*this, bounds);
+	}
+
+	m_instanceEvents.PushBack(InstanceEvent{ InstanceEvent::Type::TransformChanged, _handle });
+}
+
+void Scene::SetInstanceVisible(InstanceHandle _handle, bool _visible)
+{
+	uint32_t const instanceIdx = InstanceIndex(_handle);
+	KT_ASSERT(instanceIdx != UINT32_MAX);
+
+	ModelInstance& inst = m_modelInstances[instanceIdx];
+
+	if (inst.m_isVisible == _visible)
+	{
+		return;
+	}
+
+	inst.m_isVisible = _visible;
+	kt::AABB const bounds = InstanceWorldBounds(inst);
+
+	if (_visible)
+	{
+		inst.m_treeProxy = m_instanceTree.Insert(bounds, instanceIdx);
+	}
+	else
+	{
+		m_instanceTree.Remove(inst.m_treeProxy);
+		inst.m_treeProxy = AABBTree::c_invalidProxy;
+	}
+
+	if (inst.m_isStatic)
+	{
+		MarkStaticInstancesChanged(*this, bounds);
+	}
+
+	m_instanceEvents.PushBack(InstanceEvent{ InstanceEvent::Type::VisibilityChanged, _handle });
+}
+
+void Scene::SetNodeTransform(InstanceHandle _handle, uint32_t _transformNodeIdx, kt::Mat4 const& _local)
+{
+	uint32_t const instanceIdx = InstanceIndex(_handle);
+	KT_ASSERT(instanceIdx != UINT32_MAX);
+
+	ModelInstance const& inst = m_modelInstances[instanceIdx];
+	KT_ASSERT(_transformNodeIdx + 1 < m_transforms.NumNodes(inst.m_transformNodes));
+
+	m_transforms.SetLocal(m_transforms.FirstNode(inst.m_transformNodes) + _transformNodeIdx + 1, _local);
+
+	if (inst.m_isStatic && inst.m_isVisible)
+	{
+		MarkStaticInstancesChanged(*this, InstanceWorldBounds(inst));
+	}
+
+	m_instanceEvents.PushBack(InstanceEvent{ InstanceEvent::Type::TransformChanged, _handle });
 }
 
 void Scene::BindPerFrameConstants(gpu::cmd::Context* _ctx)
@@ -292,7 +1145,7 @@ void Scene::BindPerFrameConstants(gpu::cmd::Context* _ctx)
 	// See: "shaderlib/GFXPerFrameBindings.hlsli"
 	gfx::ResourceManager::UnifiedBuffers const& buffers = gfx::ResourceManager::GetUnifiedBuffers();
 
-	gpu::DescriptorData frameSrvs[10];
+	gpu::DescriptorData frameSrvs[12];
 
 	frameSrvs[0].Set(m_iblIrradiance);
 	frameSrvs[1].Set(m_iblGgx);
@@ -304,6 +1157,8 @@ void Scene::BindPerFrameConstants(gpu::cmd::Context* _ctx)
 	frameSrvs[7].Set(buffers.m_posVertexBuf);
 	frameSrvs[8].Set(buffers.m_tangentSpaceVertexBuf);
 	frameSrvs[9].Set(buffers.m_uv0VertexBuf);
+	frameSrvs[10].Set(m_lightClusters.ClusterBuffer());
+	frameSrvs[11].Set(m_lightClusters.LightIndexBuffer());
 
 	gpu::cmd::SetGraphicsSRVTable(_ctx, frameSrvs, PATHOS_PER_FRAME_SPACE);
 }
@@ -6,6 +6,7 @@
 #include <shaderlib/CommonShared.h>
 
 #include <gpu/CommandContext.h>
+#include <gpu/CommandStream.h>
 #include <gpu/Types.h>
 #include <gpu/HandleRef.h>
 
@@ -15,6 +16,13 @@
 #include "Texture.h"
 #include "ResourceManager.h"
 #include "MeshRenderer.h"
+#include "RenderView.h"
+#include "InstanceTable.h"
+#include "TransformHierarchy.h"
+#include "AABBTree.h"
+#include "OcclusionBuffer.h"
+#include "DepthPyramid.h"
+#include "LightClusters.h"
 
 
 namespace gfx
@@ -51,6 +59,7 @@ public:
 	static uint32_t constexpr c_numShadowCascades = 4;
 
 	Scene();
+	~Scene();
 
 	void Init(uint32_t _shadowMapResolution = 2048);
 
@@ -61,9 +70,57 @@ public:
 	void RenderCascadeViews(gpu::cmd::Context* _ctx);
 	void RenderInstances(gpu::cmd::Context* _ctx);
 
+	// Gpu culling only: builds the depth pyramid from what RenderInstances drew into _depth, then retests what the early cull phase rejected.
+	// Returns true if RenderLateInstances has anything to draw, the caller must rebind its pso and targets first (compute work was done).
+	bool BuildDepthPyramidAndCullLate(gpu::cmd::Context* _ctx, gpu::TextureHandle _depth);
+	void RenderLateInstances(gpu::cmd::Context* _ctx);
+
 	void EndFrame();
 
-	void AddModelInstance(ResourceManager::ModelIdx _idx, kt::Mat4 const& _mtx);
+	struct ModelInstance;
+
+	// Generational, stays valid for the life of the instance and fails lookup after it's removed.
+	// Unlike an index into m_modelInstances, which changes whenever another instance is swapped into its place.
+	using InstanceHandle = ResourceManager::Index<ModelInstance>;
+
+	struct InstanceEvent
+	{
+		enum class Type : uint8_t
+		{
+			Added,
+			Removed,
+			TransformChanged,
+			VisibilityChanged
+		};
+
+		Type m_type;
+		InstanceHandle m_handle;
+	};
+
+	// Static instances are cached in the shadow cascades and the main view's draw batches, moving or removing one re-renders the cascades it touches and rebuilds the batches.
+	InstanceHandle AddModelInstance(ResourceManager::ModelIdx _idx, kt::Mat4 const& _mtx, bool _isStatic = true);
+
+	// Swaps the last instance into the removed one's place in m_modelInstances.
+	void RemoveModelInstance(InstanceHandle _handle);
+
+	// Instances must be moved through here so the instance tree stays in sync.
+	void SetInstanceTransform(InstanceHandle _handle, kt::Mat4 const& _mtx);
+
+	// Hidden instances are taken out of the instance tree, so aren't drawn, cast shadows or occlude anything.
+	void SetInstanceVisible(InstanceHandle _handle, bool _visible);
+
+	// Sets the local transform of one of the model's transform nodes (an index into Model::m_transformNodes), eg. for animation.
+	// Takes effect, along with everything below the node, in the next BeginFrameAndUpdateBuffers. Culling still uses the model's rest pose bounds.
+	void SetNodeTransform(InstanceHandle _handle, uint32_t _transformNodeIdx, kt::Mat4 const& _local);
+
+	bool IsInstanceLive(InstanceHandle _handle) const { return InstanceIndex(_handle) != UINT32_MAX; }
+
+	// Current index into m_modelInstances, UINT32_MAX if the instance was removed.
+	uint32_t InstanceIndex(InstanceHandle _handle) const;
+
+	// Everything that happened to instances since the last EndFrame, in order.
+	// Anything keeping its own per instance state (eg. a gpu copy of the scene) can follow this rather than rescanning m_modelInstances.
+	kt::Array<InstanceEvent> const& InstanceEvents() const { return m_instanceEvents; }
 
 	void BindPerFrameConstants(gpu::cmd::Context* _ctx);
 
@@ -71,24 +128,114 @@ public:
 	{
 		kt::Mat4 m_mtx;
 		ResourceManager::ModelIdx m_modelIdx;
+		AABBTree::ProxyId m_treeProxy = AABBTree::c_invalidProxy;
+
+		// One slot per model node in m_instanceTable.
+		InstanceTable::RangeHandle m_instanceSlots = InstanceTable::c_invalidRange;
+
+		// Instance root followed by the model's transform nodes, in m_transforms.
+		TransformHierarchy::RangeHandle m_transformNodes = TransformHierarchy::c_invalidRange;
+
+		InstanceHandle m_handle;
+
+		bool m_isStatic = true;
+		bool m_isVisible = true;
+	};
+
+	struct ShadowCascadeCache
+	{
+		// Sun direction the cascade's static casters were rendered with.
+		kt::Vec3 m_lightDir = kt::Vec3(0.0f);
+
+		// m_shadowStaticCacheTex holds the static casters for m_shadowViews.
+		bool m_staticValid = false;
+
+		// Decided in BeginFrameAndUpdateBuffers.
+		bool m_renderStaticThisFrame = false;
+		bool m_updateThisFrame = true;
 	};
 
+	// Packed, removal swaps the last instance into the gap.
 	kt::Array<ModelInstance> m_modelInstances;
 
-	gfx::Camera m_shadowCascades[c_numShadowCascades];
+	struct InstanceHandleSlot
+	{
+		uint32_t m_version = 1;
+		uint32_t m_instanceIdx = UINT32_MAX;
+	};
+
+	// Indexed by InstanceHandle::Slot(), free slots are recycled with their version bumped.
+	kt::Array<InstanceHandleSlot> m_instanceHandleSlots;
+	kt::Array<uint32_t> m_freeInstanceHandleSlots;
+
+	kt::Array<InstanceEvent> m_instanceEvents;
+
+	// World bounds of visible m_modelInstances, leaves store the instance index.
+	gfx::AABBTree m_instanceTree;
+
+	// Transforms of every mesh instance, persistent on the gpu. Renderers submit slots from here.
+	gfx::InstanceTable m_instanceTable;
+
+	// Node transforms of every instance, world transforms of mesh nodes are copied into m_instanceTable as they change.
+	gfx::TransformHierarchy m_transforms;
+
+	// Camera from BeginFrameAndUpdateBuffers. Static instances are batched once into its renderer.
+	gfx::RenderView m_mainView;
+
+	// Casters outside the main view still shadow visible areas, so cascades can't share the main view's culled batches.
+	// Each cascade has its own casters, culled against the cascade volume extruded toward the light.
+	// With shadow caching the renderer only holds dynamic casters, static ones go to the cached renderer and are drawn into m_shadowStaticCacheTex when it's invalidated.
+	gfx::RenderView m_shadowViews[c_numShadowCascades];
+	uint32_t m_numShadowCasterInstances[c_numShadowCascades] = {};
+
+	ShadowCascadeCache m_shadowCascadeCache[c_numShadowCascades];
+
+	// World bounds of static instances added, moved or removed since the cascade caches were last checked.
+	kt::AABB m_staticCasterChangeBounds;
+	bool m_hasStaticCasterChanges = false;
 
-	// TODO: Separate for each view, culling etc.
-	gfx::MeshRenderer m_meshRenderer;
+	// Static instances are batched once into the main view's renderer, rebuilt when any are added, moved or removed.
+	bool m_staticBatchesDirty = true;
+	bool m_staticBatchesEnabled = false;
+
+	// The batches bake unified buffer offsets, so they're also rebuilt after the buffers are compacted.
+	uint32_t m_staticBatchesUnifiedGeneration = 0;
+
+	uint32_t m_frameIdx = 0;
+
+	// If set, used for main view culling instead (eg. locked frustum debugging in the editor).
+	gfx::Camera const* m_debugCullCamera = nullptr;
 
 	gfx::GPUCullingBuffers m_scratchCullingBuffers;
 
+	// Each view's cpu draw build is recorded into its own stream on the job threads, then replayed in view order.
+	gpu::cmd::CommandStream* m_viewCommandStreams[1 + c_numShadowCascades] = {};
+
+	// Main view depth, kept between frames for the early gpu cull phase.
+	gfx::DepthPyramid m_depthPyramid;
+
+	// Largest visible instances are rasterized here each frame, instances and submeshes behind them are culled.
+	gfx::OcclusionBuffer m_occlusionBuffer;
+	uint32_t m_numOccludedInstances = 0;
+
+	struct LodStats
+	{
+		// Main view instances at each detail level this frame, and those too small to draw.
+		uint32_t m_numInstances[c_maxMeshLods] = {};
+		uint32_t m_numCulled = 0;
+	};
+
+	LodStats m_lodStats;
+
 	kt::Array<Light> m_lights;
 	gpu::BufferRef m_lightGpuBuf;
+	gfx::LightClusters m_lightClusters;
 
 	shaderlib::FrameConstants m_frameConstants;
 	gpu::BufferRef m_frameConstantsGpuBuf;
 
 	gpu::TextureRef m_shadowCascadeTex;
+	gpu::TextureRef m_shadowStaticCacheTex;
 
 	// TODO: MoveMe.
 	gpu::TextureRef m_iblIrradiance;
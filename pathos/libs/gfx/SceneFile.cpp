@@ -0,0 +1,437 @@
+#include "SceneFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <kt/Hash.h>
+#include <kt/HashMap.h>
+#include <kt/Strings.h>
+#include <kt/Logging.h>
+#include <kt/Macros.h>
+
+#include "Scene.h"
+#include "Model.h"
+#include "Material.h"
+#include "ResourceManager.h"
+
+namespace gfx
+{
+
+namespace SceneFile
+{
+
+static_assert(sizeof(Header) % c_arrayAlignment == 0, "Scene file header should keep the first array aligned.");
+static_assert(sizeof(ModelRef) == 16, "Scene file layout changed, bump c_version.");
+static_assert(sizeof(MaterialParams) == 32, "Scene file layout changed, bump c_version.");
+static_assert(sizeof(Instance) == 80, "Scene file layout changed, bump c_version.");
+static_assert(sizeof(Light) == 96, "Scene file layout changed, bump c_version.");
+static_assert(sizeof(kt::Mat4) == sizeof(float) * 16, "Transforms are copied as 16 floats.");
+
+static uint32_t AlignArrayOffset(uint32_t _offset)
+{
+	return (_offset + c_arrayAlignment - 1) & ~(c_arrayAlignment - 1);
+}
+
+// Materials of a model in the order their submeshes first use them, which is stable across loads of the same file.
+static void GatherModelMaterials(Model const& _model, kt::Array<ResourceManager::MaterialIdx>& o_materials)
+{
+	o_materials.Clear();
+
+	for (ResourceManager::MeshIdx meshIdx : _model.m_meshes)
+	{
+		Mesh const* mesh = ResourceManager::GetMesh(meshIdx);
+
+		for (Mesh::SubMesh const& subMesh : mesh->m_subMeshes)
+		{
+			// Submeshes without a material have no params to store.
+			if (!subMesh.m_materialIdx.IsValid())
+			{
+				continue;
+			}
+
+			bool seen = false;
+			for (ResourceManager::MaterialIdx matIdx : o_materials)
+			{
+				if (matIdx == subMesh.m_materialIdx)
+				{
+					seen = true;
+					break;
+				}
+			}
+
+			if (!seen)
+			{
+				o_materials.PushBack(subMesh.m_materialIdx);
+			}
+		}
+	}
+}
+
+void Write(Scene const& _scene, kt::Array<uint8_t>& o_data)
+{
+	kt::Array<ModelRef> models;
+	kt::Array<MaterialParams> materials;
+	kt::Array<char> strings;
+	kt::Array<ResourceManager::MaterialIdx> modelMaterials;
+
+	// Path hash to index into models, the same file loaded twice is still one model.
+	kt::HashMap<uint32_t, uint32_t, kt::HashMap_KeyOps_IdentityInt<uint32_t>> modelLookup;
+
+	uint32_t const numInstances = _scene.m_modelInstances.Size();
+	uint32_t const numLights = _scene.m_lights.Size();
+
+	kt::Array<Instance> instances;
+	instances.PushBack_Raw(numInstances);
+
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		Scene::ModelInstance const& sceneInstance = _scene.m_modelInstances[i];
+		Model const* model = ResourceManager::GetModel(sceneInstance.m_modelIdx);
+
+		uint32_t const pathHash = kt::StringHashI(model->m_name.c_str());
+
+		if (modelLookup.Find(pathHash) == modelLookup.End())
+		{
+			modelLookup.Insert(pathHash, models.Size());
+
+			ModelRef& ref = models.PushBack();
+			ref.m_pathHash = pathHash;
+			ref.m_pathOffset = strings.Size();
+
+			uint32_t const pathLen = uint32_t(model->m_name.size());
+			memcpy(strings.PushBack_Raw(pathLen + 1), model->m_name.c_str(), pathLen + 1);
+
+			GatherModelMaterials(*model, modelMaterials);
+			ref.m_firstMaterial = materials.Size();
+			ref.m_numMaterials = modelMaterials.Size();
+
+			for (ResourceManager::MaterialIdx matIdx : modelMaterials)
+			{
+				Material::Params const& params = ResourceManager::GetMaterial(matIdx)->m_params;
+
+				MaterialParams& out = materials.PushBack();
+				memset(&out, 0, sizeof(out));
+				memcpy(out.m_baseColour, &params.m_baseColour, sizeof(out.m_baseColour));
+				out.m_roughnessFactor = params.m_roughnessFactor;
+				out.m_metallicFactor = params.m_metallicFactor;
+				out.m_alphaCutoff = params.m_alphaCutoff;
+				out.m_alphaMode = uint32_t(params.m_alphaMode);
+			}
+		}
+
+		Instance& out = instances[i];
+		memset(&out, 0, sizeof(out));
+		memcpy(out.m_mtx, &sceneInstance.m_mtx, sizeof(out.m_mtx));
+		out.m_modelPathHash = pathHash;
+		out.m_flags = (sceneInstance.m_isStatic ? Instance_Static : 0) | (sceneInstance.m_isVisible ? Instance_Visible : 0);
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+
+	header.m_magic = c_magic;
+	header.m_version = c_version;
+
+	uint32_t offset = sizeof(Header);
+
+	auto placeArray = [&offset](uint32_t _num, uint32_t _elemSize, uint32_t& o_num, uint32_t& o_offset)
+	{
+		offset = AlignArrayOffset(offset);
+		o_num = _num;
+		o_offset = offset;
+		offset += _num * _elemSize;
+	};
+
+	placeArray(models.Size(), sizeof(ModelRef), header.m_numModels, header.m_modelsOffset);
+	placeArray(materials.Size(), sizeof(MaterialParams), header.m_numMaterials, header.m_materialsOffset);
+	placeArray(numInstances, sizeof(Instance), header.m_numInstances, header.m_instancesOffset);
+	placeArray(numLights, sizeof(Light), header.m_numLights, header.m_lightsOffset);
+	placeArray(strings.Size(), 1, header.m_stringsSize, header.m_stringsOffset);
+
+	header.m_fileSize = offset;
+
+	memcpy(header.m_sunColour, &_scene.m_sunColor, sizeof(header.m_sunColour));
+	header.m_sunIntensity = _scene.m_sunIntensity;
+	memcpy(header.m_sunThetaPhi, &_scene.m_sunThetaPhi, sizeof(header.m_sunThetaPhi));
+
+	o_data.Clear();
+	uint8_t* data = o_data.PushBack_Raw(header.m_fileSize);
+	memset(data, 0, header.m_fileSize);
+
+	memcpy(data, &header, sizeof(header));
+	memcpy(data + header.m_modelsOffset, models.Data(), models.Size() * sizeof(ModelRef));
+	memcpy(data + header.m_materialsOffset, materials.Data(), materials.Size() * sizeof(MaterialParams));
+	memcpy(data + header.m_instancesOffset, instances.Data(), numInstances * sizeof(Instance));
+	memcpy(data + header.m_stringsOffset, strings.Data(), strings.Size());
+
+	Light* lights = (Light*)(data + header.m_lightsOffset);
+	for (uint32_t i = 0; i < numLights; ++i)
+	{
+		gfx::Light const& sceneLight = _scene.m_lights[i];
+		memcpy(lights[i].m_transform, &sceneLight.m_transform, sizeof(lights[i].m_transform));
+		memcpy(lights[i].m_colour, &sceneLight.m_colour, sizeof(lights[i].m_colour));
+		lights[i].m_intensity = sceneLight.m_intensity;
+		lights[i].m_radius = sceneLight.m_radius;
+		lights[i].m_spotInnerAngle = sceneLight.m_spotInnerAngle;
+		lights[i].m_spotOuterAngle = sceneLight.m_spotOuterAngle;
+		lights[i].m_type = uint32_t(sceneLight.m_type);
+	}
+}
+
+Header const* Validate(void const* _data, uint32_t _size)
+{
+	if (_size < sizeof(Header) || (uintptr_t(_data) % alignof(Header)) != 0)
+	{
+		return nullptr;
+	}
+
+	Header const* header = (Header const*)_data;
+
+	if (header->m_magic != c_magic)
+	{
+		KT_LOG_ERROR("Not a scene file.");
+		return nullptr;
+	}
+
+	if (header->m_version != c_version)
+	{
+		KT_LOG_ERROR("Scene file version %u, expected %u.", header->m_version, c_version);
+		return nullptr;
+	}
+
+	if (header->m_fileSize > _size)
+	{
+		KT_LOG_ERROR("Scene file truncated, %u bytes of %u.", _size, header->m_fileSize);
+		return nullptr;
+	}
+
+	auto arrayInBounds = [header](uint32_t _num, uint32_t _elemSize, uint32_t _offset)
+	{
+		return _offset % c_arrayAlignment == 0
+			&& _offset <= header->m_fileSize
+			&& uint64_t(_num) * _elemSize <= uint64_t(header->m_fileSize - _offset);
+	};
+
+	if (!arrayInBounds(header->m_numModels, sizeof(ModelRef), header->m_modelsOffset)
+		|| !arrayInBounds(header->m_numMaterials, sizeof(MaterialParams), header->m_materialsOffset)
+		|| !arrayInBounds(header->m_numInstances, sizeof(Instance), header->m_instancesOffset)
+		|| !arrayInBounds(header->m_numLights, sizeof(Light), header->m_lightsOffset)
+		|| !arrayInBounds(header->m_stringsSize, 1, header->m_stringsOffset))
+	{
+		KT_LOG_ERROR("Scene file has an array out of bounds.");
+		return nullptr;
+	}
+
+	char const* strings = (char const*)_data + header->m_stringsOffset;
+	ModelRef const* models = (ModelRef const*)((uint8_t const*)_data + header->m_modelsOffset);
+
+	for (uint32_t i = 0; i < header->m_numModels; ++i)
+	{
+		ModelRef const& ref = models[i];
+
+		bool const pathTerminated = ref.m_pathOffset < header->m_stringsSize && memchr(strings + ref.m_pathOffset, 0, header->m_stringsSize - ref.m_pathOffset);
+		bool const materialsInBounds = uint64_t(ref.m_firstMaterial) + ref.m_numMaterials <= header->m_numMaterials;
+
+		if (!pathTerminated || !materialsInBounds)
+		{
+			KT_LOG_ERROR("Scene file model %u is out of bounds.", i);
+			return nullptr;
+		}
+	}
+
+	return header;
+}
+
+bool Read(Scene& io_scene, void const* _data, uint32_t _size)
+{
+	Header const* header = Validate(_data, _size);
+	if (!header)
+	{
+		return false;
+	}
+
+	uint8_t const* data = (uint8_t const*)_data;
+	ModelRef const* models = (ModelRef const*)(data + header->m_modelsOffset);
+	MaterialParams const* materials = (MaterialParams const*)(data + header->m_materialsOffset);
+	Instance const* instances = (Instance const*)(data + header->m_instancesOffset);
+	Light const* lights = (Light const*)(data + header->m_lightsOffset);
+	char const* strings = (char const*)(data + header->m_stringsOffset);
+
+	using ModelLookup = kt::HashMap<uint32_t, ResourceManager::ModelIdx, kt::HashMap_KeyOps_IdentityInt<uint32_t>>;
+
+	ModelLookup loadedModels;
+	ResourceManager::EnumModels([&loadedModels](ResourceManager::ModelIdx _idx, gfx::Model& _model)
+	{
+		loadedModels.Insert(kt::StringHashI(_model.m_name.c_str()), _idx);
+	});
+
+	// Models this load created. Their creation reference is dropped once instances hold their own, so they're freed with their last instance.
+	kt::Array<ResourceManager::ModelIdx> createdModels;
+	ModelLookup fileModels;
+	kt::Array<ResourceManager::MaterialIdx> modelMaterials;
+
+	for (uint32_t i = 0; i < header->m_numModels; ++i)
+	{
+		ModelRef const& ref = models[i];
+		char const* path = strings + ref.m_pathOffset;
+
+		ResourceManager::ModelIdx modelIdx;
+
+		ModelLookup::Iterator it = loadedModels.Find(ref.m_pathHash);
+		if (it != loadedModels.End())
+		{
+			modelIdx = it->m_val;
+		}
+		else
+		{
+			modelIdx = ResourceManager::CreateModelFromGLTF(path);
+			createdModels.PushBack(modelIdx);
+		}
+
+		fileModels.Insert(ref.m_pathHash, modelIdx);
+
+		GatherModelMaterials(*ResourceManager::GetModel(modelIdx), modelMaterials);
+		if (modelMaterials.Size() != ref.m_numMaterials)
+		{
+			KT_LOG_ERROR("Scene file has %u materials for %s, the model has %u. Keeping the model's.", ref.m_numMaterials, path, modelMaterials.Size());
+			continue;
+		}
+
+		for (uint32_t matIdx = 0; matIdx < ref.m_numMaterials; ++matIdx)
+		{
+			MaterialParams const& fileParams = materials[ref.m_firstMaterial + matIdx];
+			Material::Params& params = ResourceManager::GetMaterial(modelMaterials[matIdx])->m_params;
+
+			memcpy(&params.m_baseColour, fileParams.m_baseColour, sizeof(fileParams.m_baseColour));
+			params.m_roughnessFactor = fileParams.m_roughnessFactor;
+			params.m_metallicFactor = fileParams.m_metallicFactor;
+			params.m_alphaCutoff = fileParams.m_alphaCutoff;
+			params.m_alphaMode = Material::AlphaMode(kt::Min(fileParams.m_alphaMode, uint32_t(Material::AlphaMode::Transparent)));
+		}
+	}
+
+	if (header->m_numMaterials)
+	{
+		ResourceManager::SetMaterialsDirty();
+	}
+
+	uint32_t numSkipped = 0;
+
+	for (uint32_t i = 0; i < header->m_numInstances; ++i)
+	{
+		Instance const& instance = instances[i];
+
+		ModelLookup::Iterator it = fileModels.Find(instance.m_modelPathHash);
+		if (it == fileModels.End())
+		{
+			++numSkipped;
+			continue;
+		}
+
+		kt::Mat4 mtx;
+		memcpy(&mtx, instance.m_mtx, sizeof(instance.m_mtx));
+
+		Scene::InstanceHandle const handle = io_scene.AddModelInstance(it->m_val, mtx, (instance.m_flags & Instance_Static) != 0);
+
+		if (!(instance.m_flags & Instance_Visible))
+		{
+			io_scene.SetInstanceVisible(handle, false);
+		}
+	}
+
+	if (numSkipped)
+	{
+		KT_LOG_ERROR("Scene file has %u instances of models not in its model table.", numSkipped);
+	}
+
+	for (ResourceManager::ModelIdx modelIdx : createdModels)
+	{
+		ResourceManager::Release(modelIdx);
+	}
+
+	gfx::Light* sceneLights = io_scene.m_lights.PushBack_Raw(header->m_numLights);
+	for (uint32_t i = 0; i < header->m_numLights; ++i)
+	{
+		Light const& light = lights[i];
+		gfx::Light& sceneLight = sceneLights[i];
+
+		memcpy(&sceneLight.m_transform, light.m_transform, sizeof(light.m_transform));
+		memcpy(&sceneLight.m_colour, light.m_colour, sizeof(light.m_colour));
+		sceneLight.m_intensity = light.m_intensity;
+		sceneLight.m_radius = light.m_radius;
+		sceneLight.m_spotInnerAngle = light.m_spotInnerAngle;
+		sceneLight.m_spotOuterAngle = light.m_spotOuterAngle;
+		sceneLight.m_type = light.m_type < uint32_t(gfx::Light::Type::Count) ? gfx::Light::Type(light.m_type) : gfx::Light::Type::Point;
+	}
+
+	memcpy(&io_scene.m_sunColor, header->m_sunColour, sizeof(header->m_sunColour));
+	io_scene.m_sunIntensity = header->m_sunIntensity;
+	memcpy(&io_scene.m_sunThetaPhi, header->m_sunThetaPhi, sizeof(header->m_sunThetaPhi));
+
+	return true;
+}
+
+bool Save(Scene const& _scene, char const* _path)
+{
+	kt::Array<uint8_t> data;
+	Write(_scene, data);
+
+	FILE* file = fopen(_path, "wb");
+	if (!file)
+	{
+		KT_LOG_ERROR("Failed to open %s for writing.", _path);
+		return false;
+	}
+	KT_SCOPE_EXIT(fclose(file));
+
+	if (fwrite(data.Data(), 1, data.Size(), file) != data.Size())
+	{
+		KT_LOG_ERROR("Failed to write scene file %s.", _path);
+		return false;
+	}
+
+	return true;
+}
+
+bool Load(Scene& io_scene, char const* _path)
+{
+	FILE* file = fopen(_path, "rb");
+	if (!file)
+	{
+		KT_LOG_ERROR("Failed to open scene file %s.", _path);
+		return false;
+	}
+	KT_SCOPE_EXIT(fclose(file));
+
+	fseek(file, 0, SEEK_END);
+	long const size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size <= 0 || uint64_t(size) > UINT32_MAX)
+	{
+		KT_LOG_ERROR("Scene file %s has a bad size.", _path);
+		return false;
+	}
+
+	// One read of the whole file, the arrays are used from this buffer in place.
+	kt::Array<uint8_t> data;
+	uint8_t* mem = data.PushBack_Raw(uint32_t(size));
+
+	if (fread(mem, 1, size_t(size), file) != size_t(size))
+	{
+		KT_LOG_ERROR("Failed to read scene file %s.", _path);
+		return false;
+	}
+
+	if (!Read(io_scene, mem, uint32_t(size)))
+	{
+		KT_LOG_ERROR("Failed to load scene file %s.", _path);
+		return false;
+	}
+
+	return true;
+}
+
+}
+
+}
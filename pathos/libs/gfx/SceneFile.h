@@ -0,0 +1,110 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+
+namespace gfx
+{
+
+class Scene;
+
+// Binary scene file: a header followed by flat arrays at the offsets it gives, with no pointers or per element encoding.
+// A file read (or mapped) into memory is used in place, lights and instances are copied straight out of their arrays.
+// Instances reference models by the case insensitive hash of the model's path (kt::StringHashI), the model table maps each hash to its path.
+namespace SceneFile
+{
+
+uint32_t constexpr c_magic = 0x4e435350;	// 'PSCN'
+uint32_t constexpr c_version = 1;
+
+// Arrays start aligned to this from the start of the file.
+uint32_t constexpr c_arrayAlignment = 16;
+
+struct Header
+{
+	uint32_t m_magic;
+	uint32_t m_version;
+	uint32_t m_fileSize;
+	uint32_t m_pad0;
+
+	uint32_t m_numModels;
+	uint32_t m_modelsOffset;
+
+	uint32_t m_numMaterials;
+	uint32_t m_materialsOffset;
+
+	uint32_t m_numInstances;
+	uint32_t m_instancesOffset;
+
+	uint32_t m_numLights;
+	uint32_t m_lightsOffset;
+
+	// Null terminated model paths.
+	uint32_t m_stringsSize;
+	uint32_t m_stringsOffset;
+
+	float m_sunColour[3];
+	float m_sunIntensity;
+	float m_sunThetaPhi[2];
+	uint32_t m_pad1[4];
+};
+
+struct ModelRef
+{
+	uint32_t m_pathHash;
+	uint32_t m_pathOffset;	// Into the strings.
+
+	// Params of the model's materials, in the order they're first used by its meshes' submeshes.
+	uint32_t m_firstMaterial;
+	uint32_t m_numMaterials;
+};
+
+struct MaterialParams
+{
+	float m_baseColour[4];
+	float m_roughnessFactor;
+	float m_metallicFactor;
+	float m_alphaCutoff;
+	uint32_t m_alphaMode;
+};
+
+enum InstanceFlags : uint32_t
+{
+	Instance_Static = 0x1,
+	Instance_Visible = 0x2
+};
+
+struct Instance
+{
+	float m_mtx[16];
+	uint32_t m_modelPathHash;
+	uint32_t m_flags;	// InstanceFlags
+	uint32_t m_pad[2];
+};
+
+struct Light
+{
+	float m_transform[16];
+	float m_colour[3];
+	float m_intensity;
+	float m_radius;
+	float m_spotInnerAngle;
+	float m_spotOuterAngle;
+	uint32_t m_type;
+};
+
+// Writes the scene's instances, lights, sun and the params of materials used by its instances' models.
+void Write(Scene const& _scene, kt::Array<uint8_t>& o_data);
+
+// Checks the header and that every array and path lies within _size bytes. Returns nullptr if not.
+Header const* Validate(void const* _data, uint32_t _size);
+
+// Adds the file's instances and lights to the scene and sets its sun. Models already loaded with a matching path are reused, the rest are loaded.
+// Stored material params overwrite those of the models they belong to.
+bool Read(Scene& io_scene, void const* _data, uint32_t _size);
+
+bool Save(Scene const& _scene, char const* _path);
+bool Load(Scene& io_scene, char const* _path);
+
+}
+
+}
@@ -21,7 +21,8 @@ void CalculateShadowCascades
 	uint32_t _shadowResolution, 
 	uint32_t _numCascades,
 	Camera *o_cascades, 
-	float *o_splitsViewSpace
+	float *o_splitsViewSpace,
+	float _extentScale
 )
 {
 	Camera::ProjectionParams const& viewParams = i_cam.GetProjectionParams();
@@ -91,6 +92,7 @@ void CalculateShadowCascades
 				sphRad = kt::Max(sphRad, kt::Length(p1 - frustumCenter));
 				sphRad = kt::Max(sphRad, kt::Length(p2 - frustumCenter));
 			}
+			sphRad *= _extentScale;
 			frustumAabbLightSpace.m_min = kt::Vec3(-sphRad );
 			frustumAabbLightSpace.m_max = kt::Vec3( sphRad );
 		}
@@ -131,6 +133,9 @@ gpu::PSORef CreateShadowMapPSO(gpu::Format _depthFormat)
 
 	desc.m_rasterDesc.m_scopedScaledDepthBias = 3.0f;
 
+	// Casters between the light and a cascade's near plane are kept by culling, clamping flattens them onto the near plane.
+	desc.m_rasterDesc.m_depthClip = 0;
+
 	gpu::ShaderRef const vs = ResourceManager::LoadShader("shaders/ShadowMap.vs.cso", gpu::ShaderType::Vertex);
 
 	desc.m_vs = vs;
@@ -9,6 +9,7 @@ namespace gfx
 {
 struct Camera;
 
+// _extentScale grows each cascade past the bounds of its slice of the view, so a cached cascade still covers the slice after the view moves a little.
 void CalculateShadowCascades
 (
 	gfx::Camera const& i_cam,
@@ -16,7 +17,8 @@ void CalculateShadowCascades
 	uint32_t _shadowResolution,
 	uint32_t _numCascades,
 	gfx::Camera *o_cascades,
-	float *o_splitsViewSpace
+	float *o_splitsViewSpace,
+	float _extentScale = 1.0f
 );
 
 gpu::PSORef CreateShadowMapPSO(gpu::Format _depthFormat);
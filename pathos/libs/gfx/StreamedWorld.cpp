@@ -0,0 +1,643 @@
+#include <math.h>
+
+#include <kt/Hash.h>
+#include <kt/Strings.h>
+#include <kt/Logging.h>
+
+#include <core/CVar.h>
+
+#include "StreamedWorld.h"
+#include "Model.h"
+#include "Material.h"
+#include "Texture.h"
+
+namespace gfx
+{
+
+core::CVar<float> s_worldLoadRadius("gfx.world.load_radius", "streamed world cells closer than this to the camera are loaded", 256.0f, 0.0f, 100000.0f);
+core::CVar<float> s_worldUnloadRadius("gfx.world.unload_radius", "streamed world cells further than this from the camera are unloaded (at least the load radius)", 320.0f, 0.0f, 100000.0f);
+core::CVar<float> s_worldGeometryBudgetMb("gfx.world.geometry_budget_mb", "vertex and index memory of resident streamed models, 0 for no limit", 512.0f, 0.0f, 65536.0f);
+core::CVar<float> s_worldTextureBudgetMb("gfx.world.texture_budget_mb", "texture memory of resident streamed models, 0 for no limit", 1024.0f, 0.0f, 65536.0f);
+core::CVar<float> s_worldLoadBudgetMs("gfx.world.load_budget_ms", "main thread time a frame spends creating models and instancing cells, at least one model is created a frame", 4.0f, 0.0f, 100.0f);
+core::CVar<float> s_worldHitchMs("gfx.world.hitch_ms", "stream updates taking longer than this are counted as hitches", 8.0f, 0.0f, 1000.0f);
+
+static uint64_t PackCellCoords(int32_t _x, int32_t _z)
+{
+	return (uint64_t(uint32_t(_x)) << 32) | uint64_t(uint32_t(_z));
+}
+
+static float MsSince(kt::TimePoint const& _start)
+{
+	return float((kt::TimePoint::Now() - _start).Seconds() * 1000.0);
+}
+
+static uint64_t MeshGeometryBytes(Mesh const& _mesh)
+{
+	uint64_t const vertexBytes = sizeof(kt::Vec3) + sizeof(TangentSpace) + sizeof(kt::Vec2);
+	return uint64_t(_mesh.m_numVertices) * vertexBytes + uint64_t(_mesh.m_numIndices) * sizeof(uint32_t);
+}
+
+static uint64_t TextureBytes(Texture const& _tex)
+{
+	uint64_t bytes = 0;
+	uint32_t const texelSize = gpu::GetFormatSize(_tex.m_format);
+
+	for (uint32_t mip = 0; mip < kt::Max(_tex.m_numMips, 1u); ++mip)
+	{
+		uint64_t const w = kt::Max(_tex.m_width >> mip, 1u);
+		uint64_t const h = kt::Max(_tex.m_height >> mip, 1u);
+		bytes += w * h * texelSize;
+	}
+
+	return bytes;
+}
+
+StreamedWorld::~StreamedWorld()
+{
+	Shutdown();
+}
+
+void StreamedWorld::Init(Scene* _scene, float _cellSize)
+{
+	KT_ASSERT(_scene);
+	KT_ASSERT(_cellSize > 0.0f);
+	KT_ASSERT(!m_ioThread.joinable());
+
+	m_scene = _scene;
+	m_cellSize = _cellSize;
+	m_ioQuit = false;
+
+	m_ioThread = std::thread([this]() { IoThreadMain(); });
+}
+
+void StreamedWorld::Shutdown()
+{
+	if (m_ioThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_ioMutex);
+			m_ioQuit = true;
+		}
+
+		m_ioCv.notify_one();
+		m_ioThread.join();
+	}
+
+	for (IoResult const& result : m_ioCompleted)
+	{
+		delete result.m_parsed;
+	}
+
+	for (Cell& cell : m_cells)
+	{
+		if (cell.m_state != CellState::Unloaded)
+		{
+			UnloadCell(cell);
+		}
+	}
+
+	for (StreamedModel& model : m_models)
+	{
+		delete model.m_parsed;
+	}
+
+	m_cells.Clear();
+	m_models.Clear();
+	m_cellLookup.Clear();
+	m_modelLookup.Clear();
+	m_ioRequests.Clear();
+	m_ioCompleted.Clear();
+
+	m_instanceBounds = kt::AABB::FloatMax();
+	m_stats = Stats{};
+	m_scene = nullptr;
+}
+
+uint32_t StreamedWorld::FindOrAddModel(char const* _path)
+{
+	uint32_t const hash = kt::StringHashI(_path);
+
+	auto it = m_modelLookup.Find(hash);
+	if (it != m_modelLookup.End())
+	{
+		KT_ASSERT(kt::StrCmpI(m_models[it->m_val].m_path.c_str(), _path) == 0 && "Model path hash collision.");
+		return it->m_val;
+	}
+
+	uint32_t const idx = m_models.Size();
+	m_models.PushBack().m_path = _path;
+	m_modelLookup.Insert(hash, idx);
+	return idx;
+}
+
+uint32_t StreamedWorld::FindOrAddCell(int32_t _x, int32_t _z)
+{
+	uint64_t const key = PackCellCoords(_x, _z);
+
+	auto it = m_cellLookup.Find(key);
+	if (it != m_cellLookup.End())
+	{
+		return it->m_val;
+	}
+
+	uint32_t const idx = m_cells.Size();
+	Cell& cell = m_cells.PushBack();
+	cell.m_x = _x;
+	cell.m_z = _z;
+	m_cellLookup.Insert(key, idx);
+	return idx;
+}
+
+void StreamedWorld::AddInstance(char const* _modelPath, kt::Mat4 const& _mtx, bool _isStatic)
+{
+	KT_ASSERT(m_scene);
+
+	kt::Vec3 const pos = _mtx.GetPos();
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		m_instanceBounds.m_min[i] = kt::Min(m_instanceBounds.m_min[i], pos[i]);
+		m_instanceBounds.m_max[i] = kt::Max(m_instanceBounds.m_max[i], pos[i]);
+	}
+
+	int32_t const x = int32_t(floorf(pos.x / m_cellSize));
+	int32_t const z = int32_t(floorf(pos.z / m_cellSize));
+
+	uint32_t const modelIdx = FindOrAddModel(_modelPath);
+	Cell& cell = m_cells[FindOrAddCell(x, z)];
+
+	Cell::Instance& instance = cell.m_instances.PushBack();
+	instance.m_mtx = _mtx;
+	instance.m_model = modelIdx;
+	instance.m_isStatic = _isStatic;
+
+	bool newModel = true;
+	for (uint32_t usedModel : cell.m_models)
+	{
+		if (usedModel == modelIdx)
+		{
+			newModel = false;
+			break;
+		}
+	}
+
+	if (!newModel)
+	{
+		if (cell.m_state == CellState::Loaded)
+		{
+			instance.m_handle = m_scene->AddModelInstance(m_models[modelIdx].m_idx, _mtx, _isStatic);
+		}
+		return;
+	}
+
+	cell.m_models.PushBack(modelIdx);
+
+	if (cell.m_state != CellState::Unloaded)
+	{
+		// Simplest to take the cell back to loading, it's instanced again once the new model is resident.
+		UnloadCell(cell);
+		StartLoadingCell(cell);
+	}
+}
+
+float StreamedWorld::CellDistance(Cell const& _cell, kt::Vec3 const& _pos) const
+{
+	float const minX = float(_cell.m_x) * m_cellSize;
+	float const minZ = float(_cell.m_z) * m_cellSize;
+
+	float const dx = kt::Max(kt::Max(minX - _pos.x, _pos.x - (minX + m_cellSize)), 0.0f);
+	float const dz = kt::Max(kt::Max(minZ - _pos.z, _pos.z - (minZ + m_cellSize)), 0.0f);
+	return kt::Sqrt(dx * dx + dz * dz);
+}
+
+bool StreamedWorld::CanStartLoading(Cell const& _cell) const
+{
+	// Only models that aren't already used by another cell add to what's resident.
+	uint64_t geometryBytes = m_stats.m_residentGeometryBytes;
+	uint64_t textureBytes = m_stats.m_residentTextureBytes;
+
+	for (uint32_t modelIdx : _cell.m_models)
+	{
+		StreamedModel const& model = m_models[modelIdx];
+		if (model.m_numCellRefs == 0)
+		{
+			geometryBytes += model.m_geometryBytes;
+			textureBytes += model.m_textureBytes;
+		}
+	}
+
+	uint64_t const geometryBudget = uint64_t(double(s_worldGeometryBudgetMb) * 1024.0 * 1024.0);
+	uint64_t const textureBudget = uint64_t(double(s_worldTextureBudgetMb) * 1024.0 * 1024.0);
+
+	return (geometryBudget == 0 || geometryBytes <= geometryBudget)
+		&& (textureBudget == 0 || textureBytes <= textureBudget);
+}
+
+void StreamedWorld::StartLoadingCell(Cell& io_cell)
+{
+	KT_ASSERT(io_cell.m_state == CellState::Unloaded);
+	io_cell.m_state = CellState::Loading;
+	io_cell.m_cost.m_loadMs = 0.0f;
+
+	bool queuedReads = false;
+
+	for (uint32_t modelIdx : io_cell.m_models)
+	{
+		StreamedModel& model = m_models[modelIdx];
+		if (model.m_numCellRefs++ == 0)
+		{
+			// Models aren't resident with no cells using them, resident geometry is tracked as refs are taken.
+			m_stats.m_residentGeometryBytes += model.m_geometryBytes;
+			m_stats.m_residentTextureBytes += model.m_textureBytes;
+		}
+
+		if (model.m_state == ModelState::Unloaded)
+		{
+			model.m_state = ModelState::Reading;
+
+			std::lock_guard<std::mutex> lock(m_ioMutex);
+			IoRequest& request = m_ioRequests.PushBack();
+			request.m_model = modelIdx;
+			request.m_path = model.m_path;
+			queuedReads = true;
+		}
+	}
+
+	if (queuedReads)
+	{
+		m_ioCv.notify_one();
+	}
+}
+
+void StreamedWorld::UnloadCell(Cell& io_cell)
+{
+	KT_ASSERT(io_cell.m_state != CellState::Unloaded);
+
+	if (io_cell.m_state == CellState::Loaded)
+	{
+		for (Cell::Instance& instance : io_cell.m_instances)
+		{
+			// The scene may have been cleared under us (eg. loading a scene file in the editor).
+			if (m_scene->IsInstanceLive(instance.m_handle))
+			{
+				m_scene->RemoveModelInstance(instance.m_handle);
+				instance.m_handle = Scene::InstanceHandle{};
+			}
+		}
+
+		++m_stats.m_numCellUnloads;
+	}
+
+	io_cell.m_state = CellState::Unloaded;
+
+	for (uint32_t modelIdx : io_cell.m_models)
+	{
+		ReleaseModelRef(modelIdx);
+	}
+}
+
+void StreamedWorld::ReleaseModelRef(uint32_t _modelIdx)
+{
+	StreamedModel& model = m_models[_modelIdx];
+	KT_ASSERT(model.m_numCellRefs > 0);
+
+	if (--model.m_numCellRefs != 0)
+	{
+		return;
+	}
+
+	m_stats.m_residentGeometryBytes -= model.m_geometryBytes;
+	m_stats.m_residentTextureBytes -= model.m_textureBytes;
+
+	if (model.m_state == ModelState::Resident)
+	{
+		// Instances hold their own reference, they were removed with the cell.
+		ResourceManager::Release(model.m_idx);
+		model.m_idx = ResourceManager::ModelIdx{};
+		model.m_state = ModelState::Unloaded;
+		--m_stats.m_numResidentModels;
+	}
+	else if (model.m_state == ModelState::Read)
+	{
+		delete model.m_parsed;
+		model.m_parsed = nullptr;
+		model.m_state = ModelState::Unloaded;
+	}
+
+	// A model still being parsed is dropped when it finishes, unless a cell wants it again by then.
+}
+
+void StreamedWorld::CreateModel(StreamedModel& io_model)
+{
+	KT_ASSERT(io_model.m_state == ModelState::Read);
+
+	io_model.m_idx = ResourceManager::CreateModelFromParsed(*io_model.m_parsed);
+	delete io_model.m_parsed;
+	io_model.m_parsed = nullptr;
+	io_model.m_state = ModelState::Resident;
+	++m_stats.m_numResidentModels;
+
+	if (io_model.m_costKnown)
+	{
+		return;
+	}
+
+	// First load, measure what the model costs. Its cell ref was counted with zero bytes, so add them now.
+	Model const* model = ResourceManager::GetModel(io_model.m_idx);
+
+	uint64_t geometryBytes = 0;
+	uint64_t textureBytes = 0;
+
+	kt::Array<uint32_t> seenTextures;
+
+	for (ResourceManager::MeshIdx meshIdx : model->m_meshes)
+	{
+		Mesh const* mesh = ResourceManager::GetMesh(meshIdx);
+		geometryBytes += MeshGeometryBytes(*mesh);
+
+		for (Mesh::SubMesh const& subMesh : mesh->m_subMeshes)
+		{
+			Material const* mat = ResourceManager::GetMaterial(subMesh.m_materialIdx);
+			if (!mat)
+			{
+				continue;
+			}
+
+			for (ResourceManager::TextureIdx texIdx : mat->m_textures)
+			{
+				if (!texIdx.IsValid())
+				{
+					continue;
+				}
+
+				bool seen = false;
+				for (uint32_t seenTex : seenTextures)
+				{
+					if (seenTex == texIdx.m_packed)
+					{
+						seen = true;
+						break;
+					}
+				}
+
+				if (seen)
+				{
+					continue;
+				}
+
+				seenTextures.PushBack(texIdx.m_packed);
+				textureBytes += TextureBytes(*ResourceManager::GetTexture(texIdx));
+			}
+		}
+	}
+
+	io_model.m_geometryBytes = geometryBytes;
+	io_model.m_textureBytes = textureBytes;
+	io_model.m_costKnown = true;
+
+	m_stats.m_residentGeometryBytes += geometryBytes;
+	m_stats.m_residentTextureBytes += textureBytes;
+}
+
+void StreamedWorld::FinishLoads(kt::Vec3 const& _streamPos, float _budgetMs, kt::TimePoint const& _updateStart)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_ioMutex);
+		for (IoResult const& result : m_ioCompleted)
+		{
+			StreamedModel& model = m_models[result.m_model];
+			KT_ASSERT(model.m_state == ModelState::Reading);
+
+			if (model.m_numCellRefs == 0)
+			{
+				delete result.m_parsed;
+				model.m_state = ModelState::Unloaded;
+				continue;
+			}
+
+			model.m_parsed = result.m_parsed;
+			model.m_state = ModelState::Read;
+		}
+		m_ioCompleted.Clear();
+	}
+
+	struct LoadingCell
+	{
+		float m_dist;
+		uint32_t m_idx;
+	};
+
+	kt::Array<LoadingCell> loading;
+	for (uint32_t cellIdx = 0; cellIdx < m_cells.Size(); ++cellIdx)
+	{
+		if (m_cells[cellIdx].m_state == CellState::Loading)
+		{
+			LoadingCell const entry{ CellDistance(m_cells[cellIdx], _streamPos), cellIdx };
+
+			uint32_t insertAt = loading.Size();
+			loading.PushBack(entry);
+			while (insertAt > 0 && loading[insertAt - 1].m_dist > entry.m_dist)
+			{
+				loading[insertAt] = loading[insertAt - 1];
+				--insertAt;
+			}
+			loading[insertAt] = entry;
+		}
+	}
+
+	// Always make some progress, so a budget smaller than one model can't stall streaming.
+	bool didWork = false;
+
+	for (LoadingCell const& entry : loading)
+	{
+		Cell& cell = m_cells[entry.m_idx];
+		bool allResident = true;
+
+		for (uint32_t modelIdx : cell.m_models)
+		{
+			StreamedModel& model = m_models[modelIdx];
+
+			if (model.m_state == ModelState::Read)
+			{
+				if (didWork && MsSince(_updateStart) >= _budgetMs)
+				{
+					return;
+				}
+
+				kt::TimePoint const createStart = kt::TimePoint::Now();
+				CreateModel(model);
+				cell.m_cost.m_loadMs += MsSince(createStart);
+				didWork = true;
+			}
+
+			allResident &= model.m_state == ModelState::Resident;
+		}
+
+		if (!allResident)
+		{
+			continue;
+		}
+
+		if (didWork && MsSince(_updateStart) >= _budgetMs)
+		{
+			return;
+		}
+
+		kt::TimePoint const instanceStart = kt::TimePoint::Now();
+
+		for (Cell::Instance& instance : cell.m_instances)
+		{
+			instance.m_handle = m_scene->AddModelInstance(m_models[instance.m_model].m_idx, instance.m_mtx, instance.m_isStatic);
+		}
+
+		cell.m_cost.m_geometryBytes = 0;
+		cell.m_cost.m_textureBytes = 0;
+		for (uint32_t modelIdx : cell.m_models)
+		{
+			cell.m_cost.m_geometryBytes += m_models[modelIdx].m_geometryBytes;
+			cell.m_cost.m_textureBytes += m_models[modelIdx].m_textureBytes;
+		}
+
+		cell.m_state = CellState::Loaded;
+		cell.m_cost.m_loadMs += MsSince(instanceStart);
+		++m_stats.m_numCellLoads;
+		didWork = true;
+	}
+}
+
+void StreamedWorld::Update(kt::Vec3 const& _streamPos)
+{
+	KT_ASSERT(m_scene);
+
+	kt::TimePoint const updateStart = kt::TimePoint::Now();
+
+	float const loadRadius = s_worldLoadRadius;
+	float const unloadRadius = kt::Max(float(s_worldUnloadRadius), loadRadius);
+
+	struct CellDist
+	{
+		float m_dist;
+		uint32_t m_idx;
+	};
+
+	// Unloaded cells in range, nearest first. Loaded cells past the load radius, furthest first, are evicted for them if a budget is full.
+	kt::Array<CellDist> toLoad;
+	kt::Array<CellDist> evictable;
+
+	for (uint32_t cellIdx = 0; cellIdx < m_cells.Size(); ++cellIdx)
+	{
+		Cell& cell = m_cells[cellIdx];
+		float const dist = CellDistance(cell, _streamPos);
+
+		if (cell.m_state != CellState::Unloaded && dist > unloadRadius)
+		{
+			UnloadCell(cell);
+		}
+		else if (cell.m_state == CellState::Unloaded && dist <= loadRadius)
+		{
+			toLoad.PushBack(CellDist{ dist, cellIdx });
+		}
+		else if (cell.m_state == CellState::Loaded && dist > loadRadius)
+		{
+			evictable.PushBack(CellDist{ dist, cellIdx });
+		}
+	}
+
+	auto sortByDist = [](kt::Array<CellDist>& io_arr, bool _nearestFirst)
+	{
+		for (uint32_t i = 1; i < io_arr.Size(); ++i)
+		{
+			CellDist const entry = io_arr[i];
+			uint32_t j = i;
+			while (j > 0 && (_nearestFirst ? io_arr[j - 1].m_dist > entry.m_dist : io_arr[j - 1].m_dist < entry.m_dist))
+			{
+				io_arr[j] = io_arr[j - 1];
+				--j;
+			}
+			io_arr[j] = entry;
+		}
+	};
+
+	sortByDist(toLoad, true);
+	sortByDist(evictable, false);
+
+	m_stats.m_numBudgetBlockedCells = 0;
+	uint32_t nextEvict = 0;
+
+	for (CellDist const& entry : toLoad)
+	{
+		Cell& cell = m_cells[entry.m_idx];
+
+		while (!CanStartLoading(cell) && nextEvict < evictable.Size())
+		{
+			UnloadCell(m_cells[evictable[nextEvict++].m_idx]);
+		}
+
+		if (CanStartLoading(cell))
+		{
+			StartLoadingCell(cell);
+		}
+		else
+		{
+			++m_stats.m_numBudgetBlockedCells;
+		}
+	}
+
+	FinishLoads(_streamPos, s_worldLoadBudgetMs, updateStart);
+
+	m_stats.m_numLoadedCells = 0;
+	m_stats.m_numLoadingCells = 0;
+	for (Cell const& cell : m_cells)
+	{
+		m_stats.m_numLoadedCells += cell.m_state == CellState::Loaded ? 1 : 0;
+		m_stats.m_numLoadingCells += cell.m_state == CellState::Loading ? 1 : 0;
+	}
+
+	m_stats.m_updateMs = MsSince(updateStart);
+	m_stats.m_maxUpdateMs = kt::Max(m_stats.m_maxUpdateMs, m_stats.m_updateMs);
+	m_stats.m_numHitches += m_stats.m_updateMs > s_worldHitchMs ? 1 : 0;
+	++m_stats.m_numUpdates;
+}
+
+void StreamedWorld::ResetHitchStats()
+{
+	m_stats.m_maxUpdateMs = 0.0f;
+	m_stats.m_numHitches = 0;
+	m_stats.m_numUpdates = 0;
+}
+
+void StreamedWorld::IoThreadMain()
+{
+	for (;;)
+	{
+		IoRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(m_ioMutex);
+			m_ioCv.wait(lock, [this]() { return m_ioQuit || m_ioRequests.Size() != 0; });
+
+			if (m_ioQuit)
+			{
+				return;
+			}
+
+			// Oldest first, cells queue their models nearest first.
+			request = m_ioRequests[0];
+			for (uint32_t i = 1; i < m_ioRequests.Size(); ++i)
+			{
+				m_ioRequests[i - 1] = m_ioRequests[i];
+			}
+			m_ioRequests.PopBack();
+		}
+
+		// A model that fails to parse is still created, empty, so its cells finish loading. The loader logs why.
+		ParsedModel* parsed = new ParsedModel;
+		parsed->LoadFromGLTF(request.m_path.c_str());
+
+		{
+			std::lock_guard<std::mutex> lock(m_ioMutex);
+			m_ioCompleted.PushBack(IoResult{ request.m_model, parsed });
+		}
+	}
+}
+
+}
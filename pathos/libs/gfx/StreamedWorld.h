@@ -0,0 +1,198 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+#include <kt/HashMap.h>
+#include <kt/Timer.h>
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "ResourceManager.h"
+#include "Scene.h"
+
+namespace gfx
+{
+
+// Model instances partitioned into a grid of cells on the xz plane, streamed into a Scene around a point (usually the camera).
+// Cells within gfx.world.load_radius are loaded nearest first, and unloaded once past gfx.world.unload_radius.
+// Model files are parsed ahead on an io thread, then their gpu resources are created and instanced on the main thread within gfx.world.load_budget_ms a frame.
+// Models are shared between cells, loaded with the first cell that needs them and released with the last.
+class StreamedWorld
+{
+public:
+	enum class CellState : uint8_t
+	{
+		Unloaded,
+		Loading,	// Waiting for its models to be read and created.
+		Loaded		// Instances are in the scene.
+	};
+
+	// Measured as a cell's models load, so zero until the cell has been loaded once.
+	struct CellCost
+	{
+		// Of every model the cell uses, including ones shared with other cells.
+		uint64_t m_geometryBytes = 0;
+		uint64_t m_textureBytes = 0;
+
+		// Main thread time the last load spent creating models and adding instances.
+		float m_loadMs = 0.0f;
+	};
+
+	struct Cell
+	{
+		int32_t m_x;
+		int32_t m_z;
+
+		CellState m_state = CellState::Unloaded;
+
+		// Into m_models, each model once.
+		kt::Array<uint32_t> m_models;
+
+		struct Instance
+		{
+			kt::Mat4 m_mtx;
+			uint32_t m_model;
+			bool m_isStatic;
+			Scene::InstanceHandle m_handle;
+		};
+
+		kt::Array<Instance> m_instances;
+
+		CellCost m_cost;
+	};
+
+	struct Stats
+	{
+		uint32_t m_numLoadedCells = 0;
+		uint32_t m_numLoadingCells = 0;
+
+		// Cells in range that weren't started, as they would go over a memory budget.
+		uint32_t m_numBudgetBlockedCells = 0;
+
+		uint32_t m_numResidentModels = 0;
+		uint64_t m_residentGeometryBytes = 0;
+		uint64_t m_residentTextureBytes = 0;
+
+		// Main thread time in Update.
+		float m_updateMs = 0.0f;
+		float m_maxUpdateMs = 0.0f;
+
+		// Updates over gfx.world.hitch_ms since the last ResetHitchStats.
+		uint32_t m_numHitches = 0;
+		uint32_t m_numUpdates = 0;
+
+		uint32_t m_numCellLoads = 0;
+		uint32_t m_numCellUnloads = 0;
+	};
+
+	StreamedWorld() = default;
+	~StreamedWorld();
+
+	KT_NO_COPY(StreamedWorld);
+
+	void Init(Scene* _scene, float _cellSize = 64.0f);
+
+	// Unloads every cell and forgets them.
+	void Shutdown();
+
+	// The cell is picked from the translation. Can be called at any time, the instance appears if its cell is loaded.
+	void AddInstance(char const* _modelPath, kt::Mat4 const& _mtx, bool _isStatic = true);
+
+	void Update(kt::Vec3 const& _streamPos);
+
+	kt::Array<Cell> const& Cells() const { return m_cells; }
+	float CellSize() const { return m_cellSize; }
+
+	// Union of every instance translation.
+	kt::AABB const& InstanceBounds() const { return m_instanceBounds; }
+
+	Stats const& GetStats() const { return m_stats; }
+	void ResetHitchStats();
+
+private:
+	enum class ModelState : uint8_t
+	{
+		Unloaded,
+		Reading,	// Queued for, or being parsed on, the io thread.
+		Read,		// Parsed, waiting for the main thread to create it.
+		Resident
+	};
+
+	struct StreamedModel
+	{
+		std::string m_path;
+
+		ModelState m_state = ModelState::Unloaded;
+		ResourceManager::ModelIdx m_idx;
+
+		// Set while Read, owned by the model.
+		ParsedModel* m_parsed = nullptr;
+
+		// Loading or loaded cells using the model.
+		uint32_t m_numCellRefs = 0;
+
+		uint64_t m_geometryBytes = 0;
+		uint64_t m_textureBytes = 0;
+		bool m_costKnown = false;
+	};
+
+	uint32_t FindOrAddModel(char const* _path);
+	uint32_t FindOrAddCell(int32_t _x, int32_t _z);
+
+	float CellDistance(Cell const& _cell, kt::Vec3 const& _pos) const;
+
+	// Returns false if the cell's models would go over a memory budget.
+	bool CanStartLoading(Cell const& _cell) const;
+
+	void StartLoadingCell(Cell& io_cell);
+	void UnloadCell(Cell& io_cell);
+
+	// Creates read models and instances cells with every model resident, nearest first, until the frame's budget is used.
+	void FinishLoads(kt::Vec3 const& _streamPos, float _budgetMs, kt::TimePoint const& _updateStart);
+
+	void CreateModel(StreamedModel& io_model);
+	void ReleaseModelRef(uint32_t _modelIdx);
+
+	void IoThreadMain();
+
+	Scene* m_scene = nullptr;
+	float m_cellSize = 64.0f;
+
+	kt::Array<Cell> m_cells;
+	kt::Array<StreamedModel> m_models;
+
+	// Packed cell coordinates to index into m_cells, and path hash to index into m_models.
+	kt::HashMap<uint64_t, uint32_t, kt::HashMap_KeyOps_IdentityInt<uint64_t>> m_cellLookup;
+	kt::HashMap<uint32_t, uint32_t, kt::HashMap_KeyOps_IdentityInt<uint32_t>> m_modelLookup;
+
+	kt::AABB m_instanceBounds = kt::AABB::FloatMax();
+
+	Stats m_stats;
+
+	// Io thread reads and parses model files (the model cache if there is one), so the main thread only creates their gpu resources.
+	std::thread m_ioThread;
+	std::mutex m_ioMutex;
+	std::condition_variable m_ioCv;
+
+	// Guarded by m_ioMutex. Requests hold their own copy of the path, m_models may grow while they're in flight.
+	struct IoRequest
+	{
+		uint32_t m_model;
+		std::string m_path;
+	};
+
+	struct IoResult
+	{
+		uint32_t m_model;
+		ParsedModel* m_parsed;
+	};
+
+	kt::Array<IoRequest> m_ioRequests;
+	kt::Array<IoResult> m_ioCompleted;
+	bool m_ioQuit = false;
+};
+
+}
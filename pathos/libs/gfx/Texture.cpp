@@ -3,6 +3,11 @@
 #include <kt/File.h>
 #include <kt/Serialization.h>
 
+#include <immintrin.h>
+
+#include <core/CPU.h>
+#include <shaderlib/CPPInterop.h>
+
 #include "stb_image.h"
 #include "stb_image_resize.h"
 
@@ -11,10 +16,13 @@
 namespace gfx
 {
 
-constexpr uint32_t c_textureCacheVersion = 1;
+constexpr uint32_t c_textureCacheVersion = 2;
 
 static void Serialize(kt::ISerializer* _s, Texture& _tex)
 {
+	uint32_t format = uint32_t(_tex.m_format);
+	kt::Serialize(_s, format);
+	_tex.m_format = gpu::Format(format);
 	kt::Serialize(_s, _tex.m_width);
 	kt::Serialize(_s, _tex.m_height);
 	kt::Serialize(_s, _tex.m_numMips);
@@ -46,7 +54,7 @@ static bool LoadFromCache(Texture& o_tex, TextureLoadFlags _loadFlags, char cons
 
 	if (version != c_textureCacheVersion)
 	{
-		KT_LOG_INFO("%s has version %u, but texture cache version is %u.", version, c_textureCacheVersion);
+		KT_LOG_INFO("%s has version %u, but texture cache version is %u.", cachePath.Data(), version, c_textureCacheVersion);
 		return false;
 	}
 
@@ -85,6 +93,37 @@ static void WriteToCache(Texture& o_tex, TextureLoadFlags _loadFlags, char const
 	Serialize(&serializer, o_tex);
 }
 
+// Clamp to the largest finite half, otherwise bright texels (eg the sun) round to inf.
+static float const c_maxHalf = 65504.0f;
+
+CORE_TARGET_F16C static void FloatToHalf_F16C(float const* _src, uint16_t* o_dest, uint32_t _count)
+{
+	__m128 const maxHalf = _mm_set1_ps(c_maxHalf);
+
+	for (uint32_t i = 0; i < _count; i += 4)
+	{
+		__m128 const v = _mm_min_ps(_mm_loadu_ps(_src + i), maxHalf);
+		_mm_storel_epi64((__m128i*)(o_dest + i), _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+	}
+}
+
+static void FloatToHalf(float const* _src, uint16_t* o_dest, uint32_t _count)
+{
+	KT_ASSERT((_count & 3) == 0);
+
+	if (core::CPUHasF16C())
+	{
+		FloatToHalf_F16C(_src, o_dest, _count);
+		return;
+	}
+
+	// Same round to nearest even as the F16C path.
+	for (uint32_t i = 0; i < _count; ++i)
+	{
+		o_dest[i] = uint16_t(shaderlib::f32tof16(kt::Min(_src[i], c_maxHalf)));
+	}
+}
+
 static void CreateGPUBuffer2D(Texture& _tex, void const* _texelData, uint32_t _x, uint32_t _y, gpu::Format _fmt, uint32_t _numMips, char const* _debugName = nullptr)
 {
 	gpu::TextureDesc desc = gpu::TextureDesc::Desc2D(_x, _y, gpu::TextureUsageFlags::ShaderResource, _fmt);
@@ -98,8 +137,7 @@ bool Texture::LoadFromFile(char const* _fileName, TextureLoadFlags _flags)
 
 	if (LoadFromCache(*this, _flags, _fileName))
 	{
-		gpu::Format const gpuFmt = !!(_flags & TextureLoadFlags::sRGB) ? gpu::Format::R8G8B8A8_UNorm_SRGB : gpu::Format::R8G8B8A8_UNorm;
-		CreateGPUBuffer2D(*this, m_texelData.Data(), m_width, m_height, gpuFmt, m_numMips, _fileName);
+		CreateGPUBuffer2D(*this, m_texelData.Data(), m_width, m_height, m_format, m_numMips, _fileName);
 		m_texelData.ClearAndFree();
 		return true;
 	}
@@ -117,12 +155,15 @@ bool Texture::LoadFromFile(char const* _fileName, TextureLoadFlags _flags)
 			return false;
 		}
 		KT_SCOPE_EXIT(stbi_image_free(hdrPtr));
-		m_width = uint32_t(x);
-		m_height = uint32_t(y);
-		m_numMips = 1;
-		CreateGPUBuffer2D(*this, hdrPtr, m_width, m_height, gpu::Format::R32G32B32A32_Float, 1, _fileName);
-		m_texelData.ClearAndFree();
-		return true;
+
+		if (LoadFromRGBA32F(hdrPtr, uint32_t(x), uint32_t(y), _flags, _fileName))
+		{
+			WriteToCache(*this, _flags, _fileName);
+			m_texelData.ClearAndFree();
+			return true;
+		}
+
+		return false;
 	}
 
 	uint8_t* srcTexels = stbi_load(_fileName, &x, &y, &comp, c_requiredComp);
@@ -135,6 +176,13 @@ bool Texture::LoadFromFile(char const* _fileName, TextureLoadFlags _flags)
 
 	if(LoadFromRGBA8(srcTexels, uint32_t(x), uint32_t(y), _flags, _fileName))
 	{
+		// Without mips the source is uploaded as is, it's only copied for the cache.
+		if (!(_flags & TextureLoadFlags::GenMips))
+		{
+			m_texelData.Resize(uint32_t(x) * uint32_t(y) * c_requiredComp);
+			memcpy(m_texelData.Data(), srcTexels, m_texelData.Size());
+		}
+
 		WriteToCache(*this, _flags, _fileName);
 		m_texelData.ClearAndFree();
 		return true;
@@ -147,6 +195,7 @@ bool Texture::LoadFromFile(char const* _fileName, TextureLoadFlags _flags)
 bool Texture::LoadFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags, char const* _debugName)
 {
 	gpu::Format const gpuFmt = !!(_flags & TextureLoadFlags::sRGB) ? gpu::Format::R8G8B8A8_UNorm_SRGB : gpu::Format::R8G8B8A8_UNorm;
+	m_format = gpuFmt;
 
 	uint32_t constexpr c_bytesPerPixel = 4;
 
@@ -155,6 +204,7 @@ bool Texture::LoadFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _h
 		m_width = _width;
 		m_height = _height;
 		m_numMips = 1;
+		m_mipOffsets[0] = 0;
 		CreateGPUBuffer2D(*this, _texels, _width, _height, gpuFmt, 1, _debugName);
 		return true;
 	}
@@ -244,7 +294,57 @@ bool Texture::LoadFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _h
 	}
 
 	CreateGPUBuffer2D(*this, m_texelData.Data(), _width, _height, gpuFmt, mipChainLen, _debugName);
-	m_texelData.ClearAndFree();
+	return true;
+}
+
+bool Texture::LoadFromRGBA32F(float const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags, char const* _debugName)
+{
+	uint32_t constexpr c_floatsPerPixel = 4;
+	uint32_t constexpr c_bytesPerPixel = c_floatsPerPixel * sizeof(uint16_t);
+
+	m_format = gpu::Format::R16B16G16A16_Float;
+	m_width = _width;
+	m_height = _height;
+	m_numMips = !!(_flags & TextureLoadFlags::GenMips) ? MipChainLength(_width, _height) : 1;
+	KT_ASSERT(m_numMips <= c_maxMips);
+
+	uint32_t totalPixels = 0;
+	for (uint32_t i = 0; i < m_numMips; ++i)
+	{
+		m_mipOffsets[i] = totalPixels * c_bytesPerPixel;
+		totalPixels += MipDimForLevel(_width, i) * MipDimForLevel(_height, i);
+	}
+
+	m_texelData.Resize(totalPixels * c_bytesPerPixel);
+
+	FloatToHalf(_texels, (uint16_t*)m_texelData.Data(), _width * _height * c_floatsPerPixel);
+
+	if (m_numMips > 1)
+	{
+		// Ping pong between two full precision scratch mips (odd levels in the first, even in the second).
+		uint32_t const mip1Pixels = MipDimForLevel(_width, 1) * MipDimForLevel(_height, 1);
+		uint32_t const mip2Pixels = MipDimForLevel(_width, 2) * MipDimForLevel(_height, 2);
+		kt::Array<float> scratch;
+		scratch.Resize((mip1Pixels + mip2Pixels) * c_floatsPerPixel);
+
+		float* scratchMips[2] = { scratch.Data(), scratch.Data() + mip1Pixels * c_floatsPerPixel };
+		float const* prevMip = _texels;
+
+		for (uint32_t i = 1; i < m_numMips; ++i)
+		{
+			uint32_t const prevX = MipDimForLevel(_width, i - 1);
+			uint32_t const prevY = MipDimForLevel(_height, i - 1);
+			uint32_t const x = MipDimForLevel(_width, i);
+			uint32_t const y = MipDimForLevel(_height, i);
+
+			float* curMip = scratchMips[(i - 1) & 1];
+			stbir_resize_float(prevMip, int(prevX), int(prevY), 0, curMip, int(x), int(y), 0, c_floatsPerPixel);
+			FloatToHalf(curMip, (uint16_t*)(m_texelData.Data() + m_mipOffsets[i]), x * y * c_floatsPerPixel);
+			prevMip = curMip;
+		}
+	}
+
+	CreateGPUBuffer2D(*this, m_texelData.Data(), _width, _height, m_format, m_numMips, _debugName);
 	return true;
 }
 
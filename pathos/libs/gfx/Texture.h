@@ -33,6 +33,8 @@ struct Texture
 
 	bool LoadFromFile(char const* _fileName, TextureLoadFlags _flags = TextureLoadFlags::None);
 	bool LoadFromRGBA8(uint8_t const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags = TextureLoadFlags::None, char const* _debugName = nullptr);
+	// Converts to R16B16G16A16_Float, mips are filtered at full precision before conversion.
+	bool LoadFromRGBA32F(float const* _texels, uint32_t _width, uint32_t _height, TextureLoadFlags _flags = TextureLoadFlags::None, char const* _debugName = nullptr);
 	bool LoadFromMemory(uint8_t const* _textureData, uint32_t const _size, TextureLoadFlags _flags = TextureLoadFlags::None, char const* _debugName = nullptr);
 
 	std::string m_path;
@@ -42,6 +44,7 @@ struct Texture
 	uint32_t m_numMips = 0;
 	uint32_t m_width = 0;
 	uint32_t m_height = 0;
+	gpu::Format m_format = gpu::Format::Unknown;
 
 	gpu::TextureRef m_gpuTex;
 };
@@ -0,0 +1,333 @@
+#include "TransformHierarchy.h"
+
+#include <immintrin.h>
+#include <string.h>
+
+#include <kt/Sort.h>
+
+#include <core/Memory.h>
+
+namespace gfx
+{
+
+// Nodes multiplied together, independent nodes are gathered until one depends on another in the batch.
+static uint32_t const c_mulBatchSize = 4;
+
+void MulTransforms(kt::Mat4 const* const* _lhs, kt::Mat4 const* const* _rhs, kt::Mat4* const* o_out, uint32_t _num)
+{
+	for (uint32_t i = 0; i < _num; ++i)
+	{
+		// Column major, each result column is the lhs columns weighted by a rhs column.
+		float const* lhs = _lhs[i]->Data();
+		float const* rhs = _rhs[i]->Data();
+		float* out = o_out[i]->Data();
+
+		__m128 const col0 = _mm_loadu_ps(lhs + 0);
+		__m128 const col1 = _mm_loadu_ps(lhs + 4);
+		__m128 const col2 = _mm_loadu_ps(lhs + 8);
+		__m128 const col3 = _mm_loadu_ps(lhs + 12);
+
+		for (uint32_t col = 0; col < 4; ++col)
+		{
+			__m128 res = _mm_mul_ps(col0, _mm_set1_ps(rhs[col * 4 + 0]));
+			res = _mm_add_ps(res, _mm_mul_ps(col1, _mm_set1_ps(rhs[col * 4 + 1])));
+			res = _mm_add_ps(res, _mm_mul_ps(col2, _mm_set1_ps(rhs[col * 4 + 2])));
+			res = _mm_add_ps(res, _mm_mul_ps(col3, _mm_set1_ps(rhs[col * 4 + 3])));
+			_mm_storeu_ps(out + col * 4, res);
+		}
+	}
+}
+
+void PackTransform3x4(kt::Mat4 const& _mtx, shaderlib::InstanceData_Xform* o_xform)
+{
+	float const* mtxPtr = _mtx.Data();
+
+	__m128 row0 = _mm_loadu_ps(mtxPtr + 0);
+	__m128 row1 = _mm_loadu_ps(mtxPtr + 4);
+	__m128 row2 = _mm_loadu_ps(mtxPtr + 8);
+	__m128 row3 = _mm_loadu_ps(mtxPtr + 12);
+
+	// Columns in, rows out.
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+	_mm_storeu_ps(&o_xform->row0.x, row0);
+	_mm_storeu_ps(&o_xform->row1.x, row1);
+	_mm_storeu_ps(&o_xform->row2.x, row2);
+}
+
+void EncodeInstanceData(shaderlib::InstanceData_Xform const& _xform, kt::Vec3 const& _origin, shaderlib::InstanceData_Compact* o_data)
+{
+	float const m[3][3] =
+	{
+		{ _xform.row0.x, _xform.row0.y, _xform.row0.z },
+		{ _xform.row1.x, _xform.row1.y, _xform.row1.z },
+		{ _xform.row2.x, _xform.row2.y, _xform.row2.z }
+	};
+
+	// Columns are the scaled basis vectors, a mirrored basis is folded into a negative x scale.
+	float scale[3];
+	for (uint32_t col = 0; col < 3; ++col)
+	{
+		scale[col] = kt::Sqrt(m[0][col] * m[0][col] + m[1][col] * m[1][col] + m[2][col] * m[2][col]);
+	}
+
+	float const det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+					- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+					+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+	if (det < 0.0f)
+	{
+		scale[0] = -scale[0];
+	}
+
+	float r[3][3];
+	for (uint32_t row = 0; row < 3; ++row)
+	{
+		for (uint32_t col = 0; col < 3; ++col)
+		{
+			r[row][col] = scale[col] != 0.0f ? m[row][col] / scale[col] : (row == col ? 1.0f : 0.0f);
+		}
+	}
+
+	// x, y, z, w.
+	float q[4];
+	float const trace = r[0][0] + r[1][1] + r[2][2];
+
+	if (trace > 0.0f)
+	{
+		float const s = kt::Sqrt(trace + 1.0f) * 2.0f;
+		q[0] = (r[2][1] - r[1][2]) / s;
+		q[1] = (r[0][2] - r[2][0]) / s;
+		q[2] = (r[1][0] - r[0][1]) / s;
+		q[3] = 0.25f * s;
+	}
+	else if (r[0][0] > r[1][1] && r[0][0] > r[2][2])
+	{
+		float const s = kt::Sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+		q[0] = 0.25f * s;
+		q[1] = (r[0][1] + r[1][0]) / s;
+		q[2] = (r[0][2] + r[2][0]) / s;
+		q[3] = (r[2][1] - r[1][2]) / s;
+	}
+	else if (r[1][1] > r[2][2])
+	{
+		float const s = kt::Sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+		q[0] = (r[0][1] + r[1][0]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (r[1][2] + r[2][1]) / s;
+		q[3] = (r[0][2] - r[2][0]) / s;
+	}
+	else
+	{
+		float const s = kt::Sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+		q[0] = (r[0][2] + r[2][0]) / s;
+		q[1] = (r[1][2] + r[2][1]) / s;
+		q[2] = 0.25f * s;
+		q[3] = (r[1][0] - r[0][1]) / s;
+	}
+
+	uint32_t largest = 0;
+	float lenSq = 0.0f;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		lenSq += q[i] * q[i];
+		largest = kt::Abs(q[i]) > kt::Abs(q[largest]) ? i : largest;
+	}
+
+	// q and -q are the same rotation, flip so the dropped component is positive.
+	float const normalize = (q[largest] < 0.0f ? -1.0f : 1.0f) / kt::Sqrt(lenSq);
+
+	uint32_t const mask = (1u << PATHOS_INSTANCE_ROTATION_BITS) - 1u;
+	uint32_t rotation = largest << 30;
+	uint32_t shift = 2 * PATHOS_INSTANCE_ROTATION_BITS;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		float const unorm = (q[i] * normalize + 0.70710678f) * (1.0f / 1.41421356f);
+		rotation |= uint32_t(kt::Clamp(unorm, 0.0f, 1.0f) * float(mask) + 0.5f) << shift;
+		shift -= PATHOS_INSTANCE_ROTATION_BITS;
+	}
+
+	o_data->position = kt::Vec3(_xform.row0.w, _xform.row1.w, _xform.row2.w) - _origin;
+	o_data->rotation = rotation;
+	o_data->scaleXY = shaderlib::f32tof16(scale[0]) | (shaderlib::f32tof16(scale[1]) << 16);
+	o_data->scaleZ = shaderlib::f32tof16(scale[2]);
+}
+
+void TransformHierarchy::Init(uint32_t _initialCapacity)
+{
+	KT_ASSERT(_initialCapacity);
+
+	m_nodeAllocator.Init(_initialCapacity);
+	m_locals.Resize(_initialCapacity);
+	m_worlds.Resize(_initialCapacity);
+	m_parents.Resize(_initialCapacity);
+	m_rangeEnds.Resize(_initialCapacity);
+	m_userData.Resize(_initialCapacity);
+	m_flags.Resize(_initialCapacity);
+
+	memset(m_flags.Data(), 0, m_flags.Size());
+}
+
+TransformHierarchy::RangeHandle TransformHierarchy::Alloc(uint32_t _numNodes, uint32_t const* _parents, kt::Mat4 const* _locals)
+{
+	RangeHandle range = m_nodeAllocator.Alloc(_numNodes);
+
+	if (range == c_invalidRange)
+	{
+		uint32_t const oldCapacity = Capacity();
+		uint32_t const newCapacity = oldCapacity + kt::Max(oldCapacity, _numNodes);
+
+		m_nodeAllocator.Grow(newCapacity);
+		m_locals.Resize(newCapacity);
+		m_worlds.Resize(newCapacity);
+		m_parents.Resize(newCapacity);
+		m_rangeEnds.Resize(newCapacity);
+		m_userData.Resize(newCapacity);
+		m_flags.Resize(newCapacity);
+
+		memset(m_flags.Data() + oldCapacity, 0, newCapacity - oldCapacity);
+
+		range = m_nodeAllocator.Alloc(_numNodes);
+	}
+
+	KT_ASSERT(range != c_invalidRange);
+
+	uint32_t const firstNode = FirstNode(range);
+
+	for (uint32_t i = 0; i < _numNodes; ++i)
+	{
+		KT_ASSERT(_parents[i] == c_noParent || _parents[i] < i);
+
+		uint32_t const node = firstNode + i;
+		m_locals[node] = _locals[i];
+		m_parents[node] = _parents[i] == c_noParent ? c_noParent : firstNode + _parents[i];
+		m_rangeEnds[node] = firstNode + _numNodes;
+		m_userData[node] = c_noUserData;
+		m_flags[node] = Flag_Dirty;
+	}
+
+	if (_numNodes)
+	{
+		// A pass from the first node covers the rest of the range.
+		m_dirtyNodes.PushBack(firstNode);
+	}
+
+	return range;
+}
+
+void TransformHierarchy::Free(RangeHandle _range)
+{
+	// Clearing the flags is enough to skip any pending dirty entries in the range.
+	uint32_t const firstNode = FirstNode(_range);
+	memset(m_flags.Data() + firstNode, 0, NumNodes(_range));
+
+	m_nodeAllocator.Free(_range);
+}
+
+void TransformHierarchy::SetLocal(uint32_t _node, kt::Mat4 const& _local)
+{
+	m_locals[_node] = _local;
+
+	if (!(m_flags[_node] & Flag_Dirty))
+	{
+		m_flags[_node] |= Flag_Dirty;
+		m_dirtyNodes.PushBack(_node);
+	}
+}
+
+void TransformHierarchy::Update()
+{
+	// Changed flags only describe the last update.
+	for (uint32_t node : m_changedNodes)
+	{
+		m_flags[node] &= ~Flag_Changed;
+	}
+
+	m_changedNodes.Clear();
+
+	if (!m_dirtyNodes.Size())
+	{
+		return;
+	}
+
+	// Lowest first, so a pass over a range also picks up later dirty nodes in it rather than recomputing them twice.
+	{
+		uint32_t* sortTemp = (uint32_t*)core::GetThreadFrameAllocator()->Alloc(sizeof(uint32_t) * m_dirtyNodes.Size());
+		kt::RadixSort(m_dirtyNodes.Data(), m_dirtyNodes.Data() + m_dirtyNodes.Size(), sortTemp, [](uint32_t _node) { return _node; });
+	}
+
+	kt::Mat4 const* batchParents[c_mulBatchSize];
+	kt::Mat4 const* batchLocals[c_mulBatchSize];
+	kt::Mat4* batchWorlds[c_mulBatchSize];
+	uint32_t batchSize = 0;
+	uint32_t batchFirstNode = 0;
+
+	auto flushBatch = [&]()
+	{
+		MulTransforms(batchParents, batchLocals, batchWorlds, batchSize);
+		batchSize = 0;
+	};
+
+	for (uint32_t dirtyNode : m_dirtyNodes)
+	{
+		if (!(m_flags[dirtyNode] & Flag_Dirty))
+		{
+			// Already updated by an earlier pass, or freed.
+			continue;
+		}
+
+		uint32_t const rangeEnd = m_rangeEnds[dirtyNode];
+
+		for (uint32_t node = dirtyNode; node < rangeEnd; ++node)
+		{
+			uint32_t const parent = m_parents[node];
+			bool const parentChanged = parent != c_noParent && (m_flags[parent] & Flag_Changed);
+
+			if (!(m_flags[node] & Flag_Dirty) && !parentChanged)
+			{
+				continue;
+			}
+
+			m_flags[node] = Flag_Changed;
+			m_changedNodes.PushBack(node);
+
+			if (parent == c_noParent)
+			{
+				m_worlds[node] = m_locals[node];
+				continue;
+			}
+
+			// Nodes come after their parents, so only a parent at or after the start of the batch can still be waiting in it.
+			if (batchSize && parent >= batchFirstNode)
+			{
+				flushBatch();
+			}
+
+			if (!batchSize)
+			{
+				batchFirstNode = node;
+			}
+
+			batchParents[batchSize] = &m_worlds[parent];
+			batchLocals[batchSize] = &m_locals[node];
+			batchWorlds[batchSize] = &m_worlds[node];
+
+			if (++batchSize == c_mulBatchSize)
+			{
+				flushBatch();
+			}
+		}
+	}
+
+	flushBatch();
+
+	m_dirtyNodes.Clear();
+}
+
+}
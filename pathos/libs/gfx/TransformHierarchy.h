@@ -0,0 +1,85 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+
+#include <shaderlib/CommonShared.h>
+
+#include "RangeAllocator.h"
+
+namespace gfx
+{
+
+// Local and world transforms of scene nodes, kept in separate arrays indexed by node.
+// Nodes are allocated in ranges (eg. one per model instance) with every node after its parent, so one forward pass over a range updates all of it.
+// Setting a local transform marks the node dirty, Update then recomputes dirty nodes and everything below them and leaves the rest alone.
+class TransformHierarchy
+{
+public:
+	using RangeHandle = RangeAllocator::Handle;
+	static RangeHandle constexpr c_invalidRange = RangeAllocator::c_invalidHandle;
+
+	static uint32_t constexpr c_noParent = UINT32_MAX;
+	static uint32_t constexpr c_noUserData = UINT32_MAX;
+
+	void Init(uint32_t _initialCapacity = 4096);
+
+	// _parents are indices within the range and must come before their children, c_noParent for roots.
+	// Every node starts dirty, world transforms are valid after the next Update.
+	RangeHandle Alloc(uint32_t _numNodes, uint32_t const* _parents, kt::Mat4 const* _locals);
+	void Free(RangeHandle _range);
+
+	uint32_t FirstNode(RangeHandle _range) const { return m_nodeAllocator.Offset(_range); }
+	uint32_t NumNodes(RangeHandle _range) const { return m_nodeAllocator.Size(_range); }
+
+	void SetLocal(uint32_t _node, kt::Mat4 const& _local);
+	kt::Mat4 const& Local(uint32_t _node) const { return m_locals[_node]; }
+	kt::Mat4 const& World(uint32_t _node) const { return m_worlds[_node]; }
+
+	// Whatever the owner wants to find from a node, eg. the InstanceTable slot its world transform goes to.
+	void SetUserData(uint32_t _node, uint32_t _userData) { m_userData[_node] = _userData; }
+	uint32_t UserData(uint32_t _node) const { return m_userData[_node]; }
+
+	void Update();
+
+	// Nodes whose world transform was recomputed by the last Update.
+	kt::Array<uint32_t> const& ChangedNodes() const { return m_changedNodes; }
+
+	uint32_t Capacity() const { return m_nodeAllocator.Capacity(); }
+	uint32_t NumUsedNodes() const { return m_nodeAllocator.UsedSize(); }
+
+private:
+	enum Flags : uint8_t
+	{
+		Flag_Dirty = 0x1,
+		Flag_Changed = 0x2
+	};
+
+	RangeAllocator m_nodeAllocator;
+
+	kt::Array<kt::Mat4> m_locals;
+	kt::Array<kt::Mat4> m_worlds;
+
+	// Absolute node index, or c_noParent.
+	kt::Array<uint32_t> m_parents;
+
+	// One past the last node in each node's range, where an update pass starting at the node stops.
+	kt::Array<uint32_t> m_rangeEnds;
+
+	kt::Array<uint32_t> m_userData;
+	kt::Array<uint8_t> m_flags;
+
+	kt::Array<uint32_t> m_dirtyNodes;
+	kt::Array<uint32_t> m_changedNodes;
+};
+
+// o_out[i] = _lhs[i] * _rhs[i], using SSE. Outputs must not alias inputs.
+void MulTransforms(kt::Mat4 const* const* _lhs, kt::Mat4 const* const* _rhs, kt::Mat4* const* o_out, uint32_t _num);
+
+// Transposes into the row major 3x4 instances are uploaded as, dropping the last row.
+void PackTransform3x4(kt::Mat4 const& _mtx, shaderlib::InstanceData_Xform* o_xform);
+
+// Splits a 3x4 into position relative to _origin, quantized rotation and half scale, see shaderlib::DecodeInstanceData.
+void EncodeInstanceData(shaderlib::InstanceData_Xform const& _xform, kt::Vec3 const& _origin, shaderlib::InstanceData_Compact* o_data);
+
+}
@@ -0,0 +1,906 @@
+#include "CommandStream.h"
+#include "GPUDevice.h"
+
+#include <kt/Array.h>
+#include <kt/Memory.h>
+
+#include <string.h>
+
+namespace gpu
+{
+
+namespace cmd
+{
+
+// Commands are an 8 byte header followed by their payload, packed into pages that never move while recording (so returned update memory stays valid).
+static uint32_t constexpr c_streamPageSize = 64 * 1024;
+static uint32_t constexpr c_streamAlignment = 8;
+
+enum class StreamOp : uint16_t
+{
+	PushMarker,
+	PopMarker,
+	ResetState,
+
+	SetPSO,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetRenderTarget,
+	SetDepthBuffer,
+
+	SetDescriptorTable,
+	SetPersistentDescriptorTable,
+
+	ResourceBarrier,
+	UAVBarrier,
+	FlushBarriers,
+
+	CopyResource,
+	CopyBufferRegion,
+	CopyTextureSubresource,
+
+	DrawIndexedInstanced,
+	DrawInstanced,
+	DrawIndexedInstancedIndirect,
+	Dispatch,
+
+	ClearRenderTarget,
+	ClearDepth,
+
+	UpdateDynamicBuffer,
+	UpdateTransientBuffer,
+
+	SetScissorRect,
+	SetViewport,
+	SetViewportAndScissorRectFromTexture,
+
+	GenerateMips,
+
+	Num_StreamOp
+};
+
+enum class TableKind : uint32_t
+{
+	ComputeCBV,
+	ComputeUAV,
+	ComputeSRV,
+	GraphicsCBV,
+	GraphicsUAV,
+	GraphicsSRV
+};
+
+struct StreamCmdHeader
+{
+	StreamOp m_op;
+	uint16_t m_pad;
+	uint32_t m_size;	// Including the header.
+};
+
+struct StreamCmd_Marker
+{
+	uint32_t m_colour;
+	uint32_t m_nameLen;	// Name follows, null terminated.
+};
+
+struct StreamCmd_Handle
+{
+	gpu::ResourceHandle m_handle;
+	uint32_t m_arg0;
+	uint32_t m_arg1;
+	uint32_t m_arg2;
+};
+
+struct StreamCmd_DescriptorTable
+{
+	TableKind m_kind;
+	uint32_t m_space;
+	uint32_t m_numDescriptors;	// Descriptors follow, their scratch constants point further into the stream.
+	uint32_t m_pad;
+};
+
+struct StreamCmd_PersistentDescriptorTable
+{
+	gpu::PersistentDescriptorTableHandle m_table;
+	uint32_t m_space;
+	uint32_t m_isCompute;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_Copy
+{
+	gpu::ResourceHandle m_dest;
+	gpu::ResourceHandle m_src;
+	uint32_t m_destOffset;
+	uint32_t m_srcOffset;
+	uint32_t m_size;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_CopyTexture
+{
+	gpu::TextureHandle m_dest;
+	gpu::TextureHandle m_src;
+	uint32_t m_destArrayIdx;
+	uint32_t m_destMipIdx;
+	uint32_t m_srcArrayIdx;
+	uint32_t m_srcMipIdx;
+};
+
+struct StreamCmd_Draw
+{
+	uint32_t m_count;
+	uint32_t m_instanceCount;
+	uint32_t m_start;
+	uint32_t m_baseVertex;
+	uint32_t m_startInstance;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_DrawIndirect
+{
+	gpu::ResourceHandle m_argBuffer;
+	gpu::ResourceHandle m_countBuffer;
+	uint32_t m_argOffset;
+	uint32_t m_maxDrawCount;
+	uint32_t m_countOffset;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_Dispatch
+{
+	uint32_t m_x;
+	uint32_t m_y;
+	uint32_t m_z;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_ClearRenderTarget
+{
+	gpu::TextureHandle m_handle;
+	float m_colour[4];
+	uint32_t m_pad;
+};
+
+struct StreamCmd_ClearDepth
+{
+	gpu::TextureHandle m_handle;
+	float m_depth;
+	uint32_t m_arrayIdx;
+	uint32_t m_mipIdx;
+};
+
+struct StreamCmd_Update
+{
+	gpu::BufferHandle m_handle;
+	uint32_t m_size;	// Data follows.
+	uint32_t m_destOffset;
+	uint32_t m_pad;
+};
+
+struct StreamCmd_Rect
+{
+	gpu::Rect m_rect;
+	float m_minDepth;
+	float m_maxDepth;
+};
+
+struct StreamCmd_TextureRect
+{
+	gpu::TextureHandle m_tex;
+	float m_minDepth;
+	float m_maxDepth;
+	uint32_t m_pad;
+};
+
+struct CommandStream
+{
+	// Must be first, recording contexts point here.
+	ContextBase m_ctx;
+
+	struct Page
+	{
+		uint8_t* m_mem;
+		uint32_t m_size;
+		uint32_t m_used;
+	};
+
+	kt::Array<Page> m_pages;
+	uint32_t m_curPage = 0;
+
+	ContextType m_type = ContextType::Graphics;
+
+	uint32_t m_numCommands = 0;
+	uint32_t m_markerDepth = 0;
+	uint32_t m_pendingDynamicUpdates = 0;
+};
+
+static ContextBase* AsContextBase(Context* _ctx)
+{
+	// Backend contexts and recording contexts both start with their ContextBase.
+	return (ContextBase*)_ctx;
+}
+
+static void* PushCmdRaw(CommandStream* _stream, StreamOp _op, uint32_t _payloadSize)
+{
+	KT_ASSERT(_stream->m_ctx.m_recordStream == _stream && "Stream isn't recording.");
+
+	uint32_t const size = uint32_t(kt::AlignUp(uint32_t(sizeof(StreamCmdHeader)) + _payloadSize, c_streamAlignment));
+
+	CommandStream::Page* page = _stream->m_pages.Size() ? &_stream->m_pages[_stream->m_curPage] : nullptr;
+
+	if (!page || page->m_used + size > page->m_size)
+	{
+		if (page)
+		{
+			++_stream->m_curPage;
+		}
+
+		uint32_t const wantedSize = kt::Max(size, c_streamPageSize);
+
+		if (_stream->m_curPage == _stream->m_pages.Size())
+		{
+			CommandStream::Page& newPage = _stream->m_pages.PushBack();
+			newPage.m_mem = (uint8_t*)kt::GetDefaultAllocator()->Alloc(wantedSize, 16);
+			newPage.m_size = wantedSize;
+		}
+		else if (_stream->m_pages[_stream->m_curPage].m_size < size)
+		{
+			// Page kept from an earlier recording is too small for this command.
+			CommandStream::Page& oldPage = _stream->m_pages[_stream->m_curPage];
+			kt::GetDefaultAllocator()->FreeSized(oldPage.m_mem, oldPage.m_size);
+			oldPage.m_mem = (uint8_t*)kt::GetDefaultAllocator()->Alloc(wantedSize, 16);
+			oldPage.m_size = wantedSize;
+		}
+
+		page = &_stream->m_pages[_stream->m_curPage];
+		page->m_used = 0;
+	}
+
+	StreamCmdHeader* header = (StreamCmdHeader*)(page->m_mem + page->m_used);
+	header->m_op = _op;
+	header->m_pad = 0;
+	header->m_size = size;
+
+	page->m_used += size;
+	++_stream->m_numCommands;
+
+	return header + 1;
+}
+
+template <typename CmdT>
+static CmdT* PushCmd(CommandStream* _stream, StreamOp _op, uint32_t _extraBytes = 0)
+{
+	static_assert(sizeof(CmdT) % c_streamAlignment == 0, "Stream commands must keep payloads aligned.");
+	return (CmdT*)PushCmdRaw(_stream, _op, uint32_t(sizeof(CmdT)) + _extraBytes);
+}
+
+CommandStream* CreateCommandStream()
+{
+	return new CommandStream();
+}
+
+void DestroyCommandStream(CommandStream* _stream)
+{
+	KT_ASSERT(!_stream->m_ctx.m_recordStream && "Stream is still recording.");
+
+	for (CommandStream::Page& page : _stream->m_pages)
+	{
+		kt::GetDefaultAllocator()->FreeSized(page.m_mem, page.m_size);
+	}
+
+	delete _stream;
+}
+
+Context* BeginRecording(CommandStream* _stream, ContextType _type)
+{
+	KT_ASSERT(!_stream->m_ctx.m_recordStream && "Stream is already recording.");
+
+	_stream->m_ctx.m_recordStream = _stream;
+	_stream->m_type = _type;
+	_stream->m_curPage = 0;
+	_stream->m_numCommands = 0;
+	_stream->m_markerDepth = 0;
+	_stream->m_pendingDynamicUpdates = 0;
+
+	if (_stream->m_pages.Size())
+	{
+		_stream->m_pages[0].m_used = 0;
+	}
+
+	return (Context*)&_stream->m_ctx;
+}
+
+void EndRecording(Context* _ctx)
+{
+	CommandStream* stream = AsContextBase(_ctx)->m_recordStream;
+	KT_ASSERT(stream);
+	KT_ASSERT(stream->m_markerDepth == 0 && "Unbalanced markers in recorded stream.");
+	KT_ASSERT(stream->m_pendingDynamicUpdates == 0 && "BeginUpdateDynamicBuffer without EndUpdateDynamicBuffer in recorded stream.");
+	stream->m_ctx.m_recordStream = nullptr;
+}
+
+uint32_t NumRecordedCommands(CommandStream const* _stream)
+{
+	return _stream->m_numCommands;
+}
+
+uint32_t RecordedSizeInBytes(CommandStream const* _stream)
+{
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < _stream->m_pages.Size() && i <= _stream->m_curPage; ++i)
+	{
+		size += _stream->m_pages[i].m_used;
+	}
+	return size;
+}
+
+static void ReplayDescriptorTable(Context* _ctx, StreamCmd_DescriptorTable const* _cmd)
+{
+	kt::Slice<DescriptorData> const descriptors = kt::MakeSlice((DescriptorData*)(_cmd + 1), _cmd->m_numDescriptors);
+
+	switch (_cmd->m_kind)
+	{
+		case TableKind::ComputeCBV: gpu::cmd::SetComputeCBVTable(_ctx, descriptors, _cmd->m_space); break;
+		case TableKind::ComputeUAV: gpu::cmd::SetComputeUAVTable(_ctx, descriptors, _cmd->m_space); break;
+		case TableKind::ComputeSRV: gpu::cmd::SetComputeSRVTable(_ctx, descriptors, _cmd->m_space); break;
+		case TableKind::GraphicsCBV: gpu::cmd::SetGraphicsCBVTable(_ctx, descriptors, _cmd->m_space); break;
+		case TableKind::GraphicsUAV: gpu::cmd::SetGraphicsUAVTable(_ctx, descriptors, _cmd->m_space); break;
+		case TableKind::GraphicsSRV: gpu::cmd::SetGraphicsSRVTable(_ctx, descriptors, _cmd->m_space); break;
+	}
+}
+
+static void ReplayCmd(Context* _ctx, StreamCmdHeader const* _header)
+{
+	void const* payload = _header + 1;
+
+	switch (_header->m_op)
+	{
+		case StreamOp::PushMarker:
+		{
+			StreamCmd_Marker const* cmd = (StreamCmd_Marker const*)payload;
+			gpu::cmd::PushMarker(_ctx, (char const*)(cmd + 1), cmd->m_colour);
+		} break;
+
+		case StreamOp::PopMarker:
+		{
+			gpu::cmd::PopMarker(_ctx);
+		} break;
+
+		case StreamOp::ResetState:
+		{
+			gpu::cmd::ResetState(_ctx);
+		} break;
+
+		case StreamOp::SetPSO:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::SetPSO(_ctx, gpu::PSOHandle{ cmd->m_handle });
+		} break;
+
+		case StreamOp::SetVertexBuffer:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::SetVertexBuffer(_ctx, cmd->m_arg0, gpu::BufferHandle{ cmd->m_handle });
+		} break;
+
+		case StreamOp::SetIndexBuffer:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::SetIndexBuffer(_ctx, gpu::BufferHandle{ cmd->m_handle });
+		} break;
+
+		case StreamOp::SetRenderTarget:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::SetRenderTarget(_ctx, cmd->m_arg0, gpu::TextureHandle{ cmd->m_handle });
+		} break;
+
+		case StreamOp::SetDepthBuffer:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::SetDepthBuffer(_ctx, gpu::TextureHandle{ cmd->m_handle }, cmd->m_arg0, cmd->m_arg1);
+		} break;
+
+		case StreamOp::SetDescriptorTable:
+		{
+			ReplayDescriptorTable(_ctx, (StreamCmd_DescriptorTable const*)payload);
+		} break;
+
+		case StreamOp::SetPersistentDescriptorTable:
+		{
+			StreamCmd_PersistentDescriptorTable const* cmd = (StreamCmd_PersistentDescriptorTable const*)payload;
+			if (cmd->m_isCompute)
+			{
+				gpu::cmd::SetComputeSRVTable(_ctx, cmd->m_table, cmd->m_space);
+			}
+			else
+			{
+				gpu::cmd::SetGraphicsSRVTable(_ctx, cmd->m_table, cmd->m_space);
+			}
+		} break;
+
+		case StreamOp::ResourceBarrier:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::ResourceBarrier(_ctx, cmd->m_handle, gpu::ResourceState(cmd->m_arg0));
+		} break;
+
+		case StreamOp::UAVBarrier:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::cmd::UAVBarrier(_ctx, cmd->m_handle);
+		} break;
+
+		case StreamOp::FlushBarriers:
+		{
+			gpu::cmd::FlushBarriers(_ctx);
+		} break;
+
+		case StreamOp::CopyResource:
+		{
+			StreamCmd_Copy const* cmd = (StreamCmd_Copy const*)payload;
+			gpu::cmd::CopyResource(_ctx, cmd->m_src, cmd->m_dest);
+		} break;
+
+		case StreamOp::CopyBufferRegion:
+		{
+			StreamCmd_Copy const* cmd = (StreamCmd_Copy const*)payload;
+			gpu::cmd::CopyBufferRegion(_ctx, cmd->m_dest, cmd->m_destOffset, cmd->m_src, cmd->m_srcOffset, cmd->m_size);
+		} break;
+
+		case StreamOp::CopyTextureSubresource:
+		{
+			StreamCmd_CopyTexture const* cmd = (StreamCmd_CopyTexture const*)payload;
+			gpu::cmd::CopyTextureSubresource(_ctx, cmd->m_dest, cmd->m_destArrayIdx, cmd->m_destMipIdx, cmd->m_src, cmd->m_srcArrayIdx, cmd->m_srcMipIdx);
+		} break;
+
+		case StreamOp::DrawIndexedInstanced:
+		{
+			StreamCmd_Draw const* cmd = (StreamCmd_Draw const*)payload;
+			gpu::cmd::DrawIndexedInstanced(_ctx, cmd->m_count, cmd->m_instanceCount, cmd->m_start, cmd->m_baseVertex, cmd->m_startInstance);
+		} break;
+
+		case StreamOp::DrawInstanced:
+		{
+			StreamCmd_Draw const* cmd = (StreamCmd_Draw const*)payload;
+			gpu::cmd::DrawInstanced(_ctx, cmd->m_count, cmd->m_instanceCount, cmd->m_start, cmd->m_startInstance);
+		} break;
+
+		case StreamOp::DrawIndexedInstancedIndirect:
+		{
+			StreamCmd_DrawIndirect const* cmd = (StreamCmd_DrawIndirect const*)payload;
+			if (cmd->m_countBuffer.IsValid())
+			{
+				gpu::cmd::DrawIndexedInstancedIndirect(_ctx, cmd->m_argBuffer, cmd->m_argOffset, cmd->m_maxDrawCount, cmd->m_countBuffer, cmd->m_countOffset);
+			}
+			else
+			{
+				gpu::cmd::DrawIndexedInstancedIndirect(_ctx, cmd->m_argBuffer, cmd->m_argOffset, cmd->m_maxDrawCount);
+			}
+		} break;
+
+		case StreamOp::Dispatch:
+		{
+			StreamCmd_Dispatch const* cmd = (StreamCmd_Dispatch const*)payload;
+			gpu::cmd::Dispatch(_ctx, cmd->m_x, cmd->m_y, cmd->m_z);
+		} break;
+
+		case StreamOp::ClearRenderTarget:
+		{
+			StreamCmd_ClearRenderTarget const* cmd = (StreamCmd_ClearRenderTarget const*)payload;
+			gpu::cmd::ClearRenderTarget(_ctx, cmd->m_handle, cmd->m_colour);
+		} break;
+
+		case StreamOp::ClearDepth:
+		{
+			StreamCmd_ClearDepth const* cmd = (StreamCmd_ClearDepth const*)payload;
+			gpu::cmd::ClearDepth(_ctx, cmd->m_handle, cmd->m_depth, cmd->m_arrayIdx, cmd->m_mipIdx);
+		} break;
+
+		case StreamOp::UpdateDynamicBuffer:
+		{
+			StreamCmd_Update const* cmd = (StreamCmd_Update const*)payload;
+			gpu::cmd::UpdateDynamicBuffer(_ctx, cmd->m_handle, cmd + 1, cmd->m_size, cmd->m_destOffset);
+		} break;
+
+		case StreamOp::UpdateTransientBuffer:
+		{
+			StreamCmd_Update const* cmd = (StreamCmd_Update const*)payload;
+			gpu::cmd::UpdateTransientBuffer(_ctx, cmd->m_handle, cmd + 1, cmd->m_size);
+		} break;
+
+		case StreamOp::SetScissorRect:
+		{
+			StreamCmd_Rect const* cmd = (StreamCmd_Rect const*)payload;
+			gpu::cmd::SetScissorRect(_ctx, cmd->m_rect);
+		} break;
+
+		case StreamOp::SetViewport:
+		{
+			StreamCmd_Rect const* cmd = (StreamCmd_Rect const*)payload;
+			gpu::cmd::SetViewport(_ctx, cmd->m_rect, cmd->m_minDepth, cmd->m_maxDepth);
+		} break;
+
+		case StreamOp::SetViewportAndScissorRectFromTexture:
+		{
+			StreamCmd_TextureRect const* cmd = (StreamCmd_TextureRect const*)payload;
+			gpu::cmd::SetViewportAndScissorRectFromTexture(_ctx, cmd->m_tex, cmd->m_minDepth, cmd->m_maxDepth);
+		} break;
+
+		case StreamOp::GenerateMips:
+		{
+			StreamCmd_Handle const* cmd = (StreamCmd_Handle const*)payload;
+			gpu::GenerateMips(_ctx, cmd->m_handle);
+		} break;
+
+		default:
+		{
+			KT_ASSERT(!"Invalid stream command.");
+		} break;
+	}
+}
+
+void Replay(Context* _ctx, CommandStream* _stream)
+{
+	KT_ASSERT(!AsContextBase(_ctx)->m_recordStream && "Replaying onto a recording context.");
+	KT_ASSERT(!_stream->m_ctx.m_recordStream && "Stream is still recording.");
+	KT_ASSERT(gpu::cmd::GetContextType(_ctx) == ContextType::Graphics || gpu::cmd::GetContextType(_ctx) == _stream->m_type);
+
+	for (uint32_t i = 0; i < _stream->m_pages.Size() && i <= _stream->m_curPage; ++i)
+	{
+		CommandStream::Page const& page = _stream->m_pages[i];
+
+		uint8_t const* it = page.m_mem;
+		uint8_t const* end = page.m_mem + page.m_used;
+
+		while (it < end)
+		{
+			StreamCmdHeader const* header = (StreamCmdHeader const*)it;
+			ReplayCmd(_ctx, header);
+			it += header->m_size;
+		}
+	}
+}
+
+void Replay(Context* _ctx, CommandStream* const* _streams, uint32_t _numStreams)
+{
+	for (uint32_t i = 0; i < _numStreams; ++i)
+	{
+		Replay(_ctx, _streams[i]);
+	}
+}
+
+namespace record
+{
+
+ContextType GetContextType(CommandStream* _stream)
+{
+	return _stream->m_type;
+}
+
+void PushMarker(CommandStream* _stream, char const* _name, uint32_t _colour)
+{
+	// Names are often built on the stack, keep a copy.
+	uint32_t const nameLen = uint32_t(strlen(_name));
+	StreamCmd_Marker* cmd = PushCmd<StreamCmd_Marker>(_stream, StreamOp::PushMarker, nameLen + 1);
+	cmd->m_colour = _colour;
+	cmd->m_nameLen = nameLen;
+	memcpy(cmd + 1, _name, nameLen + 1);
+	++_stream->m_markerDepth;
+}
+
+void PopMarker(CommandStream* _stream)
+{
+	KT_ASSERT(_stream->m_markerDepth);
+	--_stream->m_markerDepth;
+	PushCmdRaw(_stream, StreamOp::PopMarker, 0);
+}
+
+void ResetState(CommandStream* _stream)
+{
+	PushCmdRaw(_stream, StreamOp::ResetState, 0);
+}
+
+static void PushHandleCmd(CommandStream* _stream, StreamOp _op, gpu::ResourceHandle _handle, uint32_t _arg0 = 0, uint32_t _arg1 = 0)
+{
+	StreamCmd_Handle* cmd = PushCmd<StreamCmd_Handle>(_stream, _op);
+	cmd->m_handle = _handle;
+	cmd->m_arg0 = _arg0;
+	cmd->m_arg1 = _arg1;
+	cmd->m_arg2 = 0;
+}
+
+void SetPSO(CommandStream* _stream, gpu::PSOHandle _pso)
+{
+	// Stored in the resource handle slot, the tag is restored on replay.
+	PushHandleCmd(_stream, StreamOp::SetPSO, gpu::ResourceHandle{ _pso });
+}
+
+void SetVertexBuffer(CommandStream* _stream, uint32_t _streamIdx, gpu::BufferHandle _handle)
+{
+	KT_ASSERT(_streamIdx < gpu::c_maxVertexStreams);
+	PushHandleCmd(_stream, StreamOp::SetVertexBuffer, _handle, _streamIdx);
+}
+
+void SetIndexBuffer(CommandStream* _stream, gpu::BufferHandle _handle)
+{
+	PushHandleCmd(_stream, StreamOp::SetIndexBuffer, _handle);
+}
+
+void SetRenderTarget(CommandStream* _stream, uint32_t _idx, gpu::TextureHandle _handle)
+{
+	KT_ASSERT(_idx < gpu::c_maxRenderTargets);
+	PushHandleCmd(_stream, StreamOp::SetRenderTarget, _handle, _idx);
+}
+
+void SetDepthBuffer(CommandStream* _stream, gpu::TextureHandle _handle, uint32_t _arrayIdx, uint32_t _mipIdx)
+{
+	PushHandleCmd(_stream, StreamOp::SetDepthBuffer, _handle, _arrayIdx, _mipIdx);
+}
+
+static void PushDescriptorTable(CommandStream* _stream, TableKind _kind, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	uint32_t constantBytes = 0;
+	for (DescriptorData const& descriptor : _descriptors)
+	{
+		if (descriptor.m_type == DescriptorData::Type::ScratchConstant)
+		{
+			constantBytes += uint32_t(kt::AlignUp(descriptor.constants.m_size, c_streamAlignment));
+		}
+	}
+
+	uint32_t const descriptorBytes = uint32_t(sizeof(DescriptorData) * _descriptors.Size());
+
+	StreamCmd_DescriptorTable* cmd = PushCmd<StreamCmd_DescriptorTable>(_stream, StreamOp::SetDescriptorTable, descriptorBytes + constantBytes);
+	cmd->m_kind = _kind;
+	cmd->m_space = _space;
+	cmd->m_numDescriptors = _descriptors.Size();
+	cmd->m_pad = 0;
+
+	DescriptorData* descriptors = (DescriptorData*)(cmd + 1);
+	memcpy((void*)descriptors, _descriptors.Data(), descriptorBytes);
+
+	// Scratch constants are caller memory, copy them after the descriptors and point there. Pages don't move so the pointers stay valid.
+	uint8_t* constants = (uint8_t*)(cmd + 1) + descriptorBytes;
+	for (uint32_t i = 0; i < _descriptors.Size(); ++i)
+	{
+		if (descriptors[i].m_type == DescriptorData::Type::ScratchConstant)
+		{
+			memcpy(constants, descriptors[i].constants.m_ptr, descriptors[i].constants.m_size);
+			descriptors[i].constants.m_ptr = constants;
+			constants += kt::AlignUp(descriptors[i].constants.m_size, c_streamAlignment);
+		}
+	}
+}
+
+void SetComputeCBVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::ComputeCBV, _descriptors, _space);
+}
+
+void SetComputeUAVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::ComputeUAV, _descriptors, _space);
+}
+
+void SetComputeSRVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::ComputeSRV, _descriptors, _space);
+}
+
+void SetGraphicsCBVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::GraphicsCBV, _descriptors, _space);
+}
+
+void SetGraphicsUAVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::GraphicsUAV, _descriptors, _space);
+}
+
+void SetGraphicsSRVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	PushDescriptorTable(_stream, TableKind::GraphicsSRV, _descriptors, _space);
+}
+
+static void PushPersistentTable(CommandStream* _stream, gpu::PersistentDescriptorTableHandle _table, uint32_t _space, bool _isCompute)
+{
+	StreamCmd_PersistentDescriptorTable* cmd = PushCmd<StreamCmd_PersistentDescriptorTable>(_stream, StreamOp::SetPersistentDescriptorTable);
+	cmd->m_table = _table;
+	cmd->m_space = _space;
+	cmd->m_isCompute = _isCompute ? 1 : 0;
+	cmd->m_pad = 0;
+}
+
+void SetComputeSRVTable(CommandStream* _stream, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
+{
+	PushPersistentTable(_stream, _table, _space, true);
+}
+
+void SetGraphicsSRVTable(CommandStream* _stream, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
+{
+	PushPersistentTable(_stream, _table, _space, false);
+}
+
+void ResourceBarrier(CommandStream* _stream, gpu::ResourceHandle _handle, gpu::ResourceState _newState)
+{
+	PushHandleCmd(_stream, StreamOp::ResourceBarrier, _handle, uint32_t(_newState));
+}
+
+void UAVBarrier(CommandStream* _stream, gpu::ResourceHandle _handle)
+{
+	PushHandleCmd(_stream, StreamOp::UAVBarrier, _handle);
+}
+
+void FlushBarriers(CommandStream* _stream)
+{
+	PushCmdRaw(_stream, StreamOp::FlushBarriers, 0);
+}
+
+void CopyResource(CommandStream* _stream, gpu::ResourceHandle _src, gpu::ResourceHandle _dest)
+{
+	StreamCmd_Copy* cmd = PushCmd<StreamCmd_Copy>(_stream, StreamOp::CopyResource);
+	cmd->m_dest = _dest;
+	cmd->m_src = _src;
+	cmd->m_destOffset = 0;
+	cmd->m_srcOffset = 0;
+	cmd->m_size = 0;
+	cmd->m_pad = 0;
+}
+
+void CopyBufferRegion(CommandStream* _stream, gpu::ResourceHandle _dest, uint32_t _destOffset, gpu::ResourceHandle _src, uint32_t _srcOffset, uint32_t _size)
+{
+	StreamCmd_Copy* cmd = PushCmd<StreamCmd_Copy>(_stream, StreamOp::CopyBufferRegion);
+	cmd->m_dest = _dest;
+	cmd->m_src = _src;
+	cmd->m_destOffset = _destOffset;
+	cmd->m_srcOffset = _srcOffset;
+	cmd->m_size = _size;
+	cmd->m_pad = 0;
+}
+
+void CopyTextureSubresource(CommandStream* _stream, gpu::TextureHandle _dest, uint32_t _destArrayIdx, uint32_t _destMipIdx, gpu::TextureHandle _src, uint32_t _srcArrayIdx, uint32_t _srcMipIdx)
+{
+	StreamCmd_CopyTexture* cmd = PushCmd<StreamCmd_CopyTexture>(_stream, StreamOp::CopyTextureSubresource);
+	cmd->m_dest = _dest;
+	cmd->m_src = _src;
+	cmd->m_destArrayIdx = _destArrayIdx;
+	cmd->m_destMipIdx = _destMipIdx;
+	cmd->m_srcArrayIdx = _srcArrayIdx;
+	cmd->m_srcMipIdx = _srcMipIdx;
+}
+
+void DrawIndexedInstanced(CommandStream* _stream, uint32_t _indexCount, uint32_t _instanceCount, uint32_t _startIndex, uint32_t _baseVertex, uint32_t _startInstance)
+{
+	StreamCmd_Draw* cmd = PushCmd<StreamCmd_Draw>(_stream, StreamOp::DrawIndexedInstanced);
+	cmd->m_count = _indexCount;
+	cmd->m_instanceCount = _instanceCount;
+	cmd->m_start = _startIndex;
+	cmd->m_baseVertex = _baseVertex;
+	cmd->m_startInstance = _startInstance;
+	cmd->m_pad = 0;
+}
+
+void DrawInstanced(CommandStream* _stream, uint32_t _vertexCount, uint32_t _instanceCount, uint32_t _startVertex, uint32_t _startInstance)
+{
+	StreamCmd_Draw* cmd = PushCmd<StreamCmd_Draw>(_stream, StreamOp::DrawInstanced);
+	cmd->m_count = _vertexCount;
+	cmd->m_instanceCount = _instanceCount;
+	cmd->m_start = _startVertex;
+	cmd->m_baseVertex = 0;
+	cmd->m_startInstance = _startInstance;
+	cmd->m_pad = 0;
+}
+
+void DrawIndexedInstancedIndirect(CommandStream* _stream, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _maxDrawCount, gpu::ResourceHandle _countBuffer, uint32_t _countOffset)
+{
+	StreamCmd_DrawIndirect* cmd = PushCmd<StreamCmd_DrawIndirect>(_stream, StreamOp::DrawIndexedInstancedIndirect);
+	cmd->m_argBuffer = _argBuffer;
+	cmd->m_countBuffer = _countBuffer;
+	cmd->m_argOffset = _argOffset;
+	cmd->m_maxDrawCount = _maxDrawCount;
+	cmd->m_countOffset = _countOffset;
+	cmd->m_pad = 0;
+}
+
+void Dispatch(CommandStream* _stream, uint32_t _x, uint32_t _y, uint32_t _z)
+{
+	StreamCmd_Dispatch* cmd = PushCmd<StreamCmd_Dispatch>(_stream, StreamOp::Dispatch);
+	cmd->m_x = _x;
+	cmd->m_y = _y;
+	cmd->m_z = _z;
+	cmd->m_pad = 0;
+}
+
+void ClearRenderTarget(CommandStream* _stream, gpu::TextureHandle _handle, float const _color[4])
+{
+	StreamCmd_ClearRenderTarget* cmd = PushCmd<StreamCmd_ClearRenderTarget>(_stream, StreamOp::ClearRenderTarget);
+	cmd->m_handle = _handle;
+	memcpy(cmd->m_colour, _color, sizeof(cmd->m_colour));
+	cmd->m_pad = 0;
+}
+
+void ClearDepth(CommandStream* _stream, gpu::TextureHandle _handle, float _depth, uint32_t _arrayIdx, uint32_t _mipIdx)
+{
+	StreamCmd_ClearDepth* cmd = PushCmd<StreamCmd_ClearDepth>(_stream, StreamOp::ClearDepth);
+	cmd->m_handle = _handle;
+	cmd->m_depth = _depth;
+	cmd->m_arrayIdx = _arrayIdx;
+	cmd->m_mipIdx = _mipIdx;
+}
+
+static kt::Slice<uint8_t> PushUpdate(CommandStream* _stream, StreamOp _op, gpu::BufferHandle _handle, uint32_t _size, uint32_t _destOffset)
+{
+	StreamCmd_Update* cmd = PushCmd<StreamCmd_Update>(_stream, _op, _size);
+	cmd->m_handle = _handle;
+	cmd->m_size = _size;
+	cmd->m_destOffset = _destOffset;
+	cmd->m_pad = 0;
+	return kt::MakeSlice((uint8_t*)(cmd + 1), _size);
+}
+
+void UpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle, void const* _mem, uint32_t _size, uint32_t _destOffset)
+{
+	kt::Slice<uint8_t> const slice = PushUpdate(_stream, StreamOp::UpdateDynamicBuffer, _handle, _size, _destOffset);
+	memcpy(slice.Data(), _mem, _size);
+}
+
+kt::Slice<uint8_t> BeginUpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle, uint32_t _size, uint32_t _destOffset)
+{
+	++_stream->m_pendingDynamicUpdates;
+	return PushUpdate(_stream, StreamOp::UpdateDynamicBuffer, _handle, _size, _destOffset);
+}
+
+void EndUpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle)
+{
+	// Data is already in the stream.
+	KT_UNUSED(_handle);
+	KT_ASSERT(_stream->m_pendingDynamicUpdates);
+	--_stream->m_pendingDynamicUpdates;
+}
+
+kt::Slice<uint8_t> BeginUpdateTransientBuffer(CommandStream* _stream, gpu::BufferHandle _handle, uint32_t _size)
+{
+	return PushUpdate(_stream, StreamOp::UpdateTransientBuffer, _handle, _size, 0);
+}
+
+void EndUpdateTransientBuffer(CommandStream* _stream, gpu::BufferHandle _handle)
+{
+	KT_UNUSED2(_stream, _handle);
+}
+
+void SetScissorRect(CommandStream* _stream, gpu::Rect const& _rect)
+{
+	StreamCmd_Rect* cmd = PushCmd<StreamCmd_Rect>(_stream, StreamOp::SetScissorRect);
+	cmd->m_rect = _rect;
+	cmd->m_minDepth = 0.0f;
+	cmd->m_maxDepth = 0.0f;
+}
+
+void SetViewport(CommandStream* _stream, gpu::Rect const& _rect, float _minDepth, float _maxDepth)
+{
+	StreamCmd_Rect* cmd = PushCmd<StreamCmd_Rect>(_stream, StreamOp::SetViewport);
+	cmd->m_rect = _rect;
+	cmd->m_minDepth = _minDepth;
+	cmd->m_maxDepth = _maxDepth;
+}
+
+void SetViewportAndScissorRectFromTexture(CommandStream* _stream, gpu::TextureHandle _tex, float _minDepth, float _maxDepth)
+{
+	StreamCmd_TextureRect* cmd = PushCmd<StreamCmd_TextureRect>(_stream, StreamOp::SetViewportAndScissorRectFromTexture);
+	cmd->m_tex = _tex;
+	cmd->m_minDepth = _minDepth;
+	cmd->m_maxDepth = _maxDepth;
+	cmd->m_pad = 0;
+}
+
+void GenerateMips(CommandStream* _stream, gpu::ResourceHandle _handle)
+{
+	PushHandleCmd(_stream, StreamOp::GenerateMips, _handle);
+}
+
+}
+
+}
+
+}
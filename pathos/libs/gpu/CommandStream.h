@@ -0,0 +1,130 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Macros.h>
+#include <kt/Slice.h>
+
+#include "Types.h"
+#include "CommandContext.h"
+
+namespace gpu
+{
+
+namespace cmd
+{
+
+// Backend agnostic recorded commands. A recording context (BeginRecording) is passed to the regular gpu::cmd functions, which append compact
+// commands to the stream instead of executing them. Recording doesn't touch the device, so each stream can be recorded on its own thread,
+// the streams are then replayed in the order wanted onto a backend context on the main thread.
+//
+// Handles are not referenced while recorded, they must be kept alive until the stream is replayed. Data passed to updates and descriptor
+// table constants are copied into the stream. Queries can't be recorded, markers can and are profiled on replay.
+struct CommandStream;
+
+CommandStream* CreateCommandStream();
+void DestroyCommandStream(CommandStream* _stream);
+
+// Clears the stream (keeping its memory) and returns a context recording into it.
+Context* BeginRecording(CommandStream* _stream, ContextType _type);
+
+// Finish recording, gpu::cmd::End on a recording context does the same.
+void EndRecording(Context* _ctx);
+
+// Executes the streams' commands on _ctx in array order. State set by a stream carries over to the next.
+void Replay(Context* _ctx, CommandStream* const* _streams, uint32_t _numStreams);
+void Replay(Context* _ctx, CommandStream* _stream);
+
+uint32_t NumRecordedCommands(CommandStream const* _stream);
+uint32_t RecordedSizeInBytes(CommandStream const* _stream);
+
+// Backend contexts derive from this, it's only set on recording contexts.
+struct ContextBase
+{
+	CommandStream* m_recordStream = nullptr;
+};
+
+// Used by backends at the top of gpu::cmd functions to divert recording contexts.
+#define GPU_CMD_RECORD(_ctx, _fn, ...) \
+	KT_MACRO_BLOCK_BEGIN \
+		if (_ctx->m_recordStream) \
+		{ \
+			gpu::cmd::record::_fn(_ctx->m_recordStream, __VA_ARGS__); \
+			return; \
+		} \
+	KT_MACRO_BLOCK_END
+
+#define GPU_CMD_RECORD_NO_ARGS(_ctx, _fn) \
+	KT_MACRO_BLOCK_BEGIN \
+		if (_ctx->m_recordStream) \
+		{ \
+			gpu::cmd::record::_fn(_ctx->m_recordStream); \
+			return; \
+		} \
+	KT_MACRO_BLOCK_END
+
+namespace record
+{
+
+ContextType GetContextType(CommandStream* _stream);
+
+void PushMarker(CommandStream* _stream, char const* _name, uint32_t _colour);
+void PopMarker(CommandStream* _stream);
+
+void ResetState(CommandStream* _stream);
+
+void SetPSO(CommandStream* _stream, gpu::PSOHandle _pso);
+
+void SetVertexBuffer(CommandStream* _stream, uint32_t _streamIdx, gpu::BufferHandle _handle);
+void SetIndexBuffer(CommandStream* _stream, gpu::BufferHandle _handle);
+
+void SetRenderTarget(CommandStream* _stream, uint32_t _idx, gpu::TextureHandle _handle);
+void SetDepthBuffer(CommandStream* _stream, gpu::TextureHandle _handle, uint32_t _arrayIdx, uint32_t _mipIdx);
+
+void SetComputeCBVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetComputeUAVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetComputeSRVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetComputeSRVTable(CommandStream* _stream, gpu::PersistentDescriptorTableHandle _table, uint32_t _space);
+
+void SetGraphicsCBVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetGraphicsUAVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetGraphicsSRVTable(CommandStream* _stream, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space);
+void SetGraphicsSRVTable(CommandStream* _stream, gpu::PersistentDescriptorTableHandle _table, uint32_t _space);
+
+void ResourceBarrier(CommandStream* _stream, gpu::ResourceHandle _handle, gpu::ResourceState _newState);
+void UAVBarrier(CommandStream* _stream, gpu::ResourceHandle _handle);
+void FlushBarriers(CommandStream* _stream);
+
+void CopyResource(CommandStream* _stream, gpu::ResourceHandle _src, gpu::ResourceHandle _dest);
+void CopyBufferRegion(CommandStream* _stream, gpu::ResourceHandle _dest, uint32_t _destOffset, gpu::ResourceHandle _src, uint32_t _srcOffset, uint32_t _size);
+void CopyTextureSubresource(CommandStream* _stream, gpu::TextureHandle _dest, uint32_t _destArrayIdx, uint32_t _destMipIdx, gpu::TextureHandle _src, uint32_t _srcArrayIdx, uint32_t _srcMipIdx);
+
+void DrawIndexedInstanced(CommandStream* _stream, uint32_t _indexCount, uint32_t _instanceCount, uint32_t _startIndex, uint32_t _baseVertex, uint32_t _startInstance);
+void DrawInstanced(CommandStream* _stream, uint32_t _vertexCount, uint32_t _instanceCount, uint32_t _startVertex, uint32_t _startInstance);
+void DrawIndexedInstancedIndirect(CommandStream* _stream, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _maxDrawCount, gpu::ResourceHandle _countBuffer, uint32_t _countOffset);
+
+void Dispatch(CommandStream* _stream, uint32_t _x, uint32_t _y, uint32_t _z);
+
+void ClearRenderTarget(CommandStream* _stream, gpu::TextureHandle _handle, float const _color[4]);
+void ClearDepth(CommandStream* _stream, gpu::TextureHandle _handle, float _depth, uint32_t _arrayIdx, uint32_t _mipIdx);
+
+void UpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle, void const* _mem, uint32_t _size, uint32_t _destOffset);
+
+// Returned memory lives in the stream and is uploaded on replay.
+kt::Slice<uint8_t> BeginUpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle, uint32_t _size, uint32_t _destOffset);
+void EndUpdateDynamicBuffer(CommandStream* _stream, gpu::BufferHandle _handle);
+
+kt::Slice<uint8_t> BeginUpdateTransientBuffer(CommandStream* _stream, gpu::BufferHandle _handle, uint32_t _size);
+void EndUpdateTransientBuffer(CommandStream* _stream, gpu::BufferHandle _handle);
+
+void SetScissorRect(CommandStream* _stream, gpu::Rect const& _rect);
+void SetViewport(CommandStream* _stream, gpu::Rect const& _rect, float _minDepth, float _maxDepth);
+
+// Texture dimensions are looked up on replay.
+void SetViewportAndScissorRectFromTexture(CommandStream* _stream, gpu::TextureHandle _tex, float _minDepth, float _maxDepth);
+
+void GenerateMips(CommandStream* _stream, gpu::ResourceHandle _handle);
+
+}
+
+}
+
+}
@@ -87,6 +87,9 @@ struct Caps
 	bool int64ShaderOps;
 	bool waveOps;
 	bool shaderBarycentrics;
+
+	// No real device (null backend), shaders and gpu results are never used.
+	bool headless;
 };
 
 enum class ResourceState : uint8_t
@@ -358,6 +361,7 @@ struct RasterizerDesc
 		m_fillMode = FillMode::Solid;
 		m_cullMode = CullMode::Back;
 		m_frontFaceCCW = 0;
+		m_depthClip = 1;
 	}
 
 	float m_scopedScaledDepthBias = 0.0f;
@@ -365,6 +369,9 @@ struct RasterizerDesc
 	FillMode m_fillMode : c_fillModeBits;
 	CullMode m_cullMode : c_cullModeBits;
 	uint8_t m_frontFaceCCW : 1;
+
+	// If zero, depth is clamped instead of clipping against the near/far planes.
+	uint8_t m_depthClip : 1;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -534,22 +541,26 @@ struct DescriptorData
 		res.m_handle = gpu::ResourceHandle{};
 	}
 
+	// Declared outside the union, types inside an anonymous union are an MSVC extension.
+	struct Resource
+	{
+		Resource() : m_handle() {}
+
+		gpu::ResourceHandle m_handle;
+		uint32_t m_uavMipIdx : 31;
+		uint32_t m_srvCubeAsArray : 1;
+	};
+
+	struct Constants
+	{
+		void const* m_ptr;
+		uint32_t m_size;
+	};
+
 	union
 	{
-		struct Resource
-		{
-			Resource() : m_handle() {}
-
-			gpu::ResourceHandle m_handle;
-			uint32_t m_uavMipIdx : 31;
-			uint32_t m_srvCubeAsArray : 1;
-		} res;
-
-		struct
-		{
-			void const* m_ptr;
-			uint32_t m_size;
-		} constants;
+		Resource res;
+		Constants constants;
 	};
 
 	// TODO: Pedantic, but this could be packed into union padding.
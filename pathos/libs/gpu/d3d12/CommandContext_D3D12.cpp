@@ -33,6 +33,8 @@ Context* Begin(ContextType _type)
 
 void ResetState(Context* _ctx)
 {
+	GPU_CMD_RECORD_NO_ARGS(_ctx, ResetState);
+
 	SetDepthBuffer(_ctx, gpu::BackbufferDepth(), 0, 0);
 	SetRenderTarget(_ctx, 0, gpu::CurrentBackbuffer());
 
@@ -53,6 +55,11 @@ void ResetState(Context* _ctx)
 
 ContextType GetContextType(Context* _ctx)
 {
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::GetContextType(_ctx->m_recordStream);
+	}
+
 	return _ctx->m_ctxType;
 }
 
@@ -129,6 +136,12 @@ CommandContext_D3D12::~CommandContext_D3D12()
 
 void End(Context* _ctx)
 {
+	if (_ctx->m_recordStream)
+	{
+		EndRecording(_ctx);
+		return;
+	}
+
 	FlushBarriers(_ctx);
 	ID3D12CommandList* list = _ctx->m_cmdList;
 
@@ -146,12 +159,16 @@ void PushMarker(Context* _ctx, char const* _name)
 
 void PushMarker(Context* _ctx, char const* _name, uint32_t _colour)
 {
+	GPU_CMD_RECORD(_ctx, PushMarker, _name, _colour);
+
 	::PIXBeginEvent(_ctx->m_cmdList, PIX_COLOR(uint8_t(_colour & 0xFF), uint8_t((_colour >> 8) & 0xFF), uint8_t((_colour >> 16) & 0xFF)), _name);
 	gpu::profiler::Begin(_ctx, _name, _colour);
 }
 
 void PopMarker(Context* _ctx)
 {
+	GPU_CMD_RECORD_NO_ARGS(_ctx, PopMarker);
+
 	::PIXEndEvent(_ctx->m_cmdList);
 	gpu::profiler::End(_ctx);
 }
@@ -159,11 +176,15 @@ void PopMarker(Context* _ctx)
 
 gpu::QueryIndex BeginQuery(Context* _ctx)
 {
+	KT_ASSERT(!_ctx->m_recordStream && "Queries can't be recorded, use markers.");
+
 	return _ctx->m_device->m_queryProfiler.BeginQuery(_ctx->m_cmdList);
 }
 
 void EndQuery(Context* _ctx, QueryIndex _idx)
 {
+	KT_ASSERT(!_ctx->m_recordStream && "Queries can't be recorded, use markers.");
+
 	_ctx->m_device->m_queryProfiler.EndQuery(_ctx->m_cmdList, _idx);
 }
 
@@ -195,6 +216,8 @@ static void MarkDirtyIfBound(Context* _ctx, gpu::ResourceHandle _handle, Allocat
 
 void SetVertexBuffer(Context* _ctx, uint32_t _streamIdx, gpu::BufferHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, SetVertexBuffer, _streamIdx, _handle);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	KT_ASSERT(_streamIdx < gpu::c_maxVertexStreams);
@@ -217,6 +240,8 @@ void SetVertexBuffer(Context* _ctx, uint32_t _streamIdx, gpu::BufferHandle _hand
 
 void SetIndexBuffer(Context* _ctx, gpu::BufferHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, SetIndexBuffer, _handle);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	if (_ctx->m_state.m_indexBuffer.Handle() != _handle)
@@ -374,6 +399,8 @@ static uint32_t UAVTableIndex(uint32_t _space)
 
 void SetComputeSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetComputeSRVTable, _table, _space);
+
 	AllocatedPersistentDescriptorTable_D3D12* table = _ctx->m_device->m_persistentTableHandles.Lookup(_table);
 	KT_ASSERT(table);
 	_ctx->m_cmdList->SetComputeRootDescriptorTable(SRVTableIndex(_space), table->m_gpuDescriptor);
@@ -381,36 +408,50 @@ void SetComputeSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _tab
 
 void SetComputeCBVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetComputeCBVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetComputeRootDescriptorTable(CBVTableIndex(_space), MakeCBVTable(_ctx, _descriptors));
 }
 
 void SetComputeSRVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetComputeSRVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetComputeRootDescriptorTable(SRVTableIndex(_space), MakeSRVTable(_ctx, _descriptors));
 }
 
 void SetComputeUAVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetComputeUAVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetComputeRootDescriptorTable(UAVTableIndex(_space), MakeUAVTable(_ctx, _descriptors));
 }
 
 void SetGraphicsCBVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetGraphicsCBVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetGraphicsRootDescriptorTable(CBVTableIndex(_space), MakeCBVTable(_ctx, _descriptors));
 }
 
 void SetGraphicsUAVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetGraphicsUAVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetGraphicsRootDescriptorTable(UAVTableIndex(_space), MakeUAVTable(_ctx, _descriptors));
 }
 
 void SetGraphicsSRVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetGraphicsSRVTable, _descriptors, _space);
+
 	_ctx->m_cmdList->SetGraphicsRootDescriptorTable(SRVTableIndex(_space), MakeSRVTable(_ctx, _descriptors));
 }
 
 void SetGraphicsSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
 {
+	GPU_CMD_RECORD(_ctx, SetGraphicsSRVTable, _table, _space);
+
 	AllocatedPersistentDescriptorTable_D3D12* table = _ctx->m_device->m_persistentTableHandles.Lookup(_table);
 	KT_ASSERT(table);
 	_ctx->m_cmdList->SetGraphicsRootDescriptorTable(SRVTableIndex(_space), table->m_gpuDescriptor);
@@ -418,6 +459,8 @@ void SetGraphicsSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _ta
 
 void DrawIndexedInstanced(Context* _ctx, uint32_t _indexCount, uint32_t _instanceCount, uint32_t _startIndex, uint32_t _baseVertex, uint32_t _startInstance)
 {
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstanced, _indexCount, _instanceCount, _startIndex, _baseVertex, _startInstance);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	FlushBarriers(_ctx);
@@ -427,6 +470,8 @@ void DrawIndexedInstanced(Context* _ctx, uint32_t _indexCount, uint32_t _instanc
 
 void DrawInstanced(Context* _ctx, uint32_t _vertexCount, uint32_t _instanceCount, uint32_t _startVertex, uint32_t _startInstance)
 {
+	GPU_CMD_RECORD(_ctx, DrawInstanced, _vertexCount, _instanceCount, _startVertex, _startInstance);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	FlushBarriers(_ctx);
@@ -436,6 +481,8 @@ void DrawInstanced(Context* _ctx, uint32_t _vertexCount, uint32_t _instanceCount
 
 void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _drawCount)
 {
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstancedIndirect, _argBuffer, _argOffset, _drawCount, gpu::ResourceHandle{}, 0);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	FlushBarriers(_ctx);
@@ -451,6 +498,8 @@ void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer,
 
 void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _maxDrawCount, gpu::ResourceHandle _countBuffer, uint32_t _countOffset)
 {
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstancedIndirect, _argBuffer, _argOffset, _maxDrawCount, _countBuffer, _countOffset);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	FlushBarriers(_ctx);
@@ -473,6 +522,8 @@ void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer,
 
 void Dispatch(Context* _ctx, uint32_t _x, uint32_t _y, uint32_t _z)
 {
+	GPU_CMD_RECORD(_ctx, Dispatch, _x, _y, _z);
+
 	FlushBarriers(_ctx);
 	_ctx->ApplyStateChanges(CommandListFlags_D3D12::Compute);
 	_ctx->m_cmdList->Dispatch(_x, _y, _z);
@@ -487,6 +538,8 @@ void UpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle, void const*
 
 void UpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle, void const* _mem, uint32_t _size, uint32_t _destOffset)
 {
+	GPU_CMD_RECORD(_ctx, UpdateDynamicBuffer, _handle, _mem, _size, _destOffset);
+
 	// Should this be done on the copy queue and synchronized?
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Copy);
 
@@ -500,6 +553,11 @@ void UpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle, void const* _
 
 kt::Slice<uint8_t> BeginUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle, uint32_t _size, uint32_t _offset)
 {
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::BeginUpdateDynamicBuffer(_ctx->m_recordStream, _handle, _size, _offset);
+	}
+
 	// Should this be done on the copy queue and synchronized?
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Copy);
 
@@ -527,6 +585,8 @@ kt::Slice<uint8_t> BeginUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _ha
 
 void EndUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, EndUpdateDynamicBuffer, _handle);
+
 	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
 
 	for (CommandContext_D3D12::PendingDynamicUpload* it = _ctx->m_state.m_pendingUploads.Begin();
@@ -547,6 +607,11 @@ void EndUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle)
 
 kt::Slice<uint8_t> BeginUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle, uint32_t _size)
 {
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::BeginUpdateTransientBuffer(_ctx->m_recordStream, _handle, _size);
+	}
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Copy);
 
 	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
@@ -566,6 +631,8 @@ kt::Slice<uint8_t> BeginUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _
 
 void EndUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, EndUpdateTransientBuffer, _handle);
+
 	AllocatedResource_D3D12* res = _ctx->m_device->m_resourceHandles.Lookup(_handle);
 	KT_ASSERT(res);
 	MarkDirtyIfBound(_ctx, _handle, res);
@@ -573,6 +640,8 @@ void EndUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle)
 
 void SetPSO(Context* _ctx, gpu::PSOHandle _pso)
 {
+	GPU_CMD_RECORD(_ctx, SetPSO, _pso);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	if (_ctx->m_state.m_pso.Handle() != _pso)
@@ -584,6 +653,8 @@ void SetPSO(Context* _ctx, gpu::PSOHandle _pso)
 
 void ClearRenderTarget(Context* _ctx, gpu::TextureHandle _handle, float const _color[4])
 {
+	GPU_CMD_RECORD(_ctx, ClearRenderTarget, _handle, _color);
+
 	AllocatedResource_D3D12* tex = _ctx->m_device->m_resourceHandles.Lookup(_handle);
 	// TODO: Flush barriers for render target
 	KT_ASSERT(tex);
@@ -594,6 +665,8 @@ void ClearRenderTarget(Context* _ctx, gpu::TextureHandle _handle, float const _c
 
 void SetRenderTarget(Context* _ctx, uint32_t _idx, gpu::TextureHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, SetRenderTarget, _idx, _handle);
+
 	if (_ctx->m_state.m_renderTargets[_idx].Handle() != _handle)
 	{
 #if KT_DEBUG
@@ -613,6 +686,8 @@ void SetRenderTarget(Context* _ctx, uint32_t _idx, gpu::TextureHandle _handle)
 
 void SetDepthBuffer(Context* _ctx, gpu::TextureHandle _handle, uint32_t _arrayIdx, uint32_t _mipIdx)
 {
+	GPU_CMD_RECORD(_ctx, SetDepthBuffer, _handle, _arrayIdx, _mipIdx);
+
 	if (!_ctx->m_state.m_depthBuffer.Equals(_handle, _arrayIdx, _mipIdx))
 	{
 #if KT_DEBUG
@@ -633,6 +708,8 @@ void SetDepthBuffer(Context* _ctx, gpu::TextureHandle _handle, uint32_t _arrayId
 
 void ClearDepth(Context* _ctx, gpu::TextureHandle _handle, float _depth, uint32_t _arrayIdx, uint32_t _mipIdx)
 {
+	GPU_CMD_RECORD(_ctx, ClearDepth, _handle, _depth, _arrayIdx, _mipIdx);
+
 	AllocatedResource_D3D12* tex = _ctx->m_device->m_resourceHandles.Lookup(_handle);
 	// TODO: Flush barriers for depth target?
 	KT_ASSERT(tex);
@@ -647,6 +724,8 @@ void ClearDepth(Context* _ctx, gpu::TextureHandle _handle, float _depth, uint32_
 
 void ResourceBarrier(Context* _ctx, gpu::ResourceHandle _handle, gpu::ResourceState _newState)
 {
+	GPU_CMD_RECORD(_ctx, ResourceBarrier, _handle, _newState);
+
 	AllocatedResource_D3D12* res = _ctx->m_device->m_resourceHandles.Lookup(_handle);
 	KT_ASSERT(res);
 
@@ -709,6 +788,8 @@ void ResourceBarrier(Context* _ctx, gpu::ResourceHandle _handle, gpu::ResourceSt
 
 void UAVBarrier(Context* _ctx, gpu::ResourceHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, UAVBarrier, _handle);
+
 	AllocatedResource_D3D12* res = _ctx->m_device->m_resourceHandles.Lookup(_handle);
 	KT_ASSERT(res);
 
@@ -771,6 +852,8 @@ void CommandContext_D3D12::ApplyStateChanges(CommandListFlags_D3D12 _dispatchTyp
 
 void FlushBarriers(Context* _ctx)
 {
+	GPU_CMD_RECORD_NO_ARGS(_ctx, FlushBarriers);
+
 	if (_ctx->m_state.m_batchedBarriers.Size() == 0)
 	{
 		return;
@@ -789,6 +872,8 @@ void FlushBarriers(Context* _ctx)
 
 void CopyResource(Context* _ctx, gpu::ResourceHandle _src, gpu::ResourceHandle _dest)
 {
+	GPU_CMD_RECORD(_ctx, CopyResource, _src, _dest);
+
 	AllocatedResource_D3D12* resSrc = _ctx->m_device->m_resourceHandles.Lookup(_src);
 	AllocatedResource_D3D12* resDst = _ctx->m_device->m_resourceHandles.Lookup(_dest);
 	KT_ASSERT(resSrc);
@@ -798,6 +883,8 @@ void CopyResource(Context* _ctx, gpu::ResourceHandle _src, gpu::ResourceHandle _
 
 void CopyBufferRegion(Context* _ctx, gpu::ResourceHandle _dest, uint32_t _destOffset, gpu::ResourceHandle _src, uint32_t _srcOffset, uint32_t _size)
 {
+	GPU_CMD_RECORD(_ctx, CopyBufferRegion, _dest, _destOffset, _src, _srcOffset, _size);
+
 	AllocatedResource_D3D12* resSrc = _ctx->m_device->m_resourceHandles.Lookup(_src);
 	AllocatedResource_D3D12* resDst = _ctx->m_device->m_resourceHandles.Lookup(_dest);
 	KT_ASSERT(resSrc);
@@ -805,6 +892,28 @@ void CopyBufferRegion(Context* _ctx, gpu::ResourceHandle _dest, uint32_t _destOf
 	_ctx->m_cmdList->CopyBufferRegion(resDst->m_res, _destOffset, resSrc->m_res, _srcOffset, _size);
 }
 
+void CopyTextureSubresource(Context* _ctx, gpu::TextureHandle _dest, uint32_t _destArrayIdx, uint32_t _destMipIdx, gpu::TextureHandle _src, uint32_t _srcArrayIdx, uint32_t _srcMipIdx)
+{
+	GPU_CMD_RECORD(_ctx, CopyTextureSubresource, _dest, _destArrayIdx, _destMipIdx, _src, _srcArrayIdx, _srcMipIdx);
+
+	AllocatedResource_D3D12* resSrc = _ctx->m_device->m_resourceHandles.Lookup(_src);
+	AllocatedResource_D3D12* resDst = _ctx->m_device->m_resourceHandles.Lookup(_dest);
+	KT_ASSERT(resSrc && resSrc->IsTexture());
+	KT_ASSERT(resDst && resDst->IsTexture());
+
+	D3D12_TEXTURE_COPY_LOCATION srcLoc = {};
+	srcLoc.pResource = resSrc->m_res;
+	srcLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	srcLoc.SubresourceIndex = gpu::D3DSubresourceIndex(_srcMipIdx, _srcArrayIdx, resSrc->m_textureDesc.m_mipLevels);
+
+	D3D12_TEXTURE_COPY_LOCATION dstLoc = {};
+	dstLoc.pResource = resDst->m_res;
+	dstLoc.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	dstLoc.SubresourceIndex = gpu::D3DSubresourceIndex(_destMipIdx, _destArrayIdx, resDst->m_textureDesc.m_mipLevels);
+
+	_ctx->m_cmdList->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+}
+
 
 void CommandContext_D3D12::ApplyGraphicsStateChanges()
 {
@@ -905,6 +1014,8 @@ void CommandContext_D3D12::ApplyGraphicsStateChanges()
 
 void SetScissorRect(Context* _ctx, gpu::Rect const& _rect)
 {
+	GPU_CMD_RECORD(_ctx, SetScissorRect, _rect);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 	
 	if (_rect.m_bottomRight != _ctx->m_state.m_scissorRect.m_bottomRight
@@ -917,6 +1028,8 @@ void SetScissorRect(Context* _ctx, gpu::Rect const& _rect)
 
 void SetViewport(Context* _ctx, gpu::Rect const& _rect, float _minDepth, float _maxDepth)
 {
+	GPU_CMD_RECORD(_ctx, SetViewport, _rect, _minDepth, _maxDepth);
+
 	CHECK_QUEUE_FLAGS(_ctx, CommandListFlags_D3D12::Graphics);
 
 	if (_ctx->m_state.m_viewport.m_depthMax != _maxDepth
@@ -934,6 +1047,8 @@ void SetViewport(Context* _ctx, gpu::Rect const& _rect, float _minDepth, float _
 
 void SetViewportAndScissorRectFromTexture(Context* _ctx, gpu::TextureHandle _tex, float _minDepth, float _maxDepth)
 {
+	GPU_CMD_RECORD(_ctx, SetViewportAndScissorRectFromTexture, _tex, _minDepth, _maxDepth);
+
 	gpu::TextureDesc desc;
 	bool const ok = gpu::GetTextureInfo(_tex, desc);
 	KT_ASSERT(ok);
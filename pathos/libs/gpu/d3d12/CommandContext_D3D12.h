@@ -1,6 +1,7 @@
 #pragma once
 #include "Types.h"
 #include "CommandContext.h"
+#include "CommandStream.h"
 #include "HandleRef.h"
 
 #include <kt/Array.h>
@@ -60,7 +61,7 @@ struct BatchedBarrier
 	D3D12_RESOURCE_BARRIER barrier;
 };
 
-struct CommandContext_D3D12
+struct CommandContext_D3D12 : ContextBase
 {
 	CommandContext_D3D12(ContextType _type, Device_D3D12* _dev);
 	~CommandContext_D3D12();
@@ -529,7 +529,7 @@ static ID3D12PipelineState* CreateD3DGraphicsPSO(ID3D12Device* _device, gpu::Gra
 	d3dDesc.RasterizerState.DepthBias = INT(_desc.m_rasterDesc.m_depthBias); // TODO: Need to convert to fixed point d3d expects
 	d3dDesc.RasterizerState.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
 	d3dDesc.RasterizerState.SlopeScaledDepthBias = _desc.m_rasterDesc.m_scopedScaledDepthBias;
-	d3dDesc.RasterizerState.DepthClipEnable = TRUE;
+	d3dDesc.RasterizerState.DepthClipEnable = _desc.m_rasterDesc.m_depthClip ? TRUE : FALSE;
 	d3dDesc.RasterizerState.MultisampleEnable = FALSE;
 	d3dDesc.RasterizerState.AntialiasedLineEnable = FALSE;
 	d3dDesc.RasterizerState.ForcedSampleCount = 0;
@@ -1484,6 +1484,7 @@ static void InitAndValidateCaps(ID3D12Device* _dev, Caps* o_caps)
 	o_caps->waveOps = featureSupport1.WaveOps;
 	o_caps->waveCountMin = featureSupport1.WaveLaneCountMin;
 	o_caps->shaderBarycentrics = featureSupport3.BarycentricsSupported;
+	o_caps->headless = false;
 }
 
 void Device_D3D12::Init(void* _nativeWindowHandle, bool _useDebugLayer)
@@ -1643,7 +1644,7 @@ void Device_D3D12::Init(void* _nativeWindowHandle, bool _useDebugLayer)
 
 	CreateRootSigs(m_d3dDev, m_graphicsRootSig, m_computeRootSig);
 
-	gpu::TextureDesc const depthDesc = gpu::TextureDesc::Desc2D(m_swapChainWidth, m_swapChainHeight, TextureUsageFlags::DepthStencil, Format::D32_Float);
+	gpu::TextureDesc const depthDesc = gpu::TextureDesc::Desc2D(m_swapChainWidth, m_swapChainHeight, TextureUsageFlags::DepthStencil | TextureUsageFlags::ShaderResource, Format::D32_Float);
 	m_backbufferDepth.AcquireNoRef(gpu::CreateTexture(depthDesc, nullptr, "Backbuffer Depth"));
 
 	// Command signatures.
@@ -2123,6 +2124,8 @@ void Device_D3D12::FrameResources::ClearOnBeginFrame()
 // However this isn't technically correct, and throws GPU-Based validation errors.
 void GenerateMips(gpu::cmd::Context* _ctx, gpu::ResourceHandle _handle)
 {
+	GPU_CMD_RECORD(_ctx, GenerateMips, _handle);
+
 	GPU_PROFILE_SCOPE(_ctx, "GPUDevice::GenerateMips", GPU_PROFILE_COLOUR(0x00, 0xff, 0x00));
 
 	AllocatedResource_D3D12* res = g_device->m_resourceHandles.Lookup(_handle);
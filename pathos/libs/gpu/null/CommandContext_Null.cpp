@@ -0,0 +1,663 @@
+#include <kt/Macros.h>
+
+#include "CommandContext_Null.h"
+#include "GPUDevice_Null.h"
+#include "GPUDevice.h"
+#include "GPUProfiler.h"
+
+#include <string.h>
+
+namespace gpu
+{
+
+namespace cmd
+{
+
+#define CHECK_CTX_TYPE(_ctx, _type) \
+	KT_MACRO_BLOCK_BEGIN \
+		KT_ASSERT(_ctx->m_ctxType == ContextType::Graphics || _ctx->m_ctxType == _type); \
+	KT_MACRO_BLOCK_END
+
+#define CHECK_TRANSIENT_TOUCHED_THIS_FRAME(_ctx, _allocatedBuffer) \
+	KT_MACRO_BLOCK_BEGIN \
+		KT_ASSERT(!(_allocatedBuffer->m_bufferDesc.m_flags & BufferFlags::Transient) || _allocatedBuffer->m_lastFrameTouched == _ctx->m_device->m_frameCounter); \
+	KT_MACRO_BLOCK_END
+
+CommandContext_Null::CommandContext_Null(ContextType _type, Device_Null* _dev)
+	: m_device(_dev)
+	, m_ctxType(_type)
+{
+	m_stats.m_numContexts = 1;
+}
+
+CommandContext_Null::~CommandContext_Null()
+{
+	KT_ASSERT(m_state.m_pendingUploads.Size() == 0);
+	KT_ASSERT(m_state.m_markerDepth == 0);
+}
+
+static AllocatedResource_Null* LookupBuffer(Context* _ctx, gpu::ResourceHandle _handle)
+{
+	AllocatedResource_Null* res = _ctx->m_device->m_resourceHandles.Lookup(_handle);
+	KT_ASSERT(res);
+	KT_ASSERT(res->IsBuffer());
+	return res;
+}
+
+static void CheckTableBound(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors)
+{
+#if KT_DEBUG
+	for (DescriptorData const& descriptor : _descriptors)
+	{
+		if (descriptor.m_type != DescriptorData::Type::View || !descriptor.res.m_handle.IsValid())
+		{
+			continue;
+		}
+
+		AllocatedResource_Null* res = _ctx->m_device->m_resourceHandles.Lookup(descriptor.res.m_handle);
+		KT_ASSERT(res);
+		if (res->IsBuffer())
+		{
+			CHECK_TRANSIENT_TOUCHED_THIS_FRAME(_ctx, res);
+		}
+	}
+#else
+	KT_UNUSED2(_ctx, _descriptors);
+#endif
+}
+
+Context* Begin(ContextType _type)
+{
+	return (Context*)(new CommandContext_Null(_type, g_device));
+}
+
+void End(Context* _ctx)
+{
+	if (_ctx->m_recordStream)
+	{
+		EndRecording(_ctx);
+		return;
+	}
+
+	FlushBarriers(_ctx);
+	_ctx->m_device->m_frameStats.Add(_ctx->m_stats);
+	delete _ctx;
+}
+
+void PushMarker(Context* _ctx, char const* _name)
+{
+	PushMarker(_ctx, _name, GPU_PROFILE_COLOUR(0, 0, 0xFF));
+}
+
+void PushMarker(Context* _ctx, char const* _name, uint32_t _colour)
+{
+	GPU_CMD_RECORD(_ctx, PushMarker, _name, _colour);
+
+	_ctx->Count(CommandType_Null::Marker);
+	++_ctx->m_state.m_markerDepth;
+	gpu::profiler::Begin(_ctx, _name, _colour);
+}
+
+void PopMarker(Context* _ctx)
+{
+	GPU_CMD_RECORD_NO_ARGS(_ctx, PopMarker);
+
+	KT_ASSERT(_ctx->m_state.m_markerDepth);
+	--_ctx->m_state.m_markerDepth;
+	gpu::profiler::End(_ctx);
+}
+
+gpu::QueryIndex BeginQuery(Context* _ctx)
+{
+	KT_ASSERT(!_ctx->m_recordStream && "Queries can't be recorded, use markers.");
+
+	_ctx->Count(CommandType_Null::Query);
+
+	Device_Null::QueryFrame& frame = _ctx->m_device->m_queryFrames[gpu::CPUFrameIndexWrapped()];
+	KT_ASSERT(frame.m_numQueries < Device_Null::c_maxQueries);
+	uint32_t const idx = frame.m_numQueries++;
+	frame.m_times[idx * 2] = _ctx->m_device->QueryTimestamp();
+	frame.m_times[idx * 2 + 1] = frame.m_times[idx * 2];
+	return idx;
+}
+
+void EndQuery(Context* _ctx, QueryIndex _idx)
+{
+	KT_ASSERT(!_ctx->m_recordStream && "Queries can't be recorded, use markers.");
+
+	Device_Null::QueryFrame& frame = _ctx->m_device->m_queryFrames[gpu::CPUFrameIndexWrapped()];
+	KT_ASSERT(_idx < frame.m_numQueries);
+	frame.m_times[_idx * 2 + 1] = _ctx->m_device->QueryTimestamp();
+}
+
+ContextType GetContextType(Context* _ctx)
+{
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::GetContextType(_ctx->m_recordStream);
+	}
+
+	return _ctx->m_ctxType;
+}
+
+void ResetState(Context* _ctx)
+{
+	GPU_CMD_RECORD_NO_ARGS(_ctx, ResetState);
+
+	SetDepthBuffer(_ctx, gpu::BackbufferDepth(), 0, 0);
+	SetRenderTarget(_ctx, 0, gpu::CurrentBackbuffer());
+
+	for (uint32_t i = 1; i < c_maxRenderTargets; ++i)
+	{
+		SetRenderTarget(_ctx, i, gpu::TextureHandle{});
+	}
+
+	SetIndexBuffer(_ctx, gpu::BufferHandle{});
+
+	for (uint32_t i = 0; i < c_maxVertexStreams; ++i)
+	{
+		SetVertexBuffer(_ctx, i, gpu::BufferHandle{});
+	}
+
+	SetViewportAndScissorRectFromTexture(_ctx, gpu::CurrentBackbuffer(), 0.0f, 1.0f);
+}
+
+void SetPSO(Context* _ctx, gpu::PSOHandle _pso)
+{
+	GPU_CMD_RECORD(_ctx, SetPSO, _pso);
+
+	if (_ctx->m_state.m_pso.Handle() != _pso)
+	{
+		KT_ASSERT(!_pso.IsValid() || _ctx->m_device->m_psoHandles.IsValid(_pso));
+		_ctx->m_state.m_pso.Acquire(_pso);
+		_ctx->Count(CommandType_Null::SetPSO);
+	}
+}
+
+void SetVertexBuffer(Context* _ctx, uint32_t _streamIdx, gpu::BufferHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, SetVertexBuffer, _streamIdx, _handle);
+
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	KT_ASSERT(_streamIdx < gpu::c_maxVertexStreams);
+
+	if (_ctx->m_state.m_vertexStreams[_streamIdx].Handle() != _handle)
+	{
+		if (_handle.IsValid())
+		{
+			AllocatedResource_Null* res = LookupBuffer(_ctx, _handle);
+			CHECK_TRANSIENT_TOUCHED_THIS_FRAME(_ctx, res);
+			KT_UNUSED(res);
+		}
+
+		_ctx->m_state.m_vertexStreams[_streamIdx].Acquire(_handle);
+		_ctx->Count(CommandType_Null::SetVertexBuffer);
+	}
+}
+
+void SetIndexBuffer(Context* _ctx, gpu::BufferHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, SetIndexBuffer, _handle);
+
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+
+	if (_ctx->m_state.m_indexBuffer.Handle() != _handle)
+	{
+		if (_handle.IsValid())
+		{
+			AllocatedResource_Null* res = LookupBuffer(_ctx, _handle);
+			CHECK_TRANSIENT_TOUCHED_THIS_FRAME(_ctx, res);
+			KT_ASSERT(res->m_bufferDesc.m_format == gpu::Format::R16_Uint || res->m_bufferDesc.m_format == gpu::Format::R32_Uint);
+			KT_UNUSED(res);
+		}
+
+		_ctx->m_state.m_indexBuffer.Acquire(_handle);
+		_ctx->Count(CommandType_Null::SetIndexBuffer);
+	}
+}
+
+void SetRenderTarget(Context* _ctx, uint32_t _idx, gpu::TextureHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, SetRenderTarget, _idx, _handle);
+
+	KT_ASSERT(_idx < gpu::c_maxRenderTargets);
+
+	if (_ctx->m_state.m_renderTargets[_idx].Handle() != _handle)
+	{
+#if KT_DEBUG
+		if (_handle.IsValid())
+		{
+			AllocatedResource_Null* tex = _ctx->m_device->m_resourceHandles.Lookup(_handle);
+			KT_ASSERT(tex);
+			KT_ASSERT(tex->IsTexture());
+			KT_ASSERT(!!(tex->m_textureDesc.m_usageFlags & TextureUsageFlags::RenderTarget));
+		}
+#endif
+
+		_ctx->m_state.m_renderTargets[_idx].Acquire(_handle);
+		_ctx->Count(CommandType_Null::SetRenderTarget);
+	}
+}
+
+void SetDepthBuffer(Context* _ctx, gpu::TextureHandle _handle, uint32_t _arrayIdx, uint32_t _mipIdx)
+{
+	GPU_CMD_RECORD(_ctx, SetDepthBuffer, _handle, _arrayIdx, _mipIdx);
+
+#if KT_DEBUG
+	if (_handle.IsValid())
+	{
+		AllocatedResource_Null* tex = _ctx->m_device->m_resourceHandles.Lookup(_handle);
+		KT_ASSERT(tex);
+		KT_ASSERT(tex->IsTexture());
+		KT_ASSERT(!!(tex->m_textureDesc.m_usageFlags & TextureUsageFlags::DepthStencil));
+		KT_ASSERT(_arrayIdx < tex->m_textureDesc.m_arraySlices || tex->m_type == ResourceType::TextureCube);
+		KT_ASSERT(_mipIdx < tex->m_textureDesc.m_mipLevels);
+	}
+#else
+	KT_UNUSED2(_arrayIdx, _mipIdx);
+#endif
+
+	_ctx->m_state.m_depthBuffer.Acquire(_handle);
+	_ctx->Count(CommandType_Null::SetDepthBuffer);
+}
+
+void SetComputeCBVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetComputeCBVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Compute);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetComputeUAVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetComputeUAVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Compute);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetComputeSRVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetComputeSRVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Compute);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetComputeSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetComputeSRVTable, _table, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Compute);
+	KT_ASSERT(_ctx->m_device->m_persistentTableHandles.IsValid(_table));
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetGraphicsCBVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetGraphicsCBVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetGraphicsUAVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetGraphicsUAVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetGraphicsSRVTable(Context* _ctx, kt::Slice<DescriptorData> const& _descriptors, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetGraphicsSRVTable, _descriptors, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	CheckTableBound(_ctx, _descriptors);
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void SetGraphicsSRVTable(Context* _ctx, gpu::PersistentDescriptorTableHandle _table, uint32_t _space)
+{
+	GPU_CMD_RECORD(_ctx, SetGraphicsSRVTable, _table, _space);
+
+	KT_UNUSED(_space);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	KT_ASSERT(_ctx->m_device->m_persistentTableHandles.IsValid(_table));
+	_ctx->Count(CommandType_Null::SetDescriptorTable);
+}
+
+void ResourceBarrier(Context* _ctx, gpu::ResourceHandle _handle, gpu::ResourceState _newState)
+{
+	GPU_CMD_RECORD(_ctx, ResourceBarrier, _handle, _newState);
+
+	AllocatedResource_Null* res = _ctx->m_device->m_resourceHandles.Lookup(_handle);
+	KT_ASSERT(res);
+
+	if (res->IsBuffer() && !!(res->m_bufferDesc.m_flags & gpu::BufferFlags::Transient))
+	{
+		// Always in generic read, as on D3D12.
+		return;
+	}
+
+	if (res->m_resState == _newState)
+	{
+		return;
+	}
+
+	res->m_resState = _newState;
+	_ctx->Count(CommandType_Null::ResourceBarrier);
+}
+
+void UAVBarrier(Context* _ctx, gpu::ResourceHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, UAVBarrier, _handle);
+
+	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
+	KT_UNUSED(_handle);
+	_ctx->Count(CommandType_Null::UAVBarrier);
+}
+
+void FlushBarriers(Context* _ctx)
+{
+	GPU_CMD_RECORD_NO_ARGS(_ctx, FlushBarriers);
+
+	// Barriers are applied as they're issued.
+	KT_UNUSED(_ctx);
+}
+
+void CopyResource(Context* _ctx, gpu::ResourceHandle _src, gpu::ResourceHandle _dest)
+{
+	GPU_CMD_RECORD(_ctx, CopyResource, _src, _dest);
+
+	AllocatedResource_Null* resSrc = _ctx->m_device->m_resourceHandles.Lookup(_src);
+	AllocatedResource_Null* resDst = _ctx->m_device->m_resourceHandles.Lookup(_dest);
+	KT_ASSERT(resSrc);
+	KT_ASSERT(resDst);
+	KT_ASSERT(resSrc->m_type == resDst->m_type);
+
+	if (resSrc->IsBuffer())
+	{
+		KT_ASSERT(resSrc->m_cpuData.Size() == resDst->m_cpuData.Size());
+		memcpy(resDst->m_cpuData.Data(), resSrc->m_cpuData.Data(), kt::Min(resSrc->m_cpuData.Size(), resDst->m_cpuData.Size()));
+	}
+
+	_ctx->Count(CommandType_Null::CopyResource);
+}
+
+void CopyBufferRegion(Context* _ctx, gpu::ResourceHandle _dest, uint32_t _destOffset, gpu::ResourceHandle _src, uint32_t _srcOffset, uint32_t _size)
+{
+	GPU_CMD_RECORD(_ctx, CopyBufferRegion, _dest, _destOffset, _src, _srcOffset, _size);
+
+	AllocatedResource_Null* resSrc = LookupBuffer(_ctx, _src);
+	AllocatedResource_Null* resDst = LookupBuffer(_ctx, _dest);
+	KT_ASSERT(_srcOffset + _size <= resSrc->m_cpuData.Size());
+	KT_ASSERT(_destOffset + _size <= resDst->m_cpuData.Size());
+	memmove(resDst->m_cpuData.Data() + _destOffset, resSrc->m_cpuData.Data() + _srcOffset, _size);
+	_ctx->Count(CommandType_Null::CopyBufferRegion);
+}
+
+void CopyTextureSubresource(Context* _ctx, gpu::TextureHandle _dest, uint32_t _destArrayIdx, uint32_t _destMipIdx, gpu::TextureHandle _src, uint32_t _srcArrayIdx, uint32_t _srcMipIdx)
+{
+	GPU_CMD_RECORD(_ctx, CopyTextureSubresource, _dest, _destArrayIdx, _destMipIdx, _src, _srcArrayIdx, _srcMipIdx);
+
+#if KT_DEBUG
+	AllocatedResource_Null* resSrc = _ctx->m_device->m_resourceHandles.Lookup(_src);
+	AllocatedResource_Null* resDst = _ctx->m_device->m_resourceHandles.Lookup(_dest);
+	KT_ASSERT(resSrc && resSrc->IsTexture());
+	KT_ASSERT(resDst && resDst->IsTexture());
+	KT_ASSERT(_srcMipIdx < resSrc->m_textureDesc.m_mipLevels);
+	KT_ASSERT(_destMipIdx < resDst->m_textureDesc.m_mipLevels);
+#else
+	KT_UNUSED4(_dest, _src, _srcMipIdx, _destMipIdx);
+#endif
+	KT_UNUSED2(_destArrayIdx, _srcArrayIdx);
+	_ctx->Count(CommandType_Null::CopyTextureSubresource);
+}
+
+static void CheckGraphicsDraw(Context* _ctx)
+{
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	KT_ASSERT(_ctx->m_state.m_pso.Handle().IsValid());
+
+#if KT_DEBUG
+	AllocatedPSO_Null* pso = _ctx->m_device->m_psoHandles.Lookup(_ctx->m_state.m_pso);
+	KT_ASSERT(pso && !pso->IsCompute());
+#endif
+}
+
+void DrawIndexedInstanced(Context* _ctx, uint32_t _indexCount, uint32_t _instanceCount, uint32_t _startIndex, uint32_t _baseVertex, uint32_t _startInstance)
+{
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstanced, _indexCount, _instanceCount, _startIndex, _baseVertex, _startInstance);
+
+	KT_UNUSED3(_startIndex, _baseVertex, _startInstance);
+	CheckGraphicsDraw(_ctx);
+	KT_ASSERT(_ctx->m_state.m_indexBuffer.Handle().IsValid());
+
+	_ctx->Count(CommandType_Null::DrawIndexedInstanced);
+	++_ctx->m_stats.m_numDraws;
+	_ctx->m_stats.m_numInstances += _instanceCount;
+	_ctx->m_stats.m_numIndices += uint64_t(_indexCount) * _instanceCount;
+}
+
+void DrawInstanced(Context* _ctx, uint32_t _vertexCount, uint32_t _instanceCount, uint32_t _startVertex, uint32_t _startInstance)
+{
+	GPU_CMD_RECORD(_ctx, DrawInstanced, _vertexCount, _instanceCount, _startVertex, _startInstance);
+
+	KT_UNUSED2(_startVertex, _startInstance);
+	CheckGraphicsDraw(_ctx);
+
+	_ctx->Count(CommandType_Null::DrawInstanced);
+	++_ctx->m_stats.m_numDraws;
+	_ctx->m_stats.m_numInstances += _instanceCount;
+	_ctx->m_stats.m_numIndices += uint64_t(_vertexCount) * _instanceCount;
+}
+
+void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _drawCount)
+{
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstancedIndirect, _argBuffer, _argOffset, _drawCount, gpu::ResourceHandle{}, 0);
+
+	DrawIndexedInstancedIndirect(_ctx, _argBuffer, _argOffset, _drawCount, gpu::ResourceHandle{}, 0);
+}
+
+void DrawIndexedInstancedIndirect(Context* _ctx, gpu::ResourceHandle _argBuffer, uint32_t _argOffset, uint32_t _maxDrawCount, gpu::ResourceHandle _countBuffer, uint32_t _countOffset)
+{
+	GPU_CMD_RECORD(_ctx, DrawIndexedInstancedIndirect, _argBuffer, _argOffset, _maxDrawCount, _countBuffer, _countOffset);
+
+	CheckGraphicsDraw(_ctx);
+
+	AllocatedResource_Null* argBuffer = LookupBuffer(_ctx, _argBuffer);
+	KT_ASSERT(_argOffset + _maxDrawCount * sizeof(uint32_t) * 5 <= argBuffer->m_bufferDesc.m_sizeInBytes);
+	KT_UNUSED2(argBuffer, _argOffset);
+
+	if (_countBuffer.IsValid())
+	{
+		AllocatedResource_Null* countBuffer = LookupBuffer(_ctx, _countBuffer);
+		KT_ASSERT(_countOffset + sizeof(uint32_t) <= countBuffer->m_bufferDesc.m_sizeInBytes);
+		KT_UNUSED(countBuffer);
+	}
+	KT_UNUSED(_countOffset);
+
+	// Arguments are gpu written, count the upper bound.
+	_ctx->Count(CommandType_Null::DrawIndexedInstancedIndirect);
+	_ctx->m_stats.m_numDraws += _maxDrawCount;
+}
+
+void Dispatch(Context* _ctx, uint32_t _x, uint32_t _y, uint32_t _z)
+{
+	GPU_CMD_RECORD(_ctx, Dispatch, _x, _y, _z);
+
+	CHECK_CTX_TYPE(_ctx, ContextType::Compute);
+	KT_ASSERT(_x && _y && _z);
+	KT_UNUSED3(_x, _y, _z);
+
+#if KT_DEBUG
+	AllocatedPSO_Null* pso = _ctx->m_device->m_psoHandles.Lookup(_ctx->m_state.m_pso);
+	KT_ASSERT(pso && pso->IsCompute());
+#endif
+
+	_ctx->Count(CommandType_Null::Dispatch);
+}
+
+void ClearRenderTarget(Context* _ctx, gpu::TextureHandle _handle, float const _color[4])
+{
+	GPU_CMD_RECORD(_ctx, ClearRenderTarget, _handle, _color);
+
+	KT_UNUSED(_color);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
+	KT_UNUSED(_handle);
+	_ctx->Count(CommandType_Null::ClearRenderTarget);
+}
+
+void ClearDepth(Context* _ctx, gpu::TextureHandle _handle, float _depth, uint32_t _arrayIdx, uint32_t _mipIdx)
+{
+	GPU_CMD_RECORD(_ctx, ClearDepth, _handle, _depth, _arrayIdx, _mipIdx);
+
+	KT_UNUSED3(_depth, _arrayIdx, _mipIdx);
+	CHECK_CTX_TYPE(_ctx, ContextType::Graphics);
+	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
+	KT_UNUSED(_handle);
+	_ctx->Count(CommandType_Null::ClearDepth);
+}
+
+void UpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle, void const* _mem, uint32_t _size, uint32_t _destOffset)
+{
+	GPU_CMD_RECORD(_ctx, UpdateDynamicBuffer, _handle, _mem, _size, _destOffset);
+
+	kt::Slice<uint8_t> slice = BeginUpdateDynamicBuffer(_ctx, _handle, _size, _destOffset);
+	memcpy(slice.Data(), _mem, _size);
+	EndUpdateDynamicBuffer(_ctx, _handle);
+}
+
+kt::Slice<uint8_t> BeginUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle, uint32_t _size, uint32_t _destOffset)
+{
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::BeginUpdateDynamicBuffer(_ctx->m_recordStream, _handle, _size, _destOffset);
+	}
+
+	AllocatedResource_Null* res = LookupBuffer(_ctx, _handle);
+	KT_ASSERT(!!(res->m_bufferDesc.m_flags & BufferFlags::Dynamic));
+	KT_ASSERT(_destOffset + _size <= res->m_cpuData.Size());
+
+#if KT_DEBUG
+	for (CommandContext_Null::PendingDynamicUpload const& oldUpdate : _ctx->m_state.m_pendingUploads)
+	{
+		KT_ASSERT(oldUpdate.m_resource.Handle() != _handle && "Already updating this buffer!");
+	}
+#endif
+
+	CommandContext_Null::PendingDynamicUpload& pendingUpload = _ctx->m_state.m_pendingUploads.PushBack();
+	pendingUpload.m_resource = _handle;
+	pendingUpload.m_destOffset = _destOffset;
+	pendingUpload.m_size = _size;
+
+	return kt::MakeSlice(res->m_cpuData.Data() + _destOffset, _size);
+}
+
+void EndUpdateDynamicBuffer(Context* _ctx, gpu::BufferHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, EndUpdateDynamicBuffer, _handle);
+
+	KT_ASSERT(_ctx->m_device->m_resourceHandles.IsValid(_handle));
+
+	for (CommandContext_Null::PendingDynamicUpload* it = _ctx->m_state.m_pendingUploads.Begin();
+		 it != _ctx->m_state.m_pendingUploads.End();
+		 ++it)
+	{
+		if (it->m_resource.Handle() == _handle)
+		{
+			_ctx->Count(CommandType_Null::UpdateDynamicBuffer);
+			_ctx->m_stats.m_uploadBytes += it->m_size;
+			_ctx->m_state.m_pendingUploads.EraseSwap(it);
+			return;
+		}
+	}
+
+	KT_ASSERT(!"BeginUpdateDynamicBuffer was not called with this resource.");
+}
+
+void UpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle, void const* _mem, uint32_t _size)
+{
+	kt::Slice<uint8_t> slice = BeginUpdateTransientBuffer(_ctx, _handle, _size);
+	memcpy(slice.Data(), _mem, _size);
+	EndUpdateTransientBuffer(_ctx, _handle);
+}
+
+kt::Slice<uint8_t> BeginUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle, uint32_t _size)
+{
+	if (_ctx->m_recordStream)
+	{
+		return gpu::cmd::record::BeginUpdateTransientBuffer(_ctx->m_recordStream, _handle, _size);
+	}
+
+	AllocatedResource_Null* res = LookupBuffer(_ctx, _handle);
+	KT_ASSERT(!!(res->m_bufferDesc.m_flags & BufferFlags::Transient));
+
+	res->UpdateTransientSize(_size);
+	res->m_lastFrameTouched = _ctx->m_device->m_frameCounter;
+
+	_ctx->Count(CommandType_Null::UpdateTransientBuffer);
+	_ctx->m_stats.m_uploadBytes += _size;
+
+	return kt::MakeSlice(res->m_cpuData.Data(), res->m_bufferDesc.m_sizeInBytes);
+}
+
+void EndUpdateTransientBuffer(Context* _ctx, gpu::BufferHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, EndUpdateTransientBuffer, _handle);
+
+	KT_UNUSED2(_ctx, _handle);
+}
+
+void SetScissorRect(Context* _ctx, gpu::Rect const& _rect)
+{
+	GPU_CMD_RECORD(_ctx, SetScissorRect, _rect);
+
+	_ctx->m_state.m_scissorRect = _rect;
+	_ctx->Count(CommandType_Null::SetScissorRect);
+}
+
+void SetViewport(Context* _ctx, gpu::Rect const& _rect, float _minDepth, float _maxDepth)
+{
+	GPU_CMD_RECORD(_ctx, SetViewport, _rect, _minDepth, _maxDepth);
+
+	KT_ASSERT(_minDepth <= _maxDepth);
+	KT_UNUSED2(_minDepth, _maxDepth);
+	_ctx->m_state.m_viewport = _rect;
+	_ctx->Count(CommandType_Null::SetViewport);
+}
+
+void SetViewportAndScissorRectFromTexture(Context* _ctx, gpu::TextureHandle _tex, float _minDepth, float _maxDepth)
+{
+	GPU_CMD_RECORD(_ctx, SetViewportAndScissorRectFromTexture, _tex, _minDepth, _maxDepth);
+
+	gpu::TextureDesc desc;
+	bool const ok = gpu::GetTextureInfo(_tex, desc);
+	KT_ASSERT(ok);
+	KT_UNUSED(ok);
+
+	gpu::Rect const rect(float(desc.m_width), float(desc.m_height));
+
+	gpu::cmd::SetViewport(_ctx, rect, _minDepth, _maxDepth);
+	gpu::cmd::SetScissorRect(_ctx, rect);
+}
+
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <gpu/Types.h>
+#include <gpu/CommandContext.h>
+#include <gpu/CommandStream.h>
+#include <gpu/HandleRef.h>
+
+#include <kt/Array.h>
+
+#include "GPUDevice_Null.h"
+
+namespace gpu
+{
+
+namespace cmd
+{
+
+struct CommandContext_Null : ContextBase
+{
+	CommandContext_Null(ContextType _type, Device_Null* _dev);
+	~CommandContext_Null();
+
+	void Count(CommandType_Null _type)
+	{
+		++m_stats.m_numCommands[uint32_t(_type)];
+	}
+
+	Device_Null* m_device;
+
+	ContextType m_ctxType;
+
+	CommandStats_Null m_stats;
+
+	struct PendingDynamicUpload
+	{
+		gpu::ResourceRef m_resource;
+		uint32_t m_destOffset;
+		uint32_t m_size;
+	};
+
+	struct State
+	{
+		gpu::BufferRef m_vertexStreams[gpu::c_maxVertexStreams];
+		gpu::BufferRef m_indexBuffer;
+
+		gpu::PSORef m_pso;
+
+		gpu::TextureRef m_depthBuffer;
+		gpu::TextureRef m_renderTargets[gpu::c_maxRenderTargets];
+
+		gpu::Rect m_scissorRect;
+		gpu::Rect m_viewport;
+
+		// Written in place, Begin/EndUpdateDynamicBuffer only checks they're paired.
+		kt::InplaceArray<PendingDynamicUpload, 16u> m_pendingUploads;
+
+		uint32_t m_markerDepth = 0;
+	} m_state;
+};
+
+struct Context : CommandContext_Null {};
+
+}
+
+}
@@ -0,0 +1,712 @@
+#include "GPUDevice_Null.h"
+#include "CommandContext_Null.h"
+#include "GPUDevice.h"
+#include "GPUProfiler.h"
+
+#include <kt/Macros.h>
+#include <kt/Logging.h>
+#include <kt/Hash.h>
+
+#include <string.h>
+
+namespace gpu
+{
+
+Device_Null* g_device = nullptr;
+
+static uint32_t s_backbufferWidth = 1280;
+static uint32_t s_backbufferHeight = 720;
+
+void CommandStats_Null::Add(CommandStats_Null const& _other)
+{
+	for (uint32_t i = 0; i < uint32_t(CommandType_Null::Num_CommandType_Null); ++i)
+	{
+		m_numCommands[i] += _other.m_numCommands[i];
+	}
+
+	m_numDraws += _other.m_numDraws;
+	m_numInstances += _other.m_numInstances;
+	m_numIndices += _other.m_numIndices;
+	m_uploadBytes += _other.m_uploadBytes;
+	m_numContexts += _other.m_numContexts;
+}
+
+bool AllocatedResource_Null::InitAsBuffer(BufferDesc const& _desc, void const* _initialData, uint32_t _initialDataSize, char const* _debugName)
+{
+	// Same requirements as D3D12.
+	if (!!(_desc.m_flags & BufferFlags::Transient) && !!(_desc.m_flags & BufferFlags::Dynamic))
+	{
+		KT_ASSERT(!"Buffer can't be both transient and dynamic.");
+		return false;
+	}
+
+	if (!(_desc.m_flags & BufferFlags::Transient) && _desc.m_sizeInBytes == 0)
+	{
+		KT_ASSERT(!"Non transient buffer must have a size.");
+		return false;
+	}
+
+	AllocatedObjectBase_Null::Init(_debugName);
+
+	m_type = ResourceType::Buffer;
+	m_bufferDesc = _desc;
+	m_resState = ResourceState::Common;
+
+	m_cpuData.Resize(_desc.m_sizeInBytes);
+
+	if (_desc.m_sizeInBytes)
+	{
+		memset(m_cpuData.Data(), 0, _desc.m_sizeInBytes);
+	}
+
+	if (_initialData)
+	{
+		if (!!(_desc.m_flags & BufferFlags::Transient))
+		{
+			// Transient with initial data.
+			UpdateTransientSize(_initialDataSize);
+			m_lastFrameTouched = g_device->m_frameCounter;
+		}
+
+		KT_ASSERT(_initialDataSize <= m_bufferDesc.m_sizeInBytes);
+		memcpy(m_cpuData.Data(), _initialData, _initialDataSize);
+	}
+
+	return true;
+}
+
+bool AllocatedResource_Null::InitAsTexture(TextureDesc const& _desc, void const* _initialData, char const* _debugName)
+{
+	KT_UNUSED(_initialData);
+
+	if (_desc.m_type == ResourceType::Buffer || _desc.m_type == ResourceType::Num_ResourceType || _desc.m_format == Format::Num_Format)
+	{
+		KT_ASSERT(!"Invalid texture description.");
+		return false;
+	}
+
+	AllocatedObjectBase_Null::Init(_debugName);
+
+	m_type = _desc.m_type;
+	m_textureDesc = _desc;
+	m_resState = !!(_desc.m_usageFlags & TextureUsageFlags::RenderTarget) ? ResourceState::RenderTarget
+		: !!(_desc.m_usageFlags & TextureUsageFlags::DepthStencil) ? ResourceState::DepthStencilTarget
+		: ResourceState::ShaderResource;
+
+	return true;
+}
+
+void AllocatedResource_Null::Destroy()
+{
+	m_cpuData.Clear();
+	m_lastFrameTouched = 0xFFFFFFFF;
+	m_type = ResourceType::Num_ResourceType;
+}
+
+void AllocatedResource_Null::UpdateTransientSize(uint32_t _size)
+{
+	KT_ASSERT(!!(m_bufferDesc.m_flags & gpu::BufferFlags::Transient));
+
+	// Constant buffers are placed on 256 byte boundaries on D3D12, keep sizes matching.
+	m_bufferDesc.m_sizeInBytes = !!(m_bufferDesc.m_flags & gpu::BufferFlags::Constant) ? uint32_t(kt::AlignUp(_size, 256u)) : _size;
+	m_cpuData.Resize(m_bufferDesc.m_sizeInBytes);
+}
+
+void AllocatedShader_Null::Init(ShaderType _type, ShaderBytecode const& _byteCode, char const* _name)
+{
+	m_shaderType = _type;
+	m_byteCode.Resize(uint32_t(_byteCode.m_size));
+
+	if (_byteCode.m_size)
+	{
+		memcpy(m_byteCode.Data(), _byteCode.m_data, _byteCode.m_size);
+	}
+
+	AllocatedObjectBase_Null::Init(_name);
+}
+
+void AllocatedShader_Null::Destroy()
+{
+	m_byteCode.Clear();
+	m_computePso = gpu::PSOHandle{};
+}
+
+void AllocatedPSO_Null::InitAsCompute(gpu::ShaderHandle _handle, char const* _debugName)
+{
+	gpu::AddRef(_handle);
+	m_cs = _handle;
+
+	AllocatedObjectBase_Null::Init(_debugName);
+}
+
+void AllocatedPSO_Null::InitAsGraphics(gpu::GraphicsPSODesc const& _desc, char const* _debugName)
+{
+	m_psoDesc = _desc;
+	gpu::AddRef(m_psoDesc.m_vs);
+
+	if (m_psoDesc.m_ps.IsValid())
+	{
+		gpu::AddRef(m_psoDesc.m_ps);
+	}
+
+	AllocatedObjectBase_Null::Init(_debugName);
+}
+
+void AllocatedPSO_Null::Destroy()
+{
+	if (m_psoDesc.m_ps.IsValid())
+	{
+		gpu::Release(m_psoDesc.m_ps);
+	}
+
+	if (m_psoDesc.m_vs.IsValid())
+	{
+		gpu::Release(m_psoDesc.m_vs);
+	}
+
+	if (m_cs.IsValid())
+	{
+		gpu::Release(m_cs);
+		m_cs = gpu::ShaderHandle{};
+	}
+
+	m_psoDesc = gpu::GraphicsPSODesc{};
+}
+
+void Device_Null::Init(uint32_t _backbufferWidth, uint32_t _backbufferHeight)
+{
+	m_resourceHandles.Init(kt::GetDefaultAllocator(), 1024 * 8);
+	m_shaderHandles.Init(kt::GetDefaultAllocator(), 1024);
+	m_psoHandles.Init(kt::GetDefaultAllocator(), 1024);
+	m_persistentTableHandles.Init(kt::GetDefaultAllocator(), 256);
+
+	m_initTime = kt::TimePoint::Now();
+
+	m_swapChainWidth = _backbufferWidth;
+	m_swapChainHeight = _backbufferHeight;
+
+	// Capabilities the renderer asks for on D3D12, so the same paths run.
+	m_caps = Caps{};
+	m_caps.waveCountMin = 32;
+	m_caps.conservativeRasterization = true;
+	m_caps.doubleShaderOps = true;
+	m_caps.int64ShaderOps = true;
+	m_caps.waveOps = true;
+	m_caps.shaderBarycentrics = true;
+	m_caps.headless = true;
+
+	for (uint32_t i = 0; i < c_maxBufferedFrames; ++i)
+	{
+		kt::String64 name;
+		name.AppendFmt("Backbuffer %u", i);
+		gpu::TextureDesc const desc = gpu::TextureDesc::Desc2D(_backbufferWidth, _backbufferHeight, TextureUsageFlags::RenderTarget, gpu::Format::R8G8B8A8_UNorm);
+		m_backBuffers[i] = gpu::CreateTexture(desc, nullptr, name.Data());
+	}
+
+	{
+		gpu::TextureDesc desc = gpu::TextureDesc::Desc2D(_backbufferWidth, _backbufferHeight, TextureUsageFlags::DepthStencil, gpu::Format::D32_Float);
+		desc.m_clear.ds.m_depth = 1.0f;
+		desc.m_clear.ds.m_stencil = 0;
+		m_backbufferDepth = gpu::CreateTexture(desc, nullptr, "Backbuffer Depth");
+	}
+
+	KT_LOG_INFO("Null gpu device created, backbuffer %ux%u.", _backbufferWidth, _backbufferHeight);
+}
+
+Device_Null::~Device_Null()
+{
+	KT_ASSERT(!m_mainThreadCtx);
+
+	for (gpu::TextureRef& texRef : m_backBuffers)
+	{
+		texRef = gpu::TextureRef{};
+	}
+
+	m_backbufferDepth = gpu::TextureRef{};
+
+	m_psoCache.Clear();
+
+	KT_ASSERT(m_psoHandles.NumAllocated() == 0);
+	KT_ASSERT(m_resourceHandles.NumAllocated() == 0);
+	KT_ASSERT(m_shaderHandles.NumAllocated() == 0);
+	KT_ASSERT(m_persistentTableHandles.NumAllocated() == 0);
+}
+
+uint64_t Device_Null::QueryTimestamp() const
+{
+	return uint64_t((kt::TimePoint::Now() - m_initTime).Seconds() * 1000000000.0);
+}
+
+void Device_Null::BeginFrame()
+{
+	m_mainThreadCtx = gpu::cmd::Begin(gpu::cmd::ContextType::Graphics);
+
+	// Nothing is in flight, so the frame's queries can be resolved straight away.
+	QueryFrame& queries = m_queryFrames[m_cpuFrameIdx];
+	memcpy(m_resolvedQueryTimes, queries.m_times, sizeof(uint64_t) * 2 * queries.m_numQueries);
+	gpu::profiler::ResolveFrame(m_cpuFrameIdx);
+
+	queries.m_numQueries = 0;
+	gpu::profiler::BeginFrame(m_mainThreadCtx, m_cpuFrameIdx);
+
+	gpu::cmd::ResourceBarrier(m_mainThreadCtx, m_backBuffers[m_cpuFrameIdx], gpu::ResourceState::RenderTarget);
+	gpu::cmd::FlushBarriers(m_mainThreadCtx);
+}
+
+void Device_Null::EndFrame()
+{
+	gpu::profiler::EndFrame(m_mainThreadCtx, m_cpuFrameIdx);
+
+	gpu::cmd::ResourceBarrier(m_mainThreadCtx, m_backBuffers[m_cpuFrameIdx], gpu::ResourceState::Present);
+	gpu::cmd::End(m_mainThreadCtx);
+	m_mainThreadCtx = nullptr;
+
+	m_totalStats.Add(m_frameStats);
+	m_lastFrameStats = m_frameStats;
+	m_frameStats = CommandStats_Null{};
+
+	m_cpuFrameIdx = (m_cpuFrameIdx + 1) % c_maxBufferedFrames;
+	++m_frameCounter;
+}
+
+CommandStats_Null const& LastFrameCommandStats_Null()
+{
+	return g_device->m_lastFrameStats;
+}
+
+CommandStats_Null const& TotalCommandStats_Null()
+{
+	return g_device->m_totalStats;
+}
+
+void SetBackbufferSize_Null(uint32_t _width, uint32_t _height)
+{
+	KT_ASSERT(!g_device);
+	s_backbufferWidth = _width;
+	s_backbufferHeight = _height;
+}
+
+kt::Slice<uint8_t const> BufferContents_Null(gpu::BufferHandle _handle)
+{
+	AllocatedResource_Null* res = g_device->m_resourceHandles.Lookup(_handle);
+	KT_ASSERT(res && res->IsBuffer());
+	return kt::MakeSlice((uint8_t const*)res->m_cpuData.Data(), res->m_cpuData.Size());
+}
+
+bool Init(void* _nwh)
+{
+	// No window to present to.
+	KT_UNUSED(_nwh);
+
+	KT_ASSERT(!g_device);
+	g_device = new Device_Null();
+	g_device->Init(s_backbufferWidth, s_backbufferHeight);
+	return true;
+}
+
+void Shutdown()
+{
+	KT_ASSERT(g_device);
+	delete g_device;
+	g_device = nullptr;
+}
+
+void BeginFrame()
+{
+	g_device->BeginFrame();
+}
+
+void EndFrame()
+{
+	g_device->EndFrame();
+}
+
+void BeginGraphicsDebuggerCapture()
+{
+}
+
+void EndGraphicsDebuggerCapture()
+{
+}
+
+cmd::Context* GetMainThreadCommandCtx()
+{
+	KT_ASSERT(g_device->m_mainThreadCtx);
+	return g_device->m_mainThreadCtx;
+}
+
+gpu::BufferHandle CreateBuffer(gpu::BufferDesc const& _desc, void const* _initialData, uint32_t _initialDataSize, char const* _debugName)
+{
+	AllocatedResource_Null* res;
+	gpu::ResourceHandle const handle = gpu::ResourceHandle{ g_device->m_resourceHandles.Alloc(res) };
+	if (!handle.IsValid())
+	{
+		return gpu::BufferHandle{};
+	}
+
+	if (!res->InitAsBuffer(_desc, _initialData, _initialDataSize, _debugName))
+	{
+		g_device->m_resourceHandles.Free(handle);
+		return gpu::BufferHandle{};
+	}
+
+	return gpu::BufferHandle{ handle };
+}
+
+gpu::BufferHandle CreateBuffer(gpu::BufferDesc const& _desc, void const* _initialData, char const* _debugName)
+{
+	return CreateBuffer(_desc, _initialData, _desc.m_sizeInBytes, _debugName);
+}
+
+gpu::TextureHandle CreateTexture(gpu::TextureDesc const& _desc, void const* _initialData, char const* _debugName)
+{
+	AllocatedResource_Null* res;
+	gpu::ResourceHandle const handle = gpu::ResourceHandle{ g_device->m_resourceHandles.Alloc(res) };
+	if (!handle.IsValid())
+	{
+		return gpu::TextureHandle{};
+	}
+
+	if (!res->InitAsTexture(_desc, _initialData, _debugName))
+	{
+		g_device->m_resourceHandles.Free(handle);
+		return gpu::TextureHandle{};
+	}
+
+	return gpu::TextureHandle{ handle };
+}
+
+void GetSwapchainDimensions(uint32_t& o_width, uint32_t& o_height)
+{
+	o_width = g_device->m_swapChainWidth;
+	o_height = g_device->m_swapChainHeight;
+}
+
+gpu::PSOHandle CreateGraphicsPSO(gpu::GraphicsPSODesc const& _desc, char const* _debugName)
+{
+	// Make sure VS and PS are valid. (allow null ps)
+	if (_desc.m_ps.IsValid())
+	{
+		AllocatedShader_Null* psShader = g_device->m_shaderHandles.Lookup(_desc.m_ps);
+		if (!psShader || psShader->m_shaderType != ShaderType::Pixel)
+		{
+			KT_ASSERT(!"Invalid pixel shader handle passed to CreateGraphicsPSO.");
+			return gpu::PSOHandle{};
+		}
+	}
+
+	AllocatedShader_Null* vsShader = g_device->m_shaderHandles.Lookup(_desc.m_vs);
+	if (!vsShader || vsShader->m_shaderType != ShaderType::Vertex)
+	{
+		KT_ASSERT(!"Invalid vertex shader handle passed to CreateGraphicsPSO.");
+		return gpu::PSOHandle{};
+	}
+
+	// Cached by description as on D3D12, so refcounts behave the same.
+	uint64_t const hash = kt::XXHash_64(&_desc, sizeof(gpu::GraphicsPSODesc));
+	Device_Null::PSOCache::Iterator it = g_device->m_psoCache.Find(hash);
+
+	if (it != g_device->m_psoCache.End())
+	{
+		gpu::PSOHandle const handle = it->m_val;
+		AllocatedPSO_Null* allocatedPso = g_device->m_psoHandles.Lookup(handle);
+		KT_ASSERT(allocatedPso);
+		KT_ASSERT(memcmp(&_desc, &allocatedPso->m_psoDesc, sizeof(gpu::GraphicsPSODesc)) == 0);
+		allocatedPso->AddRef();
+		return handle;
+	}
+
+	AllocatedPSO_Null* psoData;
+	gpu::PSOHandle const psoHandle = gpu::PSOHandle(g_device->m_psoHandles.Alloc(psoData));
+	if (!psoHandle.IsValid())
+	{
+		return gpu::PSOHandle{};
+	}
+
+	psoData->InitAsGraphics(_desc, _debugName);
+	g_device->m_psoCache.Insert(hash, gpu::PSORef{ psoHandle });
+	return psoHandle;
+}
+
+gpu::PSOHandle CreateComputePSO(gpu::ShaderHandle _shader, char const* _debugName)
+{
+	AllocatedShader_Null* allocatedShader = g_device->m_shaderHandles.Lookup(_shader);
+	KT_ASSERT(allocatedShader);
+	KT_ASSERT(allocatedShader->m_shaderType == gpu::ShaderType::Compute);
+
+	if (g_device->m_psoHandles.IsValid(allocatedShader->m_computePso))
+	{
+		gpu::AddRef(allocatedShader->m_computePso);
+		return allocatedShader->m_computePso;
+	}
+
+	AllocatedPSO_Null* psoData;
+	gpu::PSOHandle const psoHandle = gpu::PSOHandle{ g_device->m_psoHandles.Alloc(psoData) };
+	KT_ASSERT(psoHandle.IsValid());
+
+	psoData->InitAsCompute(_shader, _debugName);
+	allocatedShader->m_computePso = psoHandle;
+	return psoHandle;
+}
+
+gpu::PersistentDescriptorTableHandle CreatePersistentDescriptorTable(uint32_t _descriptorCount)
+{
+	AllocatedPersistentDescriptorTable_Null* table;
+	gpu::PersistentDescriptorTableHandle const handle = PersistentDescriptorTableHandle{ g_device->m_persistentTableHandles.Alloc(table) };
+
+	if (!handle.IsValid())
+	{
+		return handle;
+	}
+
+	table->Init();
+	table->m_descriptors.Resize(_descriptorCount);
+
+	for (gpu::ResourceHandle& descriptor : table->m_descriptors)
+	{
+		descriptor = gpu::ResourceHandle{};
+	}
+
+	return handle;
+}
+
+void SetPersistentTableSRV(gpu::PersistentDescriptorTableHandle _table, gpu::ResourceHandle _resource, uint32_t _idx)
+{
+	AllocatedPersistentDescriptorTable_Null* table = g_device->m_persistentTableHandles.Lookup(_table);
+	KT_ASSERT(table);
+	KT_ASSERT(_idx < table->m_descriptors.Size());
+	KT_ASSERT(g_device->m_resourceHandles.IsValid(_resource));
+	table->m_descriptors[_idx] = _resource;
+}
+
+gpu::ShaderHandle CreateShader(gpu::ShaderType _type, gpu::ShaderBytecode const& _byteCode, char const* _debugName)
+{
+	AllocatedShader_Null* shader;
+	kt::VersionedHandle const handle = g_device->m_shaderHandles.Alloc(shader);
+	if (!handle.IsValid())
+	{
+		return gpu::ShaderHandle{};
+	}
+
+	shader->Init(_type, _byteCode, _debugName);
+	return gpu::ShaderHandle{ handle };
+}
+
+void ReloadShader(gpu::ShaderHandle _handle, gpu::ShaderBytecode const& _newBytecode)
+{
+	AllocatedShader_Null* shader = g_device->m_shaderHandles.Lookup(_handle);
+	if (!shader)
+	{
+		KT_LOG_ERROR("Attempt to reload shader with invalid handle!");
+		return;
+	}
+
+	// Psos only reference shaders by handle, nothing to rebuild.
+	shader->m_byteCode.Resize(uint32_t(_newBytecode.m_size));
+	if (_newBytecode.m_size)
+	{
+		memcpy(shader->m_byteCode.Data(), _newBytecode.m_data, _newBytecode.m_size);
+	}
+
+	KT_LOG_INFO("Shader \"%s\" reloaded.", shader->m_debugName.Data());
+}
+
+void GenerateMips(gpu::cmd::Context* _ctx, gpu::ResourceHandle _handle)
+{
+	GPU_CMD_RECORD(_ctx, GenerateMips, _handle);
+
+	AllocatedResource_Null* res = g_device->m_resourceHandles.Lookup(_handle);
+	KT_ASSERT(res);
+	KT_ASSERT(res->IsTexture());
+
+	// A dispatch per mip after the first, as the D3D12 compute path does.
+	for (uint32_t mip = 1; mip < res->m_textureDesc.m_mipLevels; ++mip)
+	{
+		_ctx->Count(CommandType_Null::Dispatch);
+	}
+
+	res->m_resState = ResourceState::ShaderResource;
+}
+
+gpu::TextureHandle CurrentBackbuffer()
+{
+	return g_device->m_backBuffers[g_device->m_cpuFrameIdx].Handle();
+}
+
+gpu::TextureHandle BackbufferDepth()
+{
+	return g_device->m_backbufferDepth;
+}
+
+gpu::Format BackbufferFormat()
+{
+	return g_device->m_resourceHandles.Lookup(g_device->m_backBuffers[0])->m_textureDesc.m_format;
+}
+
+gpu::Format BackbufferDepthFormat()
+{
+	return g_device->m_resourceHandles.Lookup(g_device->m_backbufferDepth)->m_textureDesc.m_format;
+}
+
+uint32_t CPUFrameIndexWrapped()
+{
+	return g_device->m_cpuFrameIdx;
+}
+
+void SetVsyncEnabled(bool _vsync)
+{
+	g_device->m_vsync = _vsync;
+}
+
+bool GetShaderInfo(gpu::ShaderHandle _handle, gpu::ShaderType& o_type, char const*& o_name)
+{
+	if (AllocatedShader_Null* shader = g_device->m_shaderHandles.Lookup(_handle))
+	{
+		o_type = shader->m_shaderType;
+		o_name = shader->m_debugName.Data();
+		return true;
+	}
+
+	return false;
+}
+
+bool GetResourceInfo(gpu::ResourceHandle _handle, gpu::ResourceType& _type, gpu::BufferDesc* o_bufferDesc, gpu::TextureDesc* o_textureDesc, char const** o_name)
+{
+	if (AllocatedResource_Null* res = g_device->m_resourceHandles.Lookup(_handle))
+	{
+		if (o_name)
+		{
+			*o_name = res->m_debugName.Data();
+		}
+
+		_type = res->m_type;
+		if (res->IsTexture())
+		{
+			if (o_textureDesc)
+			{
+				*o_textureDesc = res->m_textureDesc;
+			}
+		}
+		else if (o_bufferDesc)
+		{
+			*o_bufferDesc = res->m_bufferDesc;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool GetTextureInfo(gpu::TextureHandle _handle, gpu::TextureDesc& o_textureDesc)
+{
+	gpu::ResourceType type;
+	return GetResourceInfo(_handle, type, nullptr, &o_textureDesc) && gpu::IsTexture(type);
+}
+
+bool GetBufferInfo(gpu::BufferHandle _handle, gpu::BufferDesc& o_bufferDesc)
+{
+	gpu::ResourceType type;
+	return GetResourceInfo(_handle, type, &o_bufferDesc) && type == ResourceType::Buffer;
+}
+
+uint32_t GetBufferNumElements(gpu::BufferHandle _handle)
+{
+	gpu::BufferDesc desc;
+	if (!GetBufferInfo(_handle, desc))
+	{
+		return 0;
+	}
+
+	return desc.m_strideInBytes == 0 ? 0 : desc.m_sizeInBytes / desc.m_strideInBytes;
+}
+
+template <typename HandleT, typename DataT>
+static void AddRefImpl(HandleT _handle, kt::VersionedHandlePool<DataT>& _pool)
+{
+	KT_ASSERT(_pool.IsValid(_handle));
+	_pool.Lookup(_handle)->AddRef();
+}
+
+template <typename HandleT, typename DataT>
+static void ReleaseRefImpl(HandleT _handle, kt::VersionedHandlePool<DataT>& _pool)
+{
+	KT_ASSERT(_pool.IsValid(_handle));
+	DataT* data = _pool.Lookup(_handle);
+	if (data->ReleaseRef() == 0)
+	{
+		data->Destroy();
+		_pool.Free(_handle);
+	}
+}
+
+void AddRef(gpu::ResourceHandle _handle)
+{
+	AddRefImpl(_handle, g_device->m_resourceHandles);
+}
+
+void AddRef(gpu::ShaderHandle _handle)
+{
+	AddRefImpl(_handle, g_device->m_shaderHandles);
+}
+
+void AddRef(gpu::PSOHandle _handle)
+{
+	AddRefImpl(_handle, g_device->m_psoHandles);
+}
+
+void AddRef(gpu::PersistentDescriptorTableHandle _handle)
+{
+	AddRefImpl(_handle, g_device->m_persistentTableHandles);
+}
+
+void Release(gpu::ResourceHandle _handle)
+{
+	ReleaseRefImpl(_handle, g_device->m_resourceHandles);
+}
+
+void Release(gpu::ShaderHandle _handle)
+{
+	ReleaseRefImpl(_handle, g_device->m_shaderHandles);
+}
+
+void Release(gpu::PSOHandle _handle)
+{
+	ReleaseRefImpl(_handle, g_device->m_psoHandles);
+}
+
+void Release(gpu::PersistentDescriptorTableHandle _handle)
+{
+	ReleaseRefImpl(_handle, g_device->m_persistentTableHandles);
+}
+
+void ResolveQuery(QueryIndex _index, uint64_t* o_begin, uint64_t* o_end)
+{
+	KT_ASSERT(_index < Device_Null::c_maxQueries);
+	*o_begin = g_device->m_resolvedQueryTimes[_index * 2];
+	*o_end = g_device->m_resolvedQueryTimes[_index * 2 + 1];
+}
+
+uint64_t GetQueryFrequency()
+{
+	// Query times are cpu nanoseconds.
+	return 1000000000ull;
+}
+
+Caps GetCaps()
+{
+	return g_device->m_caps;
+}
+
+void EnumResourceHandles(kt::StaticFunction<void(gpu::ResourceHandle), 32> const& _ftor)
+{
+	kt::VersionedHandlePool<AllocatedResource_Null>& handlePool = g_device->m_resourceHandles;
+
+	for (uint32_t i = handlePool.FirstAllocatedIndex();
+		 handlePool.IsIndexInUse(i);
+		 i = handlePool.NextAllocatedIndex(i))
+	{
+		_ftor(gpu::ResourceHandle{ handlePool.HandleForIndex(i) });
+	}
+}
+
+}
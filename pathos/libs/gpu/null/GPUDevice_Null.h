@@ -0,0 +1,240 @@
+#pragma once
+#include <stdint.h>
+
+#include <kt/Macros.h>
+#include <kt/Array.h>
+#include <kt/Strings.h>
+#include <kt/Handles.h>
+#include <kt/HashMap.h>
+#include <kt/Timer.h>
+#include <kt/Slice.h>
+
+#include <gpu/Types.h>
+#include <gpu/HandleRef.h>
+
+namespace gpu
+{
+
+namespace cmd
+{
+struct Context;
+}
+
+// Headless backend: resources are handles and descriptions, buffers are backed by cpu memory and commands are validated and counted rather than executed.
+// Lets the renderer run (eg. benchmarks and regression tests) on machines without a gpu or D3D12.
+
+enum class CommandType_Null : uint8_t
+{
+	SetPSO,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetRenderTarget,
+	SetDepthBuffer,
+	SetDescriptorTable,
+	SetViewport,
+	SetScissorRect,
+
+	ResourceBarrier,
+	UAVBarrier,
+
+	CopyResource,
+	CopyBufferRegion,
+	CopyTextureSubresource,
+
+	DrawIndexedInstanced,
+	DrawInstanced,
+	DrawIndexedInstancedIndirect,
+	Dispatch,
+
+	ClearRenderTarget,
+	ClearDepth,
+
+	UpdateDynamicBuffer,
+	UpdateTransientBuffer,
+
+	Marker,
+	Query,
+
+	Num_CommandType_Null
+};
+
+struct CommandStats_Null
+{
+	void Add(CommandStats_Null const& _other);
+
+	uint32_t m_numCommands[uint32_t(CommandType_Null::Num_CommandType_Null)] = {};
+
+	// Draw calls issued, including each draw of an indirect draw's max count.
+	uint64_t m_numDraws = 0;
+	uint64_t m_numInstances = 0;
+	uint64_t m_numIndices = 0;
+
+	// Written into dynamic and transient buffers.
+	uint64_t m_uploadBytes = 0;
+
+	uint32_t m_numContexts = 0;
+};
+
+// Commands of contexts ended during the last EndFrame'd frame, and since Init.
+CommandStats_Null const& LastFrameCommandStats_Null();
+CommandStats_Null const& TotalCommandStats_Null();
+
+// Before Init, backbuffer dimensions the null device is created with.
+void SetBackbufferSize_Null(uint32_t _width, uint32_t _height);
+
+// Cpu memory backing a buffer, eg. for tests to compare what was uploaded. Valid until the buffer is destroyed.
+kt::Slice<uint8_t const> BufferContents_Null(gpu::BufferHandle _handle);
+
+struct Device_Null;
+
+struct AllocatedObjectBase_Null
+{
+	void Init(char const* _name = nullptr)
+	{
+		m_debugName = (_name && *_name != '\0') ? _name : "Un-named resource";
+		m_refs = 1;
+	}
+
+	void AddRef()
+	{
+		KT_ASSERT(m_refs);
+		++m_refs;
+	}
+
+	uint32_t ReleaseRef()
+	{
+		KT_ASSERT(m_refs);
+		return --m_refs;
+	}
+
+	kt::String64 m_debugName;
+	uint32_t m_refs = 0;
+};
+
+struct AllocatedResource_Null : AllocatedObjectBase_Null
+{
+	AllocatedResource_Null()
+		: m_bufferDesc{}
+	{}
+
+	bool InitAsBuffer(BufferDesc const& _desc, void const* _initialData, uint32_t _initialDataSize, char const* _debugName = nullptr);
+	bool InitAsTexture(TextureDesc const& _desc, void const* _initialData, char const* _debugName = nullptr);
+
+	void Destroy();
+
+	void UpdateTransientSize(uint32_t _size);
+
+	bool IsBuffer() const { return m_type == gpu::ResourceType::Buffer; }
+	bool IsTexture() const { return !IsBuffer(); }
+
+	gpu::ResourceType m_type = gpu::ResourceType::Num_ResourceType;
+
+	union
+	{
+		gpu::BufferDesc m_bufferDesc;
+		gpu::TextureDesc m_textureDesc;
+	};
+
+	// Buffer contents, textures have no storage.
+	kt::Array<uint8_t> m_cpuData;
+
+	gpu::ResourceState m_resState = ResourceState::Common;
+
+	uint32_t m_lastFrameTouched = 0xFFFFFFFF;
+};
+
+struct AllocatedShader_Null : AllocatedObjectBase_Null
+{
+	void Init(ShaderType _type, ShaderBytecode const& _byteCode, char const* _name = nullptr);
+	void Destroy();
+
+	kt::Array<uint8_t> m_byteCode;
+	ShaderType m_shaderType;
+
+	// Compute shaders share one pso, as on D3D12.
+	gpu::PSOHandle m_computePso;
+};
+
+struct AllocatedPSO_Null : AllocatedObjectBase_Null
+{
+	// Psos hold a reference to their shaders.
+	void InitAsCompute(gpu::ShaderHandle _handle, char const* _debugName);
+	void InitAsGraphics(gpu::GraphicsPSODesc const& _desc, char const* _debugName);
+
+	void Destroy();
+
+	bool IsCompute() const { return m_cs.IsValid(); }
+
+	gpu::GraphicsPSODesc m_psoDesc;
+	gpu::ShaderHandle m_cs;
+};
+
+struct AllocatedPersistentDescriptorTable_Null : AllocatedObjectBase_Null
+{
+	void Destroy() { m_descriptors.Clear(); }
+
+	// Not referenced, as on D3D12 the table only holds views.
+	kt::Array<gpu::ResourceHandle> m_descriptors;
+};
+
+extern Device_Null* g_device;
+
+struct Device_Null
+{
+	KT_NO_COPY(Device_Null);
+
+	Device_Null() = default;
+	~Device_Null();
+
+	void Init(uint32_t _backbufferWidth, uint32_t _backbufferHeight);
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Nanoseconds since Init, written by queries.
+	uint64_t QueryTimestamp() const;
+
+	using PSOCache = kt::HashMap<uint64_t, PSORef, kt::HashMap_KeyOps_IdentityInt<uint64_t>>;
+
+	static uint32_t constexpr c_maxQueries = 1024;
+
+	kt::VersionedHandlePool<AllocatedResource_Null>	m_resourceHandles;
+	kt::VersionedHandlePool<AllocatedShader_Null>		m_shaderHandles;
+	kt::VersionedHandlePool<AllocatedPSO_Null>			m_psoHandles;
+	kt::VersionedHandlePool<AllocatedPersistentDescriptorTable_Null> m_persistentTableHandles;
+
+	PSOCache m_psoCache;
+
+	gpu::TextureRef m_backBuffers[c_maxBufferedFrames];
+	gpu::TextureRef m_backbufferDepth;
+
+	cmd::Context* m_mainThreadCtx = nullptr;
+
+	// Cpu timestamps (ns) written as queries begin and end, per buffered frame.
+	struct QueryFrame
+	{
+		uint64_t m_times[c_maxQueries * 2];
+		uint32_t m_numQueries = 0;
+	};
+
+	QueryFrame m_queryFrames[c_maxBufferedFrames];
+	uint64_t m_resolvedQueryTimes[c_maxQueries * 2] = {};
+
+	kt::TimePoint m_initTime;
+
+	CommandStats_Null m_frameStats;
+	CommandStats_Null m_lastFrameStats;
+	CommandStats_Null m_totalStats;
+
+	Caps m_caps;
+
+	uint32_t m_cpuFrameIdx = 0;
+	uint32_t m_frameCounter = 0;
+
+	uint32_t m_swapChainWidth = 0;
+	uint32_t m_swapChainHeight = 0;
+
+	bool m_vsync = false;
+};
+
+}
@@ -4,7 +4,7 @@
 
 #include "shaderlib/GFXPerFrameBindings.hlsli"
 
-StructuredBuffer<InstanceData_Xform> g_instanceData_Transform : register(t0, PATHOS_PER_VIEW_SPACE);
+StructuredBuffer<InstanceData_Gpu> g_instanceData_Transform : register(t0, PATHOS_PER_VIEW_SPACE);
 
 
 VSOut_ObjectFull_Material main(uint _instanceId_meshId : TEXCOORD, uint _vid : SV_VertexID)
@@ -22,7 +22,7 @@ VSOut_ObjectFull_Material main(uint _instanceId_meshId : TEXCOORD, uint _vid : S
 
     uint materialIdx = subMeshData.materialIdx;
 
-    InstanceData_Xform instanceXform = g_instanceData_Transform[instanceDataIdx];
+    InstanceData_Xform instanceXform = DecodeInstanceData(g_instanceData_Transform[instanceDataIdx], g_frameCb.instanceOrigin);
 
     float3 pos = g_unifiedVtxPos[vtxOffset];
     float3 modelPos = TransformInstanceData(float4(pos, 1), instanceXform.row0, instanceXform.row1, instanceXform.row2);
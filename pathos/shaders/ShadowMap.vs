@@ -11,14 +11,14 @@ struct ShadowMtx
 
 ConstantBuffer<ShadowMtx> g_viewCb : register(b0, PATHOS_PER_VIEW_SPACE);
 
-StructuredBuffer<InstanceData_Xform> g_instanceData_xform : register(t0, PATHOS_PER_VIEW_SPACE);
+StructuredBuffer<InstanceData_Gpu> g_instanceData_xform : register(t0, PATHOS_PER_VIEW_SPACE);
 
 float4 main(uint _instanceId_meshId : TEXCOORD0, uint _vid : SV_VertexID) : SV_Position
 {
     uint instanceDataIdx = _instanceId_meshId & PATHOS_INSTANCE_ID_REMAP_MASK;
     uint submeshId = _instanceId_meshId >> PATHOS_SUBMESH_ID_REMAP_SHIFT;
 
-    InstanceData_Xform instanceData = g_instanceData_xform[instanceDataIdx];
+    InstanceData_Xform instanceData = DecodeInstanceData(g_instanceData_xform[instanceDataIdx], g_frameCb.instanceOrigin);
     uint vtxOffset = g_subMeshData[submeshId].unifiedVertexBufferOffset + _vid;
     float3 pos = g_unifiedVtxPos[vtxOffset];
 
@@ -0,0 +1,44 @@
+#include "../shaderlib/DefinesShared.h"
+
+Texture2D<float> g_depth : register(t0, PATHOS_PER_BATCH_SPACE);
+
+RWTexture2D<float> g_srcMip : register(u0, PATHOS_PER_BATCH_SPACE);
+RWTexture2D<float> g_dstMip : register(u1, PATHOS_PER_BATCH_SPACE);
+
+struct BuildDepthPyramidConstants
+{
+    uint2 srcDims;
+    uint2 dstDims;
+    uint fromDepth;
+};
+
+ConstantBuffer<BuildDepthPyramidConstants> g_cb : register(b0, PATHOS_PER_BATCH_SPACE);
+
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (any(DTid.xy >= g_cb.dstDims))
+    {
+        return;
+    }
+
+    if (g_cb.fromDepth)
+    {
+        // Mip 0 is a straight copy so the pyramid maps 1:1 onto the depth buffer.
+        g_dstMip[DTid.xy] = g_depth.Load(int3(DTid.xy, 0));
+        return;
+    }
+
+    // Each mip is ceil(src / 2), the last texel of an odd row/column only covers one source texel so the clamp repeats it.
+    const uint2 maxSrc = g_cb.srcDims - 1;
+    const uint2 src0 = min(DTid.xy * 2, maxSrc);
+    const uint2 src1 = min(DTid.xy * 2 + 1, maxSrc);
+
+    const float d00 = g_srcMip[uint2(src0.x, src0.y)];
+    const float d10 = g_srcMip[uint2(src1.x, src0.y)];
+    const float d01 = g_srcMip[uint2(src0.x, src1.y)];
+    const float d11 = g_srcMip[uint2(src1.x, src1.y)];
+
+    // Farthest depth, anything nearer than this is in front of every texel below.
+    g_dstMip[DTid.xy] = max(max(d00, d10), max(d01, d11));
+}
@@ -3,20 +3,36 @@
 #include "../shaderlib/CullingShared.h"
 
 
-StructuredBuffer<uint> g_packedInstancesToCull : register(t0, PATHOS_PER_BATCH_SPACE);
-StructuredBuffer<InstanceData_Xform> g_instanceXforms : register(t1, PATHOS_PER_BATCH_SPACE);
+StructuredBuffer<MeshInstanceCullData> g_meshInstancesToCull : register(t0, PATHOS_PER_BATCH_SPACE);
+StructuredBuffer<InstanceData_Gpu> g_instanceXforms : register(t1, PATHOS_PER_BATCH_SPACE);
 StructuredBuffer<GPUSubMeshData> g_submeshData : register(t2, PATHOS_PER_BATCH_SPACE);
 
+// Farthest depth pyramid, last frame's in the early phase and this frame's in the late phase.
+Texture2D<float> g_hiz : register(t3, PATHOS_PER_BATCH_SPACE);
+
 RWBuffer<uint> g_outDrawArgs : register(u0, PATHOS_PER_BATCH_SPACE);
 RWBuffer<uint> g_outPackedMeshInstance : register(u1, PATHOS_PER_BATCH_SPACE);
 
+// 1 for submesh instances the early phase found occluded, the late phase only retests these.
+RWBuffer<uint> g_lateCandidates : register(u2, PATHOS_PER_BATCH_SPACE);
+
 ConstantBuffer<CullingConstants> g_cb : register(b0, PATHOS_PER_BATCH_SPACE);
 
 groupshared uint lds_numDraws;
 groupshared uint lds_baseDrawIdx;
 
-void WriteDrawArgs(uint _globalIdx, GPUSubMeshData _subMeshData, uint _packedCullingData)
+void WriteDrawArgs(uint _globalIdx, GPUSubMeshData _subMeshData, uint _lod, uint _packedCullingData)
 {
+    // Index range of the detail level, as gfx::Mesh::GetSubMeshLodIndices.
+    uint numIndices = _subMeshData.numIndices;
+    uint indexStart = _subMeshData.unifiedIndexBufferOffset;
+
+    if (_lod > 0)
+    {
+        numIndices = _subMeshData.lodNumIndices[_lod - 1];
+        indexStart = _subMeshData.lodUnifiedIndexBufferOffset[_lod - 1];
+    }
+
     // uint indicesPerInstance;
     // uint instanceCount;
     // uint indexStart;
@@ -24,14 +40,63 @@ void WriteDrawArgs(uint _globalIdx, GPUSubMeshData _subMeshData, uint _packedCul
     // uint startInstance;
 
     // +1 because counter is stored at 0
-    g_outDrawArgs[_globalIdx * 5 + 0 + 1] = _subMeshData.numIndices; // indicesPerInstance
+    g_outDrawArgs[_globalIdx * 5 + 0 + 1] = numIndices; // indicesPerInstance
     g_outDrawArgs[_globalIdx * 5 + 1 + 1] = 1; // instanceCount
-    g_outDrawArgs[_globalIdx * 5 + 2 + 1] = _subMeshData.unifiedIndexBufferOffset; // indexStart
+    g_outDrawArgs[_globalIdx * 5 + 2 + 1] = indexStart; // indexStart
     g_outDrawArgs[_globalIdx * 5 + 3 + 1] = _subMeshData.unifiedVertexBufferOffset; // baseVertex
     g_outDrawArgs[_globalIdx * 5 + 4 + 1] = _globalIdx; // startInstance
     g_outPackedMeshInstance[_globalIdx] = _packedCullingData;
 }
 
+// Submesh instances aren't listed, each thread finds the mesh instance its submesh instance is part of.
+// Neighbouring threads mostly land in the same or neighbouring mesh instances, so search the same records.
+uint PackedSubmeshInstance(uint _submeshInstance, out uint o_lod)
+{
+    // Last mesh instance starting at or before _submeshInstance, the first always starts at 0.
+    uint lo = 0;
+    uint hi = g_cb.numMeshInstances;
+
+    while (hi - lo > 1)
+    {
+        const uint mid = (lo + hi) / 2;
+
+        if (g_meshInstancesToCull[mid].firstSubmeshInstance <= _submeshInstance)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    const MeshInstanceCullData meshInstance = g_meshInstancesToCull[lo];
+    o_lod = meshInstance.lod;
+
+    // Submesh ids follow on from the mesh's first.
+    return meshInstance.packedInstance + ((_submeshInstance - meshInstance.firstSubmeshInstance) << PATHOS_SUBMESH_ID_REMAP_SHIFT);
+}
+
+float LoadHiZ(uint _x, uint _y, uint _mip)
+{
+    const uint maxX = HiZ_MipSize(g_cb.hizWidth, _mip) - 1;
+    const uint maxY = HiZ_MipSize(g_cb.hizHeight, _mip) - 1;
+    return g_hiz.Load(int3(min(_x, maxX), min(_y, maxY), _mip));
+}
+
+bool IsOccluded(HiZFootprint _footprint)
+{
+    if (_footprint.result != PATHOS_HIZ_TEST)
+    {
+        return false;
+    }
+
+    const uint x = _footprint.texelX;
+    const uint y = _footprint.texelY;
+    const uint mip = _footprint.mip;
+    return HiZ_IsOccluded(_footprint, LoadHiZ(x, y, mip), LoadHiZ(x + 1, y, mip), LoadHiZ(x, y + 1, mip), LoadHiZ(x + 1, y + 1, mip));
+}
+
 [numthreads(64, 1, 1)]
 void main(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID)
 {
@@ -39,19 +104,44 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID)
     {
         lds_numDraws = 0;
     }
-    
+
     bool writeDrawCall = false;
     uint packedCullingData;
     uint localDrawIdx;
+    uint lod;
+    GPUSubMeshData subMesh;
 
     GroupMemoryBarrierWithGroupSync();
-     
-    if(DTid.x < g_cb.numSubmeshInstances)
+
+    // Dispatch isn't indirect, so the late phase runs over everything and skips what the early phase already handled.
+    if(DTid.x < g_cb.numSubmeshInstances && (g_cb.cullPhase == PATHOS_CULL_PHASE_EARLY || g_lateCandidates[DTid.x]))
     {
-        writeDrawCall = true;
-        packedCullingData = g_packedInstancesToCull[DTid.x];
-        // TODO: Cull stuff!
-        InterlockedAdd(lds_numDraws, 1, localDrawIdx);
+        packedCullingData = PackedSubmeshInstance(DTid.x, lod);
+        subMesh = g_submeshData[packedCullingData >> PATHOS_SUBMESH_ID_REMAP_SHIFT];
+        const InstanceData_Xform xform = DecodeInstanceData(g_instanceXforms[packedCullingData & PATHOS_INSTANCE_ID_REMAP_MASK], g_cb.instanceOrigin);
+
+        // Too small to draw counts as frustum culled.
+        HiZFootprint footprint = (HiZFootprint)0;
+        footprint.result = PATHOS_HIZ_CULLED;
+
+        if (lod != PATHOS_LOD_CULLED)
+        {
+            footprint = HiZ_CalcFootprint(subMesh, xform, g_cb);
+        }
+
+        const bool occluded = IsOccluded(footprint);
+
+        if (g_cb.cullPhase == PATHOS_CULL_PHASE_EARLY)
+        {
+            // Frustum culled instances aren't worth a second look, occluded ones might have been uncovered this frame.
+            g_lateCandidates[DTid.x] = occluded ? 1 : 0;
+        }
+
+        if (footprint.result != PATHOS_HIZ_CULLED && !occluded)
+        {
+            writeDrawCall = true;
+            InterlockedAdd(lds_numDraws, 1, localDrawIdx);
+        }
     }
 
     GroupMemoryBarrierWithGroupSync();
@@ -66,7 +156,6 @@ void main(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID)
     if(writeDrawCall)
     {
         uint idx = lds_baseDrawIdx + localDrawIdx;
-        GPUSubMeshData subMesh = g_submeshData[packedCullingData >> PATHOS_SUBMESH_ID_REMAP_SHIFT];
-        WriteDrawArgs(idx, subMesh, packedCullingData);
+        WriteDrawArgs(idx, subMesh, lod, packedCullingData);
     }
-}
\ No newline at end of file
+}
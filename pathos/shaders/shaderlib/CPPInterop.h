@@ -9,6 +9,8 @@
 #define PATHOS_CBV_SLOT(x) x
 
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <kt/Vec2.h>
 #include <kt/Vec3.h>
 #include <kt/Vec4.h>
@@ -29,7 +31,80 @@ using uint2 = uint32_t[2];
 using uint3 = uint32_t[3];
 using uint4 = uint32_t[3];
 
+// Row _i of an hlsl matrix (compiled row major) is column _i of a kt::Mat4.
+#define SHADERLIB_MATRIX_ROW(_mtx, _i) (_mtx).m_cols[_i]
 
+#define SHADERLIB_PRECISE
+#define SHADERLIB_INLINE inline
+
+namespace shaderlib
+{
+
+// Hlsl intrinsics used by code shared with the cpu.
+inline float min(float _a, float _b) { return _a < _b ? _a : _b; }
+inline float max(float _a, float _b) { return _a > _b ? _a : _b; }
+inline uint min(uint _a, uint _b) { return _a < _b ? _a : _b; }
+inline uint max(uint _a, uint _b) { return _a > _b ? _a : _b; }
+inline float floor(float _v) { return floorf(_v); }
+inline float ceil(float _v) { return ceilf(_v); }
+inline uint firstbithigh(uint _v) { return kt::FloorLog2(_v); }
+inline float sqrt(float _v) { return sqrtf(_v); }
+
+// Half in the low 16 bits.
+inline float f16tof32(uint _v)
+{
+	uint const sign = (_v & 0x8000u) << 16;
+	uint const exp = (_v >> 10) & 0x1fu;
+	uint const mant = _v & 0x3ffu;
+
+	if (exp == 0)
+	{
+		// Denormal, mant * 2^-24.
+		float const f = float(mant) * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+
+	uint const bits = exp == 0x1fu ? (sign | 0x7f800000u | (mant << 13)) : (sign | ((exp + 112u) << 23) | (mant << 13));
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// Rounds to nearest even, out of range values go to infinity (NaNs too).
+inline uint f32tof16(float _v)
+{
+	uint bits;
+	memcpy(&bits, &_v, sizeof(bits));
+
+	uint const sign = (bits >> 16) & 0x8000u;
+	int const exp = int((bits >> 23) & 0xffu) - 112;
+	uint const mant = bits & 0x7fffffu;
+
+	if (exp >= 0x1f)
+	{
+		return sign | 0x7c00u;
+	}
+
+	if (exp <= 0)
+	{
+		if (exp < -10)
+		{
+			return sign;
+		}
+
+		// Denormal, shift the mantissa (with its implicit bit) down to units of 2^-24.
+		uint const full = mant | 0x800000u;
+		uint const shift = uint(14 - exp);
+		uint const roundUp = ((full >> (shift - 1)) & 1u) & uint((full & ((1u << (shift - 1)) - 1u)) != 0 || ((full >> shift) & 1u));
+		return sign | ((full >> shift) + roundUp);
+	}
+
+	// Ties to even. A carry out of the mantissa correctly bumps the exponent.
+	uint const roundUp = ((mant >> 12) & 1u) & uint((mant & 0xfffu) != 0 || ((mant >> 13) & 1u));
+	return (sign | (uint(exp) << 10) | (mant >> 13)) + roundUp;
+}
+
+}
 
 #else
 
@@ -41,6 +116,12 @@ using uint4 = uint32_t[3];
 #define SHADERLIB_NAMESPACE_BEGIN
 #define SHADERLIB_NAMESPACE_END
 
+#define SHADERLIB_MATRIX_ROW(_mtx, _i) (_mtx)[_i]
+
+// Keeps shared arithmetic in the order written (no fused multiply add), so the cpu gets the same results.
+#define SHADERLIB_PRECISE precise
+#define SHADERLIB_INLINE
+
 #endif // __cplusplus
 
 #endif // CPP_INTEROP
\ No newline at end of file
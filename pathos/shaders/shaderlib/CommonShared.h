@@ -4,6 +4,11 @@
 
 #define PATHOS_MAX_SHADOW_CASCADES 4
 
+// Instance transforms are uploaded as InstanceData_Compact rather than InstanceData_Xform.
+#ifndef PATHOS_COMPACT_INSTANCE_DATA
+	#define PATHOS_COMPACT_INSTANCE_DATA 0
+#endif
+
 #ifdef __cplusplus
 	#define PATHOS_ASSERT_16B_ALIGNED(_struct) static_assert((sizeof(_struct) & 15) == 0, #_struct " is not a multiple of 16 bytes.");
 #else
@@ -15,6 +20,11 @@ SHADERLIB_NAMESPACE_BEGIN
 #define PATHOS_LIGHT_TYPE_POINT (0)
 #define PATHOS_LIGHT_TYPE_SPOT  (1)
 
+// Clustered lighting grid, screen tiles by exponential depth slices (see gfx/LightClusters.h).
+#define PATHOS_LIGHT_CLUSTERS_X (16)
+#define PATHOS_LIGHT_CLUSTERS_Y (9)
+#define PATHOS_LIGHT_CLUSTERS_Z (24)
+
 struct FrameConstants
 {
     float4x4 mainViewProj;
@@ -38,10 +48,16 @@ struct FrameConstants
 
     uint numPointLights; // point lights sorted first
     uint numSpotLights; // spot lights sorted second
-    float2 __pad1__; 
+
+    // Light cluster depth slice = log2(viewDepth) * clusterDepthScale + clusterDepthBias.
+    float clusterDepthScale;
+    float clusterDepthBias;
 
 	// x = time, y = time/10, z = dt, w = ? 
 	float4 time;
+
+    // Compact instance positions are relative to this (see InstanceData_Compact).
+    float3 instanceOrigin; float __pad1__;
 };
 PATHOS_ASSERT_16B_ALIGNED(FrameConstants);
 
@@ -60,6 +76,12 @@ struct LightData
 };
 PATHOS_ASSERT_16B_ALIGNED(LightData);
 
+struct LightCluster
+{
+    uint lightIndexOffset; // into the light index list
+    uint lightCounts; // point lights in the low 16 bits, spot lights in the high 16 bits (listed after the point lights)
+};
+
 struct MaterialData
 {
     float4 baseColour;
@@ -89,6 +111,59 @@ struct InstanceData_Xform
 };
 PATHOS_ASSERT_16B_ALIGNED(InstanceData_Xform);
 
+#define PATHOS_INSTANCE_ROTATION_BITS (10)
+
+// Half the size of InstanceData_Xform, with PATHOS_COMPACT_INSTANCE_DATA.
+// Position is relative to an origin kept near the camera, so it stays precise far from the world origin.
+// Rotation is a quaternion stored as its three smallest components, the index of the dropped (largest) one is in the top 2 bits.
+// Scale is per axis, as halfs. Shear is lost.
+struct InstanceData_Compact
+{
+    float3 position;
+    uint rotation;
+    uint scaleXY;
+    uint scaleZ; // high 16 bits unused
+};
+
+#if PATHOS_COMPACT_INSTANCE_DATA
+typedef InstanceData_Compact InstanceData_Gpu;
+#else
+typedef InstanceData_Xform InstanceData_Gpu;
+#endif
+
+// Shared with the cpu, which keeps the decoded transform so culling sees what the gpu draws.
+SHADERLIB_INLINE InstanceData_Xform DecodeInstanceData(InstanceData_Compact _data, float3 _origin)
+{
+    // Anything but the largest component of a unit quaternion is within +-1/sqrt(2).
+    const uint mask = (1u << PATHOS_INSTANCE_ROTATION_BITS) - 1u;
+    const float quantScale = 1.41421356f / float(mask);
+    const float a = float((_data.rotation >> (2 * PATHOS_INSTANCE_ROTATION_BITS)) & mask) * quantScale - 0.70710678f;
+    const float b = float((_data.rotation >> PATHOS_INSTANCE_ROTATION_BITS) & mask) * quantScale - 0.70710678f;
+    const float c = float(_data.rotation & mask) * quantScale - 0.70710678f;
+    const float largest = sqrt(max(1.0f - a * a - b * b - c * c, 0.0f));
+
+    float4 q;
+    switch (_data.rotation >> 30)
+    {
+        case 0: q = float4(largest, a, b, c); break;
+        case 1: q = float4(a, largest, b, c); break;
+        case 2: q = float4(a, b, largest, c); break;
+        default: q = float4(a, b, c, largest); break;
+    }
+
+    const float sx = f16tof32(_data.scaleXY & 0xffffu);
+    const float sy = f16tof32(_data.scaleXY >> 16);
+    const float sz = f16tof32(_data.scaleZ & 0xffffu);
+
+    const float3 pos = _data.position + _origin;
+
+    InstanceData_Xform xform;
+    xform.row0 = float4((1.0f - 2.0f * (q.y * q.y + q.z * q.z)) * sx, 2.0f * (q.x * q.y - q.w * q.z) * sy, 2.0f * (q.x * q.z + q.w * q.y) * sz, pos.x);
+    xform.row1 = float4(2.0f * (q.x * q.y + q.w * q.z) * sx, (1.0f - 2.0f * (q.x * q.x + q.z * q.z)) * sy, 2.0f * (q.y * q.z - q.w * q.x) * sz, pos.y);
+    xform.row2 = float4(2.0f * (q.x * q.z - q.w * q.y) * sx, 2.0f * (q.y * q.z + q.w * q.x) * sy, (1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * sz, pos.z);
+    return xform;
+}
+
 // TODO: Should align - and pack?
 struct TangentSpace
 {
@@ -97,6 +172,8 @@ struct TangentSpace
 };
 
 
+#define PATHOS_MAX_MESH_LODS (4)
+
 struct GPUSubMeshData
 {
 	float4 bboxMin;
@@ -105,6 +182,13 @@ struct GPUSubMeshData
 	uint unifiedVertexBufferOffset;
     uint numIndices;
     uint materialIdx;
+
+    // Detail levels 1 to PATHOS_MAX_MESH_LODS - 1, as gfx::Mesh::SubMesh.
+    uint lodUnifiedIndexBufferOffset[PATHOS_MAX_MESH_LODS - 1];
+    uint lodNumIndices[PATHOS_MAX_MESH_LODS - 1];
+
+    uint __pad0__;
+    uint __pad1__;
 };
 PATHOS_ASSERT_16B_ALIGNED(GPUSubMeshData);
 
@@ -113,6 +197,12 @@ float3 TransformInstanceData(in float4 _vtx, in float4 _row0, in float4 _row1, i
 {
     return float3(dot(_vtx, _row0), dot(_vtx, _row1), dot(_vtx, _row2));
 }
+
+// So shaders can decode whichever InstanceData_Gpu is.
+InstanceData_Xform DecodeInstanceData(InstanceData_Xform _data, float3 _origin)
+{
+    return _data;
+}
 #endif
 
 SHADERLIB_NAMESPACE_END
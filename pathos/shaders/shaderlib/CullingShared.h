@@ -1,14 +1,168 @@
 #ifndef CULLING_SHARED
 #define CULLING_SHARED
 #include "CPPInterop.h"
+#include "CommonShared.h"
+
+#define PATHOS_CULL_PHASE_EARLY (0) // Test against last frame's depth pyramid, remember what failed.
+#define PATHOS_CULL_PHASE_LATE  (1) // Retest what failed the early phase against this frame's pyramid.
+
+#define PATHOS_HIZ_MAX_MIPS (16)
+
+#define PATHOS_HIZ_CULLED   (0) // Outside the frustum (or entirely nearer than the near plane).
+#define PATHOS_HIZ_VISIBLE  (1) // Crosses the near plane or too big to test, always drawn.
+#define PATHOS_HIZ_TEST     (2) // Compare nearestDepth against the 2x2 texels at (texelX, texelY) of mip.
 
 SHADERLIB_NAMESPACE_BEGIN
 
 struct CullingConstants
 {
+    float4x4 viewProj;
+
+    // FrameConstants::instanceOrigin, for compact instance data.
+    float3 instanceOrigin;
     uint numSubmeshInstances;
+
+    uint numMeshInstances;
+    uint cullPhase;
+
+    // Mip 0 is the size of the depth buffer, each mip after is ceil(prev / 2). hizNumMips is 0 if there is no pyramid to test against.
+    uint hizWidth;
+    uint hizHeight;
+    uint hizNumMips;
+
+    uint __pad0__;
+    uint __pad1__;
+    uint __pad2__;
+};
+PATHOS_ASSERT_16B_ALIGNED(CullingConstants);
+
+#define PATHOS_LOD_CULLED (0x80) // MeshInstanceCullData::lod of instances too small to draw, gfx::InstanceTable::c_lodCulled.
+
+// One per mesh instance to cull, the cull shader expands each into its submesh instances.
+struct MeshInstanceCullData
+{
+    uint packedInstance; // instance slot | first GPUSubMeshData of the mesh << PATHOS_SUBMESH_ID_REMAP_SHIFT
+    uint firstSubmeshInstance; // submeshes of every mesh instance before this one, the next one's is where this one's end
+    uint lod; // detail level to draw, clamped to the mesh's levels, or PATHOS_LOD_CULLED
+};
+
+struct HiZFootprint
+{
+    uint result;
+    uint mip;
+    uint texelX;
+    uint texelY;
+    float nearestDepth;
 };
 
+SHADERLIB_INLINE uint HiZ_MipSize(uint _sizeMip0, uint _mip)
+{
+    return max((_sizeMip0 + (1u << _mip) - 1u) >> _mip, 1u);
+}
+
+// Projects the submesh instance bounds and picks the smallest mip where they cover at most 2x2 texels.
+// Shared with the cpu (see gfx/Culling.h). Divides aside everything is ordered adds and multiplies, and the mip/texel selection is integer,
+// so both sides agree unless a projected corner lands within an ulp of a texel edge.
+SHADERLIB_INLINE HiZFootprint HiZ_CalcFootprint(GPUSubMeshData _subMesh, InstanceData_Xform _xform, CullingConstants _constants)
+{
+    HiZFootprint footprint;
+    footprint.result = PATHOS_HIZ_VISIBLE;
+    footprint.mip = 0;
+    footprint.texelX = 0;
+    footprint.texelY = 0;
+    footprint.nearestDepth = 0.0f;
+
+    float minU = 3.402823466e+38f;
+    float minV = 3.402823466e+38f;
+    float maxU = -3.402823466e+38f;
+    float maxV = -3.402823466e+38f;
+    float minZ = 3.402823466e+38f;
+    uint numNearCorners = 0;
+
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        const float lx = (corner & 1) ? _subMesh.bboxMax.x : _subMesh.bboxMin.x;
+        const float ly = (corner & 2) ? _subMesh.bboxMax.y : _subMesh.bboxMin.y;
+        const float lz = (corner & 4) ? _subMesh.bboxMax.z : _subMesh.bboxMin.z;
+
+        SHADERLIB_PRECISE float wx = _xform.row0.x * lx + _xform.row0.y * ly + _xform.row0.z * lz + _xform.row0.w;
+        SHADERLIB_PRECISE float wy = _xform.row1.x * lx + _xform.row1.y * ly + _xform.row1.z * lz + _xform.row1.w;
+        SHADERLIB_PRECISE float wz = _xform.row2.x * lx + _xform.row2.y * ly + _xform.row2.z * lz + _xform.row2.w;
+
+        const float4 r0 = SHADERLIB_MATRIX_ROW(_constants.viewProj, 0);
+        const float4 r1 = SHADERLIB_MATRIX_ROW(_constants.viewProj, 1);
+        const float4 r2 = SHADERLIB_MATRIX_ROW(_constants.viewProj, 2);
+        const float4 r3 = SHADERLIB_MATRIX_ROW(_constants.viewProj, 3);
+
+        SHADERLIB_PRECISE float cx = wx * r0.x + wy * r1.x + wz * r2.x + r3.x;
+        SHADERLIB_PRECISE float cy = wx * r0.y + wy * r1.y + wz * r2.y + r3.y;
+        SHADERLIB_PRECISE float cz = wx * r0.z + wy * r1.z + wz * r2.z + r3.z;
+        SHADERLIB_PRECISE float cw = wx * r0.w + wy * r1.w + wz * r2.w + r3.w;
+
+        if (cw <= 0.0f || cz < 0.0f)
+        {
+            // Nearer than the near plane, the projected rect is meaningless.
+            ++numNearCorners;
+            continue;
+        }
+
+        SHADERLIB_PRECISE float u = (cx / cw) * 0.5f + 0.5f;
+        SHADERLIB_PRECISE float v = 0.5f - (cy / cw) * 0.5f;
+        const float z = cz / cw;
+
+        minU = min(minU, u);
+        minV = min(minV, v);
+        maxU = max(maxU, u);
+        maxV = max(maxV, v);
+        minZ = min(minZ, z);
+    }
+
+    if (numNearCorners != 0)
+    {
+        footprint.result = numNearCorners == 8 ? PATHOS_HIZ_CULLED : PATHOS_HIZ_VISIBLE;
+        return footprint;
+    }
+
+    if (maxU < 0.0f || maxV < 0.0f || minU > 1.0f || minV > 1.0f || minZ > 1.0f)
+    {
+        footprint.result = PATHOS_HIZ_CULLED;
+        return footprint;
+    }
+
+    if (_constants.hizNumMips == 0)
+    {
+        return footprint;
+    }
+
+    // Texel rect in mip 0, [x0, x1) x [y0, y1).
+    const uint x0 = min(uint(floor(max(minU, 0.0f) * float(_constants.hizWidth))), _constants.hizWidth - 1u);
+    const uint y0 = min(uint(floor(max(minV, 0.0f) * float(_constants.hizHeight))), _constants.hizHeight - 1u);
+    const uint x1 = max(min(uint(ceil(min(maxU, 1.0f) * float(_constants.hizWidth))), _constants.hizWidth), x0 + 1u);
+    const uint y1 = max(min(uint(ceil(min(maxV, 1.0f) * float(_constants.hizHeight))), _constants.hizHeight), y0 + 1u);
+
+    // At mip m a texel covers 2^m texels of mip 0, so an extent of up to 2^m + 1 spans at most 2 texels whatever its alignment.
+    const uint extent = max(x1 - x0, y1 - y0);
+    const uint mip = extent <= 2u ? 0u : firstbithigh(extent - 2u) + 1u;
+
+    if (mip >= _constants.hizNumMips)
+    {
+        return footprint;
+    }
+
+    footprint.result = PATHOS_HIZ_TEST;
+    footprint.mip = mip;
+    footprint.texelX = x0 >> mip;
+    footprint.texelY = y0 >> mip;
+    footprint.nearestDepth = minZ;
+    return footprint;
+}
+
+// Depths are the footprint's 2x2 texels, coordinates clamped to the size of the mip. The pyramid stores the farthest depth.
+SHADERLIB_INLINE bool HiZ_IsOccluded(HiZFootprint _footprint, float _depth00, float _depth10, float _depth01, float _depth11)
+{
+    return _footprint.nearestDepth > max(max(_depth00, _depth10), max(_depth01, _depth11));
+}
+
 SHADERLIB_NAMESPACE_END
 
-#endif // CULLING_SHARED
\ No newline at end of file
+#endif // CULLING_SHARED
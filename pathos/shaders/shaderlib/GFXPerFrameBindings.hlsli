@@ -17,6 +17,9 @@ StructuredBuffer<float3> g_unifiedVtxPos                :   register(t7, PATHOS_
 StructuredBuffer<TangentSpace> g_unifiedVtxTangent      :   register(t8, PATHOS_PER_FRAME_SPACE);
 StructuredBuffer<float2> g_unifiedVtxUv                 :   register(t9, PATHOS_PER_FRAME_SPACE);
 
+StructuredBuffer<LightCluster> g_lightClusters          :   register(t10, PATHOS_PER_FRAME_SPACE);
+StructuredBuffer<uint> g_lightIndices                   :   register(t11, PATHOS_PER_FRAME_SPACE);
+
 ConstantBuffer<FrameConstants> g_frameCb    :   register(b0, PATHOS_PER_FRAME_SPACE);
 Texture2D<float4> g_bindlessTexArray[]      :   register(t0, PATHOS_CUSTOM_SPACE);
 
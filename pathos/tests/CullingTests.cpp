@@ -0,0 +1,233 @@
+#include "Test.h"
+
+#include <math.h>
+#include <float.h>
+
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+
+#include <gfx/Culling.h>
+
+// Cpu reference of the gpu hi-z cull (gfx::DepthPyramidCPU and CullSubmeshHiZ_CPU), checked against brute force over every texel.
+
+static uint32_t const c_width = 173;
+static uint32_t const c_height = 97;
+
+static float const c_near = 0.1f;
+static float const c_far = 100.0f;
+
+// Right handed, zero to one depth, as gfx::Camera builds them.
+static kt::Mat4 Perspective(float _fovY, float _aspect)
+{
+	float const t = 1.0f / tanf(_fovY * 0.5f);
+
+	kt::Mat4 mtx;
+	mtx.m_cols[0] = kt::Vec4(t / _aspect, 0.0f, 0.0f, 0.0f);
+	mtx.m_cols[1] = kt::Vec4(0.0f, t, 0.0f, 0.0f);
+	mtx.m_cols[2] = kt::Vec4(0.0f, 0.0f, c_far / (c_near - c_far), -1.0f);
+	mtx.m_cols[3] = kt::Vec4(0.0f, 0.0f, c_near * c_far / (c_near - c_far), 0.0f);
+	return mtx;
+}
+
+static float ProjectedDepth(kt::Mat4 const& _proj, float _viewZ)
+{
+	return (_proj.m_cols[2].z * _viewZ + _proj.m_cols[3].z) / -_viewZ;
+}
+
+static shaderlib::InstanceData_Xform IdentityXform()
+{
+	shaderlib::InstanceData_Xform xform;
+	xform.row0 = kt::Vec4(1.0f, 0.0f, 0.0f, 0.0f);
+	xform.row1 = kt::Vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	xform.row2 = kt::Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	return xform;
+}
+
+static shaderlib::GPUSubMeshData Cube(float _x, float _y, float _z, float _halfSize)
+{
+	shaderlib::GPUSubMeshData subMesh = {};
+	subMesh.bboxMin = kt::Vec4(_x - _halfSize, _y - _halfSize, _z - _halfSize, 1.0f);
+	subMesh.bboxMax = kt::Vec4(_x + _halfSize, _y + _halfSize, _z + _halfSize, 1.0f);
+	return subMesh;
+}
+
+// Depth buffer with a wall at view z = -10 over the left 60% of the screen, the rest at the far plane.
+static void BuildWallDepth(kt::Mat4 const& _proj, kt::Array<float>& o_depth)
+{
+	float const wallDepth = ProjectedDepth(_proj, -10.0f);
+
+	o_depth.Resize(c_width * c_height);
+
+	for (uint32_t y = 0; y < c_height; ++y)
+	{
+		for (uint32_t x = 0; x < c_width; ++x)
+		{
+			o_depth[y * c_width + x] = x < c_width * 6 / 10 ? wallDepth : 1.0f;
+		}
+	}
+}
+
+PATHOS_TEST(DepthPyramid_Reduction)
+{
+	kt::Array<float> depth;
+	depth.Resize(c_width * c_height);
+
+	uint32_t rng = 1;
+	for (float& d : depth)
+	{
+		rng = rng * 1664525u + 1013904223u;
+		d = float(rng >> 8) / float(1 << 24);
+	}
+
+	gfx::DepthPyramidCPU pyramid;
+	pyramid.Build(depth.Data(), c_width, c_height);
+
+	TEST_CHECK(pyramid.m_numMips == gfx::DepthPyramidNumMips(c_width, c_height));
+	TEST_CHECK(shaderlib::HiZ_MipSize(c_width, pyramid.m_numMips - 1) == 1 && shaderlib::HiZ_MipSize(c_height, pyramid.m_numMips - 1) == 1);
+
+	// Each texel is the farthest of the mip 0 texels under it, odd sizes included.
+	for (uint32_t mip = 0; mip < pyramid.m_numMips; ++mip)
+	{
+		for (uint32_t y = 0; y < shaderlib::HiZ_MipSize(c_height, mip); ++y)
+		{
+			for (uint32_t x = 0; x < shaderlib::HiZ_MipSize(c_width, mip); ++x)
+			{
+				float farthest = 0.0f;
+
+				for (uint32_t y0 = y << mip; y0 < kt::Min((y + 1) << mip, c_height); ++y0)
+				{
+					for (uint32_t x0 = x << mip; x0 < kt::Min((x + 1) << mip, c_width); ++x0)
+					{
+						farthest = kt::Max(farthest, depth[y0 * c_width + x0]);
+					}
+				}
+
+				TEST_CHECK(pyramid.Load(x, y, mip) == farthest);
+			}
+		}
+	}
+}
+
+PATHOS_TEST(CullSubmeshHiZ_Wall)
+{
+	kt::Mat4 const proj = Perspective(1.2f, float(c_width) / float(c_height));
+
+	kt::Array<float> depth;
+	BuildWallDepth(proj, depth);
+
+	gfx::DepthPyramidCPU pyramid;
+	pyramid.Build(depth.Data(), c_width, c_height);
+
+	shaderlib::CullingConstants constants = {};
+	constants.viewProj = proj;
+
+	shaderlib::InstanceData_Xform const xform = IdentityXform();
+
+	auto cull = [&](shaderlib::GPUSubMeshData const& _subMesh, gfx::DepthPyramidCPU const* _pyramid, bool& o_occluded)
+	{
+		return gfx::CullSubmeshHiZ_CPU(_subMesh, xform, constants, _pyramid, o_occluded);
+	};
+
+	bool occluded;
+
+	// Behind the wall.
+	TEST_CHECK(!cull(Cube(-3.0f, 0.0f, -20.0f, 1.0f), &pyramid, occluded) && occluded);
+
+	// Without a pyramid only the frustum is tested.
+	TEST_CHECK(cull(Cube(-3.0f, 0.0f, -20.0f, 1.0f), nullptr, occluded) && !occluded);
+
+	// In front of the wall, past its edge, and straddling it.
+	TEST_CHECK(cull(Cube(-3.0f, 0.0f, -5.0f, 1.0f), &pyramid, occluded) && !occluded);
+	TEST_CHECK(cull(Cube(5.0f, 0.0f, -20.0f, 1.0f), &pyramid, occluded) && !occluded);
+	TEST_CHECK(cull(Cube(0.0f, 0.0f, -20.0f, 3.0f), &pyramid, occluded) && !occluded);
+
+	// Crossing the near plane is always drawn, entirely behind the camera or beyond the far plane never.
+	TEST_CHECK(cull(Cube(-3.0f, 0.0f, -0.05f, 1.0f), &pyramid, occluded) && !occluded);
+	TEST_CHECK(!cull(Cube(-3.0f, 0.0f, 5.0f, 1.0f), &pyramid, occluded) && !occluded);
+	TEST_CHECK(!cull(Cube(-3.0f, 0.0f, -200.0f, 1.0f), &pyramid, occluded) && !occluded);
+}
+
+// Anything reported occluded must be behind every texel its projected bounds touch.
+PATHOS_TEST(CullSubmeshHiZ_Conservative)
+{
+	kt::Mat4 const proj = Perspective(1.2f, float(c_width) / float(c_height));
+
+	kt::Array<float> depth;
+	BuildWallDepth(proj, depth);
+
+	gfx::DepthPyramidCPU pyramid;
+	pyramid.Build(depth.Data(), c_width, c_height);
+
+	shaderlib::CullingConstants constants = {};
+	constants.viewProj = proj;
+
+	shaderlib::InstanceData_Xform const xform = IdentityXform();
+
+	uint32_t rng = 1;
+	auto rand01 = [&rng]() -> float
+	{
+		rng = rng * 1664525u + 1013904223u;
+		return float(rng >> 8) / float(1 << 24);
+	};
+
+	uint32_t numOccluded = 0;
+	uint32_t numNotConservative = 0;
+
+	for (uint32_t i = 0; i < 20000; ++i)
+	{
+		float const x = -20.0f + 40.0f * rand01();
+		float const y = -12.0f + 24.0f * rand01();
+		float const z = -40.0f + 39.0f * rand01();
+		float const halfSize = 0.01f + 3.0f * rand01();
+
+		bool occluded;
+		gfx::CullSubmeshHiZ_CPU(Cube(x, y, z, halfSize), xform, constants, &pyramid, occluded);
+
+		if (!occluded)
+		{
+			continue;
+		}
+
+		++numOccluded;
+
+		float minU = FLT_MAX;
+		float minV = FLT_MAX;
+		float maxU = -FLT_MAX;
+		float maxV = -FLT_MAX;
+		float minZ = FLT_MAX;
+
+		for (uint32_t corner = 0; corner < 8; ++corner)
+		{
+			float const cx = (corner & 1) ? x + halfSize : x - halfSize;
+			float const cy = (corner & 2) ? y + halfSize : y - halfSize;
+			float const cz = (corner & 4) ? z + halfSize : z - halfSize;
+			float const w = -cz;
+
+			minU = kt::Min(minU, proj.m_cols[0].x * cx / w * 0.5f + 0.5f);
+			maxU = kt::Max(maxU, proj.m_cols[0].x * cx / w * 0.5f + 0.5f);
+			minV = kt::Min(minV, 0.5f - proj.m_cols[1].y * cy / w * 0.5f);
+			maxV = kt::Max(maxV, 0.5f - proj.m_cols[1].y * cy / w * 0.5f);
+			minZ = kt::Min(minZ, ProjectedDepth(proj, cz));
+		}
+
+		int32_t const x0 = kt::Max(0, int32_t(floorf(minU * float(c_width))));
+		int32_t const x1 = kt::Min(int32_t(c_width), int32_t(ceilf(maxU * float(c_width))));
+		int32_t const y0 = kt::Max(0, int32_t(floorf(minV * float(c_height))));
+		int32_t const y1 = kt::Min(int32_t(c_height), int32_t(ceilf(maxV * float(c_height))));
+
+		bool conservative = true;
+
+		for (int32_t texelY = y0; texelY < y1; ++texelY)
+		{
+			for (int32_t texelX = x0; texelX < x1; ++texelX)
+			{
+				conservative &= depth[texelY * c_width + texelX] < minZ;
+			}
+		}
+
+		numNotConservative += !conservative;
+	}
+
+	TEST_CHECK(numOccluded > 0);
+	TEST_CHECK(numNotConservative == 0);
+}
\ No newline at end of file
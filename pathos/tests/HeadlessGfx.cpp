@@ -0,0 +1,209 @@
+#include "HeadlessGfx.h"
+
+#include <string.h>
+
+#include <core/Memory.h>
+#include <core/Jobs.h>
+
+#include <gpu/GPUDevice.h>
+
+#include <gfx/Model.h>
+#include <gfx/Primitive.h>
+#include <gfx/DebugRender.h>
+#include <gfx/Scene.h>
+#include <gfx/ShadowUtils.h>
+
+#include <shaderlib/DefinesShared.h>
+
+namespace headless
+{
+
+struct State
+{
+	gpu::PSORef m_objectPso;
+	gpu::PSORef m_shadowMapPso;
+};
+
+static State s_state;
+
+void Init(uint32_t _vertexCapacity, uint32_t _indexCapacity)
+{
+	gpu::Init(nullptr);
+	KT_ASSERT(gpu::GetCaps().headless);
+
+	gpu::BeginFrame();
+	gfx::ResourceManager::Init();
+	gfx::ResourceManager::InitUnifiedBuffers(_vertexCapacity, _indexCapacity);
+	gfx::DebugRender::Init();
+
+	gpu::GraphicsPSODesc psoDesc;
+	psoDesc.m_depthFormat = gpu::BackbufferDepthFormat();
+	psoDesc.m_numRenderTargets = 1;
+	psoDesc.m_renderTargetFormats[0] = gpu::BackbufferFormat();
+	psoDesc.m_vertexLayout = gfx::Scene::ManualFetchInstancedVertexLayout();
+	psoDesc.m_vs = gfx::ResourceManager::LoadShader("shaders/ObjectShader.vs.cso", gpu::ShaderType::Vertex);
+	psoDesc.m_ps = gfx::ResourceManager::LoadShader("shaders/ObjectShader.ps.cso", gpu::ShaderType::Pixel);
+	s_state.m_objectPso = gpu::CreateGraphicsPSO(psoDesc, "Headless Object PSO");
+
+	s_state.m_shadowMapPso = gfx::CreateShadowMapPSO(gpu::Format::D32_Float);
+}
+
+void Shutdown()
+{
+	gpu::EndFrame();
+	s_state = State{};
+	gfx::DebugRender::Shutdown();
+	gfx::ResourceManager::Shutdown();
+	gpu::Shutdown();
+}
+
+void NextFrame()
+{
+	gpu::EndFrame();
+	core::ResetThreadFrameAllocator();
+	core::jobs::ResetWorkerFrameAllocators();
+	gpu::BeginFrame();
+	gfx::ResourceManager::Update();
+}
+
+gfx::ResourceManager::MeshIdx CreateBoxMesh(uint32_t _numSubMeshes, uint32_t _numLods, gfx::ResourceManager::MaterialIdx const* _materials)
+{
+	uint32_t const c_numFaces = 6;
+	uint32_t const c_indicesPerFace = 6;
+
+	KT_ASSERT(_numSubMeshes && _numSubMeshes <= c_numFaces);
+	KT_ASSERT(_numLods && _numLods <= gfx::c_maxMeshLods);
+
+	gfx::PrimitiveBuffers cube;
+	gfx::GenCube(cube);
+
+	gfx::ResourceManager::MeshIdx const meshIdx = gfx::ResourceManager::CreateMesh();
+	gfx::Mesh& mesh = *gfx::ResourceManager::GetMesh(meshIdx);
+
+	mesh.m_name = "Headless_Box";
+	mesh.m_posStream.Resize(cube.m_pos.Size());
+	mesh.m_uvStream0.Resize(cube.m_uvs.Size());
+	mesh.m_tangentStream.Resize(cube.m_tangents.Size());
+	memcpy(mesh.m_posStream.Data(), cube.m_pos.Data(), sizeof(kt::Vec3) * cube.m_pos.Size());
+	memcpy(mesh.m_uvStream0.Data(), cube.m_uvs.Data(), sizeof(kt::Vec2) * cube.m_uvs.Size());
+	memcpy(mesh.m_tangentStream.Data(), cube.m_tangents.Data(), sizeof(gfx::TangentSpace) * cube.m_tangents.Size());
+
+	for (uint16_t idx : cube.m_indicies)
+	{
+		mesh.m_indices.PushBack(idx);
+	}
+
+	mesh.m_boundingBox = kt::AABB::FloatMax();
+	mesh.m_numLods = _numLods;
+
+	for (uint32_t subMeshIdx = 0; subMeshIdx < _numSubMeshes; ++subMeshIdx)
+	{
+		uint32_t const beginFace = subMeshIdx * c_numFaces / _numSubMeshes;
+		uint32_t const endFace = (subMeshIdx + 1) * c_numFaces / _numSubMeshes;
+
+		gfx::Mesh::SubMesh& subMesh = mesh.m_subMeshes.PushBack();
+		subMesh.m_indexBufferStartOffset = beginFace * c_indicesPerFace;
+		subMesh.m_numIndices = (endFace - beginFace) * c_indicesPerFace;
+
+		// Each level drops faces, down to one.
+		for (uint32_t lod = 1; lod < gfx::c_maxMeshLods; ++lod)
+		{
+			uint32_t const lodFaces = kt::Max((endFace - beginFace) >> kt::Min(lod, _numLods - 1), 1u);
+			subMesh.m_lodIndexBufferStartOffset[lod - 1] = subMesh.m_indexBufferStartOffset;
+			subMesh.m_lodNumIndices[lod - 1] = lodFaces * c_indicesPerFace;
+		}
+
+		if (_materials)
+		{
+			subMesh.m_materialIdx = _materials[subMeshIdx];
+			gfx::ResourceManager::AddRef(subMesh.m_materialIdx);
+		}
+
+		kt::AABB& bounds = mesh.m_subMeshBoundingBoxes.PushBack();
+		bounds = kt::AABB::FloatMax();
+
+		for (uint32_t i = subMesh.m_indexBufferStartOffset; i < subMesh.m_indexBufferStartOffset + subMesh.m_numIndices; ++i)
+		{
+			kt::Vec3 const& pos = mesh.m_posStream[mesh.m_indices[i]];
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				bounds.m_min[axis] = kt::Min(bounds.m_min[axis], pos[axis]);
+				bounds.m_max[axis] = kt::Max(bounds.m_max[axis], pos[axis]);
+			}
+		}
+
+		mesh.m_boundingBox = kt::Union(mesh.m_boundingBox, bounds);
+	}
+
+	mesh.CreateGPUBuffers();
+	return meshIdx;
+}
+
+gfx::ResourceManager::ModelIdx CreateModel(gfx::ResourceManager::MeshIdx const* _meshes, uint32_t _numMeshes, kt::Mat4 const* _nodeTransforms)
+{
+	gfx::ResourceManager::ModelIdx const modelIdx = gfx::ResourceManager::CreateModel();
+	gfx::Model& model = *gfx::ResourceManager::GetModel(modelIdx);
+
+	model.m_name = "Headless_Model";
+	model.m_boundingBox = kt::AABB::FloatMax();
+
+	for (uint32_t meshIdx = 0; meshIdx < _numMeshes; ++meshIdx)
+	{
+		kt::Mat4 const mtx = _nodeTransforms ? _nodeTransforms[meshIdx] : kt::Mat4::Identity();
+
+		model.m_meshes.PushBack(_meshes[meshIdx]);
+		model.m_transformNodes.PushBack(gfx::Model::TransformNode{ mtx, UINT32_MAX });
+		model.m_nodes.PushBack(gfx::Model::Node{ mtx, meshIdx, meshIdx });
+
+		gfx::Mesh const& mesh = *gfx::ResourceManager::GetMesh(_meshes[meshIdx]);
+		model.m_boundingBox = kt::Union(mesh.m_boundingBox.Transformed(mtx), model.m_boundingBox);
+	}
+
+	return modelIdx;
+}
+
+void RenderSceneFrame(gfx::Scene& _scene, gfx::Camera const& _cam, float _dt)
+{
+	gpu::cmd::Context* ctx = gpu::GetMainThreadCommandCtx();
+
+	_scene.BeginFrameAndUpdateBuffers(ctx, _cam, _dt);
+	_scene.BindPerFrameConstants(ctx);
+	_scene.SubmitInstances();
+
+	gpu::cmd::SetPSO(ctx, s_state.m_shadowMapPso);
+	_scene.RenderCascadeViews(ctx);
+
+	gpu::TextureHandle const backbuffer = gpu::CurrentBackbuffer();
+	gpu::TextureHandle const depth = gpu::BackbufferDepth();
+
+	gpu::cmd::SetPSO(ctx, s_state.m_objectPso);
+
+	gpu::DescriptorData cbvs;
+	cbvs.Set(_scene.m_frameConstantsGpuBuf);
+	gpu::cmd::SetGraphicsCBVTable(ctx, cbvs, PATHOS_PER_FRAME_SPACE);
+
+	gpu::cmd::SetRenderTarget(ctx, 0, backbuffer);
+	gpu::cmd::SetDepthBuffer(ctx, depth);
+
+	float const col[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	gpu::cmd::ClearRenderTarget(ctx, backbuffer, col);
+	gpu::cmd::ClearDepth(ctx, depth, 1.0f);
+
+	gpu::cmd::SetViewportAndScissorRectFromTexture(ctx, backbuffer, 0.0f, 1.0f);
+	gpu::cmd::SetGraphicsSRVTable(ctx, gfx::ResourceManager::GetTextureDescriptorTable(), PATHOS_CUSTOM_SPACE);
+
+	_scene.RenderInstances(ctx);
+
+	if (_scene.BuildDepthPyramidAndCullLate(ctx, depth))
+	{
+		gpu::cmd::SetPSO(ctx, s_state.m_objectPso);
+		gpu::cmd::SetRenderTarget(ctx, 0, backbuffer);
+		gpu::cmd::SetDepthBuffer(ctx, depth);
+		_scene.RenderLateInstances(ctx);
+	}
+
+	_scene.EndFrame();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Mat4.h>
+
+#include <core/CVar.h>
+
+#include <gfx/ResourceManager.h>
+
+namespace gfx
+{
+class Scene;
+struct Camera;
+}
+
+// Renderer setup for tests and benchmarks on the null gpu backend, so they run on machines without a gpu (eg. CI).
+// Needs the thread frame allocator and job system, which the test and bench mains already set up.
+
+namespace headless
+{
+
+// Null device, ResourceManager (shaders that weren't compiled are empty), unified buffers and DebugRender.
+// A frame is left open, so the main thread command context can be used straight away.
+void Init(uint32_t _vertexCapacity = 1024 * 1024, uint32_t _indexCapacity = 1024 * 1024);
+
+// Everything created through ResourceManager must be released (and gpu refs dropped) first.
+void Shutdown();
+
+// Ends the open frame and begins the next, resetting the thread and worker frame allocators in between.
+void NextFrame();
+
+// Unit cube (gfx::GenCube) with its six faces split between _numSubMeshes (1 to 6) submeshes.
+// Each has _numLods detail levels, lower ones drawing fewer of its faces. _materials has one per submesh, or null for none.
+gfx::ResourceManager::MeshIdx CreateBoxMesh(uint32_t _numSubMeshes, uint32_t _numLods = 1, gfx::ResourceManager::MaterialIdx const* _materials = nullptr);
+
+// A model with a root node per mesh, at _nodeTransforms (or identity if null). The model takes over the mesh references.
+gfx::ResourceManager::ModelIdx CreateModel(gfx::ResourceManager::MeshIdx const* _meshes, uint32_t _numMeshes, kt::Mat4 const* _nodeTransforms = nullptr);
+
+// Sets a cvar of another module (eg. to test both paths of a renderer option), returning its previous value.
+template <typename T>
+T SetCVar(char const* _path, T _value)
+{
+	core::CVar<T>* cvar = static_cast<core::CVar<T>*>(core::FindCVar(_path));
+	KT_ASSERT(cvar);
+	T const prev = *cvar;
+	cvar->Set(_value);
+	return prev;
+}
+
+// Renders a frame of _scene as the testbed does: shadow cascades, the main view from _cam (and the late instances if gpu culling) then Scene::EndFrame.
+void RenderSceneFrame(gfx::Scene& _scene, gfx::Camera const& _cam, float _dt);
+
+}
\ No newline at end of file
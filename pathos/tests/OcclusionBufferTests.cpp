@@ -0,0 +1,173 @@
+#include "Test.h"
+
+#include <stdio.h>
+
+#include <kt/AABB.h>
+#include <kt/Mat4.h>
+#include <kt/Vec3.h>
+
+#include <gfx/OcclusionBuffer.h>
+
+// The rasterizer is exercised through world to clip matrices that map world x/y straight onto pixels (y down) and z onto depth,
+// so occluders and bounds can be placed exactly, relative to tile boundaries.
+
+using gfx::OcclusionBuffer;
+
+static uint32_t const c_width = 256;
+static uint32_t const c_height = 64;
+
+static kt::Mat4 PixelToClip()
+{
+	kt::Mat4 mtx = kt::Mat4::Identity();
+	mtx.m_cols[0] = kt::Vec4(2.0f / float(c_width), 0.0f, 0.0f, 0.0f);
+	mtx.m_cols[1] = kt::Vec4(0.0f, -2.0f / float(c_height), 0.0f, 0.0f);
+	mtx.m_cols[2] = kt::Vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	mtx.m_cols[3] = kt::Vec4(-1.0f, 1.0f, 0.0f, 1.0f);
+	return mtx;
+}
+
+// Two front facing (clockwise on screen) triangles covering pixel centres in [_minX, _maxX) x [_minY, _maxY), at depth _z.
+struct Quad
+{
+	Quad(float _minX, float _minY, float _maxX, float _maxY, float _z)
+	{
+		m_positions[0] = kt::Vec3(_minX, _minY, _z);
+		m_positions[1] = kt::Vec3(_maxX, _minY, _z);
+		m_positions[2] = kt::Vec3(_maxX, _maxY, _z);
+		m_positions[3] = kt::Vec3(_minX, _maxY, _z);
+	}
+
+	kt::Vec3 m_positions[4];
+	uint32_t m_indices[6] = { 0, 1, 3, 1, 2, 3 };
+};
+
+static void AddQuad(OcclusionBuffer& _buffer, Quad const& _quad)
+{
+	_buffer.AddOccluder(kt::Mat4::Identity(), _quad.m_positions, _quad.m_indices, KT_ARRAY_COUNT(_quad.m_indices));
+}
+
+static kt::AABB Box(float _minX, float _minY, float _minZ, float _maxX, float _maxY, float _maxZ)
+{
+	kt::AABB box;
+	box.m_min = kt::Vec3(_minX, _minY, _minZ);
+	box.m_max = kt::Vec3(_maxX, _maxY, _maxZ);
+	return box;
+}
+
+static bool InitBuffer(OcclusionBuffer& o_buffer)
+{
+	o_buffer.Init(c_width, c_height);
+
+	if (!o_buffer.IsEnabled())
+	{
+		printf("  skipped, the occlusion buffer needs AVX2\n");
+		return false;
+	}
+
+	o_buffer.BeginFrame(PixelToClip());
+	return true;
+}
+
+PATHOS_TEST(OcclusionBuffer_Empty)
+{
+	OcclusionBuffer buffer;
+	if (!InitBuffer(buffer))
+	{
+		return;
+	}
+
+	buffer.RasterizeOccluders();
+
+	TEST_CHECK(buffer.Width() == c_width && buffer.Height() == c_height);
+	TEST_CHECK(buffer.PixelDepth(0, 0) == 1.0f && buffer.PixelDepth(c_width - 1, c_height - 1) == 1.0f);
+
+	TEST_CHECK(buffer.IsVisible(Box(10.0f, 10.0f, 0.9f, 20.0f, 20.0f, 0.95f)));
+
+	// Off screen.
+	TEST_CHECK(!buffer.IsVisible(Box(300.0f, 10.0f, 0.5f, 310.0f, 20.0f, 0.6f)));
+	TEST_CHECK(!buffer.IsVisible(Box(10.0f, -20.0f, 0.5f, 20.0f, -10.0f, 0.6f)));
+}
+
+// One occluder whose edges fall inside tiles, so the edge tiles are only partly covered (mask) and the inner ones become fully covered (reference depth).
+PATHOS_TEST(OcclusionBuffer_SingleOccluder)
+{
+	OcclusionBuffer buffer;
+	if (!InitBuffer(buffer))
+	{
+		return;
+	}
+
+	Quad const quad(40.0f, 12.0f, 200.0f, 52.0f, 0.5f);
+	AddQuad(buffer, quad);
+	buffer.RasterizeOccluders();
+
+	TEST_CHECK(buffer.GetStats().m_numOccluders == 1);
+	TEST_CHECK(buffer.GetStats().m_numTrianglesRasterized == 2);
+
+	// Coverage ends exactly at the quad edges, either side of tile boundaries and mid tile.
+	TEST_CHECK(buffer.PixelDepth(40, 12) == 0.5f && buffer.PixelDepth(39, 12) == 1.0f && buffer.PixelDepth(40, 11) == 1.0f);
+	TEST_CHECK(buffer.PixelDepth(199, 51) == 0.5f && buffer.PixelDepth(200, 51) == 1.0f && buffer.PixelDepth(199, 52) == 1.0f);
+	TEST_CHECK(buffer.PixelDepth(63, 30) == 0.5f && buffer.PixelDepth(64, 30) == 0.5f);
+	TEST_CHECK(buffer.PixelDepth(100, 15) == 0.5f && buffer.PixelDepth(100, 16) == 0.5f);
+
+	// Behind, over several whole tiles and the partly covered edge tiles.
+	TEST_CHECK(!buffer.IsVisible(Box(41.0f, 13.0f, 0.6f, 198.0f, 50.0f, 0.8f)));
+
+	// Behind, inside a single tile and straddling tile corners.
+	TEST_CHECK(!buffer.IsVisible(Box(70.0f, 20.0f, 0.6f, 80.0f, 22.0f, 0.7f)));
+	TEST_CHECK(!buffer.IsVisible(Box(60.0f, 14.0f, 0.6f, 68.0f, 18.0f, 0.7f)));
+
+	// In front of the occluder.
+	TEST_CHECK(buffer.IsVisible(Box(41.0f, 13.0f, 0.2f, 198.0f, 50.0f, 0.3f)));
+
+	// Behind, but poking out past an edge, whether that's a tile boundary or mid tile.
+	TEST_CHECK(buffer.IsVisible(Box(30.0f, 20.0f, 0.6f, 100.0f, 30.0f, 0.7f)));
+	TEST_CHECK(buffer.IsVisible(Box(38.5f, 20.0f, 0.6f, 60.0f, 30.0f, 0.7f)));
+	TEST_CHECK(buffer.IsVisible(Box(100.0f, 40.0f, 0.6f, 120.0f, 56.0f, 0.7f)));
+	TEST_CHECK(buffer.IsVisible(Box(190.0f, 20.0f, 0.6f, 210.0f, 30.0f, 0.7f)));
+
+	// Crossing the near plane.
+	TEST_CHECK(buffer.IsVisible(Box(70.0f, 20.0f, -0.1f, 80.0f, 22.0f, 0.7f)));
+
+	// A new frame forgets the occluder.
+	buffer.BeginFrame(PixelToClip());
+	buffer.RasterizeOccluders();
+	TEST_CHECK(buffer.IsVisible(Box(70.0f, 20.0f, 0.6f, 80.0f, 22.0f, 0.7f)));
+}
+
+// Occluders meeting mid tile leave no gap, and once their masks fill a tile it's at the farther of the two depths.
+PATHOS_TEST(OcclusionBuffer_AdjacentOccluders)
+{
+	OcclusionBuffer buffer;
+	if (!InitBuffer(buffer))
+	{
+		return;
+	}
+
+	Quad const left(0.0f, 0.0f, 100.0f, float(c_height), 0.4f);
+	Quad const right(100.0f, 0.0f, float(c_width), float(c_height), 0.5f);
+	AddQuad(buffer, left);
+	AddQuad(buffer, right);
+	buffer.RasterizeOccluders();
+
+	TEST_CHECK(buffer.GetStats().m_numTrianglesRasterized == 4);
+
+	for (uint32_t y = 0; y < c_height; ++y)
+	{
+		for (uint32_t x = 0; x < c_width; ++x)
+		{
+			TEST_CHECK(buffer.PixelDepth(x, y) <= 0.5f);
+		}
+	}
+
+	// Behind both, across the seam.
+	TEST_CHECK(!buffer.IsVisible(Box(90.0f, 10.0f, 0.6f, 110.0f, 30.0f, 0.7f)));
+	TEST_CHECK(!buffer.IsVisible(Box(1.0f, 1.0f, 0.6f, 254.0f, 62.0f, 0.7f)));
+
+	// Between the two depths.
+	TEST_CHECK(buffer.IsVisible(Box(90.0f, 10.0f, 0.45f, 110.0f, 30.0f, 0.7f)));
+	TEST_CHECK(buffer.IsVisible(Box(150.0f, 10.0f, 0.45f, 160.0f, 30.0f, 0.7f)));
+
+	// Whole tiles of the nearer occluder are at its depth.
+	TEST_CHECK(!buffer.IsVisible(Box(10.0f, 10.0f, 0.45f, 60.0f, 30.0f, 0.7f)));
+}
\ No newline at end of file
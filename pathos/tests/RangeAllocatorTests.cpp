@@ -0,0 +1,236 @@
+#include "Test.h"
+
+#include <string.h>
+
+#include <kt/Array.h>
+
+#include <gfx/RangeAllocator.h>
+
+using gfx::RangeAllocator;
+
+PATHOS_TEST(RangeAllocator_AllocFree)
+{
+	RangeAllocator allocator;
+	allocator.Init(100);
+
+	TEST_CHECK(allocator.Alloc(0) == RangeAllocator::c_invalidHandle);
+
+	RangeAllocator::Handle const a = allocator.Alloc(10);
+	RangeAllocator::Handle const b = allocator.Alloc(20);
+	RangeAllocator::Handle const c = allocator.Alloc(30);
+
+	TEST_CHECK(allocator.Offset(a) == 0 && allocator.Size(a) == 10);
+	TEST_CHECK(allocator.Offset(b) == 10 && allocator.Size(b) == 20);
+	TEST_CHECK(allocator.Offset(c) == 30 && allocator.Size(c) == 30);
+	TEST_CHECK(allocator.UsedSize() == 60 && allocator.FreeSize() == 40);
+
+	// An exact fit reuses the hole rather than splitting the tail.
+	allocator.Free(b);
+	RangeAllocator::Handle const b2 = allocator.Alloc(20);
+	TEST_CHECK(allocator.Offset(b2) == 10);
+
+	RangeAllocator::Handle const d = allocator.Alloc(40);
+	TEST_CHECK(d != RangeAllocator::c_invalidHandle && allocator.Offset(d) == 60);
+	TEST_CHECK(allocator.FreeSize() == 0 && allocator.LargestFreeBlock() == 0);
+	TEST_CHECK(allocator.Alloc(1) == RangeAllocator::c_invalidHandle);
+
+	allocator.Free(RangeAllocator::c_invalidHandle);
+	TEST_CHECK(allocator.UsedSize() == 100);
+}
+
+PATHOS_TEST(RangeAllocator_Merge)
+{
+	RangeAllocator allocator;
+	allocator.Init(100);
+
+	RangeAllocator::Handle const a = allocator.Alloc(10);
+	RangeAllocator::Handle const b = allocator.Alloc(20);
+	RangeAllocator::Handle const c = allocator.Alloc(30);
+
+	// Merge with the next block.
+	allocator.Free(b);
+	allocator.Free(a);
+	TEST_CHECK(allocator.LargestFreeBlock() == 40);
+
+	RangeAllocator::Handle const ab = allocator.Alloc(30);
+	TEST_CHECK(allocator.Offset(ab) == 0);
+
+	// Merge with the previous block and the free tail, leaving one block.
+	allocator.Free(ab);
+	allocator.Free(c);
+	TEST_CHECK(allocator.UsedSize() == 0);
+	TEST_CHECK(allocator.LargestFreeBlock() == 100);
+	TEST_CHECK(allocator.Offset(allocator.Alloc(100)) == 0);
+}
+
+PATHOS_TEST(RangeAllocator_Fragmentation)
+{
+	RangeAllocator allocator;
+	allocator.Init(100);
+	TEST_CHECK(allocator.Fragmentation() == 0.0f);
+
+	RangeAllocator::Handle const a = allocator.Alloc(10);
+	RangeAllocator::Handle const b = allocator.Alloc(20);
+	RangeAllocator::Handle const c = allocator.Alloc(30);
+	KT_UNUSED(c);
+	TEST_CHECK(allocator.Fragmentation() == 0.0f);
+
+	// 20 free in the hole and 40 at the end.
+	allocator.Free(b);
+	TEST_CHECK(allocator.LargestFreeBlock() == 40);
+	TEST_CHECK(kt::Abs(allocator.Fragmentation() - (1.0f - 40.0f / 60.0f)) < 1e-6f);
+
+	// 30 free in the hole.
+	allocator.Free(a);
+	TEST_CHECK(kt::Abs(allocator.Fragmentation() - (1.0f - 40.0f / 70.0f)) < 1e-6f);
+
+	// Full has no fragmentation.
+	RangeAllocator full;
+	full.Init(16);
+	full.Alloc(16);
+	TEST_CHECK(full.Fragmentation() == 0.0f);
+}
+
+PATHOS_TEST(RangeAllocator_Grow)
+{
+	RangeAllocator allocator;
+	allocator.Init(64);
+
+	RangeAllocator::Handle const a = allocator.Alloc(64);
+	TEST_CHECK(allocator.Alloc(32) == RangeAllocator::c_invalidHandle);
+
+	allocator.Grow(96);
+	RangeAllocator::Handle const b = allocator.Alloc(16);
+	TEST_CHECK(allocator.Offset(b) == 64);
+
+	// Growing extends the free tail rather than adding a block.
+	allocator.Grow(128);
+	TEST_CHECK(allocator.LargestFreeBlock() == 48);
+	TEST_CHECK(allocator.Capacity() == 128 && allocator.UsedSize() == 80);
+	TEST_CHECK(allocator.Offset(a) == 0);
+}
+
+PATHOS_TEST(RangeAllocator_CompactMoves)
+{
+	RangeAllocator allocator;
+	allocator.Init(100);
+
+	RangeAllocator::Handle const a = allocator.Alloc(10);
+	RangeAllocator::Handle const b = allocator.Alloc(20);
+	RangeAllocator::Handle const c = allocator.Alloc(30);
+	RangeAllocator::Handle const d = allocator.Alloc(5);
+	RangeAllocator::Handle const e = allocator.Alloc(5);
+
+	allocator.Free(a);
+	allocator.Free(c);
+
+	kt::Array<RangeAllocator::Move> moves;
+	allocator.Compact(moves);
+
+	// Every live allocation moved, in address order, and neighbours shifted by the same amount stay consecutive.
+	TEST_CHECK(moves.Size() == 3);
+	if (moves.Size() == 3)
+	{
+		TEST_CHECK(moves[0].m_handle == b && moves[0].m_srcOffset == 10 && moves[0].m_destOffset == 0 && moves[0].m_size == 20);
+		TEST_CHECK(moves[1].m_handle == d && moves[1].m_srcOffset == 60 && moves[1].m_destOffset == 20 && moves[1].m_size == 5);
+		TEST_CHECK(moves[2].m_handle == e && moves[2].m_srcOffset == 65 && moves[2].m_destOffset == 25 && moves[2].m_size == 5);
+	}
+
+	TEST_CHECK(allocator.Offset(b) == 0 && allocator.Offset(d) == 20 && allocator.Offset(e) == 25);
+	TEST_CHECK(allocator.LargestFreeBlock() == 70 && allocator.Fragmentation() == 0.0f);
+
+	// Nothing before the first hole moves.
+	allocator.Free(d);
+	moves.Clear();
+	allocator.Compact(moves);
+	TEST_CHECK(moves.Size() == 1);
+	if (moves.Size() == 1)
+	{
+		TEST_CHECK(moves[0].m_handle == e && moves[0].m_srcOffset == 25 && moves[0].m_destOffset == 20);
+	}
+
+	// Already packed.
+	moves.Clear();
+	allocator.Compact(moves);
+	TEST_CHECK(moves.Size() == 0);
+	TEST_CHECK(allocator.Offset(allocator.Alloc(75)) == 25);
+}
+
+// Random allocs and frees, checking live ranges never overlap and compaction packs them in order.
+PATHOS_TEST(RangeAllocator_Random)
+{
+	uint32_t const c_capacity = 4096;
+
+	RangeAllocator allocator;
+	allocator.Init(c_capacity);
+
+	kt::Array<RangeAllocator::Handle> live;
+	kt::Array<uint8_t> owner;
+	kt::Array<RangeAllocator::Move> moves;
+
+	uint32_t rng = 0x12345678;
+	auto nextRand = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+
+	for (uint32_t iter = 0; iter < 4000; ++iter)
+	{
+		if (live.Size() && (nextRand() % 3) == 0)
+		{
+			uint32_t const idx = nextRand() % live.Size();
+			allocator.Free(live[idx]);
+			live[idx] = live.Back();
+			live.PopBack();
+		}
+		else
+		{
+			uint32_t const size = 1 + nextRand() % 64;
+			RangeAllocator::Handle const handle = allocator.Alloc(size);
+			if (handle != RangeAllocator::c_invalidHandle)
+			{
+				live.PushBack(handle);
+			}
+			else
+			{
+				TEST_CHECK(allocator.LargestFreeBlock() < size);
+			}
+		}
+
+		if (iter % 500 != 499)
+		{
+			continue;
+		}
+
+		owner.Clear();
+		owner.Resize(c_capacity);
+		memset(owner.Data(), 0, c_capacity);
+
+		uint32_t used = 0;
+		for (RangeAllocator::Handle handle : live)
+		{
+			uint32_t const offset = allocator.Offset(handle);
+			uint32_t const size = allocator.Size(handle);
+			TEST_CHECK(offset + size <= c_capacity);
+
+			for (uint32_t i = offset; i < kt::Min(offset + size, c_capacity); ++i)
+			{
+				TEST_CHECK(!owner[i]);
+				owner[i] = 1;
+			}
+
+			used += size;
+		}
+
+		TEST_CHECK(used == allocator.UsedSize());
+
+		moves.Clear();
+		allocator.Compact(moves);
+
+		for (uint32_t i = 1; i < moves.Size(); ++i)
+		{
+			TEST_CHECK(moves[i].m_srcOffset > moves[i - 1].m_srcOffset);
+			TEST_CHECK(moves[i].m_destOffset == moves[i - 1].m_destOffset + moves[i - 1].m_size);
+		}
+
+		TEST_CHECK(allocator.Fragmentation() == 0.0f);
+		TEST_CHECK(allocator.LargestFreeBlock() == allocator.FreeSize());
+	}
+}
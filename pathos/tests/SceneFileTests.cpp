@@ -0,0 +1,279 @@
+#include "Test.h"
+#include "HeadlessGfx.h"
+
+#include <string.h>
+
+#include <kt/Array.h>
+#include <kt/Mat4.h>
+
+#include <gfx/Scene.h>
+#include <gfx/SceneFile.h>
+#include <gfx/Model.h>
+#include <gfx/Material.h>
+
+// SceneFile written from one Scene and read into another on the null backend. Models stay loaded, so reading reuses them by path.
+
+static uint32_t const c_numMaterials = 3;
+
+struct TestModels
+{
+	gfx::ResourceManager::ModelIdx m_models[2];
+
+	// Used by the first model's submeshes, in order.
+	gfx::ResourceManager::MaterialIdx m_materials[c_numMaterials];
+};
+
+static void SetMaterialParams(gfx::Material::Params& o_params, uint32_t _seed)
+{
+	o_params.m_baseColour = kt::Vec4(0.1f * float(_seed), 0.2f, 0.3f, 1.0f);
+	o_params.m_roughnessFactor = 0.25f + 0.1f * float(_seed);
+	o_params.m_metallicFactor = 0.05f * float(_seed);
+	o_params.m_alphaCutoff = 0.5f;
+	o_params.m_alphaMode = gfx::Material::AlphaMode(_seed % 3);
+}
+
+static void CreateTestModels(TestModels& o_models)
+{
+	for (uint32_t i = 0; i < c_numMaterials; ++i)
+	{
+		o_models.m_materials[i] = gfx::ResourceManager::CreateMaterial();
+		SetMaterialParams(gfx::ResourceManager::GetMaterial(o_models.m_materials[i])->m_params, i + 1);
+	}
+
+	gfx::ResourceManager::MeshIdx const meshA = headless::CreateBoxMesh(c_numMaterials, 1, o_models.m_materials);
+	gfx::ResourceManager::MeshIdx const meshB = headless::CreateBoxMesh(1);
+
+	for (gfx::ResourceManager::MaterialIdx material : o_models.m_materials)
+	{
+		gfx::ResourceManager::Release(material);
+	}
+
+	o_models.m_models[0] = headless::CreateModel(&meshA, 1);
+	o_models.m_models[1] = headless::CreateModel(&meshB, 1);
+
+	// Models are found by path when read, which is their name.
+	gfx::ResourceManager::GetModel(o_models.m_models[0])->m_name = "SceneFileTests/ModelA.gltf";
+	gfx::ResourceManager::GetModel(o_models.m_models[1])->m_name = "SceneFileTests/ModelB.gltf";
+}
+
+// Instances of both models with every combination of flags, a light of each type and a sun.
+static void BuildScene(gfx::Scene& io_scene, TestModels const& _models)
+{
+	for (uint32_t i = 0; i < 12; ++i)
+	{
+		kt::Mat4 const mtx = kt::Mat4::Translation(kt::Vec3(float(i) * 2.0f, float(i % 3), -float(i)));
+		gfx::Scene::InstanceHandle const handle = io_scene.AddModelInstance(_models.m_models[i % 2], mtx, (i / 2) % 2 == 0);
+
+		if (i % 4 >= 2)
+		{
+			io_scene.SetInstanceVisible(handle, false);
+		}
+	}
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		gfx::Light& light = io_scene.m_lights.PushBack();
+		light.m_type = i % 2 ? gfx::Light::Type::Spot : gfx::Light::Type::Point;
+		light.m_colour = kt::Vec3(1.0f, 0.5f, 0.1f * float(i));
+		light.m_intensity = 1.0f + float(i);
+		light.m_radius = 3.0f + float(i);
+		light.m_spotInnerAngle = 0.2f;
+		light.m_spotOuterAngle = 0.4f + 0.05f * float(i);
+		light.m_transform = kt::Mat4::Translation(kt::Vec3(float(i), 2.0f, 0.0f));
+	}
+
+	io_scene.m_sunColor = kt::Vec3(1.0f, 0.9f, 0.7f);
+	io_scene.m_sunIntensity = 3.5f;
+	io_scene.m_sunThetaPhi = kt::Vec2(0.3f, 1.2f);
+}
+
+PATHOS_TEST(SceneFile_RoundTrip)
+{
+	headless::Init();
+
+	{
+		TestModels models;
+		CreateTestModels(models);
+
+		gfx::Scene written;
+		written.Init(512);
+		BuildScene(written, models);
+
+		// Instances keep their models loaded.
+		for (gfx::ResourceManager::ModelIdx model : models.m_models)
+		{
+			gfx::ResourceManager::Release(model);
+		}
+
+		kt::Array<uint8_t> data;
+		gfx::SceneFile::Write(written, data);
+		TEST_CHECK(gfx::SceneFile::Validate(data.Data(), data.Size()) != nullptr);
+
+		// Stored params should be put back over these.
+		for (gfx::ResourceManager::MaterialIdx material : models.m_materials)
+		{
+			SetMaterialParams(gfx::ResourceManager::GetMaterial(material)->m_params, 7);
+		}
+
+		gfx::Scene read;
+		read.Init(512);
+		TEST_CHECK(gfx::SceneFile::Read(read, data.Data(), data.Size()));
+
+		TEST_CHECK(read.m_modelInstances.Size() == written.m_modelInstances.Size());
+
+		for (uint32_t i = 0; i < kt::Min(read.m_modelInstances.Size(), written.m_modelInstances.Size()); ++i)
+		{
+			gfx::Scene::ModelInstance const& lhs = written.m_modelInstances[i];
+			gfx::Scene::ModelInstance const& rhs = read.m_modelInstances[i];
+
+			TEST_CHECK(lhs.m_modelIdx == rhs.m_modelIdx);
+			TEST_CHECK(!memcmp(&lhs.m_mtx, &rhs.m_mtx, sizeof(kt::Mat4)));
+			TEST_CHECK(lhs.m_isStatic == rhs.m_isStatic);
+			TEST_CHECK(lhs.m_isVisible == rhs.m_isVisible);
+		}
+
+		TEST_CHECK(read.m_lights.Size() == written.m_lights.Size());
+
+		for (uint32_t i = 0; i < kt::Min(read.m_lights.Size(), written.m_lights.Size()); ++i)
+		{
+			gfx::Light const& lhs = written.m_lights[i];
+			gfx::Light const& rhs = read.m_lights[i];
+
+			TEST_CHECK(lhs.m_type == rhs.m_type);
+			TEST_CHECK(!memcmp(&lhs.m_colour, &rhs.m_colour, sizeof(kt::Vec3)));
+			TEST_CHECK(lhs.m_intensity == rhs.m_intensity);
+			TEST_CHECK(lhs.m_radius == rhs.m_radius);
+			TEST_CHECK(lhs.m_spotInnerAngle == rhs.m_spotInnerAngle);
+			TEST_CHECK(lhs.m_spotOuterAngle == rhs.m_spotOuterAngle);
+			TEST_CHECK(!memcmp(&lhs.m_transform, &rhs.m_transform, sizeof(kt::Mat4)));
+		}
+
+		TEST_CHECK(!memcmp(&read.m_sunColor, &written.m_sunColor, sizeof(kt::Vec3)));
+		TEST_CHECK(read.m_sunIntensity == written.m_sunIntensity);
+		TEST_CHECK(!memcmp(&read.m_sunThetaPhi, &written.m_sunThetaPhi, sizeof(kt::Vec2)));
+
+		for (uint32_t i = 0; i < c_numMaterials; ++i)
+		{
+			gfx::Material::Params expected;
+			SetMaterialParams(expected, i + 1);
+
+			gfx::Material::Params const& params = gfx::ResourceManager::GetMaterial(models.m_materials[i])->m_params;
+			TEST_CHECK(!memcmp(&params.m_baseColour, &expected.m_baseColour, sizeof(kt::Vec4)));
+			TEST_CHECK(params.m_roughnessFactor == expected.m_roughnessFactor);
+			TEST_CHECK(params.m_metallicFactor == expected.m_metallicFactor);
+			TEST_CHECK(params.m_alphaCutoff == expected.m_alphaCutoff);
+			TEST_CHECK(params.m_alphaMode == expected.m_alphaMode);
+		}
+
+		// Written again, the read scene should give the same file.
+		kt::Array<uint8_t> rewritten;
+		gfx::SceneFile::Write(read, rewritten);
+		TEST_CHECK(rewritten.Size() == data.Size() && !memcmp(rewritten.Data(), data.Data(), data.Size()));
+	}
+
+	headless::Shutdown();
+}
+
+PATHOS_TEST(SceneFile_ValidateRejectsBadData)
+{
+	headless::Init();
+
+	{
+		TestModels models;
+		CreateTestModels(models);
+
+		gfx::Scene scene;
+		scene.Init(512);
+		BuildScene(scene, models);
+
+		for (gfx::ResourceManager::ModelIdx model : models.m_models)
+		{
+			gfx::ResourceManager::Release(model);
+		}
+
+		kt::Array<uint8_t> data;
+		gfx::SceneFile::Write(scene, data);
+
+		uint32_t const size = data.Size();
+		TEST_CHECK(gfx::SceneFile::Validate(data.Data(), size) != nullptr);
+
+		// Truncated anywhere, including mid header.
+		uint32_t const truncatedSizes[] = { 0, 1, sizeof(gfx::SceneFile::Header) - 1, sizeof(gfx::SceneFile::Header), size / 2, size - 1 };
+
+		for (uint32_t truncatedSize : truncatedSizes)
+		{
+			TEST_CHECK(gfx::SceneFile::Validate(data.Data(), truncatedSize) == nullptr);
+		}
+
+		// Each corruption is made to a fresh copy, with the header at the start of an aligned buffer.
+		kt::Array<uint8_t> corrupt;
+
+		auto corruptHeader = [&data, &corrupt]() -> gfx::SceneFile::Header&
+		{
+			corrupt.Clear();
+			memcpy(corrupt.PushBack_Raw(data.Size()), data.Data(), data.Size());
+			return *(gfx::SceneFile::Header*)corrupt.Data();
+		};
+
+		auto rejected = [&corrupt]() -> bool
+		{
+			return gfx::SceneFile::Validate(corrupt.Data(), corrupt.Size()) == nullptr;
+		};
+
+		corruptHeader().m_magic ^= 0xff;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_version += 1;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_fileSize = size + 1;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_instancesOffset += 4;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_numInstances = size / sizeof(gfx::SceneFile::Instance) + 1;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_numLights = UINT32_MAX;
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_lightsOffset = UINT32_MAX & ~(gfx::SceneFile::c_arrayAlignment - 1);
+		TEST_CHECK(rejected());
+
+		corruptHeader().m_stringsSize += gfx::SceneFile::c_arrayAlignment;
+		TEST_CHECK(rejected());
+
+		{
+			gfx::SceneFile::Header const& header = corruptHeader();
+			gfx::SceneFile::ModelRef* refs = (gfx::SceneFile::ModelRef*)(corrupt.Data() + header.m_modelsOffset);
+			refs[0].m_pathOffset = header.m_stringsSize;
+			TEST_CHECK(rejected());
+		}
+
+		{
+			gfx::SceneFile::Header const& header = corruptHeader();
+			gfx::SceneFile::ModelRef* refs = (gfx::SceneFile::ModelRef*)(corrupt.Data() + header.m_modelsOffset);
+			refs[header.m_numModels - 1].m_numMaterials = header.m_numMaterials + 1;
+			TEST_CHECK(rejected());
+		}
+
+		{
+			// The last path loses its terminator, so it would be read past the strings.
+			gfx::SceneFile::Header const& header = corruptHeader();
+			corrupt[header.m_stringsOffset + header.m_stringsSize - 1] = 'x';
+			TEST_CHECK(rejected());
+		}
+
+		// Rejected files leave the scene alone.
+		gfx::Scene untouched;
+		untouched.Init(512);
+		TEST_CHECK(!gfx::SceneFile::Read(untouched, data.Data(), size - 1));
+		corruptHeader().m_magic ^= 0xff;
+		TEST_CHECK(!gfx::SceneFile::Read(untouched, corrupt.Data(), corrupt.Size()));
+		TEST_CHECK(untouched.m_modelInstances.Size() == 0);
+		TEST_CHECK(untouched.m_lights.Size() == 0);
+	}
+
+	headless::Shutdown();
+}
\ No newline at end of file
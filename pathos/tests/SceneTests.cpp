@@ -0,0 +1,147 @@
+#include "Test.h"
+#include "HeadlessGfx.h"
+
+#include <kt/Mat4.h>
+#include <kt/MathUtil.h>
+
+#include <gpu/null/GPUDevice_Null.h>
+
+#include <gfx/Scene.h>
+#include <gfx/Model.h>
+#include <gfx/Material.h>
+
+// Whole frames of a Scene on the null backend, through ResourceManager, the instance table and the main view and cascade MeshRenderers.
+
+static uint32_t const c_gridDim = 16;
+static float const c_gridSpacing = 3.0f;
+
+static gfx::ResourceManager::MeshIdx CreateTestMesh()
+{
+	gfx::Material::AlphaMode const modes[] = { gfx::Material::AlphaMode::Opaque, gfx::Material::AlphaMode::Mask, gfx::Material::AlphaMode::Transparent };
+	gfx::ResourceManager::MaterialIdx materials[KT_ARRAY_COUNT(modes)];
+
+	for (uint32_t i = 0; i < KT_ARRAY_COUNT(modes); ++i)
+	{
+		materials[i] = gfx::ResourceManager::CreateMaterial();
+		gfx::ResourceManager::GetMaterial(materials[i])->m_params.m_alphaMode = modes[i];
+	}
+
+	gfx::ResourceManager::MeshIdx const mesh = headless::CreateBoxMesh(KT_ARRAY_COUNT(modes), 2, materials);
+
+	for (gfx::ResourceManager::MaterialIdx material : materials)
+	{
+		gfx::ResourceManager::Release(material);
+	}
+
+	return mesh;
+}
+
+static void InitCamera(gfx::Camera& o_cam)
+{
+	gfx::Camera::ProjectionParams params;
+	params.SetPerspective(0.1f, 500.0f, kt::ToRadians(60.0f), 16.0f / 9.0f);
+	o_cam.SetProjection(params);
+	o_cam.SetCameraPos(kt::Vec3(float(c_gridDim) * c_gridSpacing * 0.5f, 4.0f, -10.0f));
+}
+
+PATHOS_TEST(Scene_HeadlessFrames)
+{
+	headless::Init();
+
+	{
+		// A hole ahead of the test mesh in the unified buffers, so compacting moves it.
+		gfx::ResourceManager::MeshIdx const spacerMesh = headless::CreateBoxMesh(1);
+		gfx::ResourceManager::MeshIdx const testMesh = CreateTestMesh();
+		gfx::ResourceManager::ModelIdx const model = headless::CreateModel(&testMesh, 1);
+
+		gfx::Scene scene;
+		scene.Init(512);
+
+		kt::Array<gfx::Scene::InstanceHandle> dynamicInstances;
+
+		for (uint32_t z = 0; z < c_gridDim; ++z)
+		{
+			for (uint32_t x = 0; x < c_gridDim; ++x)
+			{
+				bool const isStatic = (x + z) % 4 != 0;
+				kt::Mat4 const mtx = kt::Mat4::Translation(kt::Vec3(float(x) * c_gridSpacing, 0.0f, float(z) * c_gridSpacing));
+				gfx::Scene::InstanceHandle const handle = scene.AddModelInstance(model, mtx, isStatic);
+
+				if (!isStatic)
+				{
+					dynamicInstances.PushBack(handle);
+				}
+			}
+		}
+
+		// Instances keep their model loaded.
+		gfx::ResourceManager::Release(model);
+
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			gfx::Light& light = scene.m_lights.PushBack();
+			light.m_type = i % 2 ? gfx::Light::Type::Point : gfx::Light::Type::Spot;
+			light.m_radius = 4.0f;
+			light.m_spotInnerAngle = 0.3f;
+			light.m_spotOuterAngle = 0.6f;
+			light.m_transform = kt::Mat4::Translation(kt::Vec3(float(i % 8) * 6.0f, 2.0f, float(i / 8) * 6.0f));
+		}
+
+		gfx::Camera cam;
+		InitCamera(cam);
+
+		float const dt = 1.0f / 60.0f;
+
+		for (uint32_t frame = 0; frame < 4; ++frame)
+		{
+			headless::RenderSceneFrame(scene, cam, dt);
+			headless::NextFrame();
+
+			TEST_CHECK(gpu::LastFrameCommandStats_Null().m_numDraws > 0);
+			TEST_CHECK(scene.m_mainView.m_renderer.GetCullStats().m_numVisible > 0);
+		}
+
+		// Dynamic instances moving, static ones being removed and hidden.
+		for (uint32_t i = 0; i < dynamicInstances.Size(); ++i)
+		{
+			scene.SetInstanceTransform(dynamicInstances[i], kt::Mat4::Translation(kt::Vec3(float(i), 1.0f, 20.0f)));
+		}
+
+		gfx::Scene::InstanceHandle const removed = scene.m_modelInstances[1].m_handle;
+		scene.RemoveModelInstance(removed);
+		TEST_CHECK(!scene.IsInstanceLive(removed));
+		scene.SetInstanceVisible(scene.m_modelInstances[2].m_handle, false);
+
+		headless::RenderSceneFrame(scene, cam, dt);
+		headless::NextFrame();
+		TEST_CHECK(gpu::LastFrameCommandStats_Null().m_numDraws > 0);
+
+		// Static batches bake unified buffer offsets, they must rebuild after compaction moves the mesh.
+		uint32_t const testMeshIndexOffset = gfx::ResourceManager::GetMesh(testMesh)->m_unifiedBufferIndexOffset;
+		uint32_t const generation = gfx::ResourceManager::UnifiedBuffersGeneration();
+
+		gfx::ResourceManager::Release(spacerMesh);
+		gfx::ResourceManager::CompactUnifiedBuffers();
+
+		TEST_CHECK(gfx::ResourceManager::UnifiedBuffersGeneration() != generation);
+		TEST_CHECK(gfx::ResourceManager::GetMesh(testMesh)->m_unifiedBufferIndexOffset < testMeshIndexOffset);
+
+		headless::RenderSceneFrame(scene, cam, dt);
+		headless::NextFrame();
+		TEST_CHECK(scene.m_staticBatchesUnifiedGeneration == gfx::ResourceManager::UnifiedBuffersGeneration());
+
+		// Gpu culling path, on the null backend the culling dispatches are only validated.
+		bool const prevGpuCulling = headless::SetCVar("gfx.gpu_culling", true);
+
+		for (uint32_t frame = 0; frame < 2; ++frame)
+		{
+			headless::RenderSceneFrame(scene, cam, dt);
+			headless::NextFrame();
+			TEST_CHECK(gpu::LastFrameCommandStats_Null().m_numCommands[uint32_t(gpu::CommandType_Null::Dispatch)] > 0);
+		}
+
+		headless::SetCVar("gfx.gpu_culling", prevGpuCulling);
+	}
+
+	headless::Shutdown();
+}
\ No newline at end of file
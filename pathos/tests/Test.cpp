@@ -0,0 +1,98 @@
+#include "Test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <kt/Timer.h>
+
+#include <core/Memory.h>
+#include <core/Jobs.h>
+
+namespace test
+{
+
+struct RegisteredTest
+{
+	char const* m_name;
+	TestFn m_fn;
+};
+
+static uint32_t const c_maxTests = 256;
+
+struct Registry
+{
+	RegisteredTest m_tests[c_maxTests];
+	uint32_t m_numTests = 0;
+
+	uint32_t m_numFailedChecks = 0;
+};
+
+// Function local so registrars in other translation units can run first.
+static Registry& GetRegistry()
+{
+	static Registry s_registry;
+	return s_registry;
+}
+
+Registrar::Registrar(char const* _name, TestFn _fn)
+{
+	Registry& registry = GetRegistry();
+	KT_ASSERT(registry.m_numTests < c_maxTests);
+	registry.m_tests[registry.m_numTests++] = RegisteredTest{ _name, _fn };
+}
+
+void ReportFailure(char const* _expr, char const* _file, int _line)
+{
+	printf("  %s(%d): check failed: %s\n", _file, _line, _expr);
+	++GetRegistry().m_numFailedChecks;
+}
+
+}
+
+int main(int _argc, char** _argv)
+{
+	uint32_t const c_frameAllocatorSize = 64 * 1024 * 1024;
+	uint32_t const c_workerFrameAllocatorSize = 16 * 1024 * 1024;
+	core::InitThreadFrameAllocator(c_frameAllocatorSize);
+	core::jobs::Init(c_workerFrameAllocatorSize);
+
+	char const* filter = _argc > 1 ? _argv[1] : nullptr;
+
+	test::Registry& registry = test::GetRegistry();
+
+	uint32_t numRun = 0;
+	uint32_t numFailed = 0;
+
+	for (uint32_t testIdx = 0; testIdx < registry.m_numTests; ++testIdx)
+	{
+		test::RegisteredTest const& entry = registry.m_tests[testIdx];
+		if (filter && !strstr(entry.m_name, filter))
+		{
+			continue;
+		}
+
+		printf("%s\n", entry.m_name);
+
+		uint32_t const failedBefore = registry.m_numFailedChecks;
+		kt::TimePoint const start = kt::TimePoint::Now();
+
+		entry.m_fn();
+
+		double const ms = (kt::TimePoint::Now() - start).Seconds() * 1000.0;
+		bool const passed = registry.m_numFailedChecks == failedBefore;
+		printf("  %s (%.2fms)\n", passed ? "passed" : "FAILED", ms);
+
+		++numRun;
+		numFailed += passed ? 0 : 1;
+
+		core::ResetThreadFrameAllocator();
+		core::jobs::ResetWorkerFrameAllocators();
+	}
+
+	printf("%u/%u tests passed.\n", numRun - numFailed, numRun);
+
+	core::jobs::Shutdown();
+	core::ShutdownThreadFrameAllocator();
+
+	return numFailed ? 1 : 0;
+}
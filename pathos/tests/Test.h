@@ -0,0 +1,34 @@
+#pragma once
+#include <kt/kt.h>
+#include <kt/Macros.h>
+
+// Minimal self registering tests, all linked into the pathos_tests executable.
+// Run with no arguments for every test, or with a substring to run only matching tests.
+
+namespace test
+{
+
+using TestFn = void(*)();
+
+struct Registrar
+{
+	Registrar(char const* _name, TestFn _fn);
+};
+
+// Logs the failure and marks the running test as failed, the test carries on.
+void ReportFailure(char const* _expr, char const* _file, int _line);
+
+}
+
+#define PATHOS_TEST(_name) \
+	static void _name(); \
+	static test::Registrar const s_registrar_##_name(#_name, &_name); \
+	static void _name()
+
+#define TEST_CHECK(_expr) \
+	KT_MACRO_BLOCK_BEGIN \
+		if (!(_expr)) \
+		{ \
+			test::ReportFailure(#_expr, __FILE__, __LINE__); \
+		} \
+	KT_MACRO_BLOCK_END